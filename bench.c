@@ -0,0 +1,1152 @@
+// Đo hiệu năng (--bench-*): các nhân tổng lũy thừa, số luồng, cửa sổ trượt, nhiều chuỗi,
+// dự báo hàng loạt, bộ nhớ đệm kết quả; bộ đo tổng hợp và sinh dữ liệu (--bench-suite, --generate);
+// thông lượng và độ trễ của máy chủ (--bench-server)
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "lsq.h"
+#include "bench.h"
+#include "server.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// ===== Đo hiệu năng =====
+
+// Cách tính cũ của polyRegression: pow() cho từng lũy thừa, từng điểm
+static void powerSumsPow(const double *x, const double *y, int n, double shift,
+                         int degree, double *sx, double *sxy, double *syy) {
+    for (int i = 0; i <= 2*degree; i++) {
+        for (int j = 0; j < n; j++) {
+            sx[i] += pow(x[j], i);
+        }
+    }
+    for (int i = 0; i <= degree; i++) {
+        for (int j = 0; j < n; j++) {
+            sxy[i] += pow(x[j], i) * (y[j] - shift);
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        *syy += (y[j] - shift) * (y[j] - shift);
+    }
+}
+
+// Thời gian ngắn nhất (ms) của vài lần chạy một nhân tổng lũy thừa
+static double timePowerSums(PowerSumFn fn, const double *x, const double *y, int n,
+                            int degree, int repeats, double *sums) {
+    double best = 1e300;
+    for (int r = 0; r < repeats; r++) {
+        memset(sums, 0, (size_t)(3 * degree + 3) * sizeof(double));
+        double t0 = nowSeconds();
+        fn(x, y, n, 0.0, degree, sums, sums + 2 * degree + 1, sums + 3 * degree + 2);
+        double t = (nowSeconds() - t0) * 1e3;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+// So sánh nhân tổng lũy thừa với cách dùng pow() cho bậc 1..20
+int benchPowerSums(int n) {
+    double *x = (double*)malloc((size_t)n * sizeof(double));
+    double *y = (double*)malloc((size_t)n * sizeof(double));
+    double *ref = (double*)malloc(64 * sizeof(double));
+    double *sums = (double*)malloc(64 * sizeof(double));
+    if (!x || !y || !ref || !sums) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    // x trong [-1, 1] để lũy thừa bậc 40 không tràn số
+    unsigned long long state = 12345;
+    for (int i = 0; i < n; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        x[i] = (double)(state >> 11) / 9007199254740992.0 * 2.0 - 1.0;
+        y[i] = 1.0 + 2.0 * x[i] - 0.5 * x[i] * x[i];
+    }
+
+    PowerSumKernel kernels[3];
+    int count = availablePowerSumKernels(kernels, 3);
+    printf("Tong luy thua, %d diem (thoi gian ms, toc do so voi pow)\n", n);
+    printf("%-6s %10s", "bac", "pow");
+    for (int k = 0; k < count; k++) printf(" %10s %8s", kernels[k].name, "x");
+    printf(" %10s\n", "sai so");
+
+    for (int degree = 1; degree <= 20; degree++) {
+        double tPow = timePowerSums(powerSumsPow, x, y, n, degree, 1, ref);
+        printf("%-6d %10.2lf", degree, tPow);
+        double maxErr = 0;
+        for (int k = 0; k < count; k++) {
+            double t = timePowerSums(kernels[k].fn, x, y, n, degree, 3, sums);
+            printf(" %10.2lf %8.1lf", t, safeDiv(tPow, t));
+            for (int j = 0; j < 3 * degree + 3; j++) {
+                double err = fabs(sums[j] - ref[j]) / (fabs(ref[j]) + 1.0);
+                if (err > maxErr) maxErr = err;
+            }
+        }
+        printf(" %10.1e\n", maxErr);
+        fflush(stdout);
+    }
+
+    free(x);
+    free(y);
+    free(ref);
+    free(sums);
+    return 0;
+}
+
+// Đo khả năng mở rộng theo số luồng; kiểm tra kết quả giống hệt bản 1 luồng
+int benchThreads(int n) {
+    Dataset ds;
+    initDataset(&ds);
+    if (reserveDataset(&ds, n) != 0) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    unsigned long long state = 12345;
+    for (int i = 0; i < n; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double noise = (double)(state >> 11) / 9007199254740992.0 - 0.5;
+        ds.x[i] = 1.0 + i * 1e-6;
+        ds.y[i] = 3.0 + 2.0 * ds.x[i] - 0.5 * ds.x[i] * ds.x[i] + noise;
+    }
+    ds.size = n;
+    DatasetView view = datasetView(&ds);
+
+    // Mặc định đến số CPU; --threads lớn hơn thì đo đến số đó
+    int maxThreads = getThreadCount() > hardwareThreads() ? getThreadCount() : hardwareThreads();
+    double coeff[3] = {3.0, 2.0, -0.5};
+    Moments ref, m;
+    if (initMoments(&ref, 3, MOMENT_LOGX | MOMENT_LOGY) != 0 ||
+        initMoments(&m, 3, MOMENT_LOGX | MOMENT_LOGY) != 0) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    double refR2 = 0, baseTime = 0;
+
+    printf("Mo-men bac 3 + ln x, ln y va R^2, %d diem\n", n);
+    printf("%-7s %12s %12s %10s %10s %12s\n", "luong", "mo-men ms", "R^2 ms", "Mdiem/s", "tang toc", "giong 1 luong");
+    for (int t = 1; ; t = t * 2 > maxThreads && t < maxThreads ? maxThreads : t * 2) {
+        setThreadCount(t);
+        double bestMoments = 1e300, bestR2 = 1e300, r2 = 0;
+        for (int r = 0; r < 3; r++) {
+            resetMoments(&m);
+            double t0 = nowSeconds();
+            accumulateMoments(&m, ds.x, ds.y, ds.size, NULL);
+            double t1 = nowSeconds();
+            r2 = calculateR2(&view, quadraticModel, coeff, 2);
+            double t2 = nowSeconds();
+            if (t1 - t0 < bestMoments) bestMoments = t1 - t0;
+            if (t2 - t1 < bestR2) bestR2 = t2 - t1;
+        }
+        if (t == 1) {
+            mergeMoments(&ref, &m);
+            ref.yShift = m.yShift;
+            refR2 = r2;
+            baseTime = bestMoments + bestR2;
+        }
+        int same = memcmp(ref.sx, m.sx, momentsBufferSize(3) * sizeof(double)) == 0 &&
+                   ref.syy == m.syy && ref.slnx == m.slnx && ref.slny == m.slny && r2 == refR2;
+        printf("%-7d %12.2lf %12.2lf %10.1lf %10.2lf %12s\n", t, bestMoments * 1e3, bestR2 * 1e3,
+               n / bestMoments * 1e-6, baseTime / (bestMoments + bestR2), same ? "co" : "KHONG");
+        fflush(stdout);
+        if (t >= maxThreads) break;
+    }
+
+    freeMoments(&ref);
+    freeMoments(&m);
+    freeDataset(&ds);
+    return 0;
+}
+
+// Sai lệch lớn nhất của hệ số (tương đối theo hệ số lớn nhất) giữa hai cách tính
+static double coeffDrift(OnlineFit *of, const Moments *exact) {
+    double drift = 0;
+    for (int i = 0; i < of->modelCount; i++) {
+        double a[MAX_MODELS + 2], b[MAX_MODELS + 2], r2;
+        if (onlineQuery(of, i, a, &r2) != FIT_OK ||
+            solveModel(NULL, exact, &of->models[i], &of->ws, b, &r2) != FIT_OK) continue;
+        int first = of->models[i].kind == MODEL_POLY ? 1 : 0;
+        int nc = coeffCount(&of->models[i]);
+        double scale = 0, diff = 0;
+        for (int k = first; k < nc; k++) {
+            if (fabs(b[k]) > scale) scale = fabs(b[k]);
+            if (fabs(a[k] - b[k]) > diff) diff = fabs(a[k] - b[k]);
+        }
+        if (safeDiv(diff, scale) > drift) drift = safeDiv(diff, scale);
+    }
+    return drift;
+}
+
+// Đo tốc độ trượt cửa sổ và sai lệch so với tính lại từ đầu
+int benchWindow(int n) {
+    static const char *specs[] = {"linear", "quadratic", "poly:5", "linear,log,exp"};
+    const int window = 1000;
+    double *x = (double*)malloc((size_t)n * sizeof(double));
+    double *y = (double*)malloc((size_t)n * sizeof(double));
+    if (!x || !y) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    unsigned long long state = 12345;
+    for (int i = 0; i < n; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        x[i] = 1.0 + (double)(state >> 11) / 9007199254740992.0;
+        y[i] = 2.0 + x[i] + 0.001 * i / n;
+    }
+
+    printf("Cua so %d diem, %d lan them diem\n", window, n);
+    printf("%-18s %12s %14s %14s\n", "mo hinh", "trieu/giay", "lech truot", "lech quen");
+    for (size_t t = 0; t < sizeof(specs) / sizeof(specs[0]); t++) {
+        ModelSpec models[MAX_MODELS];
+        int count = parseModelList(specs[t], models, MAX_MODELS);
+        WindowFit wf, ewf;
+        if (initWindowFit(&wf, models, count, window, 0) != 0 ||
+            initWindowFit(&ewf, models, count, 0, 0.999) != 0) {
+            fprintf(stderr, "Loi: Khong du bo nho!\n");
+            return 1;
+        }
+        double t0 = nowSeconds();
+        for (int i = 0; i < n; i++) windowAddPoint(&wf, x[i], y[i]);
+        double t1 = nowSeconds();
+        for (int i = 0; i < n; i++) windowAddPoint(&ewf, x[i], y[i]);
+
+        // So với khớp trực tiếp trên W điểm cuối
+        Moments exact;
+        initMoments(&exact, wf.fit.m.maxDegree, wf.fit.m.flags);
+        accumulateMoments(&exact, x + n - window, y + n - window, window, NULL);
+        // Hệ số quên: so với tổng có trọng số λ^k tính trực tiếp
+        Moments decayed;
+        initMoments(&decayed, ewf.fit.m.maxDegree, ewf.fit.m.flags);
+        int start = n > 40000 ? n - 40000 : 0;
+        double w = 1;
+        for (int i = n - 1; i >= start; i--, w *= 0.999) addMomentsPoint(&decayed, x[i], y[i], w);
+
+        double drift = coeffDrift(&wf.fit, &exact), ewDrift = coeffDrift(&ewf.fit, &decayed);
+        printf("%-18s %12.2lf %14.1e %14.1e\n", specs[t], n / (t1 - t0) * 1e-6, drift, ewDrift);
+        fflush(stdout);
+        freeMoments(&exact);
+        freeMoments(&decayed);
+        freeWindowFit(&wf);
+        freeWindowFit(&ewf);
+    }
+    free(x);
+    free(y);
+    return 0;
+}
+
+// Đo khớp count chuỗi ngắn (20-200 điểm): từng chuỗi qua fitModel so với fitSeriesBatch
+int benchSeries(int count) {
+    static const char *specs[] = {"linear", "quadratic", "exp"};
+    int *offsets = (int*)malloc(((size_t)count + 1) * sizeof(int));
+    if (!offsets) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    unsigned long long state = 2024;
+    offsets[0] = 0;
+    for (int s = 0; s < count; s++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        offsets[s + 1] = offsets[s] + 20 + (int)((state >> 33) % 181);
+    }
+    int n = offsets[count];
+    double *x = (double*)malloc((size_t)n * sizeof(double));
+    double *y = (double*)malloc((size_t)n * sizeof(double));
+    double *coeff = (double*)malloc((size_t)count * 3 * sizeof(double));
+    double *r2 = (double*)malloc((size_t)count * sizeof(double));
+    int *status = (int*)malloc((size_t)count * sizeof(int));
+    if (!x || !y || !coeff || !r2 || !status) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    for (int s = 0; s < count; s++) {
+        for (int i = offsets[s]; i < offsets[s + 1]; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            double noise = (double)(state >> 11) / 9007199254740992.0 - 0.5;
+            x[i] = (i - offsets[s]) * 0.1;
+            y[i] = 5.0 + 0.3 * s / count + 0.5 * x[i] + 0.01 * x[i] * x[i] + 0.1 * noise;
+        }
+    }
+    // Chạm trước các mảng kết quả để lỗi trang không tính vào lần đo đầu
+    memset(coeff, 0, (size_t)count * 3 * sizeof(double));
+    memset(r2, 0, (size_t)count * sizeof(double));
+    memset(status, 0, (size_t)count * sizeof(int));
+    SeriesBatch batch = {x, y, offsets, count};
+    FitWorkspace ws;
+    initWorkspace(&ws);
+    int threads = getThreadCount();
+
+    printf("%d chuoi, %d diem (thoi gian ms)\n", count, n);
+    printf("%-10s %12s %12s %8s %12s %8s %10s\n", "mo hinh", "tung chuoi", "lo 1 luong", "x",
+           "lo nhieu", "x", "sai lech");
+    for (size_t t = 0; t < sizeof(specs) / sizeof(specs[0]); t++) {
+        ModelSpec spec;
+        parseModelList(specs[t], &spec, 1);
+        int width = coeffCount(&spec);
+
+        // Từng chuỗi: một DatasetView và một lần fitModel cho mỗi chuỗi
+        double t0 = nowSeconds();
+        for (int s = 0; s < count; s++) {
+            DatasetView view = {x + offsets[s], y + offsets[s], offsets[s + 1] - offsets[s], NULL, NULL, 0, 0};
+            FitResult res;
+            fitModel(&view, &spec, SOLVER_NORMAL, &ws, &res);
+            wsReset(&ws);
+        }
+        double single = (nowSeconds() - t0) * 1e3;
+
+        setThreadCount(1);
+        t0 = nowSeconds();
+        fitSeriesBatch(&batch, &spec, coeff, r2, status);
+        double batchOne = (nowSeconds() - t0) * 1e3;
+        setThreadCount(threads);
+        t0 = nowSeconds();
+        fitSeriesBatch(&batch, &spec, coeff, r2, status);
+        double batchAll = (nowSeconds() - t0) * 1e3;
+
+        // Sai lệch tương đối lớn nhất so với fitModel
+        double drift = 0;
+        for (int s = 0; s < count; s += 97) {
+            DatasetView view = {x + offsets[s], y + offsets[s], offsets[s + 1] - offsets[s], NULL, NULL, 0, 0};
+            FitResult res;
+            if (fitModel(&view, &spec, SOLVER_NORMAL, &ws, &res) == FIT_OK && status[s] == FIT_OK) {
+                for (int k = 0; k < width; k++) {
+                    double d = fabs(res.coeff[k] - coeff[(size_t)s * width + k]) /
+                               (fabs(res.coeff[k]) + 1e-300);
+                    if (d > drift) drift = d;
+                }
+            }
+            wsReset(&ws);
+        }
+        printf("%-10s %12.1lf %12.1lf %8.1lf %12.1lf %8.1lf %10.1e\n", specs[t], single, batchOne,
+               single / batchOne, batchAll, single / batchAll, drift);
+        fflush(stdout);
+    }
+
+    freeWorkspace(&ws);
+    free(offsets);
+    free(x);
+    free(y);
+    free(coeff);
+    free(r2);
+    free(status);
+    return 0;
+}
+
+// Cách dự báo cũ: gọi hàm mô hình qua con trỏ cho từng điểm
+static double (*modelFunction(const ModelSpec *m))(double, double[]) {
+    switch (m->kind) {
+        case MODEL_LINEAR: return linearModel;
+        case MODEL_LOG: return logModel;
+        case MODEL_EXP: return expModel;
+        case MODEL_QUADRATIC: return quadraticModel;
+        default: return polyModel;
+    }
+}
+
+// Thời gian ngắn nhất (ms) của vài lần predict()
+static double timePredict(const ModelSpec *spec, const double *coeff, const double *x, double *y,
+                          int n, int repeats) {
+    double best = 1e300;
+    for (int r = 0; r < repeats; r++) {
+        double t0 = nowSeconds();
+        predict(spec, coeff, x, y, n);
+        double t = (nowSeconds() - t0) * 1e3;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+// Đo dự báo n điểm: gọi model(x, coeff) từng điểm so với predict()
+int benchPredict(int n) {
+    static const char *specs[] = {"linear", "log", "exp", "quadratic", "poly:5", "poly:10"};
+    double *x = (double*)malloc((size_t)n * sizeof(double));
+    double *ref = (double*)malloc((size_t)n * sizeof(double));
+    double *y = (double*)malloc((size_t)n * sizeof(double));
+    if (!x || !ref || !y) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    // x trong [0.5, 1.5] để log và lũy thừa bậc cao đều hữu hạn
+    unsigned long long state = 777;
+    for (int i = 0; i < n; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        x[i] = 0.5 + (double)(state >> 11) / 9007199254740992.0;
+    }
+    memset(ref, 0, (size_t)n * sizeof(double));
+    memset(y, 0, (size_t)n * sizeof(double));
+    int threads = getThreadCount();
+
+    printf("%d diem (thoi gian ms, toc do trieu diem/giay)\n", n);
+    printf("%-10s %10s %10s %10s %8s %10s %8s %10s\n", "mo hinh", "tung diem", "predict 1",
+           "Md/s", "x", "predict n", "x", "sai lech");
+    for (size_t t = 0; t < sizeof(specs) / sizeof(specs[0]); t++) {
+        ModelSpec spec;
+        parseModelList(specs[t], &spec, 1);
+        // Hệ số giảm dần để đa thức bậc cao không bị số hạng cuối lấn át
+        double coeff[12];
+        int width = coeffCount(&spec);
+        int first = spec.kind == MODEL_POLY ? 1 : 0;
+        coeff[0] = spec.degree;
+        for (int k = first; k < width; k++) coeff[k] = 1.0 / (1 + k - first);
+
+        double (*fn)(double, double[]) = modelFunction(&spec);
+        double single = 1e300;
+        for (int r = 0; r < 3; r++) {
+            double t0 = nowSeconds();
+            for (int i = 0; i < n; i++) ref[i] = fn(x[i], coeff);
+            double t = (nowSeconds() - t0) * 1e3;
+            if (t < single) single = t;
+        }
+
+        setThreadCount(1);
+        double one = timePredict(&spec, coeff, x, y, n, 3);
+        setThreadCount(threads);
+        double all = timePredict(&spec, coeff, x, y, n, 3);
+
+        double drift = 0;
+        for (int i = 0; i < n; i++) {
+            double d = fabs(y[i] - ref[i]) / (fabs(ref[i]) + 1e-300);
+            if (d > drift) drift = d;
+        }
+        printf("%-10s %10.1lf %10.1lf %10.1lf %8.1lf %10.1lf %8.1lf %10.1e\n", specs[t], single, one,
+               n / one * 1e-3, single / one, all, single / all, drift);
+        fflush(stdout);
+    }
+
+    free(x);
+    free(ref);
+    free(y);
+    return 0;
+}
+
+// Đo bộ nhớ đệm trên n điểm: khớp lần đầu (tích lũy mô-men), trùng kết quả, và
+// mô hình bậc thấp hơn giải từ mô-men đã lưu, so với khớp lại từ dữ liệu
+int benchCache(int n) {
+    static const char *derivedSpecs[] = {"linear", "log", "quadratic", "poly:3", "poly:4"};
+    double *x = (double*)malloc((size_t)n * sizeof(double));
+    double *y = (double*)malloc((size_t)n * sizeof(double));
+    if (!x || !y) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    unsigned long long state = 4242;
+    for (int i = 0; i < n; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        x[i] = 0.5 + (double)(state >> 11) / 9007199254740992.0;
+        y[i] = 1.0 + 2.0 * x[i] - 0.5 * x[i] * x[i] + 0.01 * ((double)(state >> 40) / 16777216.0 - 0.5);
+    }
+    DatasetView view = {x, y, n, NULL, NULL, 0, 0};
+    uint64_t fp = hashColumns(x, y, NULL, (size_t)n);
+    FitWorkspace ws;
+    initWorkspace(&ws);
+    ModelSpec full, logSpec;
+    parseModelList("poly:5", &full, 1);
+    parseModelList("log", &logSpec, 1);
+    ModelSpec first[2] = {full, logSpec};
+    FitResult res[2];
+
+    printf("%d diem (thoi gian micro giay)\n", n);
+    double t0 = nowSeconds();
+    uint64_t h = hashColumns(x, y, NULL, (size_t)n);
+    printf("%-28s %12.1lf\n", "dau van tay (hashColumns)", (nowSeconds() - t0) * 1e6);
+    if (h != fp) return 1;
+
+    FitCache *cache = openFitCache(NULL);
+    if (!cache) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    t0 = nowSeconds();
+    cachedFitModels(cache, fp, &view, first, 2, SOLVER_NORMAL, &ws, res);
+    printf("%-28s %12.1lf\n", "lan dau poly:5,log", (nowSeconds() - t0) * 1e6);
+    wsReset(&ws);
+
+    int reps = 10000;
+    t0 = nowSeconds();
+    for (int r = 0; r < reps; r++) {
+        lookupFitCache(cache, fp, n, first, 2, SOLVER_NORMAL, &ws, res);
+        wsReset(&ws);
+    }
+    printf("%-28s %12.3lf\n", "trung poly:5,log", (nowSeconds() - t0) * 1e6 / reps);
+
+    printf("%-28s %12s %12s %8s\n", "tu tong luy thua", "bo nho dem", "khop lai", "x");
+    for (size_t t = 0; t < sizeof(derivedSpecs) / sizeof(derivedSpecs[0]); t++) {
+        ModelSpec spec;
+        parseModelList(derivedSpecs[t], &spec, 1);
+        t0 = nowSeconds();
+        int hit = lookupFitCache(cache, fp, n, &spec, 1, SOLVER_NORMAL, &ws, res);
+        double cached = (nowSeconds() - t0) * 1e6;
+        wsReset(&ws);
+        t0 = nowSeconds();
+        fitModels(&view, &spec, 1, SOLVER_NORMAL, &ws, res);
+        double refit = (nowSeconds() - t0) * 1e6;
+        wsReset(&ws);
+        printf("%-28s %12.1lf %12.1lf %8.0lf%s\n", derivedSpecs[t], cached, refit, refit / cached,
+               hit ? "" : "  (khong trung)");
+    }
+
+    closeFitCache(cache);
+    freeWorkspace(&ws);
+    free(x);
+    free(y);
+    return 0;
+}
+
+// ===== Sinh dữ liệu tổng hợp và bộ đo tổng hợp (--bench-suite) =====
+
+static const char *noiseNames[NOISE_COUNT] = {"none", "gauss", "heavy", "outliers"};
+static const char *xRangeNames[XRANGE_COUNT] = {"unit", "offset", "wide"};
+static const char *familyNames[FAMILY_COUNT] = {"poly", "log", "exp"};
+
+static int parseName(const char *name, const char *names[], int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+int parseNoise(const char *name) { return parseName(name, noiseNames, NOISE_COUNT); }
+int parseXRange(const char *name) { return parseName(name, xRangeNames, XRANGE_COUNT); }
+int parseFamily(const char *name) { return parseName(name, familyNames, FAMILY_COUNT); }
+
+// Số ngẫu nhiên theo bộ đếm: cùng (seed, k) luôn cho cùng giá trị, trong (0, 1)
+static double uniformAt(uint64_t seed, uint64_t k) {
+    uint64_t h = seed + (k + 1) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return ((double)(h >> 11) + 0.5) / 9007199254740992.0;
+}
+
+// Nhiễu của điểm i: gauss σ = 0.05; heavy: Student-t 2 bậc tự do (đuôi dày);
+// outliers: gauss và 2% điểm lệch ±1
+static double noiseAt(int noise, uint64_t seed, long long i) {
+    if (noise == NOISE_NONE) return 0;
+    uint64_t k = (uint64_t)i * 4;
+    double z = sqrt(-2.0 * log(uniformAt(seed, k))) * cos(6.283185307179586 * uniformAt(seed, k + 1));
+    switch (noise) {
+        case NOISE_HEAVY: return 0.05 * z / sqrt(-log(uniformAt(seed, k + 2)));
+        case NOISE_OUTLIERS: {
+            double u = uniformAt(seed, k + 3);
+            return 0.05 * z + (u < 0.01 ? -1.0 : u > 0.99 ? 1.0 : 0.0);
+        }
+        default: return 0.05 * z;
+    }
+}
+
+// Khoảng x: unit [0.001, 1]; offset [1000, 1001] (đơn thức gần như phụ thuộc
+// tuyến tính); wide [0.001, 1000] chia đều theo log
+static double xAt(int range, long long i, long long n) {
+    double f = ((double)i + 0.5) / (double)n;
+    switch (range) {
+        case XRANGE_OFFSET: return 1000.0 + f;
+        case XRANGE_WIDE: return 1e-3 * pow(1e6, f);
+        default: return 1e-3 + 0.999 * f;
+    }
+}
+
+// Đường cong thật theo t = vị trí chuẩn hóa của x trong khoảng, t ∈ [-1, 1]:
+// poly: đa thức bậc 4 của t; log: 2 + 0.75 ln x; exp: e^(0.3 + 0.8 t) nhân nhiễu
+static double curveAt(int family, int range, double x, double noise) {
+    double lo, hi;
+    switch (range) {
+        case XRANGE_OFFSET: lo = 1000.0; hi = 1001.0; break;
+        case XRANGE_WIDE: lo = 1e-3; hi = 1e3; break;
+        default: lo = 1e-3; hi = 1.0; break;
+    }
+    double t = 2.0 * (x - lo) / (hi - lo) - 1.0;
+    switch (family) {
+        case FAMILY_LOG: return 2.0 + 0.75 * log(x) + noise;
+        case FAMILY_EXP: return exp(0.3 + 0.8 * t + noise);
+        default: return 1.0 + t + t * t * (0.5 + t * (-0.3 + 0.1 * t)) + noise;
+    }
+}
+
+// Sinh n điểm vào ds (nội dung cũ bị thay); trả về -1 nếu không đủ bộ nhớ
+int generateDataset(Dataset *ds, int n, int family, int noise, int range, uint64_t seed) {
+    clearDataset(ds);
+    if (reserveDataset(ds, n) != 0) return -1;
+    for (int i = 0; i < n; i++) {
+        double x = xAt(range, i, n);
+        ds->x[i] = x;
+        ds->y[i] = curveAt(family, range, x, noiseAt(noise, seed, i));
+    }
+    ds->size = n;
+    return 0;
+}
+
+// Ghi ds ra file văn bản "x y" với đủ chữ số để đọc lại chính xác
+static int saveTextFile(const char *path, const Dataset *ds) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+    for (int i = 0; i < ds->size; i++) fprintf(f, "%.17g %.17g\n", ds->x[i], ds->y[i]);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// Sinh dữ liệu ra file (đuôi .bin: nhị phân, còn lại văn bản)
+int generateFile(const char *path, int n, int family, int noise, int range, uint64_t seed) {
+    Dataset ds;
+    initDataset(&ds);
+    if (generateDataset(&ds, n, family, noise, range, seed) != 0) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    size_t len = strlen(path);
+    int binary = len >= 4 && strcmp(path + len - 4, ".bin") == 0;
+    int rc = binary ? saveBinaryFile(path, &ds) : saveTextFile(path, &ds);
+    if (rc != 0) {
+        fprintf(stderr, "Loi ghi file %s: %s\n", path, strerror(errno));
+    } else {
+        fprintf(stderr, "Da ghi %d diem (%s, nhieu %s, x %s) vao %s\n", n, familyNames[family],
+                noiseNames[noise], xRangeNames[range], path);
+    }
+    freeDataset(&ds);
+    return rc != 0;
+}
+
+// Khớp tham chiếu bằng long double trên t = (u - c) / h với u = x (log: ln x),
+// v = y (exp: ln y): tổng theo khối 4096 điểm rồi giải phương trình chuẩn tắc
+// có chọn phần tử trụ. Trên t ∈ [-1, 1] ma trận có điều kiện tốt nên sai số chỉ
+// cỡ vài ulp của long double, đủ làm chuẩn cho các bộ giải double.
+#define REF_MAX_DEGREE 8
+
+typedef struct {
+    int family, degree;
+    long double c, h;
+    long double coeff[REF_MAX_DEGREE + 1];
+} RefFit;
+
+static long double refU(int family, double x) {
+    return family == FAMILY_LOG ? logl((long double)x) : (long double)x;
+}
+
+static int referenceFit(const DatasetView *ds, int family, int degree, RefFit *ref) {
+    int d = degree, n = ds->size;
+    ref->family = family;
+    ref->degree = d;
+    long double lo = refU(family, ds->x[0]), hi = lo;
+    for (int i = 1; i < n; i++) {
+        long double u = refU(family, ds->x[i]);
+        if (u < lo) lo = u;
+        if (u > hi) hi = u;
+    }
+    ref->c = (lo + hi) / 2;
+    ref->h = hi > lo ? (hi - lo) / 2 : 1;
+
+    long double S[2 * REF_MAX_DEGREE + 1] = {0}, B[REF_MAX_DEGREE + 1] = {0};
+    for (int begin = 0; begin < n; begin += 4096) {
+        int end = begin + 4096 < n ? begin + 4096 : n;
+        long double s[2 * REF_MAX_DEGREE + 1] = {0}, b[REF_MAX_DEGREE + 1] = {0};
+        for (int i = begin; i < end; i++) {
+            if (family == FAMILY_EXP && ds->y[i] <= 0) continue;
+            long double t = (refU(family, ds->x[i]) - ref->c) / ref->h;
+            long double v = family == FAMILY_EXP ? logl((long double)ds->y[i]) : (long double)ds->y[i];
+            long double p = 1;
+            for (int k = 0; k <= 2 * d; k++) {
+                s[k] += p;
+                if (k <= d) b[k] += p * v;
+                p *= t;
+            }
+        }
+        for (int k = 0; k <= 2 * d; k++) S[k] += s[k];
+        for (int k = 0; k <= d; k++) B[k] += b[k];
+    }
+
+    long double A[REF_MAX_DEGREE + 1][REF_MAX_DEGREE + 2];
+    for (int i = 0; i <= d; i++) {
+        for (int j = 0; j <= d; j++) A[i][j] = S[i + j];
+        A[i][d + 1] = B[i];
+    }
+    for (int col = 0; col <= d; col++) {
+        int pivot = col;
+        for (int r = col + 1; r <= d; r++) {
+            if (fabsl(A[r][col]) > fabsl(A[pivot][col])) pivot = r;
+        }
+        if (A[pivot][col] == 0) return -1;
+        for (int j = 0; j <= d + 1; j++) {
+            long double tmp = A[col][j];
+            A[col][j] = A[pivot][j];
+            A[pivot][j] = tmp;
+        }
+        for (int r = col + 1; r <= d; r++) {
+            long double f = A[r][col] / A[col][col];
+            for (int j = col; j <= d + 1; j++) A[r][j] -= f * A[col][j];
+        }
+    }
+    for (int i = d; i >= 0; i--) {
+        long double v = A[i][d + 1];
+        for (int j = i + 1; j <= d; j++) v -= A[i][j] * ref->coeff[j];
+        ref->coeff[i] = v / A[i][i];
+    }
+    return 0;
+}
+
+static long double refPredict(const RefFit *ref, double x) {
+    long double t = (refU(ref->family, x) - ref->c) / ref->h;
+    long double p = ref->coeff[ref->degree];
+    for (int k = ref->degree - 1; k >= 0; k--) p = p * t + ref->coeff[k];
+    return ref->family == FAMILY_EXP ? expl(p) : p;
+}
+
+// R^2 tham chiếu (long double, hai lượt) của đường tham chiếu trên dữ liệu
+static double refR2(const DatasetView *ds, const RefFit *ref) {
+    long double mean = 0, ssRes = 0, ssTot = 0;
+    for (int i = 0; i < ds->size; i++) mean += ds->y[i];
+    mean /= ds->size;
+    for (int i = 0; i < ds->size; i++) {
+        long double e = ds->y[i] - refPredict(ref, ds->x[i]);
+        long double m = ds->y[i] - mean;
+        ssRes += e * e;
+        ssTot += m * m;
+    }
+    return (double)(1.0L - ssRes / ssTot);
+}
+
+// Sai số tương đối lớn nhất của đường đã khớp so với tham chiếu trên tối đa
+// m điểm rải đều trong dữ liệu: max |ŷ - ŷref| / max |ŷref|
+static double fitError(const DatasetView *ds, const FitResult *res, const RefFit *ref,
+                       double *xs, double *ys, int m) {
+    if (res->status != FIT_OK) return NAN;
+    if (m > ds->size) m = ds->size;
+    for (int j = 0; j < m; j++) xs[j] = ds->x[(long long)j * ds->size / m];
+    predict(&res->model, res->coeff, xs, ys, m);
+    long double maxDiff = 0, maxRef = 0;
+    for (int j = 0; j < m; j++) {
+        long double r = refPredict(ref, xs[j]);
+        long double diff = fabsl((long double)ys[j] - r);
+        if (!(diff == diff)) return INFINITY;
+        if (diff > maxDiff) maxDiff = diff;
+        if (fabsl(r) > maxRef) maxRef = fabsl(r);
+    }
+    return maxRef > 0 ? (double)(maxDiff / maxRef) : (double)maxDiff;
+}
+
+// Một dòng kết quả: in bảng và (nếu có) ghi bản ghi JSON
+typedef struct {
+    FILE *json;
+    int records;
+} SuiteOutput;
+
+static void jsonNumber(FILE *f, const char *key, double v) {
+    if (isfinite(v)) fprintf(f, ", \"%s\": %.6g", key, v);
+    else fprintf(f, ", \"%s\": null", key);
+}
+
+static void suiteRecord(SuiteOutput *out, int n, int range, int noise, const char *op,
+                        const char *status, double seconds, double bytes, double error) {
+    double pps = seconds > 0 ? n / seconds : NAN;
+    double bps = seconds > 0 && bytes > 0 ? bytes / seconds : NAN;
+    printf("%-11d %-7s %-9s %-18s %-15s %12.3lf %10.2lf %10.1lf %10.1e\n", n, xRangeNames[range],
+           noiseNames[noise], op, status, seconds * 1e3, pps * 1e-6, bps / 1048576.0, error);
+    fflush(stdout);
+    if (!out->json) return;
+    fprintf(out->json, "%s\n    {\"n\": %d, \"x_range\": \"%s\", \"noise\": \"%s\", \"op\": \"%s\", "
+            "\"status\": \"%s\"", out->records++ ? "," : "", n, xRangeNames[range], noiseNames[noise],
+            op, status);
+    jsonNumber(out->json, "seconds", seconds);
+    jsonNumber(out->json, "points_per_sec", pps);
+    jsonNumber(out->json, "bytes_per_sec", bps);
+    jsonNumber(out->json, "rel_error", error);
+    fprintf(out->json, "}");
+}
+
+// Số lần lặp để mỗi phép đo kéo dài đủ lâu; lấy lần nhanh nhất
+static int suiteRepeats(int n) {
+    return n <= 10000 ? 50 : n <= 1000000 ? 5 : 2;
+}
+
+static double timeFit(const DatasetView *ds, const ModelSpec *spec, int solver, FitWorkspace *ws,
+                      FitResult *res, int repeats) {
+    double best = 1e300;
+    for (int r = 0; r < repeats; r++) {
+        wsReset(ws);
+        double t0 = nowSeconds();
+        fitModel(ds, spec, solver, ws, res);
+        double t = nowSeconds() - t0;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+static double timeLoad(const char *path, Dataset *ds, int repeats, int *err) {
+    double best = 1e300;
+    for (int r = 0; r < repeats; r++) {
+        LoadReport rep;
+        double t0 = nowSeconds();
+        *err = loadDatasetFile(path, ds, &rep, 0);
+        double t = nowSeconds() - t0;
+        if (*err != LOAD_OK) return NAN;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+static double fileBytes(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NAN;
+    fseek(f, 0, SEEK_END);
+    double size = (double)ftell(f);
+    fclose(f);
+    return size;
+}
+
+#define SUITE_TEXT_FILE "pbl_bench.tmp.txt"
+#define SUITE_BINARY_FILE "pbl_bench.tmp.bin"
+#define SUITE_SAMPLES 4096
+
+// Đo một cỡ dữ liệu với mọi khoảng x và mô hình nhiễu
+static int suiteSize(SuiteOutput *out, int n, FitWorkspace *ws) {
+    Dataset ds, loaded;
+    initDataset(&ds);
+    initDataset(&loaded);
+    double *xs = (double*)malloc(SUITE_SAMPLES * sizeof(double));
+    double *ys = (double*)malloc(SUITE_SAMPLES * sizeof(double));
+    double *pred = (double*)malloc((size_t)n * sizeof(double));
+    if (!xs || !ys || !pred || reserveDataset(&ds, n) != 0) {
+        suiteRecord(out, n, XRANGE_UNIT, NOISE_NONE, "-", "no_memory", NAN, NAN, NAN);
+        free(xs);
+        free(ys);
+        free(pred);
+        freeDataset(&ds);
+        return -1;
+    }
+    int repeats = suiteRepeats(n);
+    double bytes = 2.0 * sizeof(double) * n;  // khớp, R^2 đọc x và y; dự báo đọc x, ghi ŷ
+    static const struct { const char *op; const char *spec; int family, solver, refDegree; } fits[] = {
+        {"fit_linear", "linear", FAMILY_POLY, SOLVER_NORMAL, 1},
+        {"fit_quadratic", "quadratic", FAMILY_POLY, SOLVER_NORMAL, 2},
+        {"fit_poly5", "poly:5", FAMILY_POLY, SOLVER_NORMAL, 5},
+        {"fit_poly5_qr_ortho", "poly:5", FAMILY_POLY, SOLVER_QR_ORTHO, 5},
+        {"fit_log", "log", FAMILY_LOG, SOLVER_NORMAL, 1},
+        {"fit_exp", "exp", FAMILY_EXP, SOLVER_NORMAL, 1},
+    };
+
+    for (int range = 0; range < XRANGE_COUNT; range++) {
+        for (int noise = 0; noise < NOISE_COUNT; noise++) {
+            uint64_t seed = 1000003ULL * (uint64_t)n + 101ULL * (uint64_t)range + (uint64_t)noise;
+            int family = -1;
+            RefFit ref;
+            FitResult poly5;
+            memset(&poly5, 0, sizeof(poly5));
+            for (size_t f = 0; f < sizeof(fits) / sizeof(fits[0]); f++) {
+                if (fits[f].family != family) {
+                    family = fits[f].family;
+                    generateDataset(&ds, n, family, noise, range, seed);
+                }
+                DatasetView view = datasetView(&ds);
+                ModelSpec spec;
+                parseModelList(fits[f].spec, &spec, 1);
+                FitResult res;
+                double t = timeFit(&view, &spec, fits[f].solver, ws, &res, repeats);
+                double err = referenceFit(&view, family, fits[f].refDegree, &ref) == 0
+                             ? fitError(&view, &res, &ref, xs, ys, SUITE_SAMPLES) : NAN;
+                suiteRecord(out, n, range, noise, fits[f].op, fitStatusName(res.status), t, bytes, err);
+
+                // R^2 và dự báo của đa thức bậc 5 (bộ giải normal) trên cùng dữ liệu
+                if (f != 2 || res.status != FIT_OK) continue;
+                poly5 = res;
+                double r2 = 0, best = 1e300;
+                for (int r = 0; r < repeats; r++) {
+                    double t0 = nowSeconds();
+                    r2 = calculateR2(&view, polyModel, poly5.coeff, 5);
+                    double elapsed = nowSeconds() - t0;
+                    if (elapsed < best) best = elapsed;
+                }
+                suiteRecord(out, n, range, noise, "r2", "ok", best, bytes, fabs(r2 - refR2(&view, &ref)));
+                best = 1e300;
+                for (int r = 0; r < repeats; r++) {
+                    double t0 = nowSeconds();
+                    predict(&poly5.model, poly5.coeff, ds.x, pred, n);
+                    double elapsed = nowSeconds() - t0;
+                    if (elapsed < best) best = elapsed;
+                }
+                suiteRecord(out, n, range, noise, "predict_poly5", "ok", best, bytes, NAN);
+            }
+            wsReset(ws);
+        }
+    }
+
+    // Đọc file: dữ liệu đa thức, nhiễu gauss, x unit; sai số là độ lệch so với dữ liệu gốc
+    generateDataset(&ds, n, FAMILY_POLY, NOISE_GAUSS, XRANGE_UNIT, 7);
+    const char *paths[2] = {SUITE_TEXT_FILE, SUITE_BINARY_FILE};
+    const char *ops[2] = {"load_text", "load_binary"};
+    for (int k = 0; k < 2; k++) {
+        int rc = k == 0 ? saveTextFile(paths[k], &ds) : saveBinaryFile(paths[k], &ds);
+        int err = LOAD_ERR_OPEN;
+        double t = rc == 0 ? timeLoad(paths[k], &loaded, repeats < 5 ? repeats : 5, &err) : NAN;
+        double drift = NAN;
+        if (err == LOAD_OK && loaded.size == n) {
+            drift = 0;
+            for (int i = 0; i < n; i++) {
+                double d = fabs(loaded.y[i] - ds.y[i]) + fabs(loaded.x[i] - ds.x[i]);
+                if (d > drift) drift = d;
+            }
+        }
+        suiteRecord(out, n, XRANGE_UNIT, NOISE_GAUSS, ops[k], err == LOAD_OK ? "ok" : loadErrorName(err),
+                    t, fileBytes(paths[k]), drift);
+        freeDataset(&loaded);
+        remove(paths[k]);
+    }
+
+    free(xs);
+    free(ys);
+    free(pred);
+    freeDataset(&ds);
+    return 0;
+}
+
+// Bộ đo tổng hợp: sizes là danh sách cỡ phân cách bởi dấu phẩy ("1e3,1e5"),
+// jsonPath khác NULL thì ghi thêm kết quả dạng JSON để so sánh giữa các phiên bản
+int benchSuite(const char *sizes, const char *jsonPath) {
+    int list[32], count = 0;
+    for (const char *p = sizes; *p && count < 32; ) {
+        char *end;
+        double v = strtod(p, &end);
+        if (end == p || v < 1 || v > INT_MAX) {
+            fprintf(stderr, "Danh sach kich thuoc khong hop le: %s\n", sizes);
+            return 1;
+        }
+        list[count++] = (int)v;
+        p = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            fprintf(stderr, "Danh sach kich thuoc khong hop le: %s\n", sizes);
+            return 1;
+        }
+    }
+
+    SuiteOutput out = {NULL, 0};
+    if (jsonPath) {
+        out.json = fopen(jsonPath, "w");
+        if (!out.json) {
+            fprintf(stderr, "Loi mo file %s: %s\n", jsonPath, strerror(errno));
+            return 1;
+        }
+        PowerSumKernel kernels[8];
+        int available = availablePowerSumKernels(kernels, 8);
+        const char *kernel = "scalar";
+        for (int k = 0; k < available; k++) {
+            if (kernels[k].fn == powerSumKernel()) kernel = kernels[k].name;
+        }
+        fprintf(out.json, "{\n  \"suite\": \"pblNOP-bench\",\n  \"format\": 1,\n");
+#ifdef __VERSION__
+        fprintf(out.json, "  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+        fprintf(out.json, "  \"threads\": %d,\n  \"kernel\": \"%s\",\n  \"results\": [",
+                getThreadCount(), kernel);
+    }
+
+    printf("Thoi gian ms (nhanh nhat), toc do trieu diem/giay va MB/giay, sai so tuong doi so voi\n"
+           "khop tham chieu long double (load: do lech so voi du lieu goc; r2: |R^2 - R^2 tham chieu|)\n");
+    printf("%-11s %-7s %-9s %-18s %-15s %12s %10s %10s %10s\n", "n", "x", "nhieu", "phep do",
+           "trang thai", "ms", "Mdiem/s", "MB/s", "sai so");
+    FitWorkspace ws;
+    initWorkspace(&ws);
+    for (int i = 0; i < count; i++) suiteSize(&out, list[i], &ws);
+    freeWorkspace(&ws);
+
+    if (out.json) {
+        fprintf(out.json, "\n  ]\n}\n");
+        if (fclose(out.json) != 0) {
+            fprintf(stderr, "Loi ghi file %s: %s\n", jsonPath, strerror(errno));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// ===== Máy chủ (--bench-server) =====
+//
+// Máy chủ chạy trong cùng tiến trình trên một socket tạm; các luồng client gửi
+// yêu cầu nhỏ (BENCH_SERVER_POINTS điểm nội tuyến, linear hoặc poly:2) xen với
+// yêu cầu khớp file giữ sẵn trên máy chủ. Lượt một client cho độ trễ khi không
+// có gì để gộp; lượt nhiều client đo thông lượng khi yêu cầu được gộp thành lô.
+
+#define BENCH_SERVER_POINTS 64
+#define BENCH_SERVER_CLIENTS 32
+#define BENCH_SERVER_FILE_EVERY 20      // mỗi chừng này yêu cầu có một yêu cầu khớp file
+
+#ifndef _WIN32
+typedef struct {
+    const char *socketPath;
+    const char *filePath;
+    int requests;
+    unsigned long long seed;
+    double *latency;        // requests phần tử (giây)
+    int failures;
+} BenchClient;
+
+typedef struct {
+    const char *socketPath;
+    int rc;
+} BenchServer;
+
+static void *benchServerThread(void *arg) {
+    BenchServer *s = (BenchServer*)arg;
+    ServerOptions opt = {(size_t)SERVER_RESIDENT_DEFAULT_MB << 20, SERVER_DEFAULT_CLIENTS};
+    s->rc = runServer(s->socketPath, &opt);
+    return NULL;
+}
+
+static void *benchClientThread(void *arg) {
+    BenchClient *c = (BenchClient*)arg;
+    int fd = serverConnect(c->socketPath);
+    if (fd < 0) {
+        c->failures = c->requests;
+        return NULL;
+    }
+    double x[BENCH_SERVER_POINTS], y[BENCH_SERVER_POINTS];
+    DatasetView view = {x, y, BENCH_SERVER_POINTS, NULL, NULL, 0, 0};
+    ModelSpec small[2], fileSpecs[2];
+    parseModelList("linear", &small[0], 1);
+    parseModelList("poly:2", &small[1], 1);
+    parseModelList("linear,poly:3", fileSpecs, 2);
+    FitWorkspace ws;
+    initWorkspace(&ws);
+    FitResult res[2];
+    unsigned long long state = c->seed;
+    for (int r = 0; r < c->requests; r++) {
+        for (int i = 0; i < BENCH_SERVER_POINTS; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            x[i] = i * 0.1;
+            y[i] = 1.0 + 2.0 * x[i] + 0.01 * ((double)(state >> 11) / 9007199254740992.0 - 0.5);
+        }
+        double t0 = nowSeconds();
+        int status;
+        if (r % BENCH_SERVER_FILE_EVERY == BENCH_SERVER_FILE_EVERY - 1) {
+            status = serverFitFile(fd, c->filePath, 0, SOLVER_NORMAL, fileSpecs, 2, &ws, res, NULL);
+        } else {
+            status = serverFitPoints(fd, &view, SOLVER_NORMAL, &small[r & 1], 1, &ws, res);
+            // Kiểm tra luôn hệ số góc để chắc máy chủ trả đúng kết quả của yêu cầu này
+            if (status == SERVER_OK && !(res[0].status == FIT_OK && fabs(res[0].coeff[(r & 1) ? 2 : 1] - 2.0) < 0.05)) {
+                status = SERVER_ERR_PROTOCOL;
+            }
+        }
+        c->latency[r] = nowSeconds() - t0;
+        if (status != SERVER_OK) c->failures++;
+        wsReset(&ws);
+    }
+    freeWorkspace(&ws);
+    serverClose(fd);
+    return NULL;
+}
+
+static int compareLatency(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Một lượt đo: clients luồng chia đều requests yêu cầu; in thông lượng và phân vị độ trễ
+static int runServerPhase(const char *socketPath, const char *filePath, int clients, int requests) {
+    BenchClient *c = (BenchClient*)calloc((size_t)clients, sizeof(BenchClient));
+    pthread_t *tid = (pthread_t*)malloc((size_t)clients * sizeof(pthread_t));
+    double *latency = (double*)malloc((size_t)requests * sizeof(double));
+    if (!c || !tid || !latency) {
+        free(c);
+        free(tid);
+        free(latency);
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+    int offset = 0;
+    for (int k = 0; k < clients; k++) {
+        c[k].socketPath = socketPath;
+        c[k].filePath = filePath;
+        c[k].requests = requests / clients + (k < requests % clients);
+        c[k].seed = 1000 + (unsigned long long)k;
+        c[k].latency = latency + offset;
+        offset += c[k].requests;
+    }
+    double t0 = nowSeconds();
+    int started = 0;
+    for (; started < clients; started++) {
+        if (pthread_create(&tid[started], NULL, benchClientThread, &c[started]) != 0) break;
+    }
+    int failures = 0;
+    for (int k = 0; k < started; k++) {
+        pthread_join(tid[k], NULL);
+        failures += c[k].failures;
+    }
+    double wall = nowSeconds() - t0;
+    int done = 0;
+    for (int k = 0; k < started; k++) done += c[k].requests;
+    qsort(latency, (size_t)done, sizeof(double), compareLatency);
+    if (done > 0) {
+        printf("%-10d %10d %12.0lf %10.1lf %10.1lf %10.1lf %8d\n", clients, done, done / wall,
+               latency[(done - 1) / 2] * 1e6, latency[(int)((done - 1) * 0.99)] * 1e6,
+               latency[done - 1] * 1e6, failures);
+    }
+    free(c);
+    free(tid);
+    free(latency);
+    return started < clients || failures > 0;
+}
+#endif
+
+int benchServer(int requests) {
+#ifdef _WIN32
+    (void)requests;
+    fprintf(stderr, "Che do may chu can Unix domain socket, chua ho tro tren Windows.\n");
+    return 1;
+#else
+    char socketPath[64], filePath[64];
+    snprintf(socketPath, sizeof(socketPath), "/tmp/pbl-bench-%ld.sock", (long)getpid());
+    snprintf(filePath, sizeof(filePath), "/tmp/pbl-bench-%ld.bin", (long)getpid());
+    Dataset ds;
+    initDataset(&ds);
+    if (generateDataset(&ds, 100000, FAMILY_POLY, NOISE_GAUSS, XRANGE_UNIT, 7) != 0 ||
+        saveBinaryFile(filePath, &ds) != 0) {
+        fprintf(stderr, "Loi ghi file %s: %s\n", filePath, strerror(errno));
+        freeDataset(&ds);
+        return 1;
+    }
+    freeDataset(&ds);
+
+    BenchServer server = {socketPath, 0};
+    pthread_t serverTid;
+    if (pthread_create(&serverTid, NULL, benchServerThread, &server) != 0) {
+        remove(filePath);
+        return 1;
+    }
+    // Chờ máy chủ mở socket (tối đa khoảng 5 giây)
+    int fd = -1;
+    for (int tries = 0; tries < 1000 && fd < 0; tries++) {
+        fd = serverConnect(socketPath);
+        if (fd < 0) {
+            struct timespec pause = {0, 5000000};
+            nanosleep(&pause, NULL);
+        }
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Loi ket noi may chu %s: %s\n", socketPath, strerror(errno));
+        pthread_join(serverTid, NULL);
+        remove(filePath);
+        return 1;
+    }
+
+    printf("%d yeu cau (%d diem noi tuyen; moi %d yeu cau co mot file %s giu tren may chu)\n",
+           requests, BENCH_SERVER_POINTS, BENCH_SERVER_FILE_EVERY, filePath);
+    printf("%-10s %10s %12s %10s %10s %10s %8s\n", "client", "yeu cau", "yeu cau/s", "p50 us",
+           "p99 us", "max us", "loi");
+    int rc = runServerPhase(socketPath, filePath, 1, requests / 4 > 0 ? requests / 4 : 1);
+    rc |= runServerPhase(socketPath, filePath, BENCH_SERVER_CLIENTS, requests);
+
+    double stats[SERVER_STAT_COUNT];
+    if (serverStats(fd, stats) == SERVER_OK) {
+        printf("May chu: %.0f yeu cau, %.0f gop theo %.0f lo (trung binh %.1f yeu cau/lo), "
+               "p99 = %.1f us\n", stats[SERVER_STAT_REQUESTS], stats[SERVER_STAT_BATCHED],
+               stats[SERVER_STAT_BATCHES],
+               stats[SERVER_STAT_BATCHES] > 0 ? stats[SERVER_STAT_BATCHED] / stats[SERVER_STAT_BATCHES] : 0.0,
+               stats[SERVER_STAT_P99] * 1e6);
+    }
+    serverShutdown(fd);
+    serverClose(fd);
+    pthread_join(serverTid, NULL);
+    remove(filePath);
+    return rc || server.rc;
+#endif
+}
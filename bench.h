@@ -0,0 +1,27 @@
+// Đo hiệu năng, gọi từ các tùy chọn --bench-* của chương trình
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "lsq.h"
+
+int benchPowerSums(int n);
+int benchThreads(int n);
+int benchWindow(int n);
+int benchSeries(int count);
+int benchPredict(int n);
+int benchCache(int n);
+int benchServer(int requests);
+
+// Dữ liệu tổng hợp cho bộ đo tổng hợp và --generate
+enum { NOISE_NONE, NOISE_GAUSS, NOISE_HEAVY, NOISE_OUTLIERS, NOISE_COUNT };
+enum { XRANGE_UNIT, XRANGE_OFFSET, XRANGE_WIDE, XRANGE_COUNT };
+enum { FAMILY_POLY, FAMILY_LOG, FAMILY_EXP, FAMILY_COUNT };
+
+int parseNoise(const char *name);
+int parseXRange(const char *name);
+int parseFamily(const char *name);
+int generateDataset(Dataset *ds, int n, int family, int noise, int range, uint64_t seed);
+int generateFile(const char *path, int n, int family, int noise, int range, uint64_t seed);
+int benchSuite(const char *sizes, const char *jsonPath);
+
+#endif
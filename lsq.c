@@ -0,0 +1,3402 @@
+// Phần tính toán của thư viện: song song hóa, vùng làm việc, tổng mô-men,
+// các bộ giải và khớp trực tuyến. Không in ra màn hình, không đọc file.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+#include "lsq.h"
+#include "lsq_trace.h"
+
+// ===== Song song hóa =====
+//
+// Dữ liệu được chia thành các khối PARALLEL_CHUNK điểm cố định, không phụ thuộc
+// số luồng. Mỗi khối cho ra tổng riêng, sau đó các tổng được cộng theo cây với
+// thứ tự cố định, nên kết quả giống hệt nhau từng bit với mọi số luồng.
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    int threadCount;        // số luồng mong muốn (kể cả luồng gọi)
+    int started;            // số luồng phụ đã tạo
+    unsigned generation;    // tăng mỗi khi có việc mới
+    ChunkFn fn;
+    void *ctx;
+    int taskCount, nextTask, remaining;
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+          0, 0, 0, NULL, NULL, 0, 0, 0};
+
+// Số CPU đang hoạt động
+int hardwareThreads(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// Đặt số luồng dùng cho các vòng tính toán (<= 0: theo số CPU)
+void setThreadCount(int n) {
+    pthread_mutex_lock(&pool.lock);
+    pool.threadCount = n > 0 ? n : hardwareThreads();
+    pthread_mutex_unlock(&pool.lock);
+}
+
+int getThreadCount(void) {
+    pthread_mutex_lock(&pool.lock);
+    if (pool.threadCount == 0) {
+        const char *env = getenv("PBL_THREADS");
+        int n = env ? atoi(env) : 0;
+        pool.threadCount = n > 0 ? n : hardwareThreads();
+    }
+    int n = pool.threadCount;
+    pthread_mutex_unlock(&pool.lock);
+    return n;
+}
+
+// Lấy và chạy các khối còn lại của việc hiện tại (đang giữ khóa)
+static void runPoolTasks(void) {
+    while (pool.nextTask < pool.taskCount) {
+        int task = pool.nextTask++;
+        pthread_mutex_unlock(&pool.lock);
+        pool.fn(pool.ctx, task);
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.remaining == 0) pthread_cond_signal(&pool.done);
+    }
+}
+
+static void *poolWorker(void *arg) {
+    int id = (int)(intptr_t)arg;
+    pthread_mutex_lock(&pool.lock);
+    unsigned seen = pool.generation;
+    for (;;) {
+        while (pool.generation == seen) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        seen = pool.generation;
+        // Luồng vượt quá số luồng hiện tại thì ngồi chờ
+        if (id < pool.threadCount - 1) runPoolTasks();
+    }
+    return NULL;
+}
+
+// Chạy fn(ctx, 0..taskCount-1) trên các luồng; trả về khi tất cả xong.
+// Không gọi lồng nhau từ bên trong fn.
+void parallelFor(int taskCount, ChunkFn fn, void *ctx) {
+    int threads = getThreadCount();
+    if (threads <= 1 || taskCount <= 1) {
+        for (int i = 0; i < taskCount; i++) fn(ctx, i);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.started < threads - 1) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, poolWorker, (void*)(intptr_t)pool.started) != 0) break;
+        pthread_detach(tid);
+        pool.started++;
+    }
+    pool.fn = fn;
+    pool.ctx = ctx;
+    pool.taskCount = taskCount;
+    pool.nextTask = 0;
+    pool.remaining = taskCount;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+
+    runPoolTasks();
+    while (pool.remaining > 0) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pool.fn = NULL;
+    pool.ctx = NULL;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Cộng các tổng của từng khối (parts[chunk*width + k]) theo cây cố định,
+// kết quả nằm ở parts[0..width-1]
+void reduceChunkSums(double *parts, int chunks, int width) {
+    for (int step = 1; step < chunks; step *= 2) {
+        for (int i = 0; i + step < chunks; i += 2 * step) {
+            for (int k = 0; k < width; k++) {
+                parts[i*width + k] += parts[(i+step)*width + k];
+            }
+        }
+    }
+}
+
+// Đồng hồ đơn điệu (giây)
+double nowSeconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, t;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static int chunkCount(int n) {
+    return (n + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+}
+
+// ===== Vùng nhớ làm việc (arena) =====
+//
+// Bộ nhớ tạm của các phép khớp (ma trận hệ số, tổng từng khối, hệ số...) được
+// cấp phát tuần tự từ một khối do người gọi sở hữu và trả lại cả loạt bằng
+// wsReset/wsRelease. Khi khối chính hết chỗ, wsAlloc mượn thêm khối phụ từ heap;
+// lần wsReset kế tiếp gộp lại thành một khối đủ lớn cho nhu cầu cao nhất, nên
+// khớp lặp lại nhiều chuỗi dữ liệu không cấp phát heap thêm lần nào.
+
+void initWorkspace(FitWorkspace *ws) {
+    memset(ws, 0, sizeof(*ws));
+}
+
+static size_t wsRound(size_t bytes) {
+    return (bytes + WS_ALIGN - 1) & ~(size_t)(WS_ALIGN - 1);
+}
+
+static void wsFreeOverflow(FitWorkspace *ws) {
+    while (ws->overflow) {
+        WsOverflow *next = ws->overflow->next;
+        free(ws->overflow);
+        ws->overflow = next;
+    }
+    ws->overflowBytes = 0;
+}
+
+void freeWorkspace(FitWorkspace *ws) {
+    wsFreeOverflow(ws);
+    free(ws->raw);
+    initWorkspace(ws);
+}
+
+// Đảm bảo khối chính có ít nhất bytes byte; chỉ gọi khi chưa cấp phát gì
+// (ngay sau initWorkspace hoặc wsReset). Trả về -1 nếu không đủ bộ nhớ.
+int wsReserve(FitWorkspace *ws, size_t bytes) {
+    bytes = wsRound(bytes);
+    if (ws->used != 0 || bytes <= ws->capacity) return 0;
+    free(ws->raw);
+    ws->raw = malloc(bytes + WS_ALIGN);
+    ws->heapAllocs++;
+    if (!ws->raw) {
+        ws->base = NULL;
+        ws->capacity = 0;
+        return -1;
+    }
+    ws->base = (unsigned char*)(((uintptr_t)ws->raw + WS_ALIGN - 1) & ~(uintptr_t)(WS_ALIGN - 1));
+    ws->capacity = bytes;
+    return 0;
+}
+
+// Cấp phát bytes byte căn lề WS_ALIGN; trả về NULL nếu hết bộ nhớ
+void *wsAlloc(FitWorkspace *ws, size_t bytes) {
+    bytes = wsRound(bytes ? bytes : 1);
+    void *p;
+    if (ws->capacity - ws->used >= bytes) {
+        p = ws->base + ws->used;
+        ws->used += bytes;
+    } else {
+        WsOverflow *block = (WsOverflow*)malloc(WS_ALIGN + bytes);
+        ws->heapAllocs++;
+        if (!block) return NULL;
+        block->next = ws->overflow;
+        ws->overflow = block;
+        ws->overflowBytes += bytes;
+        p = (unsigned char*)block + WS_ALIGN;
+    }
+    if (ws->used + ws->overflowBytes > ws->peak) ws->peak = ws->used + ws->overflowBytes;
+    return p;
+}
+
+// Vị trí hiện tại; wsRelease(ws, mark) trả lại mọi thứ cấp phát sau đó
+size_t wsMark(const FitWorkspace *ws) {
+    return ws->used;
+}
+
+void wsRelease(FitWorkspace *ws, size_t mark) {
+    ws->used = mark;
+}
+
+// Trả lại toàn bộ; nếu đã phải mượn khối phụ thì nới khối chính cho lần sau
+void wsReset(FitWorkspace *ws) {
+    ws->used = 0;
+    if (ws->overflow) {
+        wsFreeOverflow(ws);
+        wsReserve(ws, ws->peak);
+    }
+}
+
+// Dùng vùng nhớ của người gọi, hoặc một vùng tạm local nếu ws == NULL
+static FitWorkspace *wsBegin(FitWorkspace *ws, FitWorkspace *local, size_t *mark) {
+    if (!ws) {
+        initWorkspace(local);
+        ws = local;
+    }
+    *mark = wsMark(ws);
+    return ws;
+}
+
+static void wsEnd(FitWorkspace *ws, FitWorkspace *local, size_t mark) {
+    if (ws == local) {
+        freeWorkspace(local);
+    } else {
+        wsRelease(ws, mark);
+    }
+}
+
+double safeDiv(double a, double b) {
+    return (fabs(b) < DBL_EPSILON) ? 0.0 : (a / b);
+}
+
+// Tổng theo khối cho R^2
+typedef struct {
+    const DatasetView *ds;
+    double (*model)(double, double[]);
+    double *coeff;
+    double y_mean;
+    double *parts;
+} R2Job;
+
+static void sumYChunk(void *ctx, int chunk) {
+    R2Job *job = (R2Job*)ctx;
+    const DatasetView *ds = job->ds;
+    int begin = chunk * PARALLEL_CHUNK;
+    int end = begin + PARALLEL_CHUNK < ds->size ? begin + PARALLEL_CHUNK : ds->size;
+    double s = 0, sw = end - begin;
+    if (ds->w) {
+        sw = 0;
+        for (int i = begin; i < end; i++) {
+            s += ds->w[i] * ds->y[i];
+            sw += ds->w[i];
+        }
+    } else {
+        for (int i = begin; i < end; i++) {
+            s += ds->y[i];
+        }
+    }
+    job->parts[2*chunk] = s;
+    job->parts[2*chunk + 1] = sw;
+}
+
+static void residualChunk(void *ctx, int chunk) {
+    R2Job *job = (R2Job*)ctx;
+    const DatasetView *ds = job->ds;
+    int begin = chunk * PARALLEL_CHUNK;
+    int end = begin + PARALLEL_CHUNK < ds->size ? begin + PARALLEL_CHUNK : ds->size;
+    double ss_res = 0, ss_tot = 0;
+    for (int i = begin; i < end; i++) {
+        double y_pred = job->model(ds->x[i], job->coeff);
+        double wi = ds->w ? ds->w[i] : 1.0;
+        ss_res += wi * (ds->y[i] - y_pred) * (ds->y[i] - y_pred);
+        ss_tot += wi * (ds->y[i] - job->y_mean) * (ds->y[i] - job->y_mean);
+    }
+    job->parts[2*chunk] = ss_res;
+    job->parts[2*chunk + 1] = ss_tot;
+}
+
+// Tổng từng khối: một khối dùng mảng trên stack của bên gọi, nhiều khối lấy từ
+// ws (bên gọi trả lại bằng wsRelease)
+static double *r2Parts(FitWorkspace *ws, int chunks, double local[2]) {
+    if (chunks <= 1) return local;
+    return (double*)wsAlloc(ws, (size_t)chunks * 2 * sizeof(double));
+}
+
+// Tính Σw(y - ŷ)^2 và Σw(y - ȳ)^2 song song theo khối, tổng từng khối lấy từ ws
+// (NULL: vùng tạm). Trả về FIT_ERR_NO_MEMORY (hai tổng là NAN) nếu hết bộ nhớ.
+static int residualSums(R2Job *job, FitWorkspace *ws, double *ss_res, double *ss_tot) {
+    int chunks = chunkCount(job->ds->size);
+    double local2[2] = {0, 0};
+    FitWorkspace local;
+    size_t mark;
+    ws = wsBegin(ws, &local, &mark);
+    job->parts = r2Parts(ws, chunks, local2);
+    if (!job->parts) {
+        wsEnd(ws, &local, mark);
+        *ss_res = *ss_tot = NAN;
+        return FIT_ERR_NO_MEMORY;
+    }
+    parallelFor(chunks, residualChunk, job);
+    reduceChunkSums(job->parts, chunks, 2);
+    *ss_res = job->parts[0];
+    *ss_tot = job->parts[1];
+    wsEnd(ws, &local, mark);
+    return FIT_OK;
+}
+
+// Hàm tính R² (NAN nếu không đủ bộ nhớ cho tổng từng khối). Không nhận vùng
+// làm việc nên dữ liệu trên PARALLEL_CHUNK điểm cấp phát tổng từng khối mỗi lần
+// gọi; khớp lặp lại nên dùng fitModels.
+double calculateR2(const DatasetView *ds, double (*model)(double, double[]), double coeff[],
+                   int degree) {
+    (void)degree;
+    R2Job job = {ds, model, coeff, 0, NULL};
+    int chunks = chunkCount(ds->size);
+    double local2[2] = {0, 0};
+    FitWorkspace local;
+    size_t mark;
+    FitWorkspace *ws = wsBegin(NULL, &local, &mark);
+    job.parts = r2Parts(ws, chunks, local2);
+    if (!job.parts) {
+        wsEnd(ws, &local, mark);
+        return NAN;
+    }
+    TRACE_BEGIN(t);
+    parallelFor(chunks, sumYChunk, &job);
+    reduceChunkSums(job.parts, chunks, 2);
+    job.y_mean = job.parts[0] / job.parts[1];
+    wsRelease(ws, mark);
+
+    double ss_res, ss_tot;
+    residualSums(&job, ws, &ss_res, &ss_tot);
+    wsEnd(ws, &local, mark);
+    TRACE_END(t, TRACE_R2, ds->size);
+    return 1.0 - safeDiv(ss_res, ss_tot);
+}
+
+// Các hàm mô hình
+double linearModel(double x, double coeff[]) {
+    return coeff[0] + coeff[1] * x;
+}
+
+double logModel(double x, double coeff[]) {
+    return coeff[0] + coeff[1] * log(x);
+}
+
+double expModel(double x, double coeff[]) {
+    return coeff[0] * exp(coeff[1] * x);
+}
+
+double quadraticModel(double x, double coeff[]) {
+    return coeff[0] + coeff[1] * x + coeff[2] * x * x;
+}
+
+// Lược đồ Horner: bậc phép nhân thay cho pow() ở mỗi số hạng
+double polyModel(double x, double coeff[]) {
+    int degree = (int)coeff[0];
+    double result = coeff[degree + 1];
+    for (int i = degree - 1; i >= 0; i--) {
+        result = result * x + coeff[i + 1];
+    }
+    return result;
+}
+
+const char *fitStatusName(int status) {
+    switch (status) {
+        case FIT_OK: return "ok";
+        case FIT_ERR_TOO_FEW_POINTS: return "too_few_points";
+        case FIT_ERR_DOMAIN: return "domain";
+        case FIT_ERR_SINGULAR: return "singular";
+        case FIT_ERR_NO_MEMORY: return "no_memory";
+    }
+    return "unknown";
+}
+
+static int allFinite(const double *v, int n) {
+    for (int i = 0; i < n; i++) {
+        if (!isfinite(v[i])) return 0;
+    }
+    return 1;
+}
+
+// ===== Nhân tính tổng lũy thừa =====
+//
+// Cộng dồn sx[k] += Σ x^k (k = 0..2*degree), sxy[k] += Σ x^k y' (k = 0..degree)
+// và *syy += Σ y'^2 với y' = y - shift. Lũy thừa được tính bằng phép nhân
+// liên tiếp thay cho pow(). Bản AVX2/AVX-512 được chọn lúc chạy theo CPU.
+
+static void powerSumsScalar(const double *x, const double *y, int n, double shift,
+                            int degree, double *sx, double *sxy, double *syy) {
+    double s = 0;
+    for (int i = 0; i < n; i++) {
+        double xi = x[i], yi = y[i] - shift;
+        double p = 1;
+        for (int k = 0; k <= degree; k++) {
+            sx[k] += p;
+            sxy[k] += p * yi;
+            p *= xi;
+        }
+        for (int k = degree + 1; k <= 2 * degree; k++) {
+            sx[k] += p;
+            p *= xi;
+        }
+        s += yi * yi;
+    }
+    *syy += s;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS 1
+
+// Bậc tối đa của các nhân SIMD (bộ tích lũy nằm trên stack); bậc cao hơn dùng bản vô hướng
+#define SIMD_MAX_DEGREE 32
+
+__attribute__((target("avx2,fma")))
+static void powerSumsAvx2(const double *x, const double *y, int n, double shift,
+                          int degree, double *sx, double *sxy, double *syy) {
+    if (degree > SIMD_MAX_DEGREE) {
+        powerSumsScalar(x, y, n, shift, degree, sx, sxy, syy);
+        return;
+    }
+    __m256d ax[2 * SIMD_MAX_DEGREE + 1], axy[SIMD_MAX_DEGREE + 1];
+    for (int k = 0; k <= 2 * degree; k++) ax[k] = _mm256_setzero_pd();
+    for (int k = 0; k <= degree; k++) axy[k] = _mm256_setzero_pd();
+    __m256d ayy = _mm256_setzero_pd();
+    const __m256d vshift = _mm256_set1_pd(shift);
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    int i = 0;
+    // Hai vector mỗi vòng để hai chuỗi nhân lũy thừa chạy song song
+    for (; i + 8 <= n; i += 8) {
+        __m256d x0 = _mm256_loadu_pd(x + i), x1 = _mm256_loadu_pd(x + i + 4);
+        __m256d y0 = _mm256_sub_pd(_mm256_loadu_pd(y + i), vshift);
+        __m256d y1 = _mm256_sub_pd(_mm256_loadu_pd(y + i + 4), vshift);
+        __m256d p0 = one, p1 = one;
+        for (int k = 0; k <= degree; k++) {
+            ax[k] = _mm256_add_pd(ax[k], _mm256_add_pd(p0, p1));
+            axy[k] = _mm256_fmadd_pd(p0, y0, axy[k]);
+            axy[k] = _mm256_fmadd_pd(p1, y1, axy[k]);
+            p0 = _mm256_mul_pd(p0, x0);
+            p1 = _mm256_mul_pd(p1, x1);
+        }
+        for (int k = degree + 1; k <= 2 * degree; k++) {
+            ax[k] = _mm256_add_pd(ax[k], _mm256_add_pd(p0, p1));
+            p0 = _mm256_mul_pd(p0, x0);
+            p1 = _mm256_mul_pd(p1, x1);
+        }
+        ayy = _mm256_fmadd_pd(y0, y0, ayy);
+        ayy = _mm256_fmadd_pd(y1, y1, ayy);
+    }
+
+    double lanes[4];
+    for (int k = 0; k <= 2 * degree; k++) {
+        _mm256_storeu_pd(lanes, ax[k]);
+        sx[k] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    for (int k = 0; k <= degree; k++) {
+        _mm256_storeu_pd(lanes, axy[k]);
+        sxy[k] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    _mm256_storeu_pd(lanes, ayy);
+    *syy += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    // GCC bỏ qua vzeroupper trước lời gọi đuôi; thiếu nó log()/exp() của libm
+    // sau đó chậm đi hàng chục lần do chuyển trạng thái AVX-SSE
+    _mm256_zeroupper();
+    powerSumsScalar(x + i, y + i, n - i, shift, degree, sx, sxy, syy);
+}
+
+__attribute__((target("avx512f")))
+static void powerSumsAvx512(const double *x, const double *y, int n, double shift,
+                            int degree, double *sx, double *sxy, double *syy) {
+    if (degree > SIMD_MAX_DEGREE) {
+        powerSumsScalar(x, y, n, shift, degree, sx, sxy, syy);
+        return;
+    }
+    __m512d ax[2 * SIMD_MAX_DEGREE + 1], axy[SIMD_MAX_DEGREE + 1];
+    for (int k = 0; k <= 2 * degree; k++) ax[k] = _mm512_setzero_pd();
+    for (int k = 0; k <= degree; k++) axy[k] = _mm512_setzero_pd();
+    __m512d ayy = _mm512_setzero_pd();
+    const __m512d vshift = _mm512_set1_pd(shift);
+    const __m512d one = _mm512_set1_pd(1.0);
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512d x0 = _mm512_loadu_pd(x + i), x1 = _mm512_loadu_pd(x + i + 8);
+        __m512d y0 = _mm512_sub_pd(_mm512_loadu_pd(y + i), vshift);
+        __m512d y1 = _mm512_sub_pd(_mm512_loadu_pd(y + i + 8), vshift);
+        __m512d p0 = one, p1 = one;
+        for (int k = 0; k <= degree; k++) {
+            ax[k] = _mm512_add_pd(ax[k], _mm512_add_pd(p0, p1));
+            axy[k] = _mm512_fmadd_pd(p0, y0, axy[k]);
+            axy[k] = _mm512_fmadd_pd(p1, y1, axy[k]);
+            p0 = _mm512_mul_pd(p0, x0);
+            p1 = _mm512_mul_pd(p1, x1);
+        }
+        for (int k = degree + 1; k <= 2 * degree; k++) {
+            ax[k] = _mm512_add_pd(ax[k], _mm512_add_pd(p0, p1));
+            p0 = _mm512_mul_pd(p0, x0);
+            p1 = _mm512_mul_pd(p1, x1);
+        }
+        ayy = _mm512_fmadd_pd(y0, y0, ayy);
+        ayy = _mm512_fmadd_pd(y1, y1, ayy);
+    }
+
+    for (int k = 0; k <= 2 * degree; k++) sx[k] += _mm512_reduce_add_pd(ax[k]);
+    for (int k = 0; k <= degree; k++) sxy[k] += _mm512_reduce_add_pd(axy[k]);
+    *syy += _mm512_reduce_add_pd(ayy);
+
+    _mm256_zeroupper();
+    powerSumsScalar(x + i, y + i, n - i, shift, degree, sx, sxy, syy);
+}
+#endif
+
+int availablePowerSumKernels(PowerSumKernel out[], int max) {
+    int count = 0;
+    if (count < max) out[count++] = (PowerSumKernel){"scalar", powerSumsScalar};
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (count < max && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        out[count++] = (PowerSumKernel){"avx2", powerSumsAvx2};
+    }
+    if (count < max && __builtin_cpu_supports("avx512f")) {
+        out[count++] = (PowerSumKernel){"avx512", powerSumsAvx512};
+    }
+#endif
+    return count;
+}
+
+// Nhân tốt nhất cho CPU hiện tại (chọn một lần)
+PowerSumFn powerSumKernel(void) {
+    static PowerSumFn selected = NULL;
+    if (!selected) {
+        PowerSumKernel kernels[3];
+        int count = availablePowerSumKernels(kernels, 3);
+        selected = kernels[count - 1].fn;
+    }
+    return selected;
+}
+
+// Bản có trọng số: sx[k] += Σ w x^k, sxy[k] += Σ w x^k y', *syy += Σ w y'^2
+typedef void (*WeightedSumFn)(const double *x, const double *y, const double *w, int n,
+                              double shift, int degree, double *sx, double *sxy, double *syy);
+
+static void weightedSumsScalar(const double *x, const double *y, const double *w, int n,
+                               double shift, int degree, double *sx, double *sxy, double *syy) {
+    double s = 0;
+    for (int i = 0; i < n; i++) {
+        double xi = x[i], yi = y[i] - shift;
+        double p = w[i];
+        for (int k = 0; k <= degree; k++) {
+            sx[k] += p;
+            sxy[k] += p * yi;
+            p *= xi;
+        }
+        for (int k = degree + 1; k <= 2 * degree; k++) {
+            sx[k] += p;
+            p *= xi;
+        }
+        s += w[i] * yi * yi;
+    }
+    *syy += s;
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2,fma")))
+static void weightedSumsAvx2(const double *x, const double *y, const double *w, int n,
+                             double shift, int degree, double *sx, double *sxy, double *syy) {
+    if (degree > SIMD_MAX_DEGREE) {
+        weightedSumsScalar(x, y, w, n, shift, degree, sx, sxy, syy);
+        return;
+    }
+    __m256d ax[2 * SIMD_MAX_DEGREE + 1], axy[SIMD_MAX_DEGREE + 1];
+    for (int k = 0; k <= 2 * degree; k++) ax[k] = _mm256_setzero_pd();
+    for (int k = 0; k <= degree; k++) axy[k] = _mm256_setzero_pd();
+    __m256d ayy = _mm256_setzero_pd();
+    const __m256d vshift = _mm256_set1_pd(shift);
+
+    int i = 0;
+    // Lũy thừa bắt đầu từ w nên cùng số phép nhân như bản không trọng số
+    for (; i + 8 <= n; i += 8) {
+        __m256d x0 = _mm256_loadu_pd(x + i), x1 = _mm256_loadu_pd(x + i + 4);
+        __m256d y0 = _mm256_sub_pd(_mm256_loadu_pd(y + i), vshift);
+        __m256d y1 = _mm256_sub_pd(_mm256_loadu_pd(y + i + 4), vshift);
+        __m256d p0 = _mm256_loadu_pd(w + i), p1 = _mm256_loadu_pd(w + i + 4);
+        ayy = _mm256_fmadd_pd(_mm256_mul_pd(p0, y0), y0, ayy);
+        ayy = _mm256_fmadd_pd(_mm256_mul_pd(p1, y1), y1, ayy);
+        for (int k = 0; k <= degree; k++) {
+            ax[k] = _mm256_add_pd(ax[k], _mm256_add_pd(p0, p1));
+            axy[k] = _mm256_fmadd_pd(p0, y0, axy[k]);
+            axy[k] = _mm256_fmadd_pd(p1, y1, axy[k]);
+            p0 = _mm256_mul_pd(p0, x0);
+            p1 = _mm256_mul_pd(p1, x1);
+        }
+        for (int k = degree + 1; k <= 2 * degree; k++) {
+            ax[k] = _mm256_add_pd(ax[k], _mm256_add_pd(p0, p1));
+            p0 = _mm256_mul_pd(p0, x0);
+            p1 = _mm256_mul_pd(p1, x1);
+        }
+    }
+
+    double lanes[4];
+    for (int k = 0; k <= 2 * degree; k++) {
+        _mm256_storeu_pd(lanes, ax[k]);
+        sx[k] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    for (int k = 0; k <= degree; k++) {
+        _mm256_storeu_pd(lanes, axy[k]);
+        sxy[k] += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    _mm256_storeu_pd(lanes, ayy);
+    *syy += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    _mm256_zeroupper();
+    weightedSumsScalar(x + i, y + i, w + i, n - i, shift, degree, sx, sxy, syy);
+}
+#endif
+
+static WeightedSumFn weightedSumKernel(void) {
+    static WeightedSumFn selected = NULL;
+    if (!selected) {
+        selected = weightedSumsScalar;
+#ifdef HAVE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            selected = weightedSumsAvx2;
+        }
+#endif
+    }
+    return selected;
+}
+
+// ===== Tích lũy mô-men một lượt =====
+//
+// Mọi mô hình đều giải được từ các tổng sau, nên chỉ cần đọc dữ liệu một lần
+// cho tất cả mô hình. y được dịch theo điểm đầu tiên (y' = y - yShift) để
+// tránh triệt tiêu khi tính Σy'^2 - (Σy')^2/n; hệ số chặn được cộng lại sau.
+
+// Xóa các tổng về 0 (giữ nguyên bộ nhớ)
+void resetMoments(Moments *m) {
+    memset(m->sx, 0, (size_t)(3 * m->maxDegree + 2) * sizeof(double));
+    m->count = 0;
+    m->n = m->yShift = m->syy = 0;
+    m->slnx = m->slnx2 = m->slnxy = 0;
+    m->slny = m->slny2 = m->sxlny = 0;
+    m->badLogX = m->badLogY = 0;
+}
+
+// Số double cần cho các mảng tổng của bậc maxDegree
+size_t momentsBufferSize(int maxDegree) {
+    if (maxDegree < 1) maxDegree = 1;
+    return (size_t)(3 * maxDegree + 2);
+}
+
+// Gắn Moments vào vùng nhớ buf có momentsBufferSize(maxDegree) phần tử
+void bindMoments(Moments *m, int maxDegree, int flags, double *buf) {
+    m->maxDegree = maxDegree < 1 ? 1 : maxDegree;
+    m->flags = flags;
+    m->sx = buf;
+    m->sxy = buf + 2 * m->maxDegree + 1;
+    resetMoments(m);
+}
+
+// Trả về -1 nếu không đủ bộ nhớ
+int initMoments(Moments *m, int maxDegree, int flags) {
+    double *buf = (double*)malloc(momentsBufferSize(maxDegree) * sizeof(double));
+    if (!buf) return -1;
+    bindMoments(m, maxDegree, flags, buf);
+    return 0;
+}
+
+// Lấy bộ nhớ cho Moments từ vùng làm việc (không cần freeMoments)
+int wsMoments(FitWorkspace *ws, Moments *m, int maxDegree, int flags) {
+    double *buf = (double*)wsAlloc(ws, momentsBufferSize(maxDegree) * sizeof(double));
+    if (!buf) return -1;
+    bindMoments(m, maxDegree, flags, buf);
+    return 0;
+}
+
+// Chỉ dùng cho Moments tạo bởi initMoments
+void freeMoments(Moments *m) {
+    free(m->sx);
+    m->sx = m->sxy = NULL;
+}
+
+// Cộng các tổng của src vào dst (cùng bậc, cùng yShift)
+void mergeMoments(Moments *dst, const Moments *src) {
+    int d = dst->maxDegree;
+    for (int k = 0; k <= 2 * d; k++) dst->sx[k] += src->sx[k];
+    for (int k = 0; k <= d; k++) dst->sxy[k] += src->sxy[k];
+    dst->syy += src->syy;
+    dst->slnx += src->slnx;
+    dst->slnx2 += src->slnx2;
+    dst->slnxy += src->slnxy;
+    dst->slny += src->slny;
+    dst->slny2 += src->slny2;
+    dst->sxlny += src->sxlny;
+    dst->badLogX += src->badLogX;
+    dst->badLogY += src->badLogY;
+    dst->count += src->count;
+    dst->n += src->n;
+}
+
+// Các tổng logarit tùy chọn (MOMENT_LOGX / MOMENT_LOGY) của một đoạn điểm.
+// w == NULL: trọng số 1; điểm có trọng số 0 không tính vào badLog*.
+static void accumulateLogSums(Moments *m, const double *x, const double *y, const double *w,
+                              int n) {
+    double shift = m->yShift;
+    if (m->flags & MOMENT_LOGX) {
+        for (int i = 0; i < n; i++) {
+            double wi = w ? w[i] : 1.0;
+            if (wi == 0) continue;
+            if (x[i] <= 0) {
+                m->badLogX++;
+                continue;
+            }
+            double lnx = log(x[i]);
+            m->slnx += wi * lnx;
+            m->slnx2 += wi * lnx * lnx;
+            m->slnxy += wi * lnx * (y[i] - shift);
+        }
+    }
+    if (m->flags & MOMENT_LOGY) {
+        for (int i = 0; i < n; i++) {
+            double wi = w ? w[i] : 1.0;
+            if (wi == 0) continue;
+            if (y[i] <= 0) {
+                m->badLogY++;
+                continue;
+            }
+            double lny = log(y[i]);
+            m->slny += wi * lny;
+            m->slny2 += wi * lny * lny;
+            m->sxlny += wi * x[i] * lny;
+        }
+    }
+}
+
+// Cộng dồn một đoạn điểm liên tiếp (dùng yShift hiện có). Với trọng số, count
+// chỉ đếm điểm có w > 0 để kiểm tra số điểm tối thiểu vẫn đúng.
+static void accumulateRange(Moments *m, const double *x, const double *y, const double *w,
+                            int n) {
+    if (w) {
+        double before = m->sx[0];
+        weightedSumKernel()(x, y, w, n, m->yShift, m->maxDegree, m->sx, m->sxy, &m->syy);
+        int positive = 0;
+        for (int i = 0; i < n; i++) positive += w[i] > 0;
+        m->count += positive;
+        m->n += m->sx[0] - before;
+    } else {
+        powerSumKernel()(x, y, n, m->yShift, m->maxDegree, m->sx, m->sxy, &m->syy);
+        m->count += n;
+        m->n += n;
+    }
+    accumulateLogSums(m, x, y, w, n);
+}
+
+typedef struct {
+    Moments *parts;
+    const double *x, *y, *w;
+    int n;
+} MomentsJob;
+
+static void momentsChunk(void *ctx, int chunk) {
+    MomentsJob *job = (MomentsJob*)ctx;
+    int begin = chunk * PARALLEL_CHUNK;
+    int len = job->n - begin < PARALLEL_CHUNK ? job->n - begin : PARALLEL_CHUNK;
+    accumulateRange(&job->parts[chunk], job->x + begin, job->y + begin,
+                    job->w ? job->w + begin : NULL, len);
+}
+
+// Cộng dồn n điểm vào các tổng; dữ liệu lớn được chia khối và chạy song song.
+// Tổng từng khối lấy từ ws (NULL: vùng tạm).
+void accumulateMoments(Moments *m, const double *x, const double *y, int n, FitWorkspace *ws) {
+    accumulateWeightedMoments(m, x, y, NULL, n, ws);
+}
+
+// Như accumulateMoments với trọng số w[i] >= 0 (w == NULL: trọng số 1)
+void accumulateWeightedMoments(Moments *m, const double *x, const double *y, const double *w,
+                               int n, FitWorkspace *ws) {
+    if (n <= 0) return;
+    if (m->count == 0) m->yShift = y[0];
+    TRACE_BEGIN(t);
+
+    // m đã có điểm (cộng nhiều lô liên tiếp): lô nhỏ cũng tính tổng riêng rồi mới
+    // gộp, để tổng lớn của m không làm mất dần phần lẻ của từng điểm
+    int chunks = chunkCount(n);
+    if (chunks <= 1 && m->count == 0) {
+        accumulateRange(m, x, y, w, n);
+        TRACE_END(t, TRACE_MOMENTS, n);
+        return;
+    }
+    FitWorkspace local;
+    size_t mark;
+    ws = wsBegin(ws, &local, &mark);
+    size_t width = momentsBufferSize(m->maxDegree);
+    Moments *parts = (Moments*)wsAlloc(ws, (size_t)chunks * sizeof(Moments));
+    double *buf = parts ? (double*)wsAlloc(ws, (size_t)chunks * width * sizeof(double)) : NULL;
+    if (!buf) {
+        // Không đủ bộ nhớ cho tổng từng khối: chạy tuần tự
+        wsEnd(ws, &local, mark);
+        accumulateRange(m, x, y, w, n);
+        TRACE_END(t, TRACE_MOMENTS, n);
+        return;
+    }
+
+    for (int c = 0; c < chunks; c++) {
+        bindMoments(&parts[c], m->maxDegree, m->flags, buf + (size_t)c * width);
+        parts[c].yShift = m->yShift;
+    }
+    MomentsJob job = {parts, x, y, w, n};
+    parallelFor(chunks, momentsChunk, &job);
+
+    for (int step = 1; step < chunks; step *= 2) {
+        for (int i = 0; i + step < chunks; i += 2 * step) {
+            mergeMoments(&parts[i], &parts[i + step]);
+        }
+    }
+    mergeMoments(m, &parts[0]);
+    wsEnd(ws, &local, mark);
+    TRACE_END(t, TRACE_MOMENTS, n);
+}
+
+// Cộng (w > 0) hoặc bớt (w < 0) một điểm với trọng số |w|, O(bậc)
+void addMomentsPoint(Moments *m, double x, double y, double w) {
+    if (m->count == 0 && m->n == 0) m->yShift = y;
+    double yi = y - m->yShift;
+    int d = m->maxDegree;
+    double p = w;
+    for (int k = 0; k <= d; k++) {
+        m->sx[k] += p;
+        m->sxy[k] += p * yi;
+        p *= x;
+    }
+    for (int k = d + 1; k <= 2 * d; k++) {
+        m->sx[k] += p;
+        p *= x;
+    }
+    m->syy += w * yi * yi;
+
+    int step = w < 0 ? -1 : 1;
+    if (m->flags & MOMENT_LOGX) {
+        if (x > 0) {
+            double lnx = log(x);
+            m->slnx += w * lnx;
+            m->slnx2 += w * lnx * lnx;
+            m->slnxy += w * lnx * yi;
+        } else {
+            m->badLogX += step;
+        }
+    }
+    if (m->flags & MOMENT_LOGY) {
+        if (y > 0) {
+            double lny = log(y);
+            m->slny += w * lny;
+            m->slny2 += w * lny * lny;
+            m->sxlny += w * x * lny;
+        } else {
+            m->badLogY += step;
+        }
+    }
+    m->count += step;
+    m->n += w;
+}
+
+// Tổng bình phương toàn phần Σ(y - ȳ)^2
+static double momentsSsTot(const Moments *m) {
+    return m->syy - safeDiv(m->sxy[0] * m->sxy[0], m->n);
+}
+
+// R^2 khi biết Σ y' * (giá trị dự đoán của y') = cᵀb tại nghiệm bình phương tối thiểu
+static double momentsR2(const Moments *m, double fitted) {
+    double ss_tot = momentsSsTot(m);
+    double ss_res = m->syy - fitted;
+    if (ss_res < 0) ss_res = 0;
+    return 1.0 - safeDiv(ss_res, ss_tot);
+}
+
+// Giải hệ tuyến tính n ẩn, A là ma trận mở rộng n x (n+1) theo hàng,
+// khử Gauss có chọn phần tử trội; nghiệm ghi vào out[]
+static int gaussSolve(double *A, int n, double *out) {
+    int w = n + 1;
+    TRACE_COUNT(TRACE_PIVOTS, n);
+    for (int k = 0; k < n; k++) {
+        // Tìm hàng có phần tử lớn nhất
+        int max_row = k;
+        for (int i = k+1; i < n; i++) {
+            if (fabs(A[i*w + k]) > fabs(A[max_row*w + k])) {
+                max_row = i;
+            }
+        }
+
+        // Đổi hàng
+        if (max_row != k) {
+            TRACE_COUNT(TRACE_ROW_SWAPS, 1);
+            for (int j = k; j <= n; j++) {
+                double temp = A[k*w + j];
+                A[k*w + j] = A[max_row*w + j];
+                A[max_row*w + j] = temp;
+            }
+        }
+
+        // Khử
+        for (int i = k+1; i < n; i++) {
+            double factor = A[i*w + k] / A[k*w + k];
+            for (int j = k; j <= n; j++) {
+                A[i*w + j] -= factor * A[k*w + j];
+            }
+        }
+    }
+
+    // Thế ngược
+    for (int i = n - 1; i >= 0; i--) {
+        double v = A[i*w + n];
+        for (int j = i+1; j < n; j++) {
+            v -= A[i*w + j] * out[j];
+        }
+        out[i] = v / A[i*w + i];
+    }
+    return allFinite(out, n) ? FIT_OK : FIT_ERR_SINGULAR;
+}
+
+// Các hàm giải từ mô-men; hệ số ghi theo đúng thứ tự của các hàm mô hình
+int solveLinearMoments(const Moments *m, double coeff[], double *r2) {
+    if (m->count < 2) return FIT_ERR_TOO_FEW_POINTS;
+    double n = m->n, sx = m->sx[1], sx2 = m->sx[2];
+    double sy = m->sxy[0], sxy = m->sxy[1];
+
+    double denom = n * sx2 - sx * sx;
+    double a = safeDiv(sy * sx2 - sx * sxy, denom);
+    double b = safeDiv(n * sxy - sx * sy, denom);
+    *r2 = momentsR2(m, a * sy + b * sxy);
+    coeff[0] = a + m->yShift;
+    coeff[1] = b;
+    return FIT_OK;
+}
+
+int solveLogMoments(const Moments *m, double coeff[], double *r2) {
+    if (m->count < 2) return FIT_ERR_TOO_FEW_POINTS;
+    if (!(m->flags & MOMENT_LOGX) || m->badLogX > 0) return FIT_ERR_DOMAIN;
+    double n = m->n, sy = m->sxy[0];
+
+    double denom = n * m->slnx2 - m->slnx * m->slnx;
+    double a = safeDiv(sy * m->slnx2 - m->slnx * m->slnxy, denom);
+    double b = safeDiv(n * m->slnxy - m->slnx * sy, denom);
+    *r2 = momentsR2(m, a * sy + b * m->slnxy);
+    coeff[0] = a + m->yShift;
+    coeff[1] = b;
+    return FIT_OK;
+}
+
+// Hàm mũ được khớp trên ln y; R^2 theo y gốc cần thêm một lượt (residualR2)
+int solveExpMoments(const Moments *m, double coeff[]) {
+    if (m->count < 2) return FIT_ERR_TOO_FEW_POINTS;
+    if (!(m->flags & MOMENT_LOGY) || m->badLogY > 0) return FIT_ERR_DOMAIN;
+    double n = m->n, sx = m->sx[1], sx2 = m->sx[2];
+
+    double denom = n * sx2 - sx * sx;
+    double A = safeDiv(m->slny * sx2 - sx * m->sxlny, denom);
+    double B = safeDiv(n * m->sxlny - sx * m->slny, denom);
+    coeff[0] = exp(A);
+    coeff[1] = B;
+    return FIT_OK;
+}
+
+// Số điều kiện chuẩn 1 của ma trận vuông A (n x n, hàng cách nhau lda) qua
+// nghịch đảo Gauss-Jordan với chọn phần tử trụ; ma trận suy biến cho INFINITY
+static double matrixCond1(const double *A, int lda, int n, FitWorkspace *ws) {
+    size_t mark = wsMark(ws);
+    double *work = (double*)wsAlloc(ws, (size_t)2 * n * n * sizeof(double));
+    if (!work) return NAN;
+    double *a = work, *inv = work + (size_t)n * n;
+    for (int i = 0; i < n; i++) {
+        memcpy(a + (size_t)i * n, A + (size_t)i * lda, (size_t)n * sizeof(double));
+    }
+    memset(inv, 0, (size_t)n * n * sizeof(double));
+    for (int i = 0; i < n; i++) inv[i*n + i] = 1.0;
+
+    int singular = 0;
+    for (int k = 0; k < n && !singular; k++) {
+        int pivot = k;
+        for (int i = k + 1; i < n; i++) {
+            if (fabs(a[i*n + k]) > fabs(a[pivot*n + k])) pivot = i;
+        }
+        if (a[pivot*n + k] == 0) {
+            singular = 1;
+            break;
+        }
+        if (pivot != k) {
+            for (int j = 0; j < n; j++) {
+                double t = a[k*n + j]; a[k*n + j] = a[pivot*n + j]; a[pivot*n + j] = t;
+                t = inv[k*n + j]; inv[k*n + j] = inv[pivot*n + j]; inv[pivot*n + j] = t;
+            }
+        }
+        double d = a[k*n + k];
+        for (int j = 0; j < n; j++) {
+            a[k*n + j] /= d;
+            inv[k*n + j] /= d;
+        }
+        for (int i = 0; i < n; i++) {
+            if (i == k) continue;
+            double f = a[i*n + k];
+            if (f == 0) continue;
+            for (int j = 0; j < n; j++) {
+                a[i*n + j] -= f * a[k*n + j];
+                inv[i*n + j] -= f * inv[k*n + j];
+            }
+        }
+    }
+
+    double normA = 0, normInv = 0;
+    for (int j = 0; j < n; j++) {
+        double ca = 0, ci = 0;
+        for (int i = 0; i < n; i++) {
+            ca += fabs(A[i*lda + j]);
+            ci += fabs(inv[i*n + j]);
+        }
+        if (ca > normA) normA = ca;
+        if (ci > normInv) normInv = ci;
+    }
+    wsRelease(ws, mark);
+    double cond = normA * normInv;
+    return singular || !isfinite(cond) ? INFINITY : cond;
+}
+
+// coeff[] có degree+2 phần tử, coeff[0] lưu bậc đa thức (giống polyModel).
+// Ma trận hệ số lấy từ ws (NULL: vùng tạm). *cond (có thể NULL) nhận
+// sqrt(cond1(X^T X)), ước lượng số điều kiện của ma trận thiết kế để so sánh
+// trực tiếp với bộ giải QR.
+int solvePolyMoments(const Moments *m, int degree, FitWorkspace *ws,
+                     double coeff[], double *r2, double *cond) {
+    if (m->count <= degree) return FIT_ERR_TOO_FEW_POINTS;
+    if (degree > m->maxDegree) return FIT_ERR_SINGULAR;
+
+    int n = degree + 1;
+    FitWorkspace local;
+    size_t mark;
+    ws = wsBegin(ws, &local, &mark);
+    double *A = (double*)wsAlloc(ws, (size_t)n * (n + 1) * sizeof(double));
+    if (!A) {
+        wsEnd(ws, &local, mark);
+        return FIT_ERR_NO_MEMORY;
+    }
+
+    // Xây dựng ma trận hệ số
+    for (int i = 0; i <= degree; i++) {
+        for (int j = 0; j <= degree; j++) {
+            A[i*(n+1) + j] = m->sx[i+j];
+        }
+        A[i*(n+1) + n] = m->sxy[i];
+    }
+    if (cond) *cond = sqrt(matrixCond1(A, n + 1, n, ws));
+
+    coeff[0] = degree; // Lưu bậc đa thức
+    int status = gaussSolve(A, n, coeff + 1);
+    wsEnd(ws, &local, mark);
+    if (status != FIT_OK) return status;
+
+    double fitted = 0;
+    for (int i = 0; i <= degree; i++) {
+        fitted += coeff[i+1] * m->sxy[i];
+    }
+    *r2 = momentsR2(m, fitted);
+    coeff[1] += m->yShift;
+    return FIT_OK;
+}
+
+int solveQuadraticMoments(const Moments *m, FitWorkspace *ws, double coeff[], double *r2) {
+    double c[4];
+    int status = solvePolyMoments(m, 2, ws, c, r2, NULL);
+    if (status == FIT_OK) {
+        coeff[0] = c[1];
+        coeff[1] = c[2];
+        coeff[2] = c[3];
+    }
+    return status;
+}
+
+// R^2 của hàm mũ trên thang ln y (dạng tuyến tính hóa), chỉ cần mô-men
+double expLogR2(const Moments *m, const double coeff[]) {
+    double A = log(coeff[0]), B = coeff[1];
+    double ss_tot = m->slny2 - safeDiv(m->slny * m->slny, m->n);
+    double ss_res = m->slny2 - A * m->slny - B * m->sxlny;
+    if (ss_res < 0) ss_res = 0;
+    return 1.0 - safeDiv(ss_res, ss_tot);
+}
+
+// R^2 theo y gốc với ȳ và Σ(y - ȳ)^2 lấy từ mô-men: chỉ một lượt qua dữ liệu.
+// Tổng từng khối lấy từ ws (NULL: vùng tạm); trả về FIT_OK hoặc FIT_ERR_NO_MEMORY.
+int residualR2(const DatasetView *ds, double (*model)(double, double[]), double coeff[],
+               const Moments *m, FitWorkspace *ws, double *r2) {
+    R2Job job = {ds, model, coeff, m->yShift + safeDiv(m->sxy[0], m->n), NULL};
+    double ss_res, ss_tot;
+    TRACE_BEGIN(t);
+    int status = residualSums(&job, ws, &ss_res, &ss_tot);
+    TRACE_END(t, TRACE_R2, ds->size);
+    *r2 = 1.0 - safeDiv(ss_res, momentsSsTot(m));
+    return status;
+}
+
+// Σw(y - ŷ)^2 trên ds, song song theo khối (NAN nếu không đủ bộ nhớ); cộng dồn
+// qua các khối khi dữ liệu được đọc từng phần. Tổng từng khối lấy từ ws (NULL: vùng tạm).
+double residualSumSquares(const DatasetView *ds, double (*model)(double, double[]), double coeff[],
+                          FitWorkspace *ws) {
+    R2Job job = {ds, model, coeff, 0, NULL};
+    double ss_res, ss_tot;
+    TRACE_BEGIN(t);
+    residualSums(&job, ws, &ss_res, &ss_tot);
+    TRACE_END(t, TRACE_R2, ds->size);
+    return ss_res;
+}
+
+// Các hàm khớp: chỉ tính toán, không in ra màn hình hay ghi log.
+// Trả về FIT_OK và ghi hệ số vào coeff[], R^2 vào *r2.
+// Các tổng được đặt trong ws (NULL: vùng tạm cấp phát và giải phóng mỗi lần
+// gọi); trả về FIT_ERR_NO_MEMORY nếu không đủ bộ nhớ
+static int accumulateDataset(const DatasetView *ds, int degree, int flags, FitWorkspace *ws,
+                             Moments *m) {
+    if (wsMoments(ws, m, degree, flags) != 0) return FIT_ERR_NO_MEMORY;
+    accumulateWeightedMoments(m, ds->x, ds->y, ds->w, ds->size, ws);
+    return FIT_OK;
+}
+
+int fitLinear(const DatasetView *ds, FitWorkspace *ws, double coeff[], double *r2) {
+    FitWorkspace local;
+    size_t mark;
+    Moments m;
+    ws = wsBegin(ws, &local, &mark);
+    int status = accumulateDataset(ds, 1, 0, ws, &m);
+    if (status == FIT_OK) status = solveLinearMoments(&m, coeff, r2);
+    wsEnd(ws, &local, mark);
+    return status;
+}
+
+int fitLog(const DatasetView *ds, FitWorkspace *ws, double coeff[], double *r2) {
+    FitWorkspace local;
+    size_t mark;
+    Moments m;
+    ws = wsBegin(ws, &local, &mark);
+    int status = accumulateDataset(ds, 1, MOMENT_LOGX, ws, &m);
+    if (status == FIT_OK) status = solveLogMoments(&m, coeff, r2);
+    wsEnd(ws, &local, mark);
+    return status;
+}
+
+int fitExponential(const DatasetView *ds, FitWorkspace *ws, double coeff[], double *r2) {
+    FitWorkspace local;
+    size_t mark;
+    Moments m;
+    ws = wsBegin(ws, &local, &mark);
+    int status = accumulateDataset(ds, 1, MOMENT_LOGY, ws, &m);
+    if (status == FIT_OK) status = solveExpMoments(&m, coeff);
+    if (status == FIT_OK) status = residualR2(ds, expModel, coeff, &m, ws, r2);
+    wsEnd(ws, &local, mark);
+    return status;
+}
+
+int fitQuadratic(const DatasetView *ds, FitWorkspace *ws, double coeff[], double *r2) {
+    FitWorkspace local;
+    size_t mark;
+    Moments m;
+    ws = wsBegin(ws, &local, &mark);
+    int status = accumulateDataset(ds, 2, 0, ws, &m);
+    if (status == FIT_OK) status = solveQuadraticMoments(&m, ws, coeff, r2);
+    wsEnd(ws, &local, mark);
+    return status;
+}
+
+// ===== Bộ giải QR (Householder theo khối) =====
+//
+// Phương trình chuẩn tắc bình phương số điều kiện của ma trận Vandermonde nên
+// mất hết độ chính xác ở bậc cao. Bộ giải QR phân rã trực tiếp ma trận mở rộng
+// [V | y] (q = bậc + 2 cột) theo từng khối QR_BLOCK_ROWS hàng: mỗi khối dữ liệu
+// song song cho một nhân tố R riêng, sau đó ghép từng cặp R theo cây cố định
+// (TSQR) nên kết quả không phụ thuộc số luồng.
+// Phần tử R[q-1][q-1] chính là chuẩn của phần dư, nên SSres không cần thêm lượt.
+
+#define QR_BLOCK_ROWS 64
+
+const char *solverName(int solver) {
+    switch (solver) {
+        case SOLVER_QR: return "qr";
+        case SOLVER_QR_ORTHO: return "qr-ortho";
+        default: return "normal";
+    }
+}
+
+// Trả về -1 nếu tên không hợp lệ
+int parseSolver(const char *name) {
+    if (strcmp(name, "normal") == 0) return SOLVER_NORMAL;
+    if (strcmp(name, "qr") == 0) return SOLVER_QR;
+    if (strcmp(name, "qr-ortho") == 0) return SOLVER_QR_ORTHO;
+    return -1;
+}
+
+// Khử rows hàng của block (lưu theo hàng, q cột) vào nhân tố tam giác trên R (q x q).
+// Mỗi cột dùng một phép phản xạ Householder chỉ chạm tới hàng j của R và block.
+static void qrAbsorbRows(double *R, double *block, int rows, int q) {
+    for (int j = 0; j < q; j++) {
+        double alpha = R[j*q + j];
+        double sigma = 0;
+        for (int i = 0; i < rows; i++) {
+            sigma += block[i*q + j] * block[i*q + j];
+        }
+        if (sigma == 0) continue;
+
+        double norm = sqrt(alpha * alpha + sigma);
+        double beta = alpha > 0 ? -norm : norm;
+        double v0 = alpha - beta;
+        double tau = -v0 / beta;
+        for (int i = 0; i < rows; i++) {
+            block[i*q + j] /= v0;
+        }
+        R[j*q + j] = beta;
+
+        for (int k = j + 1; k < q; k++) {
+            double s = R[j*q + k];
+            for (int i = 0; i < rows; i++) {
+                s += block[i*q + j] * block[i*q + k];
+            }
+            s *= tau;
+            R[j*q + k] -= s;
+            for (int i = 0; i < rows; i++) {
+                block[i*q + k] -= s * block[i*q + j];
+            }
+        }
+    }
+}
+
+typedef struct {
+    const double *x, *y;
+    const double *w;        // trọng số (NULL: 1): mỗi hàng được nhân với sqrt(w)
+    int n, degree, ortho;
+    double center, scale;   // cơ sở trực giao: u = (x - center) * scale
+    double *parts;          // q*q phần tử cho mỗi khối dữ liệu, hoặc min/max
+    double *blocks;         // QR_BLOCK_ROWS*q phần tử nháp cho mỗi khối dữ liệu
+    const double *X;        // khác NULL: hồi quy nhiều biến, degree đặc trưng cách nhau ld
+    int ld;
+} QRJob;
+
+static void rangeChunk(void *ctx, int chunk) {
+    QRJob *job = (QRJob*)ctx;
+    int begin = chunk * PARALLEL_CHUNK;
+    int end = job->n - begin < PARALLEL_CHUNK ? job->n : begin + PARALLEL_CHUNK;
+    double lo = job->x[begin], hi = job->x[begin];
+    for (int i = begin + 1; i < end; i++) {
+        if (job->x[i] < lo) lo = job->x[i];
+        if (job->x[i] > hi) hi = job->x[i];
+    }
+    job->parts[2*chunk] = lo;
+    job->parts[2*chunk + 1] = hi;
+}
+
+// Hàng i của ma trận mở rộng: các hàm cơ sở tại x_i (nhiều biến: các đặc
+// trưng của điểm i), cột cuối là y
+static void designRow(const QRJob *job, int i, double *row) {
+    int d = job->degree;
+    double x = job->x[i];
+    row[0] = 1.0;
+    if (job->X) {
+        for (int k = 1; k <= d; k++) {
+            row[k] = job->X[(size_t)(k-1) * job->ld + i];
+        }
+    } else if (job->ortho) {
+        double u = (x - job->center) * job->scale;
+        if (d >= 1) row[1] = u;
+        for (int k = 2; k <= d; k++) {
+            row[k] = 2.0 * u * row[k-1] - row[k-2];
+        }
+    } else {
+        for (int k = 1; k <= d; k++) {
+            row[k] = row[k-1] * x;
+        }
+    }
+    row[d+1] = job->y[i];
+}
+
+static void qrChunk(void *ctx, int chunk) {
+    QRJob *job = (QRJob*)ctx;
+    int q = job->degree + 2;
+    double *R = job->parts + (size_t)chunk * q * q;
+    memset(R, 0, (size_t)q * q * sizeof(double));
+
+    double *block = job->blocks + (size_t)chunk * QR_BLOCK_ROWS * q;
+    int begin = chunk * PARALLEL_CHUNK;
+    int end = job->n - begin < PARALLEL_CHUNK ? job->n : begin + PARALLEL_CHUNK;
+    for (int i = begin; i < end; i += QR_BLOCK_ROWS) {
+        int rows = end - i < QR_BLOCK_ROWS ? end - i : QR_BLOCK_ROWS;
+        for (int r = 0; r < rows; r++) {
+            double *row = block + (size_t)r * q;
+            designRow(job, i + r, row);
+            if (job->w) {
+                double sw = sqrt(job->w[i+r]);
+                for (int k = 0; k < q; k++) row[k] *= sw;
+            }
+        }
+        qrAbsorbRows(R, block, rows, q);
+    }
+}
+
+// Ghép các nhân tố R theo cây cố định (giống reduceChunkSums), kết quả ở parts[0]
+static void reduceQRFactors(double *parts, int chunks, int q) {
+    size_t size = (size_t)q * q;
+    for (int step = 1; step < chunks; step *= 2) {
+        for (int i = 0; i + step < chunks; i += 2 * step) {
+            qrAbsorbRows(parts + i * size, parts + (i + step) * size, q, q);
+        }
+    }
+}
+
+// Số điều kiện chuẩn 1 của ma trận tam giác trên R (p x p, hàng cách nhau ld),
+// tính chính xác qua nghịch đảo R^-1 (O(p^3), không đáng kể so với lượt dữ liệu)
+static double triangularCond1(const double *R, int ld, int p, FitWorkspace *ws) {
+    size_t mark = wsMark(ws);
+    double *inv = (double*)wsAlloc(ws, (size_t)p * p * sizeof(double));
+    if (!inv) return NAN;
+    memset(inv, 0, (size_t)p * p * sizeof(double));
+    for (int j = 0; j < p; j++) {
+        inv[j*p + j] = 1.0 / R[j*ld + j];
+        for (int i = j - 1; i >= 0; i--) {
+            double s = 0;
+            for (int k = i + 1; k <= j; k++) {
+                s += R[i*ld + k] * inv[k*p + j];
+            }
+            inv[i*p + j] = -s / R[i*ld + i];
+        }
+    }
+    double normR = 0, normInv = 0;
+    for (int j = 0; j < p; j++) {
+        double cr = 0, ci = 0;
+        for (int i = 0; i <= j; i++) {
+            cr += fabs(R[i*ld + j]);
+            ci += fabs(inv[i*p + j]);
+        }
+        if (cr > normR) normR = cr;
+        if (ci > normInv) normInv = ci;
+    }
+    wsRelease(ws, mark);
+    double cond = normR * normInv;
+    return isfinite(cond) ? cond : INFINITY;
+}
+
+// Đổi hệ số theo cơ sở Chebyshev của u = (x - center) * scale sang đơn thức của x.
+// c[] có degree+1 phần tử, được ghi đè bằng hệ số đơn thức.
+static int chebyshevToMonomial(double c[], int degree, double center, double scale,
+                               FitWorkspace *ws) {
+    int n = degree + 1;
+    size_t mark = wsMark(ws);
+    double *buf = (double*)wsAlloc(ws, (size_t)4 * n * sizeof(double));
+    if (!buf) return FIT_ERR_NO_MEMORY;
+    memset(buf, 0, (size_t)4 * n * sizeof(double));
+    double *mono = buf, *tPrev = buf + n, *tCur = buf + 2*n, *tNext = buf + 3*n;
+
+    // T_0 = 1, T_1 = u, T_{k+1} = 2u T_k - T_{k-1} (hệ số theo lũy thừa của u)
+    tPrev[0] = 1.0;
+    mono[0] = c[0];
+    if (degree >= 1) {
+        tCur[1] = 1.0;
+        mono[1] = c[1];
+    }
+    for (int k = 2; k <= degree; k++) {
+        for (int i = 0; i <= k; i++) {
+            tNext[i] = (i > 0 ? 2.0 * tCur[i-1] : 0.0) - tPrev[i];
+        }
+        for (int i = 0; i <= k; i++) {
+            mono[i] += c[k] * tNext[i];
+        }
+        double *t = tPrev;
+        tPrev = tCur;
+        tCur = tNext;
+        tNext = t;
+    }
+
+    // Thay u = scale*x - scale*center theo sơ đồ Horner trên đa thức
+    for (int i = 0; i < n; i++) c[i] = 0;
+    c[0] = mono[degree];
+    for (int k = degree - 1; k >= 0; k--) {
+        for (int i = degree - k; i >= 1; i--) {
+            c[i] = c[i] * (-scale * center) + c[i-1] * scale;
+        }
+        c[0] = c[0] * (-scale * center) + mono[k];
+    }
+    wsRelease(ws, mark);
+    return FIT_OK;
+}
+
+// Khớp đa thức bằng QR, trả về SSres và SStot lấy thẳng từ R. multi: hồi quy
+// nhiều biến với degree đặc trưng (hàng thiết kế [1, x1..xp, y], bỏ qua ortho)
+static int qrFit(const DatasetView *ds, int degree, int ortho, int multi, FitWorkspace *ws,
+                 double coeff[], double *ssResOut, double *ssTotOut, double *cond) {
+    int n = ds->size;
+    if (n <= degree) return FIT_ERR_TOO_FEW_POINTS;
+    int p = degree + 1, q = degree + 2;
+    int chunks = chunkCount(n);
+    TRACE_BEGIN(t);
+
+    FitWorkspace local;
+    size_t mark;
+    ws = wsBegin(ws, &local, &mark);
+    size_t width = (size_t)q * q;
+    if (multi) ortho = 0;
+    QRJob job = {ds->x, ds->y, ds->w, n, degree, ortho, 0.0, 1.0, NULL, NULL, NULL, 0};
+    if (multi) {
+        job.X = ds->X ? ds->X : ds->x;
+        job.ld = ds->ld;
+    }
+    job.parts = (double*)wsAlloc(ws, (size_t)chunks * width * sizeof(double));
+    job.blocks = (double*)wsAlloc(ws, (size_t)chunks * QR_BLOCK_ROWS * q * sizeof(double));
+    if (!job.parts || !job.blocks) {
+        wsEnd(ws, &local, mark);
+        TRACE_END(t, TRACE_QR, 0);
+        return FIT_ERR_NO_MEMORY;
+    }
+
+    if (ortho) {
+        // Lượt phụ: tìm khoảng của x để đưa về [-1, 1]
+        parallelFor(chunks, rangeChunk, &job);
+        double lo = job.parts[0], hi = job.parts[1];
+        for (int c = 1; c < chunks; c++) {
+            if (job.parts[2*c] < lo) lo = job.parts[2*c];
+            if (job.parts[2*c + 1] > hi) hi = job.parts[2*c + 1];
+        }
+        job.center = 0.5 * (lo + hi);
+        job.scale = hi > lo ? 2.0 / (hi - lo) : 1.0;
+    }
+
+    parallelFor(chunks, qrChunk, &job);
+    reduceQRFactors(job.parts, chunks, q);
+    double *R = job.parts;
+
+    // Cột cuối của R là Q^T y: giải R[0..p-1] * c = z bằng thế ngược.
+    // Cột i phụ thuộc tuyến tính (trong sai số làm tròn) vào các cột trước khi
+    // |R[i][i]| quá nhỏ so với chuẩn của chính cột đó.
+    int status = FIT_OK;
+    double *c = coeff + 1;
+    for (int i = p - 1; i >= 0; i--) {
+        double colNorm = 0;
+        for (int k = 0; k <= i; k++) {
+            colNorm += R[k*q + i] * R[k*q + i];
+        }
+        if (!(fabs(R[i*q + i]) > sqrt(colNorm) * DBL_EPSILON * p)) {
+            status = FIT_ERR_SINGULAR;
+            break;
+        }
+        double v = R[i*q + p];
+        for (int j = i + 1; j < p; j++) {
+            v -= R[i*q + j] * c[j];
+        }
+        c[i] = v / R[i*q + i];
+    }
+
+    if (status == FIT_OK) {
+        // Hàm cơ sở đầu tiên là hằng số nên Σ(y - ȳ)^2 = Σ z_i^2 (i >= 1) + SSres
+        double ssRes = R[p*q + p] * R[p*q + p];
+        double ssTot = ssRes;
+        for (int i = 1; i < p; i++) {
+            ssTot += R[i*q + p] * R[i*q + p];
+        }
+        *ssResOut = ssRes;
+        *ssTotOut = ssTot;
+        if (cond) *cond = triangularCond1(R, q, p, ws);
+        if (ortho) status = chebyshevToMonomial(c, degree, job.center, job.scale, ws);
+        coeff[0] = degree;
+        if (status == FIT_OK && !allFinite(c, p)) status = FIT_ERR_SINGULAR;
+    }
+    wsEnd(ws, &local, mark);
+    TRACE_END(t, TRACE_QR, n);
+    return status;
+}
+
+// Khớp đa thức bằng QR; coeff[] có degree+2 phần tử như fitPoly.
+// Các nhân tố R và vùng nháp lấy từ ws (NULL: vùng tạm).
+// *cond (có thể NULL) nhận số điều kiện chuẩn 1 của R trong cơ sở đã dùng.
+int fitPolyQR(const DatasetView *ds, int degree, int ortho, FitWorkspace *ws,
+              double coeff[], double *r2, double *cond) {
+    double ssRes, ssTot;
+    int status = qrFit(ds, degree, ortho, 0, ws, coeff, &ssRes, &ssTot, cond);
+    if (status == FIT_OK) *r2 = 1.0 - safeDiv(ssRes, ssTot);
+    return status;
+}
+
+// Khớp đa thức với bộ giải chọn lúc chạy; coeff[] có degree+2 phần tử.
+// Bộ nhớ tạm lấy từ ws (NULL: vùng tạm); khớp lặp lại với cùng ws không cấp
+// phát heap. *cond (có thể NULL) nhận ước lượng số điều kiện của ma trận thiết kế.
+int fitPolySolver(const DatasetView *ds, int degree, int solver, FitWorkspace *ws,
+                  double coeff[], double *r2, double *cond) {
+    if (solver != SOLVER_NORMAL) {
+        return fitPolyQR(ds, degree, solver == SOLVER_QR_ORTHO, ws, coeff, r2, cond);
+    }
+    FitWorkspace local;
+    size_t mark;
+    ws = wsBegin(ws, &local, &mark);
+    Moments m;
+    int status = accumulateDataset(ds, degree, 0, ws, &m);
+    if (status == FIT_OK) status = solvePolyMoments(&m, degree, ws, coeff, r2, cond);
+    wsEnd(ws, &local, mark);
+    return status;
+}
+
+// coeff[] phải có degree+2 phần tử, coeff[0] lưu bậc đa thức (giống polyModel)
+int fitPoly(const DatasetView *ds, int degree, double coeff[], double *r2) {
+    return fitPolySolver(ds, degree, SOLVER_NORMAL, NULL, coeff, r2, NULL);
+}
+
+// ===== Hồi quy nhiều biến =====
+//
+// Mô hình y = c0 + c1 x1 + ... + cp xp trên các cột đặc trưng của DatasetView
+// (X == NULL: một đặc trưng là x). Phương trình chuẩn tắc chỉ cần ma trận Gram
+// G = AᵀA của ma trận mở rộng A = [1 | X - s | y - ys] (q = p + 2 cột; s, ys
+// là giá trị của điểm đầu, dời gốc để giảm triệt tiêu như Moments.yShift).
+// A không bao giờ được lập trọn: mỗi khối MULTI_BLOCK_ROWS hàng được chép
+// (nhân sqrt(w)) sang vùng nháp theo cột rồi cộng vào tam giác trên của G bằng
+// các ô 2x4 tích vô hướng, duyệt theo dải MULTI_PANEL cột để dải đang dùng nằm
+// trong cache. Mỗi tác vụ có G riêng, ghép bằng reduceChunkSums nên kết quả
+// không phụ thuộc số luồng. Cholesky G[0..p][0..p] = L Lᵀ cho z = L⁻¹ b, và vì
+// cột đầu là hằng số: SSres = G_yy - Σ z_i^2, SStot = G_yy - z_0^2.
+// Với bộ giải QR, qrFit sinh hàng thiết kế [1, x1..xp, y] ngay lúc khử như
+// hàng Vandermonde của đa thức.
+
+#define MULTI_BLOCK_ROWS 128
+#define MULTI_PANEL 64
+
+// Giới hạn tổng số phần tử của các G riêng (tác vụ được gộp lại khi p lớn)
+#define MULTI_PARTIAL_LIMIT (1 << 24)
+
+typedef void (*GramTileFn)(const double *bi, const double *bj, int ld, int rows,
+                           double *g, int ldg);
+
+typedef struct {
+    const double *X, *y, *w;
+    int ld, n, p;
+    int qpad;               // q làm tròn lên bội của 4 (cột đệm luôn bằng 0)
+    int rowsPerTask;
+    const double *shift;    // p + 1 phần tử: s_1..s_p rồi ys
+    double *parts;          // qpad*qpad phần tử cho mỗi tác vụ
+    double *blocks;         // MULTI_BLOCK_ROWS*qpad phần tử nháp cho mỗi tác vụ
+    GramTileFn tile;
+} GramJob;
+
+// g[a][b] += Σ_r bi[a*ld + r] * bj[b*ld + r] với a < 2, b < 4 (rows chia hết cho 4)
+static void gramTileScalar(const double *bi, const double *bj, int ld, int rows,
+                           double *g, int ldg) {
+    double acc[2][4] = {{0}};
+    for (int r = 0; r < rows; r++) {
+        for (int a = 0; a < 2; a++) {
+            double u = bi[(size_t)a * ld + r];
+            for (int b = 0; b < 4; b++) acc[a][b] += u * bj[(size_t)b * ld + r];
+        }
+    }
+    for (int a = 0; a < 2; a++) {
+        for (int b = 0; b < 4; b++) g[a*ldg + b] += acc[a][b];
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+// Tổng ngang của bốn vectơ: phần tử k là tổng các làn của c_k
+__attribute__((target("avx2,fma"), always_inline))
+static inline __m256d sum4Avx2(__m256d c0, __m256d c1, __m256d c2, __m256d c3) {
+    __m256d h01 = _mm256_hadd_pd(c0, c1), h23 = _mm256_hadd_pd(c2, c3);
+    return _mm256_add_pd(_mm256_permute2f128_pd(h01, h23, 0x20),
+                         _mm256_permute2f128_pd(h01, h23, 0x31));
+}
+
+// Như gramTileScalar: 8 bộ tích lũy FMA, 6 lần nạp cho 8 phép nhân mỗi bốn hàng
+__attribute__((target("avx2,fma")))
+static void gramTileAvx2(const double *bi, const double *bj, int ld, int rows,
+                         double *g, int ldg) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+    __m256d b0 = a0, b1 = a0, b2 = a0, b3 = a0;
+    for (int r = 0; r < rows; r += 4) {
+        __m256d u0 = _mm256_loadu_pd(bi + r), u1 = _mm256_loadu_pd(bi + ld + r);
+        __m256d v = _mm256_loadu_pd(bj + r);
+        a0 = _mm256_fmadd_pd(u0, v, a0);
+        b0 = _mm256_fmadd_pd(u1, v, b0);
+        v = _mm256_loadu_pd(bj + ld + r);
+        a1 = _mm256_fmadd_pd(u0, v, a1);
+        b1 = _mm256_fmadd_pd(u1, v, b1);
+        v = _mm256_loadu_pd(bj + 2 * ld + r);
+        a2 = _mm256_fmadd_pd(u0, v, a2);
+        b2 = _mm256_fmadd_pd(u1, v, b2);
+        v = _mm256_loadu_pd(bj + 3 * ld + r);
+        a3 = _mm256_fmadd_pd(u0, v, a3);
+        b3 = _mm256_fmadd_pd(u1, v, b3);
+    }
+    _mm256_storeu_pd(g, _mm256_add_pd(_mm256_loadu_pd(g), sum4Avx2(a0, a1, a2, a3)));
+    _mm256_storeu_pd(g + ldg, _mm256_add_pd(_mm256_loadu_pd(g + ldg), sum4Avx2(b0, b1, b2, b3)));
+    _mm256_zeroupper();
+}
+#endif
+
+static GramTileFn gramTileKernel(void) {
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return gramTileAvx2;
+#endif
+    return gramTileScalar;
+}
+
+// Cộng BᵀB của khối B (qpad cột cách nhau MULTI_BLOCK_ROWS) vào tam giác trên
+// của G; từng dải MULTI_PANEL cột j được dùng lại cho mọi cột i <= j
+static void gramAbsorbBlock(const GramJob *job, const double *B, int rows, double *G) {
+    int qpad = job->qpad, ld = MULTI_BLOCK_ROWS;
+    for (int jb = 0; jb < qpad; jb += MULTI_PANEL) {
+        int je = jb + MULTI_PANEL < qpad ? jb + MULTI_PANEL : qpad;
+        for (int i = 0; i < je; i += 2) {
+            int j0 = (i & ~3) > jb ? (i & ~3) : jb;
+            for (int j = j0; j < je; j += 4) {
+                job->tile(B + (size_t)i * ld, B + (size_t)j * ld, ld, rows, G + (size_t)i * qpad + j, qpad);
+            }
+        }
+    }
+}
+
+static void gramTask(void *ctx, int task) {
+    GramJob *job = (GramJob*)ctx;
+    int qpad = job->qpad, p = job->p;
+    double *G = job->parts + (size_t)task * qpad * qpad;
+    double *B = job->blocks + (size_t)task * MULTI_BLOCK_ROWS * qpad;
+    memset(G, 0, (size_t)qpad * qpad * sizeof(double));
+    memset(B, 0, (size_t)MULTI_BLOCK_ROWS * qpad * sizeof(double));
+
+    int begin = task * job->rowsPerTask;
+    int end = job->n - begin < job->rowsPerTask ? job->n : begin + job->rowsPerTask;
+    for (int i = begin; i < end; i += MULTI_BLOCK_ROWS) {
+        int rows = end - i < MULTI_BLOCK_ROWS ? end - i : MULTI_BLOCK_ROWS;
+        // Cột 0 là sqrt(w), các cột sau nhân với nó; hàng đệm tới bội của 4 bằng 0
+        double *sw = B;
+        for (int r = 0; r < rows; r++) sw[r] = job->w ? sqrt(job->w[i+r]) : 1.0;
+        for (int j = 0; j < p; j++) {
+            const double *col = job->X + (size_t)j * job->ld + i;
+            double *dst = B + (size_t)(j + 1) * MULTI_BLOCK_ROWS;
+            double s = job->shift[j];
+            for (int r = 0; r < rows; r++) dst[r] = (col[r] - s) * sw[r];
+        }
+        double *dst = B + (size_t)(p + 1) * MULTI_BLOCK_ROWS;
+        for (int r = 0; r < rows; r++) dst[r] = (job->y[i+r] - job->shift[p]) * sw[r];
+        int padded = (rows + 3) & ~3;
+        for (int j = 0; j < p + 2 && padded > rows; j++) {
+            memset(B + (size_t)j * MULTI_BLOCK_ROWS + rows, 0, (size_t)(padded - rows) * sizeof(double));
+        }
+        gramAbsorbBlock(job, B, padded, G);
+    }
+}
+
+// Khớp nhiều biến bằng phương trình chuẩn tắc; coeff[] có p+1 phần tử (c0, c1..cp).
+// *cond (có thể NULL) nhận sqrt(cond1) của ma trận chuẩn tắc đã dời gốc.
+static int gramFit(const DatasetView *ds, int p, FitWorkspace *ws, double coeff[],
+                   double *ssResOut, double *ssTotOut, double *cond) {
+    int n = ds->size;
+    if (n <= p) return FIT_ERR_TOO_FEW_POINTS;
+    int m = p + 1, q = p + 2;
+    TRACE_BEGIN(t);
+
+    GramJob job;
+    job.X = ds->X ? ds->X : ds->x;
+    job.ld = ds->ld;
+    job.y = ds->y;
+    job.w = ds->w;
+    job.n = n;
+    job.p = p;
+    job.qpad = (q + 3) & ~3;
+    job.tile = gramTileKernel();
+    size_t width = (size_t)job.qpad * job.qpad;
+    int tasks = chunkCount(n);
+    if ((size_t)tasks * width > MULTI_PARTIAL_LIMIT) {
+        tasks = width >= MULTI_PARTIAL_LIMIT ? 1 : (int)(MULTI_PARTIAL_LIMIT / width);
+    }
+    job.rowsPerTask = (int)(((long long)n + tasks - 1) / tasks);
+    tasks = (n + job.rowsPerTask - 1) / job.rowsPerTask;
+
+    FitWorkspace local;
+    size_t mark;
+    ws = wsBegin(ws, &local, &mark);
+    double *shift = (double*)wsAlloc(ws, (size_t)m * sizeof(double));
+    job.parts = (double*)wsAlloc(ws, (size_t)tasks * width * sizeof(double));
+    job.blocks = (double*)wsAlloc(ws, (size_t)tasks * MULTI_BLOCK_ROWS * job.qpad * sizeof(double));
+    double *L = (double*)wsAlloc(ws, ((size_t)m * m + m) * sizeof(double));
+    if (!shift || !job.parts || !job.blocks || !L) {
+        wsEnd(ws, &local, mark);
+        TRACE_END(t, TRACE_GRAM, 0);
+        return FIT_ERR_NO_MEMORY;
+    }
+    for (int j = 0; j < p; j++) shift[j] = job.X[(size_t)j * job.ld];
+    shift[p] = ds->y[0];
+    job.shift = shift;
+
+    parallelFor(tasks, gramTask, &job);
+    reduceChunkSums(job.parts, tasks, (int)width);
+    const double *G = job.parts;
+    int ldg = job.qpad;
+
+    if (cond) {
+        // Ma trận chuẩn tắc đầy đủ (G chỉ có tam giác trên) mượn chỗ của L
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++) L[i*m + j] = i <= j ? G[i*ldg + j] : G[j*ldg + i];
+        }
+        *cond = sqrt(matrixCond1(L, m, m, ws));
+    }
+
+    // Cholesky theo hàng cùng lúc với z = L⁻¹ b (b là cột y của G). Hàng k suy
+    // biến khi phần còn lại của G_kk chìm trong sai số làm tròn của chính nó.
+    int status = FIT_OK;
+    double *z = L + (size_t)m * m;
+    for (int k = 0; k < m && status == FIT_OK; k++) {
+        for (int j = 0; j <= k; j++) {
+            double s = G[j*ldg + k];
+            for (int t = 0; t < j; t++) s -= L[k*m + t] * L[j*m + t];
+            if (j < k) {
+                L[k*m + j] = s / L[j*m + j];
+            } else if (s > G[k*ldg + k] * DBL_EPSILON * m) {
+                L[k*m + k] = sqrt(s);
+            } else {
+                status = FIT_ERR_SINGULAR;
+            }
+        }
+        if (status != FIT_OK) break;
+        double v = G[k*ldg + q - 1];
+        for (int t = 0; t < k; t++) v -= L[k*m + t] * z[t];
+        z[k] = v / L[k*m + k];
+    }
+
+    if (status == FIT_OK) {
+        double syy = G[(q-1)*ldg + q - 1], sz = 0;
+        for (int k = 0; k < m; k++) sz += z[k] * z[k];
+        *ssResOut = syy - sz;
+        *ssTotOut = syy - z[0] * z[0];
+
+        // Lᵀ c = z, rồi trả gốc tọa độ: c0 = c0' + ys - Σ c_j s_j
+        for (int i = m - 1; i >= 0; i--) {
+            double v = z[i];
+            for (int k = i + 1; k < m; k++) v -= L[k*m + i] * coeff[k];
+            coeff[i] = v / L[i*m + i];
+        }
+        double c0 = coeff[0] + shift[p];
+        for (int j = 1; j < m; j++) c0 -= coeff[j] * shift[j-1];
+        coeff[0] = c0;
+        if (!allFinite(coeff, m)) status = FIT_ERR_SINGULAR;
+    }
+    wsEnd(ws, &local, mark);
+    TRACE_END(t, TRACE_GRAM, n);
+    return status;
+}
+
+// ===== Mô hình =====
+
+void formatModelSpec(const ModelSpec *m, char *buf, size_t len) {
+    switch (m->kind) {
+        case MODEL_LINEAR: snprintf(buf, len, "linear"); break;
+        case MODEL_LOG: snprintf(buf, len, "log"); break;
+        case MODEL_EXP: snprintf(buf, len, "exp"); break;
+        case MODEL_QUADRATIC: snprintf(buf, len, "quadratic"); break;
+        case MODEL_MULTI: snprintf(buf, len, "multi"); break;
+        default: snprintf(buf, len, "poly:%d", m->degree); break;
+    }
+}
+
+// Phân tích danh sách mô hình dạng "linear,log,exp,quadratic,poly:N,multi"
+// Trả về số mô hình, hoặc -1 nếu có mô hình không hợp lệ
+int parseModelList(const char *spec, ModelSpec models[], int maxModels) {
+    int count = 0;
+    const char *p = spec;
+    while (*p) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        char name[32];
+        if (len == 0 || len >= sizeof(name) || count >= maxModels) return -1;
+        memcpy(name, p, len);
+        name[len] = '\0';
+
+        ModelSpec m = {MODEL_LINEAR, 1};
+        if (strcmp(name, "linear") == 0) {
+            m.kind = MODEL_LINEAR;
+        } else if (strcmp(name, "log") == 0) {
+            m.kind = MODEL_LOG;
+        } else if (strcmp(name, "exp") == 0) {
+            m.kind = MODEL_EXP;
+        } else if (strcmp(name, "quadratic") == 0) {
+            m.kind = MODEL_QUADRATIC;
+            m.degree = 2;
+        } else if (strncmp(name, "poly:", 5) == 0) {
+            char *tail;
+            long d = strtol(name + 5, &tail, 10);
+            if (tail == name + 5 || *tail != '\0' || d < 1 || d > MAX_POLY_DEGREE) return -1;
+            m.kind = MODEL_POLY;
+            m.degree = (int)d;
+        } else if (strcmp(name, "multi") == 0) {
+            m.kind = MODEL_MULTI;
+            m.degree = 0;       // số đặc trưng, biết khi khớp
+        } else {
+            return -1;
+        }
+        models[count++] = m;
+        p += len;
+        if (*p == ',') p++;
+    }
+    return count;
+}
+
+// Số phần tử của coeff[] cho mô hình (đa thức: kể cả ô lưu bậc)
+int coeffCount(const ModelSpec *m) {
+    switch (m->kind) {
+        case MODEL_QUADRATIC: return 3;
+        case MODEL_POLY: return m->degree + 2;
+        case MODEL_MULTI: return m->degree + 1;
+        default: return 2;
+    }
+}
+
+// Bậc đa thức và các nhóm tổng cần để khớp cả danh sách mô hình
+// (hồi quy nhiều biến không dùng mô-men nên bị bỏ qua)
+void momentsNeeded(const ModelSpec models[], int modelCount, int *maxDegree, int *flags) {
+    *maxDegree = 1;
+    *flags = 0;
+    for (int i = 0; i < modelCount; i++) {
+        if (models[i].kind == MODEL_MULTI) continue;
+        if (models[i].kind == MODEL_LOG) *flags |= MOMENT_LOGX;
+        if (models[i].kind == MODEL_EXP) *flags |= MOMENT_LOGY;
+        if (models[i].degree > *maxDegree) *maxDegree = models[i].degree;
+    }
+}
+
+// Giải một mô hình từ mô-men đã tích lũy; coeff[] cần ít nhất degree+2 phần tử.
+// ds chỉ được đọc lại cho R^2 của hàm mũ; ds == NULL (không giữ dữ liệu gốc)
+// thì R^2 của hàm mũ tính trên thang ln y. Bộ nhớ tạm lấy từ ws (NULL: vùng tạm).
+int solveModel(const DatasetView *ds, const Moments *mo, const ModelSpec *m, FitWorkspace *ws,
+               double coeff[], double *r2) {
+    switch (m->kind) {
+        case MODEL_LINEAR: return solveLinearMoments(mo, coeff, r2);
+        case MODEL_LOG: return solveLogMoments(mo, coeff, r2);
+        case MODEL_EXP: {
+            int status = solveExpMoments(mo, coeff);
+            if (status == FIT_OK && ds) {
+                status = residualR2(ds, expModel, coeff, mo, ws, r2);
+            } else if (status == FIT_OK) {
+                *r2 = expLogR2(mo, coeff);
+            }
+            return status;
+        }
+        case MODEL_QUADRATIC: return solveQuadraticMoments(mo, ws, coeff, r2);
+        case MODEL_MULTI: return FIT_ERR_SINGULAR;     // cần dữ liệu gốc (fitModels)
+        default: return solvePolyMoments(mo, m->degree, ws, coeff, r2, NULL);
+    }
+}
+
+// Thống kê phần dư từ SSres; số bậc tự do trừ đi số hệ số của mô hình
+static void finishResult(FitResult *res, double ssRes, double ssTot) {
+    int params = res->model.kind == MODEL_POLY ? res->coeffCount - 1 : res->coeffCount;
+    res->ssRes = ssRes < 0 ? 0 : ssRes;
+    res->ssTot = ssTot;
+    res->rmse = res->n > 0 ? sqrt(res->ssRes / res->n) : NAN;
+    res->stdError = res->n > params ? sqrt(res->ssRes / (res->n - params)) : NAN;
+    res->adjR2 = res->n > params ? 1.0 - (1.0 - res->r2) * (res->n - 1) / (res->n - params) : NAN;
+
+    // Log-likelihood với sai số chuẩn: n ln(SSres/n); khớp tuyệt đối thì chặn dưới
+    double mse = res->n > 0 ? res->ssRes / res->n : NAN;
+    if (mse < DBL_MIN) mse = DBL_MIN;
+    res->aic = res->n * log(mse) + 2.0 * params;
+    res->bic = res->n * log(mse) + params * log((double)res->n);
+}
+
+// Khởi tạo kết quả rỗng (NAN) và cấp hệ số từ ws
+static void initFitResult(FitResult *res, const ModelSpec *spec, long long n, FitWorkspace *ws) {
+    memset(res, 0, sizeof(*res));
+    res->model = *spec;
+    res->n = n;
+    res->coeffCount = coeffCount(spec);
+    res->r2 = res->ssRes = res->ssTot = res->rmse = res->stdError = res->cond = NAN;
+    res->adjR2 = res->aic = res->bic = NAN;
+    // Bậc hai được giải như đa thức nên cần thêm ô lưu bậc
+    res->coeff = (double*)wsAlloc(ws, (size_t)(res->coeffCount + 1) * sizeof(double));
+    res->status = res->coeff ? FIT_OK : FIT_ERR_NO_MEMORY;
+}
+
+// Giải một kết quả đã khởi tạo từ mô-men (đa thức: phương trình chuẩn tắc)
+static void solveResult(const DatasetView *ds, const Moments *m, FitWorkspace *ws,
+                        FitResult *res, double ssTot) {
+    const ModelSpec *spec = &res->model;
+    TRACE_BEGIN(t);
+    if (spec->kind == MODEL_QUADRATIC || spec->kind == MODEL_POLY) {
+        res->status = solvePolyMoments(m, spec->degree, ws, res->coeff, &res->r2, &res->cond);
+        // Bậc hai không có ô lưu bậc ở coeff[0]
+        if (spec->kind == MODEL_QUADRATIC) memmove(res->coeff, res->coeff + 1, 3 * sizeof(double));
+    } else {
+        res->status = solveModel(ds, m, spec, ws, res->coeff, &res->r2);
+    }
+    if (res->status == FIT_OK) finishResult(res, (1.0 - res->r2) * ssTot, ssTot);
+    TRACE_END(t, TRACE_SOLVE, res->n);
+}
+
+// Khớp một kết quả nhiều biến đã khởi tạo (model.degree = số đặc trưng)
+static void fitMultiResult(const DatasetView *ds, int solver, FitWorkspace *ws, FitResult *res) {
+    int p = res->model.degree;
+    double ssRes = NAN, ssTot = NAN;
+    if (solver == SOLVER_NORMAL) {
+        res->status = gramFit(ds, p, ws, res->coeff, &ssRes, &ssTot, &res->cond);
+    } else {
+        res->status = qrFit(ds, p, 0, 1, ws, res->coeff, &ssRes, &ssTot, &res->cond);
+        // Bỏ ô lưu bậc mà qrFit ghi ở coeff[0]
+        memmove(res->coeff, res->coeff + 1, (size_t)(p + 1) * sizeof(double));
+    }
+    if (res->status == FIT_OK) {
+        res->r2 = 1.0 - safeDiv(ssRes, ssTot);
+        finishResult(res, ssRes, ssTot);
+    }
+}
+
+// Khớp tất cả mô hình với một lượt tích lũy chung (đa thức và hồi quy nhiều
+// biến dùng bộ giải solver; số đặc trưng của MODEL_MULTI lấy từ ds và ghi vào
+// results[i].model.degree). Hệ số của từng kết quả nằm trong ws, hợp lệ đến
+// lần wsReset kế tiếp. Trả về FIT_ERR_NO_MEMORY nếu không tích lũy được, còn
+// lại FIT_OK (trạng thái riêng của từng mô hình nằm trong results[i].status).
+int fitModels(const DatasetView *ds, const ModelSpec specs[], int count, int solver,
+              FitWorkspace *ws, FitResult results[]) {
+    TRACE_BEGIN(t);
+    int multiOnly = 1;
+    for (int i = 0; i < count; i++) {
+        ModelSpec spec = specs[i];
+        if (spec.kind == MODEL_MULTI) spec.degree = ds->X ? ds->features : 1;
+        else multiOnly = 0;
+        initFitResult(&results[i], &spec, ds->size, ws);
+    }
+
+    // Với bộ giải QR, đa thức được khớp riêng nên mô-men chỉ cần tới bậc 1
+    int maxDegree, flags;
+    momentsNeeded(specs, count, &maxDegree, &flags);
+    if (solver != SOLVER_NORMAL) maxDegree = 1;
+    Moments m;
+    if (wsMoments(ws, &m, maxDegree, flags) != 0) {
+        for (int i = 0; i < count; i++) results[i].status = FIT_ERR_NO_MEMORY;
+        TRACE_END(t, TRACE_FIT, 0);
+        return FIT_ERR_NO_MEMORY;
+    }
+    if (!multiOnly) accumulateWeightedMoments(&m, ds->x, ds->y, ds->w, ds->size, ws);
+    double ssTot = momentsSsTot(&m);
+
+    for (int i = 0; i < count; i++) {
+        FitResult *res = &results[i];
+        if (res->status != FIT_OK) continue;
+        const ModelSpec *spec = &specs[i];
+        if (spec->kind == MODEL_MULTI) {
+            fitMultiResult(ds, solver, ws, res);
+        } else if ((spec->kind == MODEL_QUADRATIC || spec->kind == MODEL_POLY) && solver != SOLVER_NORMAL) {
+            double ssRes = NAN, tot = NAN;
+            res->status = qrFit(ds, spec->degree, solver == SOLVER_QR_ORTHO, 0, ws,
+                                res->coeff, &ssRes, &tot, &res->cond);
+            res->r2 = 1.0 - safeDiv(ssRes, tot);
+            if (spec->kind == MODEL_QUADRATIC) memmove(res->coeff, res->coeff + 1, 3 * sizeof(double));
+            if (res->status == FIT_OK) finishResult(res, ssRes, tot);
+        } else {
+            solveResult(ds, &m, ws, res, ssTot);
+        }
+    }
+    TRACE_END(t, TRACE_FIT, ds->size);
+    return FIT_OK;
+}
+
+// Thay SSres của kết quả đã khớp (ví dụ hàm mũ tính lại trên y gốc):
+// R^2 và các thống kê phần dư được tính lại, SStot giữ nguyên
+void setResidualSum(FitResult *res, double ssRes) {
+    if (res->status != FIT_OK) return;
+    res->r2 = 1.0 - safeDiv(ssRes, res->ssTot);
+    finishResult(res, ssRes, res->ssTot);
+}
+
+// Khớp các mô hình từ mô-men đã có, không đọc lại dữ liệu: m phải đủ bậc và
+// nhóm tổng (momentsNeeded), đa thức giải bằng phương trình chuẩn tắc; hồi quy
+// nhiều biến cần dữ liệu gốc nên luôn cho FIT_ERR_SINGULAR. n là số
+// điểm của dữ liệu; ds chỉ dùng cho R^2 của hàm mũ (NULL: R^2 tính trên ln y).
+// Hệ số nằm trong ws như fitModels.
+void fitModelsFromMoments(const DatasetView *ds, const Moments *m, long long n, const ModelSpec specs[],
+                          int count, FitWorkspace *ws, FitResult results[]) {
+    double ssTot = momentsSsTot(m);
+    for (int i = 0; i < count; i++) {
+        FitResult *res = &results[i];
+        initFitResult(res, &specs[i], n, ws);
+        if (res->status != FIT_OK) continue;
+        if (specs[i].kind == MODEL_MULTI || specs[i].degree > m->maxDegree ||
+            (specs[i].kind == MODEL_LOG && !(m->flags & MOMENT_LOGX)) ||
+            (specs[i].kind == MODEL_EXP && !(m->flags & MOMENT_LOGY))) {
+            res->status = FIT_ERR_SINGULAR;
+            continue;
+        }
+        solveResult(ds, m, ws, res, ssTot);
+    }
+}
+
+int fitModel(const DatasetView *ds, const ModelSpec *spec, int solver, FitWorkspace *ws,
+             FitResult *res) {
+    fitModels(ds, spec, 1, solver, ws, res);
+    return res->status;
+}
+
+// ===== Tự chọn mô hình =====
+//
+// Mọi họ mô hình dùng chung một lượt tích lũy mô-men. Với đa thức, ma trận
+// chuẩn tắc G (G_ij = Σ x^(i+j)) được phân rã Cholesky G = L Lᵀ một lần tới
+// bậc K: khối (d+1) x (d+1) đầu của L chính là nhân tử của bậc d, nên
+// z = L⁻¹ b cũng dùng chung và Σ ŷ'^2 của bậc d là z_0^2 + ... + z_d^2.
+// Mỗi bậc chỉ cần thêm một phép thế ngược để ra hệ số.
+
+const char *criterionName(int criterion) {
+    switch (criterion) {
+        case CRITERION_AIC: return "aic";
+        case CRITERION_BIC: return "bic";
+        case CRITERION_ADJR2: return "adjr2";
+        case CRITERION_R2: return "r2";
+    }
+    return "unknown";
+}
+
+int parseCriterion(const char *name) {
+    for (int c = CRITERION_AIC; c <= CRITERION_R2; c++) {
+        if (strcmp(name, criterionName(c)) == 0) return c;
+    }
+    return -1;
+}
+
+// Điểm theo tiêu chí, càng nhỏ càng tốt (R^2 được đổi dấu)
+double criterionScore(const FitResult *res, int criterion) {
+    switch (criterion) {
+        case CRITERION_BIC: return res->bic;
+        case CRITERION_ADJR2: return -res->adjR2;
+        case CRITERION_R2: return -res->r2;
+        default: return res->aic;
+    }
+}
+
+// Các ứng viên: linear, log, exp, quadratic, poly:3 .. poly:K
+int autoCandidateCount(int maxDegree) {
+    return maxDegree < 2 ? 3 : maxDegree + 2;
+}
+
+static void initAutoResult(FitResult *res, int kind, int degree, int n, FitWorkspace *ws) {
+    memset(res, 0, sizeof(*res));
+    res->model.kind = kind;
+    res->model.degree = degree;
+    res->n = n;
+    res->coeffCount = coeffCount(&res->model);
+    res->r2 = res->ssRes = res->ssTot = res->rmse = res->stdError = res->cond = NAN;
+    res->adjR2 = res->aic = res->bic = NAN;
+    res->coeff = (double*)wsAlloc(ws, (size_t)res->coeffCount * sizeof(double));
+    res->status = res->coeff ? FIT_OK : FIT_ERR_NO_MEMORY;
+}
+
+// Khớp mọi họ mô hình áp dụng được (log bị bỏ khi có x <= 0, exp khi có y <= 0,
+// với trạng thái FIT_ERR_DOMAIN) và đa thức bậc 1..maxDegree, rồi chọn mô hình
+// tốt nhất theo criterion. results[] cần autoCandidateCount(maxDegree) phần tử;
+// hệ số nằm trong ws. *best là chỉ số mô hình tốt nhất (-1 nếu không có).
+// Đa thức luôn được giải bằng phương trình chuẩn tắc; cond của bậc hai và đa
+// thức bậc cao hơn tính như solvePolyMoments.
+int fitAuto(const DatasetView *ds, int maxDegree, int criterion, FitWorkspace *ws,
+            FitResult results[], int *best) {
+    *best = -1;
+    if (maxDegree < 1) maxDegree = 1;
+    int count = autoCandidateCount(maxDegree);
+    initAutoResult(&results[0], MODEL_LINEAR, 1, ds->size, ws);
+    initAutoResult(&results[1], MODEL_LOG, 1, ds->size, ws);
+    initAutoResult(&results[2], MODEL_EXP, 1, ds->size, ws);
+    for (int d = 2; d <= maxDegree; d++) {
+        initAutoResult(&results[d + 1], d == 2 ? MODEL_QUADRATIC : MODEL_POLY, d, ds->size, ws);
+    }
+
+    int q = maxDegree + 1;
+    Moments m;
+    double *L = NULL, *z = NULL;
+    if (wsMoments(ws, &m, maxDegree, MOMENT_LOGX | MOMENT_LOGY) == 0) {
+        L = (double*)wsAlloc(ws, (size_t)q * q * sizeof(double));
+        z = L ? (double*)wsAlloc(ws, (size_t)q * sizeof(double)) : NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!z) results[i].status = FIT_ERR_NO_MEMORY;
+    }
+    if (!z) return FIT_ERR_NO_MEMORY;
+    accumulateWeightedMoments(&m, ds->x, ds->y, ds->w, ds->size, ws);
+    double ssTot = momentsSsTot(&m);
+
+    // Cholesky từng hàng; dừng ở bậc đầu tiên mà G mất xác định dương
+    int valid = 0;
+    for (int j = 0; j < q && j < m.count; j++) {
+        for (int i = 0; i < j; i++) {
+            double sum = m.sx[i + j];
+            for (int k = 0; k < i; k++) sum -= L[j*q + k] * L[i*q + k];
+            L[j*q + i] = sum / L[i*q + i];
+        }
+        double pivot = m.sx[2*j];
+        for (int k = 0; k < j; k++) pivot -= L[j*q + k] * L[j*q + k];
+        if (!(pivot > m.sx[2*j] * DBL_EPSILON * q) || !isfinite(pivot)) break;
+        L[j*q + j] = sqrt(pivot);
+
+        double zj = m.sxy[j];
+        for (int k = 0; k < j; k++) zj -= L[j*q + k] * z[k];
+        z[j] = zj / L[j*q + j];
+        valid = j + 1;
+    }
+
+    double fitted = 0;
+    for (int d = 0; d <= maxDegree; d++) {
+        if (d < valid) fitted += z[d] * z[d];
+        if (d == 0) continue;
+        FitResult *res = &results[d == 1 ? 0 : d + 1];
+        if (res->status != FIT_OK) continue;
+        if (m.count <= d) {
+            res->status = FIT_ERR_TOO_FEW_POINTS;
+            continue;
+        }
+        if (d >= valid) {
+            res->status = FIT_ERR_SINGULAR;
+            continue;
+        }
+
+        // Thế ngược Lᵀ c = z trên khối bậc d
+        double *c = res->model.kind == MODEL_POLY ? res->coeff + 1 : res->coeff;
+        for (int i = d; i >= 0; i--) {
+            double sum = z[i];
+            for (int k = i + 1; k <= d; k++) sum -= L[k*q + i] * c[k];
+            c[i] = sum / L[i*q + i];
+        }
+        c[0] += m.yShift;
+        if (res->model.kind == MODEL_POLY) res->coeff[0] = d;
+
+        double ssRes = m.syy - fitted;
+        res->r2 = 1.0 - safeDiv(ssRes < 0 ? 0 : ssRes, ssTot);
+        finishResult(res, ssRes, ssTot);
+        // Ma trận chuẩn tắc là khối Hankel của sx: hàng i bắt đầu tại sx + i
+        if (d >= 2) res->cond = sqrt(matrixCond1(m.sx, 1, d + 1, ws));
+    }
+
+    // Log và hàm mũ từ cùng các tổng
+    for (int i = 1; i <= 2; i++) {
+        FitResult *res = &results[i];
+        if (res->status != FIT_OK) continue;
+        res->status = solveModel(ds, &m, &res->model, ws, res->coeff, &res->r2);
+        if (res->status == FIT_OK) finishResult(res, (1.0 - res->r2) * ssTot, ssTot);
+    }
+
+    double bestScore = INFINITY;
+    for (int i = 0; i < count; i++) {
+        if (results[i].status != FIT_OK) continue;
+        double score = criterionScore(&results[i], criterion);
+        if (*best < 0 || score < bestScore) {
+            *best = i;
+            bestScore = score;
+        }
+    }
+    return FIT_OK;
+}
+
+// ===== Khớp nhiều chuỗi ngắn (batch) =====
+//
+// Mỗi việc song song xử lý BATCH_TASK_SERIES chuỗi liên tiếp. Trong một việc,
+// các chuỗi được xếp theo độ dài rồi gom thành nhóm BATCH_LANES chuỗi; mỗi làn
+// vector cộng dồn mô-men của một chuỗi. Các tổng sau đó đi qua đúng các bộ giải
+// solve*Moments của fitModel, nên mỗi chuỗi cho cùng kết quả như khi khớp riêng
+// (chỉ khác thứ tự cộng).
+
+#define BATCH_TASK_SERIES 256
+#define BATCH_LANES 4
+#define BATCH_MAX_DEGREE 8      // bậc cao hơn dùng nhân vô hướng cho từng chuỗi
+#define BATCH_BUCKET_WIDTH 4    // độ rộng nhóm độ dài khi xếp chuỗi
+#define BATCH_BUCKETS 256
+
+typedef struct {
+    const SeriesBatch *batch;
+    const ModelSpec *spec;
+    int degree, flags;
+    int width;                  // số hệ số của mỗi chuỗi trong coeff[]
+    int simd;                   // 1: dùng nhân AVX2 theo làn
+    double *coeff, *r2;
+    int *status;
+} BatchJob;
+
+#ifdef HAVE_X86_KERNELS
+// Cộng một vector điểm (mỗi làn một chuỗi) vào các tổng; p = trọng số 0/1
+#define BATCH_ACCUMULATE(xv, yv, pv) do {                     \
+        __m256d p_ = (pv);                                    \
+        for (int k = 0; k <= degree; k++) {                   \
+            ax[k] = _mm256_add_pd(ax[k], p_);                 \
+            axy[k] = _mm256_fmadd_pd(p_, (yv), axy[k]);       \
+            p_ = _mm256_mul_pd(p_, (xv));                     \
+        }                                                     \
+        for (int k = degree + 1; k <= 2 * degree; k++) {      \
+            ax[k] = _mm256_add_pd(ax[k], p_);                 \
+            p_ = _mm256_mul_pd(p_, (xv));                     \
+        }                                                     \
+        ayy = _mm256_fmadd_pd((yv), (yv), ayy);               \
+    } while (0)
+
+// Chuyển vị khối 4x4: r[l] là 4 điểm liên tiếp của làn l, c[j] là điểm j của cả 4 làn
+#define BATCH_TRANSPOSE(r0, r1, r2, r3, c) do {               \
+        __m256d t0_ = _mm256_unpacklo_pd(r0, r1);             \
+        __m256d t1_ = _mm256_unpackhi_pd(r0, r1);             \
+        __m256d t2_ = _mm256_unpacklo_pd(r2, r3);             \
+        __m256d t3_ = _mm256_unpackhi_pd(r2, r3);             \
+        c[0] = _mm256_permute2f128_pd(t0_, t2_, 0x20);        \
+        c[1] = _mm256_permute2f128_pd(t1_, t3_, 0x20);        \
+        c[2] = _mm256_permute2f128_pd(t0_, t2_, 0x31);        \
+        c[3] = _mm256_permute2f128_pd(t1_, t3_, 0x31);        \
+    } while (0)
+
+// Mô-men x^k của BATCH_LANES chuỗi cùng lúc, làn l là chuỗi bắt đầu tại
+// start[l] với len[l] điểm (0: làn trống); kết quả cộng vào m[l]. Phần chung
+// của các làn đọc 4 điểm mỗi làn rồi chuyển vị; phần đuôi gather có mặt nạ.
+// Luôn được inline với degree là hằng số để các tổng nằm trong thanh ghi.
+__attribute__((target("avx2,fma"), always_inline))
+static inline void batchLanesAvx2(const double *x, const double *y, const long long *start,
+                                  const int *len, Moments *m[], const int degree) {
+    __m256d ax[2 * BATCH_MAX_DEGREE + 1], axy[BATCH_MAX_DEGREE + 1];
+    for (int k = 0; k <= 2 * degree; k++) ax[k] = _mm256_setzero_pd();
+    for (int k = 0; k <= degree; k++) axy[k] = _mm256_setzero_pd();
+    __m256d ayy = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d vshift = _mm256_set_pd(m[3]->yShift, m[2]->yShift, m[1]->yShift, m[0]->yShift);
+    const double *x0 = x + start[0], *x1 = x + start[1], *x2 = x + start[2], *x3 = x + start[3];
+    const double *y0 = y + start[0], *y1 = y + start[1], *y2 = y + start[2], *y3 = y + start[3];
+
+    int minLen = len[0], maxLen = len[0];
+    for (int l = 1; l < BATCH_LANES; l++) {
+        if (len[l] < minLen) minLen = len[l];
+        if (len[l] > maxLen) maxLen = len[l];
+    }
+
+    int i = 0;
+    for (; i + 4 <= minLen; i += 4) {
+        __m256d xc[4], yc[4];
+        BATCH_TRANSPOSE(_mm256_loadu_pd(x0 + i), _mm256_loadu_pd(x1 + i),
+                        _mm256_loadu_pd(x2 + i), _mm256_loadu_pd(x3 + i), xc);
+        BATCH_TRANSPOSE(_mm256_loadu_pd(y0 + i), _mm256_loadu_pd(y1 + i),
+                        _mm256_loadu_pd(y2 + i), _mm256_loadu_pd(y3 + i), yc);
+        for (int j = 0; j < 4; j++) {
+            __m256d yj = _mm256_sub_pd(yc[j], vshift);
+            BATCH_ACCUMULATE(xc[j], yj, one);
+        }
+    }
+
+    const __m256i vlen = _mm256_set_epi64x(len[3], len[2], len[1], len[0]);
+    const __m256i step = _mm256_set1_epi64x(1);
+    __m256i pos = _mm256_set1_epi64x(i);
+    __m256i idx = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)start), pos);
+    for (; i < maxLen; i++) {
+        // Làn đã hết điểm: không đọc bộ nhớ, trọng số 0
+        __m256d mask = _mm256_castsi256_pd(_mm256_cmpgt_epi64(vlen, pos));
+        __m256d xi = _mm256_mask_i64gather_pd(_mm256_setzero_pd(), x, idx, mask, 8);
+        __m256d yi = _mm256_mask_i64gather_pd(_mm256_setzero_pd(), y, idx, mask, 8);
+        yi = _mm256_and_pd(_mm256_sub_pd(yi, vshift), mask);
+        BATCH_ACCUMULATE(xi, yi, _mm256_and_pd(one, mask));
+        idx = _mm256_add_epi64(idx, step);
+        pos = _mm256_add_epi64(pos, step);
+    }
+
+    double lanes[BATCH_LANES];
+    for (int k = 0; k <= 2 * degree; k++) {
+        _mm256_storeu_pd(lanes, ax[k]);
+        for (int l = 0; l < BATCH_LANES; l++) m[l]->sx[k] += lanes[l];
+    }
+    for (int k = 0; k <= degree; k++) {
+        _mm256_storeu_pd(lanes, axy[k]);
+        for (int l = 0; l < BATCH_LANES; l++) m[l]->sxy[k] += lanes[l];
+    }
+    _mm256_storeu_pd(lanes, ayy);
+    for (int l = 0; l < BATCH_LANES; l++) m[l]->syy += lanes[l];
+}
+
+__attribute__((target("avx2,fma")))
+static void batchPowerSumsAvx2(const double *x, const double *y, const long long *start,
+                               const int *len, Moments *m[], int degree) {
+    switch (degree) {
+        case 1: batchLanesAvx2(x, y, start, len, m, 1); break;
+        case 2: batchLanesAvx2(x, y, start, len, m, 2); break;
+        default: batchLanesAvx2(x, y, start, len, m, degree); break;
+    }
+    _mm256_zeroupper();
+}
+#endif
+
+// Giải một chuỗi từ mô-men; R^2 của hàm mũ tính trên y gốc như fitModel
+static int solveSeries(const BatchJob *job, const Moments *m, const double *x, const double *y,
+                       int n, FitWorkspace *ws, double coeff[], double *r2) {
+    if (job->spec->kind != MODEL_EXP) {
+        return solveModel(NULL, m, job->spec, ws, coeff, r2);
+    }
+    int status = solveExpMoments(m, coeff);
+    if (status == FIT_OK) {
+        double ss_res = 0;
+        for (int i = 0; i < n; i++) {
+            double e = y[i] - expModel(x[i], coeff);
+            ss_res += e * e;
+        }
+        *r2 = 1.0 - safeDiv(ss_res, momentsSsTot(m));
+    }
+    return status;
+}
+
+static void batchChunk(void *ctx, int task) {
+    BatchJob *job = (BatchJob*)ctx;
+    const SeriesBatch *b = job->batch;
+    int first = task * BATCH_TASK_SERIES;
+    int count = b->count - first < BATCH_TASK_SERIES ? b->count - first : BATCH_TASK_SERIES;
+
+    // Xếp theo độ dài (đếm theo nhóm BATCH_BUCKET_WIDTH điểm, giữ thứ tự ban đầu
+    // trong mỗi nhóm) để các làn trong một nhóm vector ít phải chờ nhau
+    int order[BATCH_TASK_SERIES], bucket[BATCH_TASK_SERIES];
+    int start[BATCH_BUCKETS + 1] = {0};
+    for (int i = 0; i < count; i++) {
+        int len = b->offsets[first + i + 1] - b->offsets[first + i];
+        bucket[i] = len <= 0 ? 0 : len / BATCH_BUCKET_WIDTH;
+        if (bucket[i] >= BATCH_BUCKETS) bucket[i] = BATCH_BUCKETS - 1;
+        start[bucket[i] + 1]++;
+    }
+    for (int k = 0; k < BATCH_BUCKETS; k++) start[k + 1] += start[k];
+    for (int i = 0; i < count; i++) order[start[bucket[i]]++] = first + i;
+
+    FitWorkspace ws;
+    initWorkspace(&ws);
+    size_t width = momentsBufferSize(job->degree);
+    double *buf = (double*)wsAlloc(&ws, BATCH_LANES * width * sizeof(double));
+    if (!buf) {
+        for (int i = 0; i < count; i++) job->status[first + i] = FIT_ERR_NO_MEMORY;
+        freeWorkspace(&ws);
+        return;
+    }
+    size_t mark = wsMark(&ws);
+
+    Moments lanes[BATCH_LANES];
+    Moments *m[BATCH_LANES];
+    for (int g = 0; g < count; g += BATCH_LANES) {
+        int series[BATCH_LANES], len[BATCH_LANES];
+        long long from[BATCH_LANES];
+        for (int l = 0; l < BATCH_LANES; l++) {
+            bindMoments(&lanes[l], job->degree, job->flags, buf + l * width);
+            m[l] = &lanes[l];
+            series[l] = g + l < count ? order[g + l] : -1;
+            from[l] = series[l] >= 0 ? b->offsets[series[l]] : 0;
+            len[l] = series[l] >= 0 ? b->offsets[series[l] + 1] - b->offsets[series[l]] : 0;
+            if (len[l] < 0) len[l] = 0;
+            if (len[l] > 0) lanes[l].yShift = b->y[from[l]];
+        }
+
+#ifdef HAVE_X86_KERNELS
+        if (job->simd) {
+            batchPowerSumsAvx2(b->x, b->y, from, len, m, job->degree);
+        } else
+#endif
+        {
+            for (int l = 0; l < BATCH_LANES; l++) {
+                powerSumsScalar(b->x + from[l], b->y + from[l], len[l], lanes[l].yShift,
+                                job->degree, lanes[l].sx, lanes[l].sxy, &lanes[l].syy);
+            }
+        }
+
+        for (int l = 0; l < BATCH_LANES && series[l] >= 0; l++) {
+            int s = series[l];
+            const double *x = b->x + from[l], *y = b->y + from[l];
+            accumulateLogSums(&lanes[l], x, y, NULL, len[l]);
+            lanes[l].count = len[l];
+            lanes[l].n = len[l];
+
+            double *coeff = job->coeff + (size_t)s * job->width;
+            job->status[s] = solveSeries(job, &lanes[l], x, y, len[l], &ws, coeff, &job->r2[s]);
+            if (job->status[s] != FIT_OK) {
+                for (int k = 0; k < job->width; k++) coeff[k] = NAN;
+                job->r2[s] = NAN;
+            }
+            wsRelease(&ws, mark);
+        }
+    }
+    freeWorkspace(&ws);
+}
+
+// Khớp mô hình spec cho từng chuỗi của batch trong một lần gọi, song song theo
+// nhóm chuỗi. Kết quả nằm liền nhau: hệ số của chuỗi s ở coeff[s * coeffCount(spec)]
+// (cùng thứ tự với fitModel), R^2 ở r2[s], trạng thái FIT_* ở status[s].
+int fitSeriesBatch(const SeriesBatch *batch, const ModelSpec *spec,
+                   double coeff[], double r2[], int status[]) {
+    BatchJob job;
+    job.batch = batch;
+    job.spec = spec;
+    momentsNeeded(spec, 1, &job.degree, &job.flags);
+    job.width = coeffCount(spec);
+    job.simd = 0;
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    job.simd = job.degree <= BATCH_MAX_DEGREE &&
+               __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    job.coeff = coeff;
+    job.r2 = r2;
+    job.status = status;
+
+    int tasks = (batch->count + BATCH_TASK_SERIES - 1) / BATCH_TASK_SERIES;
+    TRACE_BEGIN(t);
+    parallelFor(tasks, batchChunk, &job);
+    TRACE_END(t, TRACE_BATCH, batch->offsets[batch->count] - batch->offsets[0]);
+    return FIT_OK;
+}
+
+// ===== Dự báo hàng loạt =====
+//
+// Mỗi họ mô hình có nhân riêng chạy trên cả mảng thay cho lời gọi gián tiếp
+// model(x, coeff) từng điểm. Tuyến tính, bậc hai và đa thức đều quy về lược đồ
+// Horner trên hệ số đơn thức c0..cd; bản AVX2 tính 16 điểm mỗi vòng (bốn chuỗi
+// FMA độc lập che độ trễ). Log và hàm mũ gọi log()/exp() của libm trong vòng
+// lặp chặt. Mảng dài được chia theo khối PARALLEL_CHUNK cho nhiều luồng.
+
+static void hornerScalar(const double *c, int degree, const double *x, double *y, int n) {
+    for (int i = 0; i < n; i++) {
+        double xi = x[i], r = c[degree];
+        for (int k = degree - 1; k >= 0; k--) r = r * xi + c[k];
+        y[i] = r;
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2,fma")))
+static void hornerAvx2(const double *c, int degree, const double *x, double *y, int n) {
+    const __m256d top = _mm256_set1_pd(c[degree]);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256d x0 = _mm256_loadu_pd(x + i), x1 = _mm256_loadu_pd(x + i + 4);
+        __m256d x2 = _mm256_loadu_pd(x + i + 8), x3 = _mm256_loadu_pd(x + i + 12);
+        __m256d r0 = top, r1 = top, r2 = top, r3 = top;
+        for (int k = degree - 1; k >= 0; k--) {
+            __m256d ck = _mm256_set1_pd(c[k]);
+            r0 = _mm256_fmadd_pd(r0, x0, ck);
+            r1 = _mm256_fmadd_pd(r1, x1, ck);
+            r2 = _mm256_fmadd_pd(r2, x2, ck);
+            r3 = _mm256_fmadd_pd(r3, x3, ck);
+        }
+        _mm256_storeu_pd(y + i, r0);
+        _mm256_storeu_pd(y + i + 4, r1);
+        _mm256_storeu_pd(y + i + 8, r2);
+        _mm256_storeu_pd(y + i + 12, r3);
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m256d xv = _mm256_loadu_pd(x + i), r = top;
+        for (int k = degree - 1; k >= 0; k--) r = _mm256_fmadd_pd(r, xv, _mm256_set1_pd(c[k]));
+        _mm256_storeu_pd(y + i, r);
+    }
+    _mm256_zeroupper();
+    hornerScalar(c, degree, x + i, y + i, n - i);
+}
+#endif
+
+typedef struct {
+    int kind;
+    int degree;
+    const double *c;        // hệ số đơn thức c0..cd (đa thức: bỏ ô lưu bậc)
+    const double *x;
+    double *y;
+    int n;
+    int simd;
+} PredictJob;
+
+static void predictRange(const PredictJob *job, int start, int end) {
+    const double *c = job->c, *x = job->x + start;
+    double *y = job->y + start;
+    int n = end - start;
+    switch (job->kind) {
+        case MODEL_LOG:
+            for (int i = 0; i < n; i++) y[i] = c[0] + c[1] * log(x[i]);
+            return;
+        case MODEL_EXP:
+            for (int i = 0; i < n; i++) y[i] = c[0] * exp(c[1] * x[i]);
+            return;
+    }
+#ifdef HAVE_X86_KERNELS
+    if (job->simd) {
+        hornerAvx2(c, job->degree, x, y, n);
+        return;
+    }
+#endif
+    hornerScalar(c, job->degree, x, y, n);
+}
+
+static void predictChunk(void *ctx, int chunk) {
+    const PredictJob *job = (const PredictJob*)ctx;
+    int start = chunk * PARALLEL_CHUNK;
+    int end = start + PARALLEL_CHUNK < job->n ? start + PARALLEL_CHUNK : job->n;
+    predictRange(job, start, end);
+}
+
+// y[i] = f(x[i]) với i = 0..n-1; coeff cùng bố cục với FitResult (đa thức:
+// coeff[0] lưu bậc). x ngoài miền (log với x <= 0) cho NaN/-inf như logModel.
+// Không gọi từ bên trong parallelFor.
+void predict(const ModelSpec *m, const double coeff[], const double *x, double *y, int n) {
+    PredictJob job;
+    job.kind = m->kind;
+    job.degree = m->kind == MODEL_QUADRATIC ? 2 : m->kind == MODEL_POLY ? m->degree : 1;
+    job.c = m->kind == MODEL_POLY ? coeff + 1 : coeff;
+    job.x = x;
+    job.y = y;
+    job.n = n;
+    job.simd = 0;
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    job.simd = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    TRACE_BEGIN(t);
+    parallelFor(chunkCount(n), predictChunk, &job);
+    TRACE_END(t, TRACE_PREDICT, n);
+}
+
+// ===== Hồi quy bền vững (IRLS) =====
+//
+// Mỗi vòng lặp: một lượt tính phần dư r = y - ŷ (nhân Horner của predict),
+// thang đo s = MAD(r) / 0.6745 bằng quickselect O(n), một lượt tính trọng số
+// u = w * ψ(r / (k s)) / (r / (k s)), rồi tích lũy lại mô-men có trọng số u
+// bằng chính nhân SIMD và vùng làm việc của phép khớp thường. Tukey (hàm ψ giảm
+// về 0) bắt đầu từ nghiệm Huber để không rơi vào cực tiểu địa phương.
+
+const char *robustName(int loss) {
+    switch (loss) {
+        case ROBUST_NONE: return "none";
+        case ROBUST_HUBER: return "huber";
+        case ROBUST_TUKEY: return "tukey";
+    }
+    return "unknown";
+}
+
+int parseRobust(const char *name) {
+    for (int loss = ROBUST_NONE; loss <= ROBUST_TUKEY; loss++) {
+        if (strcmp(name, robustName(loss)) == 0) return loss;
+    }
+    return -1;
+}
+
+// Phần tử nhỏ thứ k (0-based) của a[0..n-1]; a bị sắp xếp lại một phần
+static double selectKth(double *a, int n, int k) {
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        // Chốt là trung vị của ba phần tử, phân hoạch kiểu Hoare
+        int mid = lo + (hi - lo) / 2;
+        double pa = a[lo], pb = a[mid], pc = a[hi];
+        double pivot = pa < pb ? (pb < pc ? pb : (pa < pc ? pc : pa))
+                               : (pa < pc ? pa : (pb < pc ? pc : pb));
+        int i = lo, j = hi;
+        while (i <= j) {
+            while (a[i] < pivot) i++;
+            while (a[j] > pivot) j--;
+            if (i <= j) {
+                double t = a[i];
+                a[i] = a[j];
+                a[j] = t;
+                i++;
+                j--;
+            }
+        }
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            return a[k];
+        }
+    }
+    return a[k];
+}
+
+typedef struct {
+    const double *x, *y, *w;
+    double *r;              // phần dư
+    double *u;              // |r| (để tìm trung vị), sau đó trọng số IRLS
+    const double *c;        // hệ số đơn thức c0..cd
+    int degree, n, simd;
+    int loss;
+    double cutoff;          // k * s
+} RobustJob;
+
+static void robustResidualChunk(void *ctx, int chunk) {
+    RobustJob *job = (RobustJob*)ctx;
+    int begin = chunk * PARALLEL_CHUNK;
+    int end = begin + PARALLEL_CHUNK < job->n ? begin + PARALLEL_CHUNK : job->n;
+    double *r = job->r + begin;
+#ifdef HAVE_X86_KERNELS
+    if (job->simd) {
+        hornerAvx2(job->c, job->degree, job->x + begin, r, end - begin);
+    } else
+#endif
+    hornerScalar(job->c, job->degree, job->x + begin, r, end - begin);
+    for (int i = begin; i < end; i++) {
+        double ri = job->y[i] - job->r[i];
+        job->r[i] = ri;
+        // Điểm có trọng số gốc 0 bị đẩy về cuối khi tìm trung vị
+        job->u[i] = (job->w && job->w[i] == 0) ? INFINITY : fabs(ri);
+    }
+}
+
+static void robustWeightChunk(void *ctx, int chunk) {
+    RobustJob *job = (RobustJob*)ctx;
+    int begin = chunk * PARALLEL_CHUNK;
+    int end = begin + PARALLEL_CHUNK < job->n ? begin + PARALLEL_CHUNK : job->n;
+    double inv = 1.0 / job->cutoff;
+    for (int i = begin; i < end; i++) {
+        double t = fabs(job->r[i]) * inv, v;
+        if (job->loss == ROBUST_TUKEY) {
+            double q = 1.0 - t * t;
+            v = t < 1.0 ? q * q : 0.0;
+        } else {
+            v = t <= 1.0 ? 1.0 : 1.0 / t;
+        }
+        job->u[i] = job->w ? job->w[i] * v : v;
+    }
+}
+
+// Khớp có trọng số u (NULL: trọng số của ds) vào c[] dạng đa thức (c[0] = bậc)
+static int robustSolve(const DatasetView *ds, const double *u, int degree, Moments *m,
+                       FitWorkspace *ws, double c[], double *r2) {
+    resetMoments(m);
+    accumulateWeightedMoments(m, ds->x, ds->y, u ? u : ds->w, ds->size, ws);
+    return solvePolyMoments(m, degree, ws, c, r2, NULL);
+}
+
+// Khớp bền vững cho tuyến tính, bậc hai và đa thức (họ khác: FIT_ERR_DOMAIN).
+// Trọng số ds->w (nếu có) nhân vào trọng số IRLS. Hệ số của res nằm trong ws
+// như fitModels; R^2 và các thống kê tính với trọng số cuối cùng.
+// info (có thể NULL) nhận số vòng lặp, thang đo s và số điểm bị giảm trọng số.
+int fitRobust(const DatasetView *ds, const ModelSpec *spec, int loss, FitWorkspace *ws,
+              FitResult *res, RobustInfo *info) {
+    memset(res, 0, sizeof(*res));
+    res->model = *spec;
+    res->n = ds->size;
+    res->coeffCount = coeffCount(spec);
+    res->r2 = res->ssRes = res->ssTot = res->rmse = res->stdError = res->cond = NAN;
+    res->adjR2 = res->aic = res->bic = NAN;
+    if (info) {
+        info->iterations = 0;
+        info->scale = NAN;
+        info->downweighted = 0;
+    }
+    if (spec->kind != MODEL_LINEAR && spec->kind != MODEL_QUADRATIC && spec->kind != MODEL_POLY) {
+        return res->status = FIT_ERR_DOMAIN;
+    }
+
+    int degree = spec->kind == MODEL_LINEAR ? 1 : spec->kind == MODEL_QUADRATIC ? 2 : spec->degree;
+    int n = ds->size;
+    Moments m;
+    res->coeff = (double*)wsAlloc(ws, (size_t)(degree + 2) * sizeof(double));
+    double *c = (double*)wsAlloc(ws, (size_t)(degree + 2) * sizeof(double));
+    double *prev = (double*)wsAlloc(ws, (size_t)(degree + 2) * sizeof(double));
+    double *r = (double*)wsAlloc(ws, (size_t)n * sizeof(double));
+    double *u = (double*)wsAlloc(ws, (size_t)n * sizeof(double));
+    if (!res->coeff || !c || !prev || !r || !u || wsMoments(ws, &m, degree, 0) != 0) {
+        return res->status = FIT_ERR_NO_MEMORY;
+    }
+
+    // Điểm bị loại sẵn (trọng số gốc 0) không tham gia trung vị
+    int active = n;
+    if (ds->w) {
+        for (int i = 0; i < n; i++) active -= ds->w[i] == 0;
+    }
+
+    RobustJob job = {ds->x, ds->y, ds->w, r, u, c + 1, degree, n, 0, ROBUST_HUBER, 0};
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    job.simd = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    int chunks = chunkCount(n);
+    double r2 = NAN;
+    int status = robustSolve(ds, NULL, degree, &m, ws, c, &r2);
+    int iterations = 0;
+    double scale = NAN;
+    while (status == FIT_OK && loss != ROBUST_NONE && iterations < ROBUST_MAX_ITER && active > 0) {
+        parallelFor(chunks, robustResidualChunk, &job);
+        // MAD quanh 0: trung vị của |r| trên các điểm còn hiệu lực
+        double med = selectKth(u, n, active / 2);
+        if (active % 2 == 0 && active > 1) {
+            double below = u[0];
+            for (int i = 1; i < active / 2; i++) {
+                if (u[i] > below) below = u[i];
+            }
+            med = 0.5 * (med + below);
+        }
+        scale = med / 0.6744897501960817;
+        // Hơn nửa số điểm khớp tuyệt đối: trọng số không xác định, giữ nghiệm hiện tại
+        if (!(scale > 0)) break;
+
+        job.cutoff = (job.loss == ROBUST_TUKEY ? TUKEY_C : HUBER_K) * scale;
+        parallelFor(chunks, robustWeightChunk, &job);
+        memcpy(prev, c, (size_t)(degree + 2) * sizeof(double));
+        status = robustSolve(ds, u, degree, &m, ws, c, &r2);
+        iterations++;
+        if (status != FIT_OK) break;
+
+        double change = 0, size = 0;
+        for (int k = 1; k <= degree + 1; k++) {
+            double d = fabs(c[k] - prev[k]);
+            if (d > change) change = d;
+            if (fabs(c[k]) > size) size = fabs(c[k]);
+        }
+        if (change <= ROBUST_TOL * size) {
+            if (loss == ROBUST_TUKEY && job.loss == ROBUST_HUBER) {
+                job.loss = ROBUST_TUKEY;
+            } else {
+                break;
+            }
+        }
+    }
+
+    res->status = status;
+    if (info) {
+        info->iterations = iterations;
+        info->scale = scale;
+        // Phần dư của vòng cuối: vượt ngưỡng k s là bị giảm trọng số (Tukey: bị loại)
+        if (iterations > 0) {
+            for (int i = 0; i < n; i++) {
+                info->downweighted += fabs(r[i]) > job.cutoff && !(ds->w && ds->w[i] == 0);
+            }
+        }
+    }
+    if (status != FIT_OK) return status;
+
+    // Hệ số theo bố cục của fitModels (bậc hai, tuyến tính: không có ô lưu bậc)
+    if (spec->kind == MODEL_POLY) {
+        memcpy(res->coeff, c, (size_t)(degree + 2) * sizeof(double));
+    } else {
+        memcpy(res->coeff, c + 1, (size_t)(degree + 1) * sizeof(double));
+    }
+    res->r2 = r2;
+    double ssTot = momentsSsTot(&m);
+    finishResult(res, (1.0 - r2) * ssTot, ssTot);
+    return FIT_OK;
+}
+
+// ===== Bootstrap Poisson song song =====
+//
+// Mỗi lần lấy mẫu lại b gán cho điểm i trọng số k_bi ~ Poisson(1) (xấp xỉ
+// lấy mẫu có hoàn lại khi n lớn) nên không cần chép dữ liệu: k_bi sinh lại từ
+// bộ đếm (khóa của b, i) và mô-men có trọng số được cộng thẳng trên x, y gốc
+// bằng nhân weightedSumKernel. Các lần lấy mẫu chia thành nhóm BOOTSTRAP_GROUP
+// chạy song song; mỗi nhóm duyệt dữ liệu theo khối BOOTSTRAP_BLOCK điểm (nằm gọn
+// trong cache) cho mọi mẫu của nhóm, ln x / ln y của khối chỉ tính một lần và
+// các tổng logarit cũng đi qua cùng nhân đó. Hệ số mỗi mẫu giải từ mô-men như
+// fitModelsFromMoments, khoảng tin cậy là các phân vị của phân phối thu được.
+
+#define BOOTSTRAP_GROUP 16
+#define BOOTSTRAP_BLOCK 2048
+
+// Ngưỡng hàm phân phối của Poisson(1) theo thang 2^16: P(K <= k) * 65536
+static const uint32_t poissonCdf16[8] = {24109, 48219, 60273, 64292, 65296, 65497, 65531, 65535};
+
+static uint64_t mix64(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+// Băm 32 bit (murmur3 fmix32) của cặp điểm (i, i + 1), i chẵn, với khóa của
+// mẫu: 16 bit thấp cho điểm i, 16 bit cao cho điểm i + 1. Bản AVX2 dưới đây
+// tính đúng cùng giá trị nên kết quả không phụ thuộc CPU.
+static uint32_t pairHash(uint32_t key, uint32_t pair) {
+    uint32_t h = (pair * 0x9E3779B1u) ^ key;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    return h ^ (h >> 16);
+}
+
+static int poissonFromUniform16(uint32_t u) {
+    int k = 0;
+    for (int c = 0; c < 8; c++) k += u >= poissonCdf16[c];
+    return k;
+}
+
+typedef int (*PoissonFn)(uint32_t key, int begin, int len, double *out);
+
+// Trọng số Poisson(1) của các điểm begin..begin+len-1 (begin chẵn); trả về số
+// trọng số > 0
+static int poissonWeightsScalar(uint32_t key, int begin, int len, double *out) {
+    int positive = 0;
+    for (int i = 0; i < len; i++) {
+        uint32_t h = pairHash(key, (uint32_t)(begin + i) >> 1);
+        int k = poissonFromUniform16((begin + i) & 1 ? h >> 16 : h & 0xFFFF);
+        out[i] = k;
+        positive += k > 0;
+    }
+    return positive;
+}
+
+#ifdef HAVE_X86_KERNELS
+// Số điểm có u > cdf[0] - 1 (trọng số > 0) và trọng số của 8 giá trị u
+__attribute__((target("avx2")))
+static inline __m256i poissonLanes(__m256i u, const __m256i cdf[8], int *positive) {
+    __m256i k = _mm256_setzero_si256();
+    for (int c = 0; c < 8; c++) k = _mm256_sub_epi32(k, _mm256_cmpgt_epi32(u, cdf[c]));
+    *positive += __builtin_popcount((unsigned)_mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpgt_epi32(u, cdf[0]))));
+    return k;
+}
+
+__attribute__((target("avx2")))
+static int poissonWeightsAvx2(uint32_t key, int begin, int len, double *out) {
+    const __m256i step = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i vkey = _mm256_set1_epi32((int)key), low = _mm256_set1_epi32(0xFFFF);
+    const __m256i golden = _mm256_set1_epi32((int)0x9E3779B1u);
+    const __m256i m1 = _mm256_set1_epi32((int)0x85EBCA6Bu), m2 = _mm256_set1_epi32((int)0xC2B2AE35u);
+    __m256i cdf[8];
+    for (int c = 0; c < 8; c++) cdf[c] = _mm256_set1_epi32((int)poissonCdf16[c] - 1);
+    int positive = 0, i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i h = _mm256_add_epi32(_mm256_set1_epi32((begin + i) >> 1), step);
+        h = _mm256_xor_si256(_mm256_mullo_epi32(h, golden), vkey);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        h = _mm256_mullo_epi32(h, m1);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+        h = _mm256_mullo_epi32(h, m2);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        __m256i kLo = poissonLanes(_mm256_and_si256(h, low), cdf, &positive);
+        __m256i kHi = poissonLanes(_mm256_srli_epi32(h, 16), cdf, &positive);
+        // Xen kẽ thành điểm 0..7 (cặp 0..3) và 8..15 (cặp 4..7)
+        __m256i a = _mm256_unpacklo_epi32(kLo, kHi), b = _mm256_unpackhi_epi32(kLo, kHi);
+        __m256i first = _mm256_permute2x128_si256(a, b, 0x20);
+        __m256i second = _mm256_permute2x128_si256(a, b, 0x31);
+        _mm256_storeu_pd(out + i, _mm256_cvtepi32_pd(_mm256_castsi256_si128(first)));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtepi32_pd(_mm256_extracti128_si256(first, 1)));
+        _mm256_storeu_pd(out + i + 8, _mm256_cvtepi32_pd(_mm256_castsi256_si128(second)));
+        _mm256_storeu_pd(out + i + 12, _mm256_cvtepi32_pd(_mm256_extracti128_si256(second, 1)));
+    }
+    _mm256_zeroupper();
+    return positive + poissonWeightsScalar(key, begin + i, len - i, out + i);
+}
+#endif
+
+static PoissonFn poissonKernel(void) {
+    PoissonFn selected = poissonWeightsScalar;
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) selected = poissonWeightsAvx2;
+#endif
+    return selected;
+}
+
+// Khóa của mẫu b: mọi lượt qua dữ liệu của cùng mẫu sinh lại đúng trọng số
+static uint32_t resampleKey(uint64_t seed, int b) {
+    return (uint32_t)mix64(seed * 0x9E3779B97F4A7C15ULL + (uint64_t)b);
+}
+
+typedef struct {
+    const DatasetView *ds;
+    Moments *moments;       // tổng của từng mẫu
+    Moments *parts;         // tổng tạm của từng mẫu trong PARALLEL_CHUNK điểm gần nhất
+    int resamples;
+    uint64_t seed;
+    WeightedSumFn kernel;
+    PoissonFn poisson;
+} BootstrapJob;
+
+// Cộng các tổng logarit của một khối qua nhân có trọng số: với u = ln x (0 ở
+// điểm ngoài miền), bậc 1 cho Σ w u, Σ w u^2 (sx[1], sx[2]) và Σ w u y' (sxy[1])
+static void weightedLogSums(WeightedSumFn kernel, const double *u, const double *v, const double *w,
+                            int len, double shift, double *su, double *su2, double *suv) {
+    double sx[3] = {0, 0, 0}, sxy[2] = {0, 0}, syy = 0;
+    kernel(u, v, w, len, shift, 1, sx, sxy, &syy);
+    *su += sx[1];
+    *su2 += sx[2];
+    *suv += sxy[1];
+}
+
+static void bootstrapGroup(void *ctx, int group) {
+    BootstrapJob *job = (BootstrapJob*)ctx;
+    const DatasetView *ds = job->ds;
+    int first = group * BOOTSTRAP_GROUP;
+    int last = first + BOOTSTRAP_GROUP < job->resamples ? first + BOOTSTRAP_GROUP : job->resamples;
+    int flags = job->moments[first].flags;
+    double shift = job->moments[first].yShift;
+    double w[BOOTSTRAP_BLOCK], lnx[BOOTSTRAP_BLOCK], lny[BOOTSTRAP_BLOCK];
+    int badX[BOOTSTRAP_BLOCK], badY[BOOTSTRAP_BLOCK];
+
+    for (int begin = 0; begin < ds->size; begin += BOOTSTRAP_BLOCK) {
+        int len = ds->size - begin < BOOTSTRAP_BLOCK ? ds->size - begin : BOOTSTRAP_BLOCK;
+        const double *x = ds->x + begin, *y = ds->y + begin;
+        // ln của điểm ngoài miền là 0 (không góp vào tổng), chỉ số của nó được
+        // ghi lại để đếm vào badLog* khi có trọng số
+        int nBadX = 0, nBadY = 0;
+        if (flags & MOMENT_LOGX) {
+            for (int i = 0; i < len; i++) {
+                lnx[i] = x[i] > 0 ? log(x[i]) : 0;
+                if (x[i] <= 0) badX[nBadX++] = i;
+            }
+        }
+        if (flags & MOMENT_LOGY) {
+            for (int i = 0; i < len; i++) {
+                lny[i] = y[i] > 0 ? log(y[i]) : 0;
+                if (y[i] <= 0) badY[nBadY++] = i;
+            }
+        }
+        int flush = begin + len == ds->size || (begin + len) % PARALLEL_CHUNK == 0;
+
+        for (int b = first; b < last; b++) {
+            Moments *p = &job->parts[b];
+            int positive = job->poisson(resampleKey(job->seed, b), begin, len, w);
+            if (ds->w) {
+                positive = 0;
+                for (int i = 0; i < len; i++) {
+                    w[i] *= ds->w[begin + i];
+                    positive += w[i] > 0;
+                }
+            }
+            double before = p->sx[0];
+            job->kernel(x, y, w, len, shift, p->maxDegree, p->sx, p->sxy, &p->syy);
+            p->n += p->sx[0] - before;
+            p->count += positive;
+            if (flags & MOMENT_LOGX) {
+                weightedLogSums(job->kernel, lnx, y, w, len, shift, &p->slnx, &p->slnx2, &p->slnxy);
+                for (int j = 0; j < nBadX; j++) p->badLogX += w[badX[j]] > 0;
+            }
+            if (flags & MOMENT_LOGY) {
+                // Σ w x ln y: đặt vai trò y' = x (dịch 0)
+                weightedLogSums(job->kernel, lny, x, w, len, 0, &p->slny, &p->slny2, &p->sxlny);
+                for (int j = 0; j < nBadY; j++) p->badLogY += w[badY[j]] > 0;
+            }
+            if (flush) {
+                mergeMoments(&job->moments[b], p);
+                resetMoments(p);
+                p->yShift = shift;
+            }
+        }
+    }
+}
+
+// Lượt thứ hai cho hàm mũ: Σ k_bi w_i (y_i - a_b e^{b_b x_i})^2 của từng mẫu với
+// cùng trọng số Poisson, để R^2 của mẫu tính trên y gốc như ước lượng điểm
+typedef struct {
+    const DatasetView *ds;
+    const double *coeff;    // [mẫu][2]; a = NAN: mẫu không khớp được
+    double *ssRes;          // [mẫu]
+    int resamples;
+    uint64_t seed;
+    PoissonFn poisson;
+} ExpResidualJob;
+
+static void expResidualGroup(void *ctx, int group) {
+    ExpResidualJob *job = (ExpResidualJob*)ctx;
+    const DatasetView *ds = job->ds;
+    int first = group * BOOTSTRAP_GROUP;
+    int last = first + BOOTSTRAP_GROUP < job->resamples ? first + BOOTSTRAP_GROUP : job->resamples;
+    double w[BOOTSTRAP_BLOCK];
+
+    for (int b = first; b < last; b++) job->ssRes[b] = 0;
+    for (int begin = 0; begin < ds->size; begin += BOOTSTRAP_BLOCK) {
+        int len = ds->size - begin < BOOTSTRAP_BLOCK ? ds->size - begin : BOOTSTRAP_BLOCK;
+        const double *x = ds->x + begin, *y = ds->y + begin;
+        for (int b = first; b < last; b++) {
+            const double *c = job->coeff + 2 * (size_t)b;
+            if (isnan(c[0])) continue;
+            job->poisson(resampleKey(job->seed, b), begin, len, w);
+            double ss = 0;
+            for (int i = 0; i < len; i++) {
+                double wi = ds->w ? w[i] * ds->w[begin + i] : w[i];
+                double e = y[i] - c[0] * exp(c[1] * x[i]);
+                ss += wi * e * e;
+            }
+            job->ssRes[b] += ss;
+        }
+    }
+}
+
+// Bootstrap B = resamples lần cho các mô hình specs (đa thức: phương trình chuẩn
+// tắc), khoảng tin cậy phân vị mức level (ví dụ 0.95) ghi vào out[i]. Mảng lo,
+// hi của out nằm trong ws. Mẫu không khớp được (ví dụ suy biến) bị bỏ qua; R^2
+// của hàm mũ tính trên y gốc bằng một lượt nữa qua dữ liệu. Trả về FIT_ERR_TOO_FEW_POINTS nếu dữ liệu rỗng,
+// FIT_ERR_NO_MEMORY nếu thiếu bộ nhớ.
+int bootstrapFit(const DatasetView *ds, const ModelSpec specs[], int count, int resamples,
+                 double level, uint64_t seed, FitWorkspace *ws, BootstrapInterval out[]) {
+    if (ds->size < 1 || resamples < 1) return FIT_ERR_TOO_FEW_POINTS;
+    int maxDegree, flags;
+    momentsNeeded(specs, count, &maxDegree, &flags);
+    size_t width = momentsBufferSize(maxDegree);
+    int widest = 0;
+    for (int i = 0; i < count; i++) {
+        if (coeffCount(&specs[i]) > widest) widest = coeffCount(&specs[i]);
+    }
+
+    // Mô-men của mọi mẫu, rồi giá trị hệ số và R^2 theo [mô hình][hệ số][mẫu]
+    Moments *moments = (Moments*)wsAlloc(ws, 2 * (size_t)resamples * sizeof(Moments));
+    double *buf = moments ? (double*)wsAlloc(ws, 2 * (size_t)resamples * width * sizeof(double)) : NULL;
+    double *values = buf ? (double*)wsAlloc(ws, (size_t)count * (widest + 1) * resamples * sizeof(double))
+                         : NULL;
+    for (int i = 0; i < count && values; i++) {
+        int c = coeffCount(&specs[i]);
+        out[i].lo = (double*)wsAlloc(ws, (size_t)c * sizeof(double));
+        out[i].hi = (double*)wsAlloc(ws, (size_t)c * sizeof(double));
+        if (!out[i].lo || !out[i].hi) values = NULL;
+    }
+    if (!values) return FIT_ERR_NO_MEMORY;
+
+    Moments *parts = moments + resamples;
+    for (int b = 0; b < 2 * resamples; b++) {
+        bindMoments(&moments[b], maxDegree, flags, buf + (size_t)b * width);
+        moments[b].yShift = ds->y[0];
+    }
+    BootstrapJob job = {ds, moments, parts, resamples, seed, weightedSumKernel(), poissonKernel()};
+    parallelFor((resamples + BOOTSTRAP_GROUP - 1) / BOOTSTRAP_GROUP, bootstrapGroup, &job);
+
+    // Hàm mũ: hệ số và vị trí R^2 trong values của từng mẫu cho lượt thứ hai
+    int hasExp = 0;
+    for (int i = 0; i < count; i++) hasExp |= specs[i].kind == MODEL_EXP;
+    double *expCoeff = NULL, *expSsRes = NULL;
+    int *expSlot = NULL;
+    if (hasExp) {
+        expCoeff = (double*)wsAlloc(ws, 2 * (size_t)resamples * sizeof(double));
+        expSsRes = expCoeff ? (double*)wsAlloc(ws, (size_t)resamples * sizeof(double)) : NULL;
+        expSlot = expSsRes ? (int*)wsAlloc(ws, (size_t)count * resamples * sizeof(int)) : NULL;
+        if (!expSlot) return FIT_ERR_NO_MEMORY;
+    }
+
+    FitResult results[MAX_MODELS];
+    int ok[MAX_MODELS] = {0};
+    for (int b = 0; b < resamples; b++) {
+        size_t mark = wsMark(ws);
+        fitModelsFromMoments(NULL, &moments[b], moments[b].count, specs, count, ws, results);
+        if (hasExp) expCoeff[2 * (size_t)b] = NAN;
+        for (int i = 0; i < count; i++) {
+            if (specs[i].kind == MODEL_EXP) expSlot[(size_t)i * resamples + b] = -1;
+            if (results[i].status != FIT_OK) continue;
+            double *v = values + (size_t)i * (widest + 1) * resamples;
+            v[ok[i]] = results[i].r2;
+            if (specs[i].kind == MODEL_EXP) {
+                expCoeff[2 * (size_t)b] = results[i].coeff[0];
+                expCoeff[2 * (size_t)b + 1] = results[i].coeff[1];
+                expSlot[(size_t)i * resamples + b] = ok[i];
+            }
+            for (int k = 0; k < coeffCount(&specs[i]); k++) {
+                v[(size_t)(k + 1) * resamples + ok[i]] = results[i].coeff[k];
+            }
+            ok[i]++;
+        }
+        wsRelease(ws, mark);
+    }
+    if (hasExp) {
+        ExpResidualJob exj = {ds, expCoeff, expSsRes, resamples, seed, job.poisson};
+        parallelFor((resamples + BOOTSTRAP_GROUP - 1) / BOOTSTRAP_GROUP, expResidualGroup, &exj);
+        for (int i = 0; i < count; i++) {
+            if (specs[i].kind != MODEL_EXP) continue;
+            double *v = values + (size_t)i * (widest + 1) * resamples;
+            for (int b = 0; b < resamples; b++) {
+                int slot = expSlot[(size_t)i * resamples + b];
+                if (slot >= 0) v[slot] = 1.0 - safeDiv(expSsRes[b], momentsSsTot(&moments[b]));
+            }
+        }
+    }
+
+    // Phân vị theo hạng gần nhất, chọn bằng quickselect O(B)
+    double alpha = (1.0 - level) / 2;
+    for (int i = 0; i < count; i++) {
+        BootstrapInterval *ci = &out[i];
+        ci->model = specs[i];
+        ci->resamples = ok[i];
+        ci->level = level;
+        ci->r2Lo = ci->r2Hi = NAN;
+        int c = coeffCount(&specs[i]);
+        for (int k = 0; k < c; k++) ci->lo[k] = ci->hi[k] = NAN;
+        if (ok[i] == 0) continue;
+        int kLo = (int)floor(alpha * (ok[i] - 1) + 0.5);
+        int kHi = (int)floor((1.0 - alpha) * (ok[i] - 1) + 0.5);
+        for (int k = 0; k <= c; k++) {
+            double *v = values + ((size_t)i * (widest + 1) + k) * resamples;
+            double lo = selectKth(v, ok[i], kLo), hi = selectKth(v, ok[i], kHi);
+            if (k == 0) {
+                ci->r2Lo = lo;
+                ci->r2Hi = hi;
+            } else {
+                ci->lo[k - 1] = lo;
+                ci->hi[k - 1] = hi;
+            }
+        }
+    }
+    return FIT_OK;
+}
+
+// ===== Kiểm định chéo K-fold cho bậc đa thức =====
+//
+// Điểm được chia fold theo khối liên tiếp luân phiên (khối 0 vào fold 0, khối
+// 1 vào fold 1, ...), độ dài khối là lũy thừa của 2 nên khớp với PARALLEL_CHUNK
+// và nhân tổng lũy thừa chạy trên từng đoạn liên tiếp. Lượt 1 tính tổng mô-men
+// tới bậc D của từng fold; phương trình chuẩn tắc của tập huấn luyện fold k là
+// tổng toàn bộ trừ tổng của fold k, nên K x D hệ nhỏ không cần đọc lại dữ liệu.
+// Lượt 2 tính sai số trên điểm giữ lại của mọi bậc cùng lúc: mỗi khối (nằm gọn
+// trong L1) được dự báo bằng nhân Horner của predict cho từng bậc.
+
+#define CV_MAX_BLOCK 256
+
+typedef struct {
+    const DatasetView *ds;
+    int folds, maxDegree, blockLen, simd;
+    Moments *parts;         // [chunk][fold]
+    const double *coeffs;   // [fold][bậc - 1][0..maxDegree], hệ số đơn thức
+    double *sse;            // [chunk][fold][bậc - 1]
+    double *weight;         // [chunk][fold]: tổng trọng số điểm giữ lại
+} CvJob;
+
+static void cvMomentsChunk(void *ctx, int chunk) {
+    CvJob *job = (CvJob*)ctx;
+    int begin = chunk * PARALLEL_CHUNK;
+    int end = begin + PARALLEL_CHUNK < job->ds->size ? begin + PARALLEL_CHUNK : job->ds->size;
+    Moments *parts = job->parts + (size_t)chunk * job->folds;
+    const double *w = job->ds->w;
+    for (int i = begin; i < end; i += job->blockLen) {
+        int len = end - i < job->blockLen ? end - i : job->blockLen;
+        accumulateRange(&parts[(i / job->blockLen) % job->folds], job->ds->x + i, job->ds->y + i,
+                        w ? w + i : NULL, len);
+    }
+}
+
+static void cvScoreChunk(void *ctx, int chunk) {
+    CvJob *job = (CvJob*)ctx;
+    const DatasetView *ds = job->ds;
+    int begin = chunk * PARALLEL_CHUNK, D = job->maxDegree;
+    int end = begin + PARALLEL_CHUNK < ds->size ? begin + PARALLEL_CHUNK : ds->size;
+    double *sse = job->sse + (size_t)chunk * job->folds * D;
+    double *weight = job->weight + (size_t)chunk * job->folds;
+    double fitted[CV_MAX_BLOCK];
+    for (int i = begin; i < end; i += job->blockLen) {
+        int len = end - i < job->blockLen ? end - i : job->blockLen;
+        int fold = (i / job->blockLen) % job->folds;
+        const double *x = ds->x + i, *y = ds->y + i, *w = ds->w ? ds->w + i : NULL;
+        for (int j = 0; j < len; j++) weight[fold] += w ? w[j] : 1.0;
+        for (int d = 1; d <= D; d++) {
+            const double *c = job->coeffs + ((size_t)fold * D + d - 1) * (D + 1);
+#ifdef HAVE_X86_KERNELS
+            if (job->simd) hornerAvx2(c, d, x, fitted, len);
+            else hornerScalar(c, d, x, fitted, len);
+#else
+            hornerScalar(c, d, x, fitted, len);
+#endif
+            double s = 0;
+            for (int j = 0; j < len; j++) {
+                double e = y[j] - fitted[j];
+                s += (w ? w[j] : 1.0) * e * e;
+            }
+            sse[fold * D + d - 1] += s;
+        }
+    }
+}
+
+// dst = total - part (cùng bậc, cùng yShift): tổng của tập huấn luyện
+static void subtractMoments(Moments *dst, const Moments *total, const Moments *part) {
+    int d = total->maxDegree;
+    for (int k = 0; k <= 2 * d; k++) dst->sx[k] = total->sx[k] - part->sx[k];
+    for (int k = 0; k <= d; k++) dst->sxy[k] = total->sxy[k] - part->sxy[k];
+    dst->syy = total->syy - part->syy;
+    dst->count = total->count - part->count;
+    dst->n = total->n - part->n;
+    dst->yShift = total->yShift;
+}
+
+// Kiểm định chéo folds fold cho đa thức bậc 1..maxDegree (phương trình chuẩn
+// tắc). scores[d - 1] nhận MSE trung bình trên điểm giữ lại của bậc d và sai số
+// chuẩn của nó giữa các fold; *best là bậc có MSE nhỏ nhất (0 nếu không bậc
+// nào khớp được trên mọi fold). Trả về FIT_ERR_TOO_FEW_POINTS nếu số điểm ít
+// hơn số fold, FIT_ERR_NO_MEMORY nếu thiếu bộ nhớ. Không gọi từ bên trong
+// parallelFor.
+int crossValidatePoly(const DatasetView *ds, int folds, int maxDegree, FitWorkspace *ws,
+                      CvScore scores[], int *best) {
+    *best = 0;
+    if (folds < 2 || maxDegree < 1 || ds->size < folds) return FIT_ERR_TOO_FEW_POINTS;
+    int D = maxDegree, chunks = chunkCount(ds->size);
+    // Khối lớn nhất là lũy thừa của 2 mà mỗi fold vẫn có khoảng 64 khối
+    int blockLen = 1;
+    while (blockLen < CV_MAX_BLOCK && (long long)blockLen * 2 * folds * 64 <= ds->size) blockLen *= 2;
+
+    size_t width = momentsBufferSize(D);
+    size_t partCount = (size_t)chunks * folds;
+    Moments *parts = (Moments*)wsAlloc(ws, (partCount + 2) * sizeof(Moments));
+    double *buf = parts ? (double*)wsAlloc(ws, (partCount + 2) * width * sizeof(double)) : NULL;
+    double *coeffs = buf ? (double*)wsAlloc(ws, (size_t)folds * D * (D + 1) * sizeof(double)) : NULL;
+    double *sse = coeffs ? (double*)wsAlloc(ws, partCount * D * sizeof(double)) : NULL;
+    double *weight = sse ? (double*)wsAlloc(ws, partCount * sizeof(double)) : NULL;
+    double *solved = weight ? (double*)wsAlloc(ws, (size_t)(D + 2) * sizeof(double)) : NULL;
+    int *status = solved ? (int*)wsAlloc(ws, (size_t)folds * D * sizeof(int)) : NULL;
+    if (!status) return FIT_ERR_NO_MEMORY;
+    for (size_t p = 0; p < partCount + 2; p++) {
+        bindMoments(&parts[p], D, 0, buf + p * width);
+        parts[p].yShift = ds->y[0];
+    }
+    memset(sse, 0, partCount * D * sizeof(double));
+    memset(weight, 0, partCount * sizeof(double));
+
+    CvJob job = {ds, folds, D, blockLen, 0, parts, coeffs, sse, weight};
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    job.simd = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+    parallelFor(chunks, cvMomentsChunk, &job);
+
+    // Gộp theo fold vào hàng đầu, tổng toàn bộ vào total
+    Moments *total = &parts[partCount], *train = &parts[partCount + 1];
+    for (int c = 1; c < chunks; c++) {
+        for (int f = 0; f < folds; f++) mergeMoments(&parts[f], &parts[(size_t)c * folds + f]);
+    }
+    for (int f = 0; f < folds; f++) mergeMoments(total, &parts[f]);
+
+    for (int f = 0; f < folds; f++) {
+        subtractMoments(train, total, &parts[f]);
+        for (int d = 1; d <= D; d++) {
+            double r2;
+            int s = solvePolyMoments(train, d, ws, solved, &r2, NULL);
+            status[f * D + d - 1] = s;
+            double *c = coeffs + ((size_t)f * D + d - 1) * (D + 1);
+            for (int k = 0; k <= d; k++) c[k] = s == FIT_OK ? solved[k + 1] : NAN;
+        }
+    }
+    parallelFor(chunks, cvScoreChunk, &job);
+
+    for (int c = 1; c < chunks; c++) {
+        for (int j = 0; j < folds * D; j++) sse[j] += sse[(size_t)c * folds * D + j];
+        for (int f = 0; f < folds; f++) weight[f] += weight[(size_t)c * folds + f];
+    }
+    double bestMse = INFINITY;
+    for (int d = 1; d <= D; d++) {
+        CvScore *sc = &scores[d - 1];
+        sc->degree = d;
+        sc->status = FIT_OK;
+        double sum = 0, sumW = 0, mean = 0, var = 0;
+        for (int f = 0; f < folds; f++) {
+            if (status[f * D + d - 1] != FIT_OK) sc->status = status[f * D + d - 1];
+            sum += sse[f * D + d - 1];
+            sumW += weight[f];
+            mean += safeDiv(sse[f * D + d - 1], weight[f]) / folds;
+        }
+        for (int f = 0; f < folds; f++) {
+            double e = safeDiv(sse[f * D + d - 1], weight[f]) - mean;
+            var += e * e / (folds - 1);
+        }
+        sc->mse = sc->status == FIT_OK ? safeDiv(sum, sumW) : NAN;
+        sc->mseStdErr = sc->status == FIT_OK ? sqrt(var / folds) : NAN;
+        if (sc->status == FIT_OK && sc->mse < bestMse) {
+            bestMse = sc->mse;
+            *best = d;
+        }
+    }
+    return FIT_OK;
+}
+
+// ===== Khớp trực tuyến =====
+//
+// Chỉ giữ các tổng mô-men, không giữ điểm gốc: mỗi điểm mới cập nhật O(bậc),
+// hệ số và R^2 có thể truy vấn bất kỳ lúc nào (giải hệ O(bậc^3) khi truy vấn).
+
+// Trả về -1 nếu không đủ bộ nhớ
+int initOnlineFit(OnlineFit *of, const ModelSpec models[], int modelCount) {
+    int maxDegree, flags;
+    momentsNeeded(models, modelCount, &maxDegree, &flags);
+    if (initMoments(&of->m, maxDegree, flags) != 0) return -1;
+    initWorkspace(&of->ws);
+    memcpy(of->models, models, (size_t)modelCount * sizeof(ModelSpec));
+    of->modelCount = modelCount;
+    return 0;
+}
+
+void freeOnlineFit(OnlineFit *of) {
+    freeMoments(&of->m);
+    freeWorkspace(&of->ws);
+}
+
+void onlineAddPoint(OnlineFit *of, double x, double y) {
+    addMomentsPoint(&of->m, x, y, 1.0);
+}
+
+// Hệ số và R^2 hiện tại của mô hình thứ i
+int onlineQuery(OnlineFit *of, int i, double coeff[], double *r2) {
+    int status = solveModel(NULL, &of->m, &of->models[i], &of->ws, coeff, r2);
+    wsReset(&of->ws);
+    return status;
+}
+
+// ===== Hồi quy cửa sổ trượt và giảm dần theo hàm mũ =====
+//
+// WINDOW_SLIDING: chỉ W điểm gần nhất; điểm mới được cộng, điểm cũ nhất bị trừ
+// khỏi tổng mô-men (O(bậc) mỗi lần trượt). Sau mỗi refreshEvery lần trượt các
+// tổng được tính lại chính xác từ vòng đệm để chặn sai số tích lũy.
+// WINDOW_DECAY: mọi tổng nhân với hệ số quên λ trước khi cộng điểm mới.
+
+// window > 0: cửa sổ trượt W điểm; ngược lại dùng hệ số quên decay trong (0, 1).
+// Trả về -1 nếu tham số sai hoặc không đủ bộ nhớ.
+int initWindowFit(WindowFit *wf, const ModelSpec models[], int modelCount, int window, double decay) {
+    memset(wf, 0, sizeof(*wf));
+    if (window <= 0 && !(decay > 0 && decay < 1)) return -1;
+    if (initOnlineFit(&wf->fit, models, modelCount) != 0) return -1;
+    wf->lastBadLogX = wf->lastBadLogY = -1;
+    if (window > 0) {
+        wf->mode = WINDOW_SLIDING;
+        wf->window = window;
+        wf->refreshEvery = window > 1024 ? window : 1024;
+        wf->bx = (double*)malloc((size_t)window * sizeof(double));
+        wf->by = (double*)malloc((size_t)window * sizeof(double));
+        if (!wf->bx || !wf->by) {
+            free(wf->bx);
+            free(wf->by);
+            freeOnlineFit(&wf->fit);
+            return -1;
+        }
+    } else {
+        wf->mode = WINDOW_DECAY;
+        wf->decay = decay;
+        wf->horizon = log(DBL_EPSILON) / log(decay);
+    }
+    return 0;
+}
+
+void freeWindowFit(WindowFit *wf) {
+    free(wf->bx);
+    free(wf->by);
+    wf->bx = wf->by = NULL;
+    freeOnlineFit(&wf->fit);
+}
+
+// Nhân mọi tổng với λ (số điểm count giữ nguyên)
+static void scaleMoments(Moments *m, double lambda) {
+    size_t width = momentsBufferSize(m->maxDegree);
+    for (size_t k = 0; k < width; k++) m->sx[k] *= lambda;
+    m->syy *= lambda;
+    m->slnx *= lambda;
+    m->slnx2 *= lambda;
+    m->slnxy *= lambda;
+    m->slny *= lambda;
+    m->slny2 *= lambda;
+    m->sxlny *= lambda;
+    m->n *= lambda;
+}
+
+// Tính lại tổng của cửa sổ từ vòng đệm (từ cũ đến mới)
+static void refreshWindow(WindowFit *wf) {
+    Moments *m = &wf->fit.m;
+    resetMoments(m);
+    int first = wf->window - wf->head;
+    accumulateMoments(m, wf->bx + wf->head, wf->by + wf->head, first, &wf->fit.ws);
+    accumulateMoments(m, wf->bx, wf->by, wf->head, &wf->fit.ws);
+    wsReset(&wf->fit.ws);
+    wf->slides = 0;
+}
+
+void windowAddPoint(WindowFit *wf, double x, double y) {
+    Moments *m = &wf->fit.m;
+    if (wf->mode == WINDOW_DECAY) {
+        if (m->count > 0) scaleMoments(m, wf->decay);
+        long long seen = m->count;
+        addMomentsPoint(m, x, y, 1.0);
+        // Điểm lỗi miền chỉ chặn log/exp cho đến khi trọng số của nó không đáng kể
+        if ((m->flags & MOMENT_LOGX) && x <= 0) wf->lastBadLogX = seen;
+        if ((m->flags & MOMENT_LOGY) && y <= 0) wf->lastBadLogY = seen;
+        m->badLogX = wf->lastBadLogX >= 0 && seen - wf->lastBadLogX < wf->horizon;
+        m->badLogY = wf->lastBadLogY >= 0 && seen - wf->lastBadLogY < wf->horizon;
+        return;
+    }
+
+    if (wf->filled < wf->window) {
+        wf->bx[wf->filled] = x;
+        wf->by[wf->filled] = y;
+        wf->filled++;
+        addMomentsPoint(m, x, y, 1.0);
+        return;
+    }
+
+    // Trượt: bớt điểm cũ nhất, ghi đè bằng điểm mới
+    addMomentsPoint(m, wf->bx[wf->head], wf->by[wf->head], -1.0);
+    addMomentsPoint(m, x, y, 1.0);
+    wf->bx[wf->head] = x;
+    wf->by[wf->head] = y;
+    if (++wf->head == wf->window) wf->head = 0;
+    if (++wf->slides >= wf->refreshEvery) refreshWindow(wf);
+}
+
+int windowQuery(WindowFit *wf, int i, double coeff[], double *r2) {
+    return onlineQuery(&wf->fit, i, coeff, r2);
+}
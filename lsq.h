@@ -0,0 +1,524 @@
+// Thư viện hồi quy bình phương tối thiểu.
+//
+// lsq.c: tính toán (mô-men, các bộ giải, khớp trực tuyến), không in ra màn hình.
+// lsq_io.c: quản lý Dataset và đọc/ghi file dữ liệu.
+// Các hàm khớp nhận một DatasetView (chỉ đọc) và trả về mã trạng thái FIT_*;
+// bộ nhớ tạm lấy từ FitWorkspace do người gọi sở hữu.
+
+#ifndef LSQ_H
+#define LSQ_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ===== Dữ liệu =====
+
+// Nội dung file được ánh xạ vào bộ nhớ (chỉ đọc)
+typedef struct MappedFile {
+    const char *data;
+    size_t size;
+    int mapped;         // 0: nội dung được đọc vào heap thay vì ánh xạ
+#ifdef _WIN32
+    void *file;         // HANDLE
+    void *mapping;      // HANDLE
+#endif
+} MappedFile;
+
+// Cấu trúc dữ liệu động
+typedef struct {
+    double *x;
+    double *y;
+    double *w;          // cột trọng số (NULL: mọi điểm có trọng số 1)
+    int capacity;
+    int size;
+    MappedFile *map;    // khác NULL: x, y (và w) trỏ thẳng vào file nhị phân (chỉ đọc)
+    int features;       // > 0: dữ liệu nhiều đặc trưng, các cột nằm trong X
+    double *X;          // features cột theo cột (cột j bắt đầu ở X + j*capacity);
+                        // x trùng với cột 0 nên mô hình một biến dùng đặc trưng đầu
+} Dataset;
+
+// Cách nhìn chỉ đọc vào các cột x, y, w (của Dataset hoặc bộ nhớ của người gọi)
+typedef struct {
+    const double *x;
+    const double *y;
+    int size;
+    const double *w;    // trọng số >= 0, NULL: không có trọng số
+    const double *X;    // NULL: một đặc trưng (x); ngược lại features cột cách nhau ld
+    int features;
+    int ld;
+} DatasetView;
+
+static inline DatasetView datasetView(const Dataset *ds) {
+    DatasetView v = {ds->x, ds->y, ds->size, ds->w, ds->X, ds->features, ds->capacity};
+    return v;
+}
+
+int mapFile(const char *path, MappedFile *mf);
+void unmapFile(MappedFile *mf);
+
+void initDataset(Dataset *ds);
+void freeDataset(Dataset *ds);
+int detachDataset(Dataset *ds);
+int expandDataset(Dataset *ds);
+int addDataPoint(Dataset *ds, double x, double y);
+int addWeightedPoint(Dataset *ds, double x, double y, double w);
+void clearDataset(Dataset *ds);
+int reserveDataset(Dataset *ds, int n);
+int addFeatureRow(Dataset *ds, const double *features, int count, double y, double w);
+
+// ===== Đọc/ghi file =====
+
+#define LOAD_MAX_BAD_LINES 10
+
+// Thống kê sau khi đọc file
+typedef struct {
+    long long points;                       // số điểm đọc được
+    int headerLines;                        // dòng tiêu đề đã bỏ qua
+    int commentLines;                       // dòng chú thích / dòng trống
+    int badLines;                           // dòng không hợp lệ
+    long firstBad[LOAD_MAX_BAD_LINES];      // số thứ tự các dòng lỗi đầu tiên
+    size_t bytes;
+    uint64_t fingerprint;                   // hashColumns của dữ liệu (LOAD_FINGERPRINT)
+} LoadReport;
+
+// Mã lỗi khi đọc dữ liệu
+enum {
+    LOAD_OK = 0,
+    LOAD_ERR_OPEN = -1,       // không mở được file (xem errno)
+    LOAD_ERR_FORMAT = -2,     // file nhị phân hỏng hoặc không hỗ trợ
+    LOAD_ERR_CHECKSUM = -3,   // tổng kiểm tra không khớp
+    LOAD_ERR_NO_MEMORY = -4   // không đủ bộ nhớ
+};
+
+// Tùy chọn khi đọc file (loadTextFile / loadDatasetFile)
+enum {
+    LOAD_VERIFY = 1,          // kiểm tra checksum của file nhị phân
+    LOAD_WEIGHTS = 2,         // file văn bản có cột thứ ba là trọng số (>= 0)
+    LOAD_FINGERPRINT = 4,     // tính rep->fingerprint (file nhị phân: lấy từ header)
+    LOAD_FEATURES = 8         // file văn bản nhiều đặc trưng "x1 ... xp y" (loadFeatureFile)
+};
+
+#define MAX_FEATURES 4096
+
+const char *parseDouble(const char *p, const char *end, double *out);
+int parsePointLine(const char *p, const char *end, double *x, double *y);
+int parseWeightedLine(const char *p, const char *end, double *x, double *y, double *w);
+int loadTextFile(const char *path, Dataset *ds, LoadReport *rep, int flags);
+int loadFeatureFile(const char *path, Dataset *ds, LoadReport *rep, int flags);
+void printLoadReport(FILE *out, const char *path, const LoadReport *rep);
+const char *loadErrorName(int err);
+uint64_t hashColumns(const double *x, const double *y, const double *w, size_t n);
+int saveBinaryFile(const char *path, const Dataset *ds);
+int isBinaryFile(const char *path);
+int loadBinaryFile(const char *path, Dataset *ds, int verify);
+int loadDatasetFile(const char *path, Dataset *ds, LoadReport *rep, int flags);
+
+// Nhiều chuỗi đọc từ file "id x y": các dòng liền nhau cùng id thuộc một chuỗi
+typedef struct {
+    Dataset points;         // điểm của mọi chuỗi, nối liền theo thứ tự trong file
+    int *offsets;           // chuỗi s gồm điểm offsets[s] .. offsets[s+1]-1
+    int *nameStart;         // tên chuỗi s bắt đầu tại names + nameStart[s]
+    char *names;            // các tên, mỗi tên kết thúc bằng '\0'
+    int count, capacity;
+    size_t namesUsed, namesCapacity;
+} SeriesSet;
+
+void initSeriesSet(SeriesSet *s);
+void freeSeriesSet(SeriesSet *s);
+void clearSeriesSet(SeriesSet *s);
+int loadSeriesFile(const char *path, SeriesSet *s, LoadReport *rep);
+
+static inline const char *seriesName(const SeriesSet *s, int series) {
+    return s->names + s->nameStart[series];
+}
+
+// ===== Ghi log bất đồng bộ =====
+
+// Log được định dạng vào bộ đệm lớn; luồng nền ghi bộ đệm đầy xuống đĩa trong
+// khi luồng gọi điền tiếp bộ đệm thứ hai (chỉ chờ khi cả hai cùng đầy).
+#define LOG_BUFFER_SIZE (1 << 20)
+
+typedef struct LogSink LogSink;
+
+LogSink *openLogSink(const char *path);
+void logPrintf(LogSink *sink, const char *fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+void flushLogSink(LogSink *sink);
+int closeLogSink(LogSink *sink);
+
+// ===== Song song hóa =====
+
+#define PARALLEL_CHUNK 65536
+
+typedef void (*ChunkFn)(void *ctx, int chunk);
+
+int hardwareThreads(void);
+void setThreadCount(int n);
+int getThreadCount(void);
+void parallelFor(int taskCount, ChunkFn fn, void *ctx);
+void reduceChunkSums(double *parts, int chunks, int width);
+double nowSeconds(void);
+
+// ===== Vùng nhớ làm việc (arena) =====
+
+#define WS_ALIGN 64
+
+typedef struct WsOverflow {
+    struct WsOverflow *next;
+} WsOverflow;
+
+typedef struct {
+    void *raw;              // vùng nhớ cấp phát thật (base đã căn lề WS_ALIGN)
+    unsigned char *base;
+    size_t capacity, used;
+    WsOverflow *overflow;   // các khối phụ từ lần wsReset trước
+    size_t overflowBytes;
+    size_t peak;            // nhu cầu lớn nhất từng gặp (byte)
+    long long heapAllocs;   // số lần phải gọi malloc (để kiểm tra đường nóng)
+} FitWorkspace;
+
+void initWorkspace(FitWorkspace *ws);
+void freeWorkspace(FitWorkspace *ws);
+int wsReserve(FitWorkspace *ws, size_t bytes);
+void *wsAlloc(FitWorkspace *ws, size_t bytes);
+size_t wsMark(const FitWorkspace *ws);
+void wsRelease(FitWorkspace *ws, size_t mark);
+void wsReset(FitWorkspace *ws);
+
+// ===== Mô hình và trạng thái =====
+
+// Mã trạng thái của các hàm khớp (fit*)
+enum {
+    FIT_OK = 0,
+    FIT_ERR_TOO_FEW_POINTS,   // không đủ điểm cho mô hình
+    FIT_ERR_DOMAIN,           // x <= 0 (logarit) hoặc y <= 0 (hàm mũ)
+    FIT_ERR_SINGULAR,         // hệ phương trình suy biến
+    FIT_ERR_NO_MEMORY         // không đủ bộ nhớ cho vùng làm việc
+};
+
+enum {
+    MODEL_LINEAR = 0,
+    MODEL_LOG,
+    MODEL_EXP,
+    MODEL_QUADRATIC,
+    MODEL_POLY,
+    MODEL_MULTI     // y = c0 + c1 x1 + ... + cp xp trên các cột đặc trưng (Dataset.X)
+};
+
+typedef struct {
+    int kind;
+    int degree;   // MODEL_POLY: bậc; MODEL_MULTI: số đặc trưng (0: lấy từ dữ liệu khi khớp)
+} ModelSpec;
+
+#define MAX_MODELS 32
+
+// Bậc tối đa chỉ để chỉ số (int) trong ma trận (bậc+2)^2 không tràn; bộ nhớ
+// thực tế lấy từ vùng làm việc, thiếu thì phép khớp trả về FIT_ERR_NO_MEMORY
+#define MAX_POLY_DEGREE 40000
+
+// Bộ giải cho mô hình đa thức
+enum {
+    SOLVER_NORMAL = 0,   // phương trình chuẩn tắc từ mô-men (nhanh nhất)
+    SOLVER_QR,           // QR trên cơ sở đơn thức x^k
+    SOLVER_QR_ORTHO      // QR trên đa thức Chebyshev của x đã chuẩn hóa về [-1, 1]
+};
+
+// Ngưỡng số điều kiện mà menu tự chuyển từ phương trình chuẩn tắc sang QR
+#define POLY_COND_LIMIT 1e6
+
+double safeDiv(double a, double b);
+double linearModel(double x, double coeff[]);
+double logModel(double x, double coeff[]);
+double expModel(double x, double coeff[]);
+double quadraticModel(double x, double coeff[]);
+double polyModel(double x, double coeff[]);
+double calculateR2(const DatasetView *ds, double (*model)(double, double[]), double coeff[], int degree);
+const char *fitStatusName(int status);
+const char *solverName(int solver);
+int parseSolver(const char *name);
+void formatModelSpec(const ModelSpec *m, char *buf, size_t len);
+int parseModelList(const char *spec, ModelSpec models[], int maxModels);
+int coeffCount(const ModelSpec *m);
+
+// ===== Nhân tính tổng lũy thừa =====
+
+typedef void (*PowerSumFn)(const double *x, const double *y, int n, double shift,
+                           int degree, double *sx, double *sxy, double *syy);
+
+// Bảng các nhân có sẵn (dùng cho đo hiệu năng)
+typedef struct {
+    const char *name;
+    PowerSumFn fn;
+} PowerSumKernel;
+
+int availablePowerSumKernels(PowerSumKernel out[], int max);
+PowerSumFn powerSumKernel(void);
+
+// ===== Tích lũy mô-men =====
+
+// Các nhóm tổng tùy chọn
+enum {
+    MOMENT_LOGX = 1,    // Σ ln x, Σ (ln x)^2, Σ y' ln x (hồi quy logarit)
+    MOMENT_LOGY = 2     // Σ ln y, Σ (ln y)^2, Σ x ln y (hồi quy hàm mũ)
+};
+
+typedef struct {
+    int maxDegree;      // bậc đa thức cao nhất giải được
+    int flags;          // MOMENT_LOGX | MOMENT_LOGY
+    long long count;    // số điểm đã tích lũy
+    double n;           // tổng trọng số (bằng count khi không có trọng số)
+    double yShift;
+    double *sx;         // sx[k] = Σ x^k, k = 0..2*maxDegree
+    double *sxy;        // sxy[k] = Σ x^k y', k = 0..maxDegree
+    double syy;         // Σ y'^2
+    double slnx, slnx2, slnxy;
+    double slny, slny2, sxlny;
+    long long badLogX;  // số điểm có x <= 0
+    long long badLogY;  // số điểm có y <= 0
+} Moments;
+
+void resetMoments(Moments *m);
+size_t momentsBufferSize(int maxDegree);
+void bindMoments(Moments *m, int maxDegree, int flags, double *buf);
+int initMoments(Moments *m, int maxDegree, int flags);
+int wsMoments(FitWorkspace *ws, Moments *m, int maxDegree, int flags);
+void freeMoments(Moments *m);
+void mergeMoments(Moments *dst, const Moments *src);
+void accumulateMoments(Moments *m, const double *x, const double *y, int n, FitWorkspace *ws);
+void accumulateWeightedMoments(Moments *m, const double *x, const double *y, const double *w,
+                               int n, FitWorkspace *ws);
+void addMomentsPoint(Moments *m, double x, double y, double w);
+void momentsNeeded(const ModelSpec models[], int modelCount, int *maxDegree, int *flags);
+
+// ===== Các bộ giải và hàm khớp =====
+
+int solveLinearMoments(const Moments *m, double coeff[], double *r2);
+int solveLogMoments(const Moments *m, double coeff[], double *r2);
+int solveExpMoments(const Moments *m, double coeff[]);
+int solvePolyMoments(const Moments *m, int degree, FitWorkspace *ws,
+                     double coeff[], double *r2, double *cond);
+int solveQuadraticMoments(const Moments *m, FitWorkspace *ws, double coeff[], double *r2);
+double expLogR2(const Moments *m, const double coeff[]);
+int residualR2(const DatasetView *ds, double (*model)(double, double[]), double coeff[],
+               const Moments *m, FitWorkspace *ws, double *r2);
+double residualSumSquares(const DatasetView *ds, double (*model)(double, double[]), double coeff[],
+                          FitWorkspace *ws);
+int solveModel(const DatasetView *ds, const Moments *mo, const ModelSpec *m, FitWorkspace *ws,
+               double coeff[], double *r2);
+
+// ws: vùng làm việc của bên gọi cho các tổng (NULL: mỗi lần gọi cấp phát một
+// vùng tạm); hệ số ghi vào coeff[] của bên gọi, vùng đã dùng được trả lại
+int fitLinear(const DatasetView *ds, FitWorkspace *ws, double coeff[], double *r2);
+int fitLog(const DatasetView *ds, FitWorkspace *ws, double coeff[], double *r2);
+int fitExponential(const DatasetView *ds, FitWorkspace *ws, double coeff[], double *r2);
+int fitQuadratic(const DatasetView *ds, FitWorkspace *ws, double coeff[], double *r2);
+int fitPolyQR(const DatasetView *ds, int degree, int ortho, FitWorkspace *ws,
+              double coeff[], double *r2, double *cond);
+int fitPolySolver(const DatasetView *ds, int degree, int solver, FitWorkspace *ws,
+                  double coeff[], double *r2, double *cond);
+int fitPoly(const DatasetView *ds, int degree, double coeff[], double *r2);
+
+// Kết quả đầy đủ của một mô hình
+typedef struct {
+    int status;             // FIT_*
+    ModelSpec model;
+    long long n;            // số điểm
+    int coeffCount;         // số phần tử của coeff (đa thức: kể cả ô lưu bậc)
+    double *coeff;          // cùng thứ tự với các hàm mô hình; nằm trong ws
+    double r2;
+    double ssRes;           // Σ(y - ŷ)^2
+    double ssTot;           // Σ(y - ȳ)^2
+    double rmse;            // sqrt(ssRes / n)
+    double stdError;        // sqrt(ssRes / (n - số hệ số)), sai số chuẩn của hồi quy
+    double cond;            // ước lượng số điều kiện (chỉ đa thức, còn lại NAN)
+    double adjR2;           // R^2 hiệu chỉnh theo số hệ số
+    double aic, bic;        // tiêu chí thông tin (sai số chuẩn), càng nhỏ càng tốt
+} FitResult;
+
+int fitModel(const DatasetView *ds, const ModelSpec *spec, int solver, FitWorkspace *ws,
+             FitResult *res);
+int fitModels(const DatasetView *ds, const ModelSpec specs[], int count, int solver,
+              FitWorkspace *ws, FitResult results[]);
+void fitModelsFromMoments(const DatasetView *ds, const Moments *m, long long n, const ModelSpec specs[],
+                          int count, FitWorkspace *ws, FitResult results[]);
+void setResidualSum(FitResult *res, double ssRes);
+
+// ===== Tự chọn mô hình =====
+
+// Tiêu chí xếp hạng của fitAuto
+enum {
+    CRITERION_AIC = 0,
+    CRITERION_BIC,
+    CRITERION_ADJR2,
+    CRITERION_R2
+};
+
+#define AUTO_DEFAULT_DEGREE 5
+
+const char *criterionName(int criterion);
+int parseCriterion(const char *name);
+double criterionScore(const FitResult *res, int criterion);
+int autoCandidateCount(int maxDegree);
+int fitAuto(const DatasetView *ds, int maxDegree, int criterion, FitWorkspace *ws,
+            FitResult results[], int *best);
+
+// ===== Khớp nhiều chuỗi ngắn (batch) =====
+
+// Nhiều chuỗi đóng gói theo cột (structure of arrays): chuỗi s gồm các điểm
+// x[offsets[s]] .. x[offsets[s+1]-1], offsets có count + 1 phần tử
+typedef struct {
+    const double *x;
+    const double *y;
+    const int *offsets;
+    int count;
+} SeriesBatch;
+
+static inline SeriesBatch seriesBatch(const SeriesSet *s) {
+    SeriesBatch b = {s->points.x, s->points.y, s->offsets, s->count};
+    return b;
+}
+
+int fitSeriesBatch(const SeriesBatch *batch, const ModelSpec *spec,
+                   double coeff[], double r2[], int status[]);
+
+// ===== Dự báo hàng loạt =====
+
+// Tính giá trị mô hình đã khớp trên cả mảng x (mỗi họ có nhân riêng, đa thức
+// theo Horner với SIMD); coeff cùng bố cục với FitResult.coeff. MODEL_MULTI
+// chỉ dùng c0 + c1 x (đúng khi có một đặc trưng)
+void predict(const ModelSpec *m, const double coeff[], const double *x, double *y, int n);
+
+// ===== Hồi quy bền vững (IRLS) =====
+
+enum {
+    ROBUST_NONE = 0,    // bình phương tối thiểu (có trọng số nếu có)
+    ROBUST_HUBER,       // Huber, k = HUBER_K
+    ROBUST_TUKEY        // Tukey bisquare, c = TUKEY_C
+};
+
+// Hằng số điều chỉnh cho hiệu suất 95% với nhiễu chuẩn
+#define HUBER_K 1.345
+#define TUKEY_C 4.685
+#define ROBUST_MAX_ITER 50
+#define ROBUST_TOL 1e-8     // dừng khi max |Δc| <= ROBUST_TOL * max |c|
+
+typedef struct {
+    int iterations;         // số vòng IRLS đã chạy
+    double scale;           // thang đo phần dư s = MAD / 0.6745
+    int downweighted;       // số điểm có |r| > k s (Huber: giảm trọng số, Tukey: bị loại)
+} RobustInfo;
+
+const char *robustName(int loss);
+int parseRobust(const char *name);
+int fitRobust(const DatasetView *ds, const ModelSpec *spec, int loss, FitWorkspace *ws,
+              FitResult *res, RobustInfo *info);
+
+// ===== Bootstrap =====
+
+#define BOOTSTRAP_DEFAULT_LEVEL 0.95
+
+typedef struct {
+    ModelSpec model;
+    int resamples;          // số mẫu khớp được (tính phân vị trên chừng này mẫu)
+    double level;           // mức tin cậy, ví dụ 0.95
+    double *lo, *hi;        // khoảng phân vị của từng hệ số (bố cục như FitResult.coeff), trong ws
+    double r2Lo, r2Hi;
+} BootstrapInterval;
+
+int bootstrapFit(const DatasetView *ds, const ModelSpec specs[], int count, int resamples,
+                 double level, uint64_t seed, FitWorkspace *ws, BootstrapInterval out[]);
+
+// ===== Kiểm định chéo K-fold =====
+
+#define CV_DEFAULT_FOLDS 5
+
+typedef struct {
+    int degree;
+    int status;             // FIT_OK nếu mọi fold khớp được bậc này
+    double mse;             // sai số bình phương trung bình trên điểm giữ lại
+    double mseStdErr;       // sai số chuẩn của MSE giữa các fold
+} CvScore;
+
+int crossValidatePoly(const DatasetView *ds, int folds, int maxDegree, FitWorkspace *ws,
+                      CvScore scores[], int *best);
+
+// ===== Bộ nhớ đệm kết quả khớp (lsq_cache.c) =====
+
+// Khóa là dấu vân tay dữ liệu (hashColumns) và mô hình; ngoài kết quả còn giữ
+// mô-men của mỗi dữ liệu để giải mô hình bậc thấp hơn mà không đọc lại dữ liệu.
+typedef struct FitCache FitCache;
+
+typedef struct {
+    long long hits;         // kết quả có sẵn
+    long long derived;      // giải từ mô-men đã lưu
+    long long computed;     // phải tích lũy lại từ dữ liệu
+} FitCacheStats;
+
+FitCache *openFitCache(const char *path);
+int saveFitCache(FitCache *c);
+void closeFitCache(FitCache *c);
+void fitCacheStats(const FitCache *c, FitCacheStats *stats);
+int cacheFileFingerprint(FitCache *c, const char *path, int loadFlags, uint64_t *fp, int *n);
+void cacheRememberFile(FitCache *c, const char *path, int loadFlags, uint64_t fp, int n);
+int lookupFitCache(FitCache *c, uint64_t fp, int n, const ModelSpec specs[], int count,
+                   int solver, FitWorkspace *ws, FitResult results[]);
+int cachedFitModels(FitCache *c, uint64_t fp, const DatasetView *ds, const ModelSpec specs[],
+                    int count, int solver, FitWorkspace *ws, FitResult results[]);
+
+// ===== Đọc và khớp theo khối (dữ liệu lớn hơn RAM) =====
+
+// Tổng bộ nhớ mặc định cho các bộ đệm khi đọc theo khối (MB)
+#define CHUNK_DEFAULT_MB 64
+
+// Luồng nền đọc (và phân tích nếu là văn bản) khối kế tiếp trong khi luồng gọi
+// xử lý khối hiện tại; bộ nhớ cố định, không phụ thuộc kích thước file.
+typedef struct ChunkReader ChunkReader;
+
+ChunkReader *openChunkReader(const char *path, int flags, size_t memBytes, int *err);
+int nextChunk(ChunkReader *r, DatasetView *chunk);
+void closeChunkReader(ChunkReader *r, LoadReport *rep);
+int fitFileChunked(const char *path, int flags, size_t memBytes, const ModelSpec specs[],
+                   int count, FitWorkspace *ws, FitResult results[], LoadReport *rep);
+
+// ===== Khớp trực tuyến và cửa sổ trượt =====
+
+typedef struct {
+    Moments m;
+    ModelSpec models[MAX_MODELS];
+    int modelCount;
+    FitWorkspace ws;    // dùng lại giữa các lần truy vấn
+} OnlineFit;
+
+enum {
+    WINDOW_SLIDING = 0,
+    WINDOW_DECAY
+};
+
+typedef struct {
+    OnlineFit fit;
+    int mode;
+    int window;             // W (WINDOW_SLIDING)
+    double *bx, *by;        // vòng đệm W điểm gần nhất
+    int head;               // vị trí của điểm cũ nhất
+    int filled;
+    long slides;            // số lần trượt từ lần tính lại gần nhất
+    long refreshEvery;
+    double decay;           // λ (WINDOW_DECAY)
+    double horizon;         // số điểm sau đó trọng số λ^k không còn ảnh hưởng
+    long long lastBadLogX, lastBadLogY;
+} WindowFit;
+
+int initOnlineFit(OnlineFit *of, const ModelSpec models[], int modelCount);
+void freeOnlineFit(OnlineFit *of);
+void onlineAddPoint(OnlineFit *of, double x, double y);
+int onlineQuery(OnlineFit *of, int i, double coeff[], double *r2);
+int initWindowFit(WindowFit *wf, const ModelSpec models[], int modelCount, int window, double decay);
+void freeWindowFit(WindowFit *wf);
+void windowAddPoint(WindowFit *wf, double x, double y);
+int windowQuery(WindowFit *wf, int i, double coeff[], double *r2);
+
+#endif
@@ -0,0 +1,778 @@
+// Bộ nhớ đệm kết quả khớp: khóa theo dấu vân tay dữ liệu (hashColumns) và mô hình,
+// giữ trong bộ nhớ và tùy chọn lưu ra file giữa các lần chạy
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "lsq.h"
+
+#define CACHE_MAGIC "PBLC"
+#define CACHE_VERSION 2
+#define CACHE_MAX_PATH 4096
+
+// ===== Chỉ mục băm =====
+
+// Bảng địa chỉ mở, không xóa; mỗi ô giữ mã băm và chỉ số mục (-1: trống).
+// Bên gọi tự so khóa đầy đủ vì nhiều khóa có thể trùng mã băm.
+typedef struct {
+    uint64_t hash;
+    int entry;
+} HashSlot;
+
+typedef struct {
+    HashSlot *slots;
+    int size;       // số ô (lũy thừa của 2)
+    int used;
+} HashIndex;
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+}
+
+static void placeSlot(HashSlot *slots, int size, uint64_t hash, int entry) {
+    int i = (int)(hash & (uint64_t)(size - 1));
+    while (slots[i].entry >= 0) i = (i + 1) & (size - 1);
+    slots[i].hash = hash;
+    slots[i].entry = entry;
+}
+
+// Trả về -1 nếu không đủ bộ nhớ; hệ số tải giữ dưới 1/2
+static int indexInsert(HashIndex *ix, uint64_t hash, int entry) {
+    if (2 * (ix->used + 1) > ix->size) {
+        int size = ix->size ? 2 * ix->size : 64;
+        HashSlot *slots = (HashSlot*)malloc((size_t)size * sizeof(HashSlot));
+        if (!slots) return -1;
+        for (int i = 0; i < size; i++) slots[i].entry = -1;
+        for (int i = 0; i < ix->size; i++) {
+            if (ix->slots[i].entry >= 0) placeSlot(slots, size, ix->slots[i].hash, ix->slots[i].entry);
+        }
+        free(ix->slots);
+        ix->slots = slots;
+        ix->size = size;
+    }
+    placeSlot(ix->slots, ix->size, hash, entry);
+    ix->used++;
+    return 0;
+}
+
+// Mục tiếp theo có mã băm hash (bắt đầu với *pos = -1); -1 khi hết
+static int indexNext(const HashIndex *ix, uint64_t hash, int *pos) {
+    if (ix->size == 0) return -1;
+    int mask = ix->size - 1;
+    int i = *pos < 0 ? (int)(hash & (uint64_t)mask) : ((*pos + 1) & mask);
+    for (; ix->slots[i].entry >= 0; i = (i + 1) & mask) {
+        if (ix->slots[i].hash == hash) {
+            *pos = i;
+            return ix->slots[i].entry;
+        }
+    }
+    return -1;
+}
+
+// Mở rộng mảng *arr để chứa thêm một phần tử; -1 nếu không đủ bộ nhớ
+static int growArray(void **arr, int *capacity, int count, size_t elem) {
+    if (count < *capacity) return 0;
+    int cap = *capacity ? *capacity * 2 : 64;
+    void *p = realloc(*arr, (size_t)cap * elem);
+    if (!p) return -1;
+    *arr = p;
+    *capacity = cap;
+    return 0;
+}
+
+// ===== Các mục =====
+
+// Khóa: fp, n, kind, degree (chỉ đa thức), solver (chỉ đa thức và bậc hai)
+typedef struct {
+    uint64_t fp;
+    int n;
+    int kind, degree, solver;
+    int status;
+    int coeffCount;
+    double r2, ssRes, ssTot, rmse, stdError, cond, adjR2, aic, bic;
+    double *coeff;
+} CachedResult;
+
+typedef struct {
+    uint64_t fp;
+    int n;
+    Moments m;          // sx, sxy cấp bởi malloc
+} CachedMoments;
+
+// Thiết bị, inode, kích thước và thời điểm sửa của file: đổi bất kỳ giá trị nào
+// (kể cả file bị thay bằng bản sao qua rename) là phải đọc lại
+typedef struct {
+    uint64_t dev, ino;
+    long long size, mtime;
+} FileStamp;
+
+// Dấu vân tay của file theo (đường dẫn tuyệt đối, cờ đọc, FileStamp)
+typedef struct {
+    char *path;
+    int loadFlags;      // chỉ LOAD_WEIGHTS làm thay đổi dữ liệu đọc được
+    FileStamp stamp;
+    uint64_t fp;
+    int n;
+} CachedFile;
+
+struct FitCache {
+    char *path;         // NULL: chỉ trong bộ nhớ
+    CachedResult *results;
+    int resultCount, resultCapacity;
+    HashIndex resultIndex;
+    CachedMoments *moments;
+    int momentCount, momentCapacity;
+    HashIndex momentIndex;
+    CachedFile *files;
+    int fileCount, fileCapacity;
+    HashIndex fileIndex;
+    FitCacheStats stats;
+    int dirty;          // có thay đổi chưa ghi ra file
+};
+
+static int isPolyKind(int kind) {
+    return kind == MODEL_QUADRATIC || kind == MODEL_POLY;
+}
+
+static void resultKey(const ModelSpec *spec, int solver, int *degree, int *solverKey) {
+    *degree = spec->kind == MODEL_POLY ? spec->degree : 0;
+    *solverKey = isPolyKind(spec->kind) ? solver : SOLVER_NORMAL;
+}
+
+static uint64_t resultHash(uint64_t fp, int n, int kind, int degree, int solver) {
+    uint64_t key = ((uint64_t)(uint32_t)n << 32) ^ ((uint64_t)(uint32_t)degree << 8) ^
+                   ((uint64_t)kind << 4) ^ (uint64_t)solver;
+    return mix64(fp ^ mix64(key));
+}
+
+static uint64_t momentHash(uint64_t fp, int n) {
+    return mix64(fp ^ mix64((uint64_t)(uint32_t)n));
+}
+
+// FNV-1a của đường dẫn
+static uint64_t fileHash(const char *path, int loadFlags) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (const unsigned char *p = (const unsigned char*)path; *p; p++) {
+        h = (h ^ *p) * 0x100000001B3ULL;
+    }
+    return mix64(h ^ (uint64_t)loadFlags);
+}
+
+static CachedResult *findResult(FitCache *c, uint64_t fp, int n, const ModelSpec *spec, int solver) {
+    int degree, solverKey;
+    resultKey(spec, solver, &degree, &solverKey);
+    uint64_t h = resultHash(fp, n, spec->kind, degree, solverKey);
+    int pos = -1, i;
+    while ((i = indexNext(&c->resultIndex, h, &pos)) >= 0) {
+        CachedResult *e = &c->results[i];
+        if (e->fp == fp && e->n == n && e->kind == spec->kind && e->degree == degree &&
+            e->solver == solverKey) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Lưu res (không lưu khi thiếu bộ nhớ: lần sau có thể khớp được)
+static void storeResult(FitCache *c, uint64_t fp, int solver, const FitResult *res) {
+    if (res->status == FIT_ERR_NO_MEMORY) return;
+    // Chỉ dữ liệu trong bộ nhớ (n <= INT_MAX) đi qua bộ nhớ đệm
+    CachedResult *e = findResult(c, fp, (int)res->n, &res->model, solver);
+    if (!e) {
+        if (growArray((void**)&c->results, &c->resultCapacity, c->resultCount, sizeof(CachedResult)) != 0) {
+            return;
+        }
+        double *coeff = (double*)malloc((size_t)res->coeffCount * sizeof(double));
+        if (!coeff) return;
+        e = &c->results[c->resultCount];
+        e->fp = fp;
+        e->n = (int)res->n;
+        e->kind = res->model.kind;
+        resultKey(&res->model, solver, &e->degree, &e->solver);
+        e->coeffCount = res->coeffCount;
+        e->coeff = coeff;
+        if (indexInsert(&c->resultIndex, resultHash(fp, e->n, e->kind, e->degree, e->solver),
+                        c->resultCount) != 0) {
+            free(coeff);
+            return;
+        }
+        c->resultCount++;
+    }
+    e->status = res->status;
+    e->r2 = res->r2;
+    e->ssRes = res->ssRes;
+    e->ssTot = res->ssTot;
+    e->rmse = res->rmse;
+    e->stdError = res->stdError;
+    e->cond = res->cond;
+    e->adjR2 = res->adjR2;
+    e->aic = res->aic;
+    e->bic = res->bic;
+    memcpy(e->coeff, res->coeff, (size_t)e->coeffCount * sizeof(double));
+    c->dirty = 1;
+}
+
+// Dựng lại FitResult từ mục đã lưu; hệ số lấy từ ws như fitModels
+static void restoreResult(const CachedResult *e, const ModelSpec *spec, FitWorkspace *ws,
+                          FitResult *res) {
+    memset(res, 0, sizeof(*res));
+    res->model = *spec;
+    res->n = e->n;
+    res->coeffCount = e->coeffCount;
+    res->coeff = (double*)wsAlloc(ws, (size_t)(e->coeffCount + 1) * sizeof(double));
+    if (!res->coeff) {
+        res->status = FIT_ERR_NO_MEMORY;
+        return;
+    }
+    memcpy(res->coeff, e->coeff, (size_t)e->coeffCount * sizeof(double));
+    res->status = e->status;
+    res->r2 = e->r2;
+    res->ssRes = e->ssRes;
+    res->ssTot = e->ssTot;
+    res->rmse = e->rmse;
+    res->stdError = e->stdError;
+    res->cond = e->cond;
+    res->adjR2 = e->adjR2;
+    res->aic = e->aic;
+    res->bic = e->bic;
+}
+
+static CachedMoments *findMoments(FitCache *c, uint64_t fp, int n) {
+    int pos = -1, i;
+    while ((i = indexNext(&c->momentIndex, momentHash(fp, n), &pos)) >= 0) {
+        if (c->moments[i].fp == fp && c->moments[i].n == n) return &c->moments[i];
+    }
+    return NULL;
+}
+
+// Nhận quyền sở hữu *m (tạo bởi initMoments); thay mục cũ nếu đã có
+static int insertMoments(FitCache *c, uint64_t fp, int n, Moments *m) {
+    CachedMoments *e = findMoments(c, fp, n);
+    if (e) {
+        freeMoments(&e->m);
+    } else {
+        if (growArray((void**)&c->moments, &c->momentCapacity, c->momentCount, sizeof(CachedMoments)) != 0 ||
+            indexInsert(&c->momentIndex, momentHash(fp, n), c->momentCount) != 0) {
+            freeMoments(m);
+            return -1;
+        }
+        e = &c->moments[c->momentCount++];
+        e->fp = fp;
+        e->n = n;
+    }
+    e->m = *m;
+    c->dirty = 1;
+    return 0;
+}
+
+static void storeMoments(FitCache *c, uint64_t fp, int n, const Moments *src) {
+    Moments m;
+    if (initMoments(&m, src->maxDegree, src->flags) != 0) return;
+    double *sx = m.sx, *sxy = m.sxy;
+    m = *src;
+    m.sx = sx;
+    m.sxy = sxy;
+    memcpy(m.sx, src->sx, (size_t)(2 * src->maxDegree + 1) * sizeof(double));
+    memcpy(m.sxy, src->sxy, (size_t)(src->maxDegree + 1) * sizeof(double));
+    insertMoments(c, fp, n, &m);
+}
+
+// Mô-men m có đủ bậc và nhóm tổng cho spec
+static int momentsCover(const Moments *m, const ModelSpec *spec) {
+    int degree, flags;
+    momentsNeeded(spec, 1, &degree, &flags);
+    return degree <= m->maxDegree && (flags & ~m->flags) == 0;
+}
+
+static CachedFile *findFile(FitCache *c, const char *path, int loadFlags) {
+    int pos = -1, i;
+    while ((i = indexNext(&c->fileIndex, fileHash(path, loadFlags), &pos)) >= 0) {
+        if (c->files[i].loadFlags == loadFlags && strcmp(c->files[i].path, path) == 0) {
+            return &c->files[i];
+        }
+    }
+    return NULL;
+}
+
+static int insertFile(FitCache *c, const char *path, int loadFlags, const FileStamp *stamp,
+                      uint64_t fp, int n) {
+    CachedFile *e = findFile(c, path, loadFlags);
+    if (!e) {
+        size_t len = strlen(path);
+        char *copy = (char*)malloc(len + 1);
+        if (!copy) return -1;
+        memcpy(copy, path, len + 1);
+        if (growArray((void**)&c->files, &c->fileCapacity, c->fileCount, sizeof(CachedFile)) != 0 ||
+            indexInsert(&c->fileIndex, fileHash(path, loadFlags), c->fileCount) != 0) {
+            free(copy);
+            return -1;
+        }
+        e = &c->files[c->fileCount++];
+        e->path = copy;
+        e->loadFlags = loadFlags;
+    }
+    e->stamp = *stamp;
+    e->fp = fp;
+    e->n = n;
+    c->dirty = 1;
+    return 0;
+}
+
+static int statFile(const char *path, FileStamp *stamp) {
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    stamp->dev = (uint64_t)st.st_dev;
+    stamp->ino = (uint64_t)st.st_ino;
+    stamp->size = (long long)st.st_size;
+    stamp->mtime = (long long)st.st_mtime;
+    return 0;
+}
+
+static int sameStamp(const FileStamp *a, const FileStamp *b) {
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size && a->mtime == b->mtime;
+}
+
+// Đường dẫn tuyệt đối của path vào out (CACHE_MAX_PATH + 1 byte) để cùng một file
+// gọi từ thư mục khác nhau có chung khóa; giữ nguyên path nếu không giải được
+static void absolutePath(const char *path, char *out) {
+#ifdef _WIN32
+    if (!_fullpath(out, path, CACHE_MAX_PATH + 1)) snprintf(out, CACHE_MAX_PATH + 1, "%s", path);
+#else
+    if (!realpath(path, out)) snprintf(out, CACHE_MAX_PATH + 1, "%s", path);
+#endif
+}
+
+// ===== Đọc/ghi file bộ nhớ đệm =====
+//
+// Theo thứ tự byte của máy (file khác máy bị coi là hỏng và bỏ qua):
+//   "PBLC", uint32 phiên bản, uint32 số file, số mô-men, số kết quả
+//   file:    uint32 độ dài, đường dẫn tuyệt đối, int32 loadFlags, uint64 dev, ino,
+//            int64 kích thước, mtime, uint64 fp, int32 n
+//   mô-men:  uint64 fp, int32 n, maxDegree, flags, int64 count, badLogX, badLogY,
+//            double n, yShift, syy, slnx, slnx2, slnxy, slny, slny2, sxlny,
+//            sx[2*maxDegree+1], sxy[maxDegree+1]
+//   kết quả: uint64 fp, int32 n, kind, degree, solver, status, coeffCount,
+//            double r2, ssRes, ssTot, rmse, stdError, cond, adjR2, aic, bic, coeff[]
+
+typedef struct {
+    FILE *f;
+    int ok;
+} CacheStream;
+
+static void putBytes(CacheStream *s, const void *p, size_t size) {
+    if (s->ok && size > 0 && fwrite(p, 1, size, s->f) != size) s->ok = 0;
+}
+
+static void getBytes(CacheStream *s, void *p, size_t size) {
+    if (s->ok && size > 0 && fread(p, 1, size, s->f) != size) s->ok = 0;
+}
+
+static void putI32(CacheStream *s, int v) {
+    int32_t t = (int32_t)v;
+    putBytes(s, &t, sizeof(t));
+}
+
+static int getI32(CacheStream *s) {
+    int32_t t = 0;
+    getBytes(s, &t, sizeof(t));
+    return (int)t;
+}
+
+static void putI64(CacheStream *s, long long v) {
+    int64_t t = (int64_t)v;
+    putBytes(s, &t, sizeof(t));
+}
+
+static long long getI64(CacheStream *s) {
+    int64_t t = 0;
+    getBytes(s, &t, sizeof(t));
+    return (long long)t;
+}
+
+static void putU64(CacheStream *s, uint64_t v) {
+    putBytes(s, &v, sizeof(v));
+}
+
+static uint64_t getU64(CacheStream *s) {
+    uint64_t v = 0;
+    getBytes(s, &v, sizeof(v));
+    return v;
+}
+
+static void writeCache(const FitCache *c, CacheStream *s) {
+    uint32_t header[4] = {CACHE_VERSION, (uint32_t)c->fileCount, (uint32_t)c->momentCount,
+                          (uint32_t)c->resultCount};
+    putBytes(s, CACHE_MAGIC, 4);
+    putBytes(s, header, sizeof(header));
+
+    for (int i = 0; i < c->fileCount; i++) {
+        const CachedFile *e = &c->files[i];
+        uint32_t len = (uint32_t)strlen(e->path);
+        putBytes(s, &len, sizeof(len));
+        putBytes(s, e->path, len);
+        putI32(s, e->loadFlags);
+        putU64(s, e->stamp.dev);
+        putU64(s, e->stamp.ino);
+        putI64(s, e->stamp.size);
+        putI64(s, e->stamp.mtime);
+        putU64(s, e->fp);
+        putI32(s, e->n);
+    }
+    for (int i = 0; i < c->momentCount; i++) {
+        const CachedMoments *e = &c->moments[i];
+        const Moments *m = &e->m;
+        putU64(s, e->fp);
+        putI32(s, e->n);
+        putI32(s, m->maxDegree);
+        putI32(s, m->flags);
+        putI64(s, m->count);
+        putI64(s, m->badLogX);
+        putI64(s, m->badLogY);
+        double sums[9] = {m->n, m->yShift, m->syy, m->slnx, m->slnx2, m->slnxy,
+                          m->slny, m->slny2, m->sxlny};
+        putBytes(s, sums, sizeof(sums));
+        putBytes(s, m->sx, (size_t)(2 * m->maxDegree + 1) * sizeof(double));
+        putBytes(s, m->sxy, (size_t)(m->maxDegree + 1) * sizeof(double));
+    }
+    for (int i = 0; i < c->resultCount; i++) {
+        const CachedResult *e = &c->results[i];
+        putU64(s, e->fp);
+        putI32(s, e->n);
+        putI32(s, e->kind);
+        putI32(s, e->degree);
+        putI32(s, e->solver);
+        putI32(s, e->status);
+        putI32(s, e->coeffCount);
+        double stats[9] = {e->r2, e->ssRes, e->ssTot, e->rmse, e->stdError, e->cond,
+                           e->adjR2, e->aic, e->bic};
+        putBytes(s, stats, sizeof(stats));
+        putBytes(s, e->coeff, (size_t)e->coeffCount * sizeof(double));
+    }
+}
+
+// Đọc toàn bộ file vào c (đang rỗng); -1 nếu file hỏng hoặc thiếu bộ nhớ
+static int readCache(FitCache *c, CacheStream *s) {
+    char magic[4];
+    uint32_t header[4];
+    getBytes(s, magic, 4);
+    getBytes(s, header, sizeof(header));
+    if (!s->ok || memcmp(magic, CACHE_MAGIC, 4) != 0 || header[0] != CACHE_VERSION) return -1;
+
+    char *path = (char*)malloc(CACHE_MAX_PATH + 1);
+    double *coeff = (double*)malloc((MAX_POLY_DEGREE + 2) * sizeof(double));
+    int rc = path && coeff ? 0 : -1;
+
+    for (uint32_t i = 0; rc == 0 && i < header[1]; i++) {
+        uint32_t len = 0;
+        getBytes(s, &len, sizeof(len));
+        if (!s->ok || len == 0 || len > CACHE_MAX_PATH) {
+            rc = -1;
+            break;
+        }
+        getBytes(s, path, len);
+        path[len] = '\0';
+        int loadFlags = getI32(s);
+        FileStamp stamp;
+        stamp.dev = getU64(s);
+        stamp.ino = getU64(s);
+        stamp.size = getI64(s);
+        stamp.mtime = getI64(s);
+        uint64_t fp = getU64(s);
+        int n = getI32(s);
+        if (!s->ok || strlen(path) != len || n < 0 ||
+            insertFile(c, path, loadFlags, &stamp, fp, n) != 0) {
+            rc = -1;
+        }
+    }
+    for (uint32_t i = 0; rc == 0 && i < header[2]; i++) {
+        uint64_t fp = getU64(s);
+        int n = getI32(s);
+        int maxDegree = getI32(s);
+        int flags = getI32(s);
+        Moments m;
+        if (!s->ok || n < 0 || maxDegree < 1 || maxDegree > MAX_POLY_DEGREE ||
+            (flags & ~(MOMENT_LOGX | MOMENT_LOGY)) != 0 || initMoments(&m, maxDegree, flags) != 0) {
+            rc = -1;
+            break;
+        }
+        m.count = getI64(s);
+        m.badLogX = getI64(s);
+        m.badLogY = getI64(s);
+        double sums[9];
+        getBytes(s, sums, sizeof(sums));
+        m.n = sums[0];
+        m.yShift = sums[1];
+        m.syy = sums[2];
+        m.slnx = sums[3];
+        m.slnx2 = sums[4];
+        m.slnxy = sums[5];
+        m.slny = sums[6];
+        m.slny2 = sums[7];
+        m.sxlny = sums[8];
+        getBytes(s, m.sx, (size_t)(2 * maxDegree + 1) * sizeof(double));
+        getBytes(s, m.sxy, (size_t)(maxDegree + 1) * sizeof(double));
+        if (!s->ok) {
+            freeMoments(&m);
+            rc = -1;
+        } else if (insertMoments(c, fp, n, &m) != 0) {
+            rc = -1;
+        }
+    }
+    for (uint32_t i = 0; rc == 0 && i < header[3]; i++) {
+        FitResult res;
+        memset(&res, 0, sizeof(res));
+        uint64_t fp = getU64(s);
+        res.n = getI32(s);
+        res.model.kind = getI32(s);
+        res.model.degree = getI32(s);
+        int solver = getI32(s);
+        res.status = getI32(s);
+        res.coeffCount = getI32(s);
+        if (res.model.kind == MODEL_QUADRATIC) res.model.degree = 2;
+        else if (res.model.kind != MODEL_POLY) res.model.degree = 1;
+        if (!s->ok || res.n < 0 || res.model.kind < MODEL_LINEAR || res.model.kind > MODEL_POLY ||
+            res.model.degree < 1 || res.model.degree > MAX_POLY_DEGREE ||
+            solver < SOLVER_NORMAL || solver > SOLVER_QR_ORTHO ||
+            res.status < FIT_OK || res.status >= FIT_ERR_NO_MEMORY ||
+            res.coeffCount != coeffCount(&res.model)) {
+            rc = -1;
+            break;
+        }
+        double stats[9];
+        getBytes(s, stats, sizeof(stats));
+        getBytes(s, coeff, (size_t)res.coeffCount * sizeof(double));
+        if (!s->ok) {
+            rc = -1;
+            break;
+        }
+        res.r2 = stats[0];
+        res.ssRes = stats[1];
+        res.ssTot = stats[2];
+        res.rmse = stats[3];
+        res.stdError = stats[4];
+        res.cond = stats[5];
+        res.adjR2 = stats[6];
+        res.aic = stats[7];
+        res.bic = stats[8];
+        res.coeff = coeff;
+        int before = c->resultCount;
+        storeResult(c, fp, solver, &res);
+        if (c->resultCount == before) rc = -1;
+    }
+    free(path);
+    free(coeff);
+    return rc;
+}
+
+static void clearFitCache(FitCache *c) {
+    for (int i = 0; i < c->resultCount; i++) free(c->results[i].coeff);
+    for (int i = 0; i < c->momentCount; i++) freeMoments(&c->moments[i].m);
+    for (int i = 0; i < c->fileCount; i++) free(c->files[i].path);
+    free(c->results);
+    free(c->moments);
+    free(c->files);
+    free(c->resultIndex.slots);
+    free(c->momentIndex.slots);
+    free(c->fileIndex.slots);
+    char *path = c->path;
+    memset(c, 0, sizeof(*c));
+    c->path = path;
+}
+
+// ===== API =====
+
+// Mở bộ nhớ đệm; path == NULL: chỉ trong bộ nhớ. File chưa có hoặc hỏng thì bắt
+// đầu rỗng (file sẽ được ghi đè khi saveFitCache). NULL nếu không đủ bộ nhớ.
+FitCache *openFitCache(const char *path) {
+    FitCache *c = (FitCache*)calloc(1, sizeof(FitCache));
+    if (!c) return NULL;
+    if (!path) return c;
+    size_t len = strlen(path);
+    c->path = (char*)malloc(len + 1);
+    if (!c->path) {
+        free(c);
+        return NULL;
+    }
+    memcpy(c->path, path, len + 1);
+
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        CacheStream s = {f, 1};
+        if (readCache(c, &s) != 0) clearFitCache(c);
+        fclose(f);
+    }
+    c->dirty = 0;
+    return c;
+}
+
+// Ghi ra file nếu có thay đổi: ghi file tạm rồi đổi tên để lần chạy song song
+// không đọc phải file ghi dở. Trả về 0 hoặc -1 (errno).
+int saveFitCache(FitCache *c) {
+    if (!c->path || !c->dirty) return 0;
+    size_t len = strlen(c->path);
+    char *tmp = (char*)malloc(len + 5);
+    if (!tmp) return -1;
+    memcpy(tmp, c->path, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    int rc = -1;
+    FILE *f = fopen(tmp, "wb");
+    if (f) {
+        CacheStream s = {f, 1};
+        writeCache(c, &s);
+        if (fclose(f) == 0 && s.ok) {
+#ifdef _WIN32
+            // rename trên Windows không ghi đè file đã có
+            remove(c->path);
+#endif
+            rc = rename(tmp, c->path);
+        }
+        if (rc != 0) remove(tmp);
+    }
+    free(tmp);
+    if (rc == 0) c->dirty = 0;
+    return rc;
+}
+
+// Giải phóng bộ nhớ đệm (không tự ghi ra file)
+void closeFitCache(FitCache *c) {
+    if (!c) return;
+    clearFitCache(c);
+    free(c->path);
+    free(c);
+}
+
+void fitCacheStats(const FitCache *c, FitCacheStats *stats) {
+    *stats = c->stats;
+}
+
+// Dấu vân tay đã biết của file nếu thiết bị, inode, kích thước và thời điểm sửa
+// chưa đổi: trả về 1 và ghi *fp, *n; 0 nếu phải đọc lại file. Thời điểm sửa tính
+// theo giây nên file bị ghi đè tại chỗ cùng kích thước trong cùng giây sẽ không
+// được nhận ra.
+int cacheFileFingerprint(FitCache *c, const char *path, int loadFlags, uint64_t *fp, int *n) {
+    char key[CACHE_MAX_PATH + 1];
+    FileStamp stamp;
+    absolutePath(path, key);
+    CachedFile *e = findFile(c, key, loadFlags & LOAD_WEIGHTS);
+    if (!e || statFile(key, &stamp) != 0 || !sameStamp(&stamp, &e->stamp)) return 0;
+    *fp = e->fp;
+    *n = e->n;
+    return 1;
+}
+
+// Ghi nhớ dấu vân tay của file vừa đọc
+void cacheRememberFile(FitCache *c, const char *path, int loadFlags, uint64_t fp, int n) {
+    char key[CACHE_MAX_PATH + 1];
+    FileStamp stamp;
+    if (strlen(path) > CACHE_MAX_PATH) return;
+    absolutePath(path, key);
+    if (statFile(key, &stamp) != 0) return;
+    insertFile(c, key, loadFlags & LOAD_WEIGHTS, &stamp, fp, n);
+}
+
+// Đa thức với bộ giải QR không giải được từ mô-men
+static int needsData(const ModelSpec *spec, int solver) {
+    return isPolyKind(spec->kind) && solver != SOLVER_NORMAL;
+}
+
+// Trả lời không cần dữ liệu: chỉ khi mọi mô hình đều có kết quả sẵn hoặc giải được
+// từ mô-men đã lưu (trừ hàm mũ, vì R^2 của nó cần dữ liệu gốc). Trả về 1 và điền
+// results[] (hệ số trong ws), hoặc 0 và không thay đổi gì. count <= MAX_MODELS.
+int lookupFitCache(FitCache *c, uint64_t fp, int n, const ModelSpec specs[], int count,
+                   int solver, FitWorkspace *ws, FitResult results[]) {
+    // Chỉ số thay vì con trỏ: storeResult có thể cấp phát lại mảng kết quả
+    int hit[MAX_MODELS];
+    CachedMoments *cm = findMoments(c, fp, n);
+    for (int i = 0; i < count; i++) {
+        const CachedResult *e = findResult(c, fp, n, &specs[i], solver);
+        hit[i] = e ? (int)(e - c->results) : -1;
+        if (!e && (!cm || specs[i].kind == MODEL_EXP || needsData(&specs[i], solver) ||
+                        !momentsCover(&cm->m, &specs[i]))) {
+            return 0;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (hit[i] >= 0) {
+            restoreResult(&c->results[hit[i]], &specs[i], ws, &results[i]);
+            c->stats.hits++;
+        } else {
+            fitModelsFromMoments(NULL, &cm->m, n, &specs[i], 1, ws, &results[i]);
+            storeResult(c, fp, solver, &results[i]);
+            c->stats.derived++;
+        }
+    }
+    return 1;
+}
+
+// Như fitModels nhưng qua bộ nhớ đệm: kết quả có sẵn trả về ngay, mô hình mà mô-men
+// đã lưu đủ bậc thì giải từ mô-men, còn lại tích lũy một lượt (bậc và nhóm tổng
+// gộp với mô-men đã lưu để lần sau phục vụ được nhiều hơn). fp là dấu vân tay của ds.
+// count <= MAX_MODELS.
+int cachedFitModels(FitCache *c, uint64_t fp, const DatasetView *ds, const ModelSpec specs[],
+                    int count, int solver, FitWorkspace *ws, FitResult results[]) {
+    int n = ds->size;
+    ModelSpec pending[MAX_MODELS], qr[MAX_MODELS];
+    int pendingIndex[MAX_MODELS], qrIndex[MAX_MODELS];
+    int pendingCount = 0, qrCount = 0;
+    CachedMoments *cm = findMoments(c, fp, n);
+
+    for (int i = 0; i < count; i++) {
+        const CachedResult *e = findResult(c, fp, n, &specs[i], solver);
+        if (e) {
+            restoreResult(e, &specs[i], ws, &results[i]);
+            c->stats.hits++;
+        } else if (needsData(&specs[i], solver)) {
+            qr[qrCount] = specs[i];
+            qrIndex[qrCount++] = i;
+        } else if (cm && momentsCover(&cm->m, &specs[i])) {
+            fitModelsFromMoments(ds, &cm->m, n, &specs[i], 1, ws, &results[i]);
+            storeResult(c, fp, solver, &results[i]);
+            c->stats.derived++;
+        } else {
+            pending[pendingCount] = specs[i];
+            pendingIndex[pendingCount++] = i;
+        }
+    }
+
+    FitResult tmp[MAX_MODELS];
+    if (pendingCount > 0) {
+        int maxDegree, flags;
+        momentsNeeded(pending, pendingCount, &maxDegree, &flags);
+        if (cm) {
+            if (cm->m.maxDegree > maxDegree) maxDegree = cm->m.maxDegree;
+            flags |= cm->m.flags;
+        }
+        Moments m;
+        if (wsMoments(ws, &m, maxDegree, flags) != 0) {
+            for (int k = 0; k < pendingCount; k++) results[pendingIndex[k]].status = FIT_ERR_NO_MEMORY;
+            return FIT_ERR_NO_MEMORY;
+        }
+        accumulateWeightedMoments(&m, ds->x, ds->y, ds->w, n, ws);
+        storeMoments(c, fp, n, &m);
+        fitModelsFromMoments(ds, &m, n, pending, pendingCount, ws, tmp);
+        for (int k = 0; k < pendingCount; k++) {
+            results[pendingIndex[k]] = tmp[k];
+            storeResult(c, fp, solver, &tmp[k]);
+        }
+        c->stats.computed += pendingCount;
+    }
+    if (qrCount > 0) {
+        if (fitModels(ds, qr, qrCount, solver, ws, tmp) != FIT_OK) {
+            for (int k = 0; k < qrCount; k++) results[qrIndex[k]].status = FIT_ERR_NO_MEMORY;
+            return FIT_ERR_NO_MEMORY;
+        }
+        for (int k = 0; k < qrCount; k++) {
+            results[qrIndex[k]] = tmp[k];
+            storeResult(c, fp, solver, &tmp[k]);
+        }
+        c->stats.computed += qrCount;
+    }
+    return FIT_OK;
+}
@@ -0,0 +1,1454 @@
+// Quản lý Dataset và đọc/ghi file dữ liệu (văn bản và nhị phân theo cột)
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "lsq.h"
+#include "lsq_trace.h"
+
+// ===== Ánh xạ file vào bộ nhớ =====
+
+// Ánh xạ toàn bộ file; nếu không ánh xạ được thì đọc vào bộ nhớ
+int mapFile(const char *path, MappedFile *mf) {
+    memset(mf, 0, sizeof(*mf));
+#ifdef _WIN32
+    mf->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mf->file == INVALID_HANDLE_VALUE) {
+        errno = ENOENT;
+        return -1;
+    }
+    LARGE_INTEGER len;
+    if (!GetFileSizeEx(mf->file, &len)) {
+        CloseHandle(mf->file);
+        errno = EIO;
+        return -1;
+    }
+    mf->size = (size_t)len.QuadPart;
+    if (mf->size > 0) {
+        mf->mapping = CreateFileMappingA(mf->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mf->mapping) {
+            mf->data = (const char*)MapViewOfFile(mf->mapping, FILE_MAP_READ, 0, 0, 0);
+            if (!mf->data) CloseHandle(mf->mapping);
+        }
+        mf->mapped = mf->data != NULL;
+    }
+    if (!mf->mapped) {
+        CloseHandle(mf->file);
+        mf->file = INVALID_HANDLE_VALUE;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    mf->size = (size_t)st.st_size;
+    if (mf->size > 0) {
+        void *p = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, mf->size, MADV_SEQUENTIAL);
+            mf->data = (const char*)p;
+            mf->mapped = 1;
+        }
+    }
+    close(fd);
+#endif
+    if (mf->size > 0 && !mf->mapped) {
+        // Không ánh xạ được (ví dụ pipe): đọc toàn bộ vào heap
+        FILE *f = fopen(path, "rb");
+        char *buf = f ? (char*)malloc(mf->size) : NULL;
+        if (!buf || fread(buf, 1, mf->size, f) != mf->size) {
+            free(buf);
+            if (f) fclose(f);
+            errno = EIO;
+            return -1;
+        }
+        fclose(f);
+        mf->data = buf;
+    }
+    return 0;
+}
+
+void unmapFile(MappedFile *mf) {
+    if (mf->mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(mf->data);
+        CloseHandle(mf->mapping);
+        CloseHandle(mf->file);
+#else
+        munmap((void*)mf->data, mf->size);
+#endif
+    } else {
+        free((void*)mf->data);
+    }
+    mf->data = NULL;
+    mf->size = 0;
+    mf->mapped = 0;
+}
+
+// Khởi tạo dataset
+void initDataset(Dataset *ds) {
+    ds->x = ds->y = ds->w = NULL;
+    ds->capacity = ds->size = 0;
+    ds->map = NULL;
+    ds->features = 0;
+    ds->X = NULL;
+}
+
+// Giải phóng bộ nhớ
+void freeDataset(Dataset *ds) {
+    if (ds->map) {
+        unmapFile(ds->map);
+        free(ds->map);
+        ds->map = NULL;
+    } else {
+        if (ds->x) free(ds->x);     // với nhiều đặc trưng x chính là khối X
+        if (ds->y) free(ds->y);
+        if (ds->w) free(ds->w);
+    }
+    ds->x = ds->y = ds->w = NULL;
+    ds->capacity = ds->size = 0;
+    ds->features = 0;
+    ds->X = NULL;
+}
+
+// Cấp lại các cột cho dung lượng cap (không dùng khi đang ánh xạ). y, w được
+// cấp lại trước, x (hoặc khối X, phải chép lại từng cột vì cột cách nhau
+// capacity) sau cùng: thiếu bộ nhớ thì trả về -1, các điểm đã có vẫn hợp lệ và
+// capacity giữ nguyên.
+static int resizeColumns(Dataset *ds, int cap) {
+    TRACE_COUNT(TRACE_REALLOCS, 1);
+    TRACE_BEGIN(t);
+    double *new_y = (double*)realloc(ds->y, (size_t)cap * sizeof(double));
+    if (!new_y) return -1;
+    ds->y = new_y;
+    if (ds->w) {
+        double *new_w = (double*)realloc(ds->w, (size_t)cap * sizeof(double));
+        if (!new_w) return -1;
+        ds->w = new_w;
+    }
+    if (ds->features > 0) {
+        double *X = (double*)malloc((size_t)cap * ds->features * sizeof(double));
+        if (!X) return -1;
+        for (int j = 0; j < ds->features; j++) {
+            memcpy(X + (size_t)j * cap, ds->X + (size_t)j * ds->capacity, (size_t)ds->size * sizeof(double));
+        }
+        free(ds->X);
+        ds->x = ds->X = X;
+    } else {
+        double *new_x = (double*)realloc(ds->x, (size_t)cap * sizeof(double));
+        if (!new_x) return -1;
+        ds->x = new_x;
+    }
+    ds->capacity = cap;
+    TRACE_END(t, TRACE_GROW, cap);
+    return 0;
+}
+
+// Chép dữ liệu đang ánh xạ sang heap để có thể ghi thêm.
+// Trả về -1 nếu không đủ bộ nhớ (ds giữ nguyên).
+int detachDataset(Dataset *ds) {
+    if (!ds->map) return 0;
+    TRACE_COUNT(TRACE_REALLOCS, 1);
+    TRACE_BEGIN(t);
+    int n = ds->size;
+    int cap = n < 100 ? 100 : n;
+    double *new_x = (double*)malloc((size_t)cap * sizeof(double));
+    double *new_y = (double*)malloc((size_t)cap * sizeof(double));
+    double *new_w = ds->w ? (double*)malloc((size_t)cap * sizeof(double)) : NULL;
+    if (!new_x || !new_y || (ds->w && !new_w)) {
+        free(new_x);
+        free(new_y);
+        free(new_w);
+        return -1;
+    }
+    memcpy(new_x, ds->x, (size_t)n * sizeof(double));
+    memcpy(new_y, ds->y, (size_t)n * sizeof(double));
+    if (new_w) memcpy(new_w, ds->w, (size_t)n * sizeof(double));
+    freeDataset(ds);
+    ds->x = new_x;
+    ds->y = new_y;
+    ds->w = new_w;
+    ds->size = n;
+    ds->capacity = cap;
+    TRACE_END(t, TRACE_GROW, cap);
+    return 0;
+}
+
+// Mở rộng dung lượng khi cần. Trả về -1 nếu không đủ bộ nhớ: các điểm đã có
+// vẫn hợp lệ (cột nào cấp phát lại được thì lớn hơn, capacity giữ nguyên).
+int expandDataset(Dataset *ds) {
+    if (ds->map) {
+        if (detachDataset(ds) != 0) return -1;
+        if (ds->size < ds->capacity) return 0;
+    }
+    if (ds->capacity > INT_MAX / 2) return -1;
+    int new_capacity = ds->capacity == 0 ? 100 : ds->capacity * 2;
+    return resizeColumns(ds, new_capacity);
+}
+
+// Thêm điểm dữ liệu (trọng số 1 nếu dataset có cột trọng số);
+// trả về -1 nếu không đủ bộ nhớ hoặc dataset có nhiều đặc trưng
+int addDataPoint(Dataset *ds, double x, double y) {
+    if (ds->features > 1) return -1;
+    if (ds->size >= ds->capacity && expandDataset(ds) != 0) return -1;
+    ds->x[ds->size] = x;
+    ds->y[ds->size] = y;
+    if (ds->w) ds->w[ds->size] = 1.0;
+    ds->size++;
+    return 0;
+}
+
+// Tạo cột trọng số (các điểm đã có nhận trọng số 1); trả về -1 nếu không đủ bộ nhớ
+static int ensureWeights(Dataset *ds) {
+    if (ds->w) return 0;
+    if (detachDataset(ds) != 0) return -1;
+    int cap = ds->capacity > 0 ? ds->capacity : 1;
+    ds->w = (double*)malloc((size_t)cap * sizeof(double));
+    if (!ds->w) return -1;
+    for (int i = 0; i < ds->size; i++) ds->w[i] = 1.0;
+    return 0;
+}
+
+// Thêm điểm có trọng số w; trả về -1 nếu không đủ bộ nhớ
+int addWeightedPoint(Dataset *ds, double x, double y, double w) {
+    if (ensureWeights(ds) != 0 || addDataPoint(ds, x, y) != 0) return -1;
+    ds->w[ds->size - 1] = w;
+    return 0;
+}
+
+// Xóa điểm nhưng giữ lại bộ nhớ để dùng lại cho dataset tiếp theo.
+// Cột trọng số bị bỏ: dataset tiếp theo có thể không có trọng số. Khối đặc
+// trưng (ít nhất capacity phần tử) được giữ lại làm cột x của dataset một biến.
+void clearDataset(Dataset *ds) {
+    if (ds->map) freeDataset(ds);
+    free(ds->w);
+    ds->w = NULL;
+    ds->size = 0;
+    ds->features = 0;
+    ds->X = NULL;
+}
+
+// Dành trước dung lượng cho ít nhất n điểm; trả về -1 nếu không đủ bộ nhớ
+int reserveDataset(Dataset *ds, int n) {
+    if (n <= ds->capacity) return 0;
+    if (detachDataset(ds) != 0) return -1;
+    return resizeColumns(ds, n);
+}
+
+// Thêm một hàng count đặc trưng (trọng số w nếu dataset có cột trọng số).
+// Dataset rỗng được chuyển sang bố cục count cột; hàng khác số cột với dữ
+// liệu đã có hoặc thiếu bộ nhớ thì trả về -1.
+int addFeatureRow(Dataset *ds, const double *features, int count, double y, double w) {
+    if (ds->features != count) {
+        if (ds->size > 0 || count < 1 || count > MAX_FEATURES) return -1;
+        if (ds->capacity == 0 && reserveDataset(ds, 100) != 0) return -1;
+        if (detachDataset(ds) != 0) return -1;
+        double *X = (double*)malloc((size_t)ds->capacity * count * sizeof(double));
+        if (!X) return -1;
+        free(ds->x);
+        ds->x = ds->X = X;
+        ds->features = count;
+    }
+    if (ds->size >= ds->capacity && expandDataset(ds) != 0) return -1;
+    for (int j = 0; j < count; j++) ds->X[(size_t)j * ds->capacity + ds->size] = features[j];
+    ds->y[ds->size] = y;
+    if (ds->w) ds->w[ds->size] = w;
+    ds->size++;
+    return 0;
+}
+
+// ===== Đọc file văn bản =====
+
+// Lũy thừa của 10 biểu diễn chính xác trong double
+static const double exactPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// So khớp từ khóa không phân biệt hoa thường (word viết thường)
+static int matchWord(const char *p, const char *end, const char *word) {
+    size_t len = strlen(word);
+    if ((size_t)(end - p) < len) return 0;
+    for (size_t i = 0; i < len; i++) {
+        if (tolower((unsigned char)p[i]) != word[i]) return 0;
+    }
+    return 1;
+}
+
+// Đọc một số thực trong [p, end), không phụ thuộc locale (dấu thập phân luôn là '.').
+// Trả về con trỏ ngay sau số, hoặc NULL nếu không phải số.
+const char *parseDouble(const char *p, const char *end, double *out) {
+    const char *start = p;
+    int negative = 0;
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    unsigned long long mantissa = 0;
+    int digits = 0, scale = 0;
+    int sawDigit = 0, truncated = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (unsigned)(*p - '0');
+            if (mantissa) digits++;
+        } else {
+            scale++;
+            truncated = 1;
+        }
+        sawDigit = 1;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && (unsigned)(*p - '0') < 10) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (unsigned)(*p - '0');
+                if (mantissa) digits++;
+                scale--;
+            } else {
+                truncated = 1;
+            }
+            sawDigit = 1;
+            p++;
+        }
+    }
+    if (!sawDigit) {
+        double special;
+        if (matchWord(p, end, "inf")) {
+            special = INFINITY;
+            p += matchWord(p, end, "infinity") ? 8 : 3;
+        } else if (matchWord(p, end, "nan")) {
+            special = NAN;
+            p += 3;
+        } else {
+            return NULL;
+        }
+        *out = negative ? -special : special;
+        return p;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int expNegative = 0;
+        if (q < end && (*q == '+' || *q == '-')) {
+            expNegative = *q == '-';
+            q++;
+        }
+        if (q < end && (unsigned)(*q - '0') < 10) {
+            int e = 0;
+            while (q < end && (unsigned)(*q - '0') < 10) {
+                if (e < 100000) e = e * 10 + (*q - '0');
+                q++;
+            }
+            scale += expNegative ? -e : e;
+            p = q;
+        }
+    }
+
+    // Đường nhanh: phần định trị và lũy thừa của 10 đều chính xác trong double,
+    // nên chỉ có một lần làm tròn (kết quả giống strtod)
+    if (!truncated && mantissa <= (1ULL << 53) && scale >= -22 && scale <= 22) {
+        double v = (double)mantissa;
+        v = scale < 0 ? v / exactPow10[-scale] : v * exactPow10[scale];
+        *out = negative ? -v : v;
+        return p;
+    }
+
+    // Trường hợp hiếm: dùng strtod (chương trình không gọi setlocale nên luôn là locale "C")
+    char buf[128];
+    size_t len = (size_t)(p - start);
+    if (len >= sizeof(buf)) return NULL;
+    memcpy(buf, start, len);
+    buf[len] = '\0';
+    *out = strtod(buf, NULL);
+    return p;
+}
+
+static int isFieldDelimiter(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+}
+
+// Bỏ qua khoảng trắng và tối đa một dấu phân cách ',' hoặc ';'
+static const char *skipDelimiters(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    if (p < end && (*p == ',' || *p == ';')) p++;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+static int isCommentStart(const char *p, const char *end) {
+    return *p == '#' || *p == '%' || (*p == '/' && p + 1 < end && p[1] == '/');
+}
+
+// Đọc count số đầu dòng vào out[]; các cột sau đó (nếu có) bị bỏ qua
+static int parseFields(const char *p, const char *end, double *out, int count) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    if (p == end || isCommentStart(p, end)) return 0;
+
+    const char *r = p;
+    for (int k = 0; k < count; k++) {
+        r = parseDouble(k ? skipDelimiters(r, end) : r, end, &out[k]);
+        int last = k == count - 1;
+        if (!r || (r != end && !isFieldDelimiter(*r) && !(last && *r == '#'))) return -1;
+    }
+    return 1;
+}
+
+// Phân tích một dòng "x y": trả về 1 nếu đọc được điểm, 0 nếu là dòng trống
+// hoặc chú thích, -1 nếu dòng không hợp lệ
+int parsePointLine(const char *p, const char *end, double *x, double *y) {
+    double v[2];
+    int kind = parseFields(p, end, v, 2);
+    if (kind == 1) {
+        *x = v[0];
+        *y = v[1];
+    }
+    return kind;
+}
+
+// Như parsePointLine với dòng "x y w"; trọng số âm hoặc không hữu hạn là dòng lỗi
+int parseWeightedLine(const char *p, const char *end, double *x, double *y, double *w) {
+    double v[3];
+    int kind = parseFields(p, end, v, 3);
+    if (kind == 1) {
+        if (!(v[2] >= 0) || !isfinite(v[2])) return -1;
+        *x = v[0];
+        *y = v[1];
+        *w = v[2];
+    }
+    return kind;
+}
+
+// Đọc mọi số của dòng vào out[] (tối đa max); trả về số cột, 0 nếu là dòng
+// trống hoặc chú thích, -1 nếu dòng không hợp lệ hoặc nhiều hơn max cột
+static int parseRow(const char *p, const char *end, double *out, int max) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    if (p == end || isCommentStart(p, end)) return 0;
+
+    const char *r = p;
+    for (int count = 0; count < max; ) {
+        r = parseDouble(count ? skipDelimiters(r, end) : r, end, &out[count]);
+        if (!r) return -1;
+        count++;
+        const char *t = r;
+        while (t < end && (*t == ' ' || *t == '\t' || *t == '\r')) t++;
+        if (t == end || *t == '#') return count;
+        if (!isFieldDelimiter(*r)) return -1;
+    }
+    return -1;
+}
+
+// Dòng không đọc được: là tiêu đề nếu đứng trước mọi dữ liệu, còn lại là dòng lỗi
+static void reportBadLine(LoadReport *rep, long lineNo) {
+    if (rep->points == 0 && rep->headerLines == 0 && rep->badLines == 0) {
+        rep->headerLines++;
+    } else {
+        if (rep->badLines < LOAD_MAX_BAD_LINES) rep->firstBad[rep->badLines] = lineNo;
+        rep->badLines++;
+    }
+}
+
+// Đọc file văn bản dạng "x y" (phân cách bởi khoảng trắng, tab, ',' hoặc ';'),
+// bỏ qua dòng trống, chú thích (#, %, //) và một dòng tiêu đề trước dữ liệu.
+// flags có LOAD_WEIGHTS: dòng "x y w", w vào cột trọng số của ds.
+// Các điểm được thêm vào cuối ds. Trả về LOAD_OK, LOAD_ERR_OPEN (errno) hoặc
+// LOAD_ERR_NO_MEMORY.
+int loadTextFile(const char *path, Dataset *ds, LoadReport *rep, int flags) {
+    memset(rep, 0, sizeof(*rep));
+    int weighted = (flags & LOAD_WEIGHTS) != 0;
+    MappedFile mf;
+    if (mapFile(path, &mf) != 0) return LOAD_ERR_OPEN;
+    rep->bytes = mf.size;
+    if (weighted && ensureWeights(ds) != 0) {
+        unmapFile(&mf);
+        return LOAD_ERR_NO_MEMORY;
+    }
+
+    const char *p = mf.data;
+    const char *end = mf.data + mf.size;
+
+    // Ước lượng số dòng từ độ dài file và độ dài dòng trung bình của 64KB đầu
+    if (mf.size > 0) {
+        size_t sample = mf.size < 65536 ? mf.size : 65536;
+        size_t lines = 0;
+        for (const char *q = p; (q = memchr(q, '\n', (size_t)(p + sample - q))) != NULL; q++) {
+            lines++;
+        }
+        double estimate = (double)mf.size / ((double)sample / (double)(lines + 1)) * 1.05 + 16;
+        if (estimate + ds->size < INT_MAX) {
+            reserveDataset(ds, ds->size + (int)estimate);
+        }
+    }
+
+    long lineNo = 0;
+    TRACE_BEGIN(t);
+    while (p < end) {
+        const char *lineEnd = memchr(p, '\n', (size_t)(end - p));
+        if (!lineEnd) lineEnd = end;
+        lineNo++;
+
+        const char *q = p;
+        p = lineEnd + 1;
+        double x = 0, y = 0, w = 1.0;
+        int kind = weighted ? parseWeightedLine(q, lineEnd, &x, &y, &w)
+                            : parsePointLine(q, lineEnd, &x, &y);
+        if (kind == 0) {
+            rep->commentLines++;
+            continue;
+        }
+        if (kind < 0) {
+            reportBadLine(rep, lineNo);
+            continue;
+        }
+
+        if (ds->size < ds->capacity) {
+            ds->x[ds->size] = x;
+            ds->y[ds->size] = y;
+            if (ds->w) ds->w[ds->size] = w;
+            ds->size++;
+        } else {
+            if (addDataPoint(ds, x, y) != 0) {
+                unmapFile(&mf);
+                return LOAD_ERR_NO_MEMORY;
+            }
+            if (ds->w) ds->w[ds->size - 1] = w;
+        }
+        rep->points++;
+    }
+    TRACE_END(t, TRACE_PARSE, rep->points);
+
+    unmapFile(&mf);
+    return LOAD_OK;
+}
+
+// Đọc file văn bản nhiều đặc trưng: mỗi dòng "x1 x2 ... xp y" (flags có
+// LOAD_WEIGHTS: thêm cột w cuối), p lấy từ dòng dữ liệu đầu tiên; dòng khác số
+// cột là dòng lỗi. Dòng trống, chú thích, tiêu đề như loadTextFile. ds được
+// xóa và chuyển sang bố cục theo cột (Dataset.X); dòng quá MAX_FEATURES đặc
+// trưng là dòng lỗi. Trả về LOAD_OK, LOAD_ERR_OPEN (errno) hoặc LOAD_ERR_NO_MEMORY.
+int loadFeatureFile(const char *path, Dataset *ds, LoadReport *rep, int flags) {
+    memset(rep, 0, sizeof(*rep));
+    int weighted = (flags & LOAD_WEIGHTS) != 0;
+    int extra = weighted ? 2 : 1;
+    MappedFile mf;
+    if (mapFile(path, &mf) != 0) return LOAD_ERR_OPEN;
+    rep->bytes = mf.size;
+    double *row = (double*)malloc((MAX_FEATURES + 2) * sizeof(double));
+    clearDataset(ds);
+    if (!row || (weighted && ensureWeights(ds) != 0)) {
+        free(row);
+        unmapFile(&mf);
+        return LOAD_ERR_NO_MEMORY;
+    }
+
+    const char *p = mf.data;
+    const char *end = mf.data + mf.size;
+    int columns = 0, err = LOAD_OK;
+    long lineNo = 0;
+    TRACE_BEGIN(t);
+    while (p < end && err == LOAD_OK) {
+        const char *lineEnd = memchr(p, '\n', (size_t)(end - p));
+        if (!lineEnd) lineEnd = end;
+        lineNo++;
+
+        const char *q = p;
+        p = lineEnd + 1;
+        int count = parseRow(q, lineEnd, row, MAX_FEATURES + extra);
+        if (count == 0) {
+            rep->commentLines++;
+            continue;
+        }
+        if (count > 0 && columns == 0 && count > extra) columns = count;
+        if (count < 0 || count != columns || (weighted && !(row[count - 1] >= 0 && isfinite(row[count - 1])))) {
+            reportBadLine(rep, lineNo);
+            continue;
+        }
+        int features = columns - extra;
+        double w = weighted ? row[columns - 1] : 1.0;
+        if (addFeatureRow(ds, row, features, row[features], w) != 0) err = LOAD_ERR_NO_MEMORY;
+        else rep->points++;
+    }
+    TRACE_END(t, TRACE_PARSE, rep->points);
+
+    free(row);
+    unmapFile(&mf);
+    return err;
+}
+
+// In tóm tắt các dòng bị bỏ qua (nếu có)
+void printLoadReport(FILE *out, const char *path, const LoadReport *rep) {
+    if (rep->badLines == 0) return;
+    fprintf(out, "Canh bao: %s: bo qua %d dong khong hop le (dong", path, rep->badLines);
+    int shown = rep->badLines < LOAD_MAX_BAD_LINES ? rep->badLines : LOAD_MAX_BAD_LINES;
+    for (int i = 0; i < shown; i++) {
+        fprintf(out, "%s %ld", i ? "," : "", rep->firstBad[i]);
+    }
+    fprintf(out, "%s)\n", rep->badLines > shown ? ", ..." : "");
+}
+
+// ===== Định dạng nhị phân theo cột =====
+//
+// Bố cục file (little-endian):
+//   [0, 64)              BinaryHeader
+//   [xOffset, +8*count)  cột x (double)
+//   [yOffset, +8*count)  cột y (double), bắt đầu ở bội số của 64 byte
+//   [wOffset, +8*count)  cột trọng số, chỉ khi flags có BINARY_FLAG_WEIGHTS
+
+#define BINARY_MAGIC "PBLD"
+#define BINARY_VERSION 1
+#define BINARY_DTYPE_F64 1
+#define BINARY_HEADER_SIZE 64
+#define BINARY_FLAG_WEIGHTS 1
+
+typedef struct {
+    char magic[4];          // "PBLD"
+    uint16_t version;
+    uint16_t dtype;         // BINARY_DTYPE_F64
+    uint32_t flags;         // BINARY_FLAG_*
+    uint32_t headerSize;    // BINARY_HEADER_SIZE
+    uint64_t count;         // số điểm
+    uint64_t checksum;      // hashColumns(x, y, w)
+    uint64_t xOffset;
+    uint64_t yOffset;
+    uint64_t wOffset;       // 0 nếu không có cột trọng số
+    uint8_t reserved[8];
+} BinaryHeader;
+
+typedef char binaryHeaderSizeCheck[sizeof(BinaryHeader) == BINARY_HEADER_SIZE ? 1 : -1];
+
+const char *loadErrorName(int err) {
+    switch (err) {
+        case LOAD_OK: return "ok";
+        case LOAD_ERR_OPEN: return "khong mo duoc file";
+        case LOAD_ERR_FORMAT: return "file nhi phan khong hop le";
+        case LOAD_ERR_CHECKSUM: return "tong kiem tra khong khop";
+        case LOAD_ERR_NO_MEMORY: return "khong du bo nho";
+    }
+    return "loi khong xac dinh";
+}
+
+#define HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME3 0x165667B19E3779F9ULL
+
+static uint64_t hashRound(uint64_t acc, uint64_t word) {
+    acc += word * HASH_PRIME2;
+    acc = (acc << 31) | (acc >> 33);
+    return acc * HASH_PRIME1;
+}
+
+// Băm 64-bit các từ 8 byte, 4 làn độc lập để tận dụng băng thông bộ nhớ
+static uint64_t hashWords(const double *v, size_t n, uint64_t seed) {
+    uint64_t lane[4] = {seed + HASH_PRIME1, seed + HASH_PRIME2, seed, seed - HASH_PRIME1};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint64_t w[4];
+        memcpy(w, v + i, sizeof(w));
+        lane[0] = hashRound(lane[0], w[0]);
+        lane[1] = hashRound(lane[1], w[1]);
+        lane[2] = hashRound(lane[2], w[2]);
+        lane[3] = hashRound(lane[3], w[3]);
+    }
+    uint64_t h = ((lane[0] << 1) | (lane[0] >> 63)) + ((lane[1] << 7) | (lane[1] >> 57)) +
+                 ((lane[2] << 12) | (lane[2] >> 52)) + ((lane[3] << 18) | (lane[3] >> 46));
+    for (; i < n; i++) {
+        uint64_t w;
+        memcpy(&w, v + i, sizeof(w));
+        h = hashRound(h, w);
+    }
+    h ^= (uint64_t)n;
+    h ^= h >> 33;
+    h *= HASH_PRIME2;
+    h ^= h >> 29;
+    h *= HASH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Tổng kiểm tra của các cột dữ liệu (w == NULL: chỉ x, y)
+uint64_t hashColumns(const double *x, const double *y, const double *w, size_t n) {
+    uint64_t h = hashWords(y, n, hashWords(x, n, 0));
+    return w ? hashWords(w, n, h) : h;
+}
+
+static uint64_t alignUp64(uint64_t v) {
+    return (v + 63) & ~(uint64_t)63;
+}
+
+// Ghi dataset ra file nhị phân; trả về 0 hoặc -1 (errno)
+int saveBinaryFile(const char *path, const Dataset *ds) {
+    // Định dạng nhị phân chỉ có một cột x
+    if (ds->features > 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    BinaryHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BINARY_MAGIC, 4);
+    h.version = BINARY_VERSION;
+    h.dtype = BINARY_DTYPE_F64;
+    h.headerSize = BINARY_HEADER_SIZE;
+    h.count = (uint64_t)ds->size;
+    h.checksum = hashColumns(ds->x, ds->y, ds->w, (size_t)ds->size);
+    h.xOffset = BINARY_HEADER_SIZE;
+    h.yOffset = alignUp64(h.xOffset + h.count * sizeof(double));
+    if (ds->w) {
+        h.flags |= BINARY_FLAG_WEIGHTS;
+        h.wOffset = alignUp64(h.yOffset + h.count * sizeof(double));
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    static const char zeros[64] = {0};
+    size_t pad = (size_t)(h.yOffset - h.xOffset - h.count * sizeof(double));
+    size_t wPad = ds->w ? (size_t)(h.wOffset - h.yOffset - h.count * sizeof(double)) : 0;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+             fwrite(ds->x, sizeof(double), (size_t)ds->size, f) == (size_t)ds->size &&
+             fwrite(zeros, 1, pad, f) == pad &&
+             fwrite(ds->y, sizeof(double), (size_t)ds->size, f) == (size_t)ds->size;
+    if (ok && ds->w) {
+        ok = fwrite(zeros, 1, wPad, f) == wPad &&
+             fwrite(ds->w, sizeof(double), (size_t)ds->size, f) == (size_t)ds->size;
+    }
+    if (fclose(f) != 0) ok = 0;
+    if (!ok && errno == 0) errno = EIO;
+    return ok ? 0 : -1;
+}
+
+// Kiểm tra 4 byte đầu có phải file nhị phân không
+int isBinaryFile(const char *path) {
+    char magic[4];
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    int ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, BINARY_MAGIC, 4) == 0;
+    fclose(f);
+    return ok;
+}
+
+// Kiểm tra header với kích thước file; LOAD_OK hoặc LOAD_ERR_FORMAT
+static int checkBinaryHeader(const BinaryHeader *h, uint64_t fileSize) {
+    if (memcmp(h->magic, BINARY_MAGIC, 4) != 0 || h->version != BINARY_VERSION ||
+        h->dtype != BINARY_DTYPE_F64 || h->headerSize != BINARY_HEADER_SIZE ||
+        h->count > (UINT64_MAX >> 4)) {
+        return LOAD_ERR_FORMAT;
+    }
+    uint64_t columnBytes = h->count * sizeof(double);
+    if (h->xOffset % 8 != 0 || h->yOffset % 8 != 0 ||
+        h->xOffset < BINARY_HEADER_SIZE || h->yOffset < h->xOffset + columnBytes ||
+        h->yOffset + columnBytes > fileSize) {
+        return LOAD_ERR_FORMAT;
+    }
+    if ((h->flags & BINARY_FLAG_WEIGHTS) &&
+        (h->wOffset % 8 != 0 || h->wOffset < h->yOffset + columnBytes ||
+         h->wOffset + columnBytes > fileSize)) {
+        return LOAD_ERR_FORMAT;
+    }
+    return LOAD_OK;
+}
+
+// Ánh xạ file nhị phân thẳng vào ds (không sao chép, chỉ đọc).
+// Nội dung cũ của ds được giải phóng. verify != 0: kiểm tra checksum (đọc toàn bộ file).
+int loadBinaryFile(const char *path, Dataset *ds, int verify) {
+    MappedFile *mf = (MappedFile*)malloc(sizeof(MappedFile));
+    if (!mf) return LOAD_ERR_NO_MEMORY;
+    if (mapFile(path, mf) != 0) {
+        free(mf);
+        return LOAD_ERR_OPEN;
+    }
+
+    // Header đọc trực tiếp theo thứ tự byte của máy: trên máy big-endian
+    // version sẽ sai và file bị từ chối
+    BinaryHeader h;
+    int err = LOAD_OK;
+    if (mf->size < sizeof(h)) {
+        err = LOAD_ERR_FORMAT;
+    } else {
+        memcpy(&h, mf->data, sizeof(h));
+        err = checkBinaryHeader(&h, mf->size);
+        if (h.count > (uint64_t)INT_MAX) err = LOAD_ERR_FORMAT;
+    }
+    const double *w = NULL;
+    if (err == LOAD_OK && (h.flags & BINARY_FLAG_WEIGHTS)) w = (const double*)(mf->data + h.wOffset);
+    if (err == LOAD_OK && verify) {
+        const double *x = (const double*)(mf->data + h.xOffset);
+        const double *y = (const double*)(mf->data + h.yOffset);
+        if (hashColumns(x, y, w, (size_t)h.count) != h.checksum) err = LOAD_ERR_CHECKSUM;
+    }
+    if (err != LOAD_OK) {
+        unmapFile(mf);
+        free(mf);
+        return err;
+    }
+
+    freeDataset(ds);
+    ds->map = mf;
+    ds->x = (double*)(mf->data + h.xOffset);
+    ds->y = (double*)(mf->data + h.yOffset);
+    ds->w = (double*)w;
+    ds->size = ds->capacity = (int)h.count;
+    return LOAD_OK;
+}
+
+static int loadAnyFile(const char *path, Dataset *ds, LoadReport *rep, int flags) {
+    memset(rep, 0, sizeof(*rep));
+    if (isBinaryFile(path)) {
+        int err = loadBinaryFile(path, ds, flags & LOAD_VERIFY);
+        if (err == LOAD_OK) {
+            rep->points = ds->size;
+            rep->bytes = ds->map->size;
+            // Checksum trong header chính là hashColumns của các cột
+            BinaryHeader h;
+            memcpy(&h, ds->map->data, sizeof(h));
+            rep->fingerprint = h.checksum;
+        }
+        return err;
+    }
+    if (flags & LOAD_FEATURES) {
+        int err = loadFeatureFile(path, ds, rep, flags);
+        if (err == LOAD_OK && (flags & LOAD_FINGERPRINT)) {
+            rep->fingerprint = hashColumns(ds->x, ds->y, ds->w, (size_t)ds->size);
+        }
+        return err;
+    }
+    clearDataset(ds);
+    int err = loadTextFile(path, ds, rep, flags);
+    if (err == LOAD_OK && (flags & LOAD_FINGERPRINT)) {
+        rep->fingerprint = hashColumns(ds->x, ds->y, ds->w, (size_t)ds->size);
+    }
+    return err;
+}
+
+// Đọc file dữ liệu, tự nhận dạng nhị phân hay văn bản. Nội dung cũ của ds bị thay thế.
+// flags: LOAD_VERIFY, LOAD_WEIGHTS (file nhị phân tự ghi có cột trọng số hay không).
+int loadDatasetFile(const char *path, Dataset *ds, LoadReport *rep, int flags) {
+    TRACE_BEGIN(t);
+    int err = loadAnyFile(path, ds, rep, flags);
+    TRACE_COUNT(TRACE_BYTES_READ, rep->bytes);
+    TRACE_COUNT(TRACE_POINTS_READ, rep->points);
+    TRACE_END(t, TRACE_LOAD, rep->points);
+    return err;
+}
+
+// ===== Nhiều chuỗi =====
+
+void initSeriesSet(SeriesSet *s) {
+    initDataset(&s->points);
+    s->offsets = s->nameStart = NULL;
+    s->names = NULL;
+    s->count = s->capacity = 0;
+    s->namesUsed = s->namesCapacity = 0;
+}
+
+void freeSeriesSet(SeriesSet *s) {
+    freeDataset(&s->points);
+    free(s->offsets);
+    free(s->nameStart);
+    free(s->names);
+    initSeriesSet(s);
+}
+
+// Xóa các chuỗi nhưng giữ lại bộ nhớ cho file tiếp theo
+void clearSeriesSet(SeriesSet *s) {
+    clearDataset(&s->points);
+    s->count = 0;
+    s->namesUsed = 0;
+    if (s->offsets) s->offsets[0] = 0;
+}
+
+// Mở chuỗi mới tên name (độ dài len) bắt đầu từ điểm hiện tại; -1 nếu hết bộ nhớ
+static int beginSeries(SeriesSet *s, const char *name, size_t len) {
+    if (s->count + 1 >= s->capacity) {
+        int cap = s->capacity == 0 ? 256 : s->capacity * 2;
+        int *offsets = (int*)realloc(s->offsets, (size_t)cap * sizeof(int));
+        if (!offsets) return -1;
+        s->offsets = offsets;
+        int *nameStart = (int*)realloc(s->nameStart, (size_t)cap * sizeof(int));
+        if (!nameStart) return -1;
+        s->nameStart = nameStart;
+        s->capacity = cap;
+    }
+    // nameStart là int nên vùng tên giới hạn ở INT_MAX byte
+    if (s->namesUsed + len + 1 > INT_MAX) return -1;
+    if (s->namesUsed + len + 1 > s->namesCapacity) {
+        size_t cap = s->namesCapacity == 0 ? 4096 : s->namesCapacity * 2;
+        while (cap < s->namesUsed + len + 1) cap *= 2;
+        char *names = (char*)realloc(s->names, cap);
+        if (!names) return -1;
+        s->names = names;
+        s->namesCapacity = cap;
+    }
+    s->nameStart[s->count] = (int)s->namesUsed;
+    memcpy(s->names + s->namesUsed, name, len);
+    s->names[s->namesUsed + len] = '\0';
+    s->namesUsed += len + 1;
+    s->offsets[s->count] = s->points.size;
+    s->count++;
+    s->offsets[s->count] = s->points.size;
+    return 0;
+}
+
+// Đọc file "id x y" (id là một từ bất kỳ, phân cách giống file "x y"); mỗi khi
+// id khác dòng trước thì bắt đầu chuỗi mới. Nội dung cũ của s bị thay thế.
+int loadSeriesFile(const char *path, SeriesSet *s, LoadReport *rep) {
+    memset(rep, 0, sizeof(*rep));
+    clearSeriesSet(s);
+    MappedFile mf;
+    if (mapFile(path, &mf) != 0) return LOAD_ERR_OPEN;
+    rep->bytes = mf.size;
+
+    const char *p = mf.data;
+    const char *end = mf.data + mf.size;
+    const char *lastName = NULL;
+    size_t lastLen = 0;
+    long lineNo = 0;
+    int err = LOAD_OK;
+
+    while (p < end) {
+        const char *lineEnd = memchr(p, '\n', (size_t)(end - p));
+        if (!lineEnd) lineEnd = end;
+        lineNo++;
+
+        const char *q = p;
+        p = lineEnd + 1;
+        while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r')) q++;
+        if (q == lineEnd || isCommentStart(q, lineEnd)) {
+            rep->commentLines++;
+            continue;
+        }
+
+        const char *name = q;
+        while (q < lineEnd && !isFieldDelimiter(*q)) q++;
+        size_t nameLen = (size_t)(q - name);
+        double x, y;
+        if (parsePointLine(skipDelimiters(q, lineEnd), lineEnd, &x, &y) != 1) {
+            reportBadLine(rep, lineNo);
+            continue;
+        }
+
+        if (!lastName || nameLen != lastLen || memcmp(name, lastName, nameLen) != 0) {
+            if (beginSeries(s, name, nameLen) != 0) {
+                err = LOAD_ERR_NO_MEMORY;
+                break;
+            }
+            lastName = name;
+            lastLen = nameLen;
+        }
+        if (addDataPoint(&s->points, x, y) != 0) {
+            err = LOAD_ERR_NO_MEMORY;
+            break;
+        }
+        s->offsets[s->count] = s->points.size;
+        rep->points++;
+    }
+
+    unmapFile(&mf);
+    return err;
+}
+
+// ===== Đọc theo khối (dữ liệu lớn hơn RAM) =====
+
+// Vị trí 64 bit trong file (file nhị phân có thể lớn hơn 2 GB)
+static int seekFile(FILE *f, uint64_t offset, int whence) {
+#ifdef _WIN32
+    return _fseeki64(f, (__int64)offset, whence);
+#else
+    return fseeko(f, (off_t)offset, whence);
+#endif
+}
+
+static uint64_t tellFile(FILE *f) {
+#ifdef _WIN32
+    return (uint64_t)_ftelli64(f);
+#else
+    return (uint64_t)ftello(f);
+#endif
+}
+
+typedef struct {
+    double *x, *y, *w;
+    int size;
+    int full;               // đã điền, chờ luồng gọi lấy
+} ChunkBuffer;
+
+// Hai bộ đệm điểm: luồng nền điền buf[k] trong khi luồng gọi xử lý buf[1 - k]
+struct ChunkReader {
+    FILE *file;
+    int binary;
+    int weighted;
+    int capacity;           // số điểm mỗi khối
+    ChunkBuffer buf[2];
+    int next;               // khối luồng gọi nhận tiếp theo
+    int held;               // khối luồng gọi đang giữ (-1: không có)
+    int done;               // luồng nền đã dừng (hết file hoặc lỗi)
+    int err;
+    int stop;               // luồng gọi yêu cầu dừng sớm
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    LoadReport report;      // chỉ luồng nền ghi; đọc sau khi done
+
+    // File văn bản: raw[pos, len) là phần chưa phân tích
+    char *raw;
+    size_t rawCapacity, rawLen, rawPos;
+    int eof;
+    int skipping;           // đang bỏ phần còn lại của một dòng quá dài
+    long lineNo;
+
+    // File nhị phân
+    BinaryHeader header;
+    uint64_t pos;           // số điểm đã đọc
+};
+
+static void chunkLine(ChunkReader *r, ChunkBuffer *b, const char *p, const char *end) {
+    LoadReport *rep = &r->report;
+    r->lineNo++;
+    double x = 0, y = 0, w = 1.0;
+    int kind = r->weighted ? parseWeightedLine(p, end, &x, &y, &w) : parsePointLine(p, end, &x, &y);
+    if (kind == 0) {
+        rep->commentLines++;
+        return;
+    }
+    if (kind < 0) {
+        reportBadLine(rep, r->lineNo);
+        return;
+    }
+    b->x[b->size] = x;
+    b->y[b->size] = y;
+    if (b->w) b->w[b->size] = w;
+    b->size++;
+    rep->points++;
+}
+
+// Điền b từ file văn bản; 1: còn dữ liệu, 0: hết file, < 0: LOAD_ERR_*.
+// Dòng dài hơn cả bộ đệm thô bị tính là dòng lỗi.
+static int fillTextChunk(ChunkReader *r, ChunkBuffer *b) {
+    for (;;) {
+        while (b->size < r->capacity) {
+            char *p = r->raw + r->rawPos;
+            char *end = r->raw + r->rawLen;
+            char *lineEnd = (char*)memchr(p, '\n', (size_t)(end - p));
+            if (!lineEnd) {
+                if (!r->eof) break;
+                if (p == end) return 0;
+                lineEnd = end;  // dòng cuối không có '\n'
+            }
+            r->rawPos = (size_t)(lineEnd - r->raw) + (lineEnd < end ? 1 : 0);
+            chunkLine(r, b, p, lineEnd);
+        }
+        if (b->size == r->capacity) return 1;
+
+        // Dời phần dòng dở dang về đầu rồi đọc tiếp
+        size_t tail = r->rawLen - r->rawPos;
+        memmove(r->raw, r->raw + r->rawPos, tail);
+        r->rawLen = tail;
+        r->rawPos = 0;
+        if (r->rawLen == r->rawCapacity) {
+            r->lineNo++;
+            reportBadLine(&r->report, r->lineNo);
+            r->rawLen = 0;
+            r->skipping = 1;
+        }
+        size_t got = fread(r->raw + r->rawLen, 1, r->rawCapacity - r->rawLen, r->file);
+        if (got < r->rawCapacity - r->rawLen) {
+            if (ferror(r->file)) return LOAD_ERR_OPEN;
+            r->eof = 1;
+        }
+        r->report.bytes += got;
+        r->rawLen += got;
+        if (r->skipping) {
+            char *nl = (char*)memchr(r->raw, '\n', r->rawLen);
+            if (nl) {
+                r->rawPos = (size_t)(nl - r->raw) + 1;
+                r->skipping = 0;
+            } else {
+                r->rawLen = 0;
+                if (r->eof) return 0;
+            }
+        }
+    }
+}
+
+static int readColumn(FILE *f, uint64_t offset, double *out, int n) {
+    if (seekFile(f, offset, SEEK_SET) != 0) return -1;
+    return fread(out, sizeof(double), (size_t)n, f) == (size_t)n ? 0 : -1;
+}
+
+// Điền b từ file nhị phân: mỗi cột đọc một đoạn liên tục
+static int fillBinaryChunk(ChunkReader *r, ChunkBuffer *b) {
+    const BinaryHeader *h = &r->header;
+    uint64_t left = h->count - r->pos;
+    int len = left < (uint64_t)r->capacity ? (int)left : r->capacity;
+    if (len == 0) return 0;
+    uint64_t skip = r->pos * sizeof(double);
+    if (readColumn(r->file, h->xOffset + skip, b->x, len) != 0 ||
+        readColumn(r->file, h->yOffset + skip, b->y, len) != 0 ||
+        (b->w && readColumn(r->file, h->wOffset + skip, b->w, len) != 0)) {
+        return ferror(r->file) ? LOAD_ERR_OPEN : LOAD_ERR_FORMAT;
+    }
+    b->size = len;
+    r->pos += (uint64_t)len;
+    r->report.points += len;
+    r->report.bytes += (size_t)len * sizeof(double) * (b->w ? 3 : 2);
+    return r->pos < h->count ? 1 : 0;
+}
+
+static void *chunkReaderMain(void *arg) {
+    ChunkReader *r = (ChunkReader*)arg;
+    int k = 0;
+    for (;;) {
+        ChunkBuffer *b = &r->buf[k];
+        pthread_mutex_lock(&r->lock);
+        while (b->full && !r->stop) pthread_cond_wait(&r->cond, &r->lock);
+        int stop = r->stop;
+        pthread_mutex_unlock(&r->lock);
+        if (stop) break;
+
+        b->size = 0;
+        int rc = r->binary ? fillBinaryChunk(r, b) : fillTextChunk(r, b);
+
+        pthread_mutex_lock(&r->lock);
+        if (rc < 0) r->err = rc;
+        else if (b->size > 0) b->full = 1;
+        if (rc <= 0) r->done = 1;
+        pthread_cond_broadcast(&r->cond);
+        pthread_mutex_unlock(&r->lock);
+        if (rc <= 0) break;
+        k = 1 - k;
+    }
+    return NULL;
+}
+
+static void freeChunkReader(ChunkReader *r) {
+    for (int k = 0; k < 2; k++) {
+        free(r->buf[k].x);
+        free(r->buf[k].y);
+        free(r->buf[k].w);
+    }
+    free(r->raw);
+    if (r->file) fclose(r->file);
+    free(r);
+}
+
+// Mở file (văn bản hoặc nhị phân) để đọc theo khối; memBytes là tổng bộ nhớ
+// cho các bộ đệm. flags: LOAD_WEIGHTS (LOAD_VERIFY không áp dụng: checksum cần
+// đọc trọn từng cột). NULL nếu lỗi, *err = LOAD_ERR_*.
+ChunkReader *openChunkReader(const char *path, int flags, size_t memBytes, int *err) {
+    ChunkReader *r = (ChunkReader*)calloc(1, sizeof(ChunkReader));
+    if (!r) {
+        *err = LOAD_ERR_NO_MEMORY;
+        return NULL;
+    }
+    r->held = -1;
+    r->file = fopen(path, "rb");
+    if (!r->file) {
+        free(r);
+        *err = LOAD_ERR_OPEN;
+        return NULL;
+    }
+
+    BinaryHeader *h = &r->header;
+    if (fread(h, 1, sizeof(*h), r->file) == sizeof(*h) && memcmp(h->magic, BINARY_MAGIC, 4) == 0) {
+        r->binary = 1;
+        seekFile(r->file, 0, SEEK_END);
+        *err = checkBinaryHeader(h, tellFile(r->file));
+        if (*err != LOAD_OK) {
+            freeChunkReader(r);
+            return NULL;
+        }
+        r->weighted = (h->flags & BINARY_FLAG_WEIGHTS) != 0;
+    } else {
+        seekFile(r->file, 0, SEEK_SET);
+        r->weighted = (flags & LOAD_WEIGHTS) != 0;
+        // Văn bản: 1/4 bộ nhớ cho bộ đệm thô, phần còn lại cho hai khối điểm
+        r->rawCapacity = memBytes / 4 < 65536 ? 65536 : memBytes / 4;
+        memBytes -= memBytes / 4;
+        r->raw = (char*)malloc(r->rawCapacity);
+    }
+    size_t perPoint = 2 * sizeof(double) * (r->weighted ? 3 : 2);
+    size_t capacity = memBytes / perPoint;
+    if (capacity < 1024) capacity = 1024;
+    if (capacity > INT_MAX / 2) capacity = INT_MAX / 2;
+    r->capacity = (int)capacity;
+    int ok = r->binary || r->raw;
+    for (int k = 0; k < 2; k++) {
+        r->buf[k].x = (double*)malloc(capacity * sizeof(double));
+        r->buf[k].y = (double*)malloc(capacity * sizeof(double));
+        if (r->weighted) r->buf[k].w = (double*)malloc(capacity * sizeof(double));
+        if (!r->buf[k].x || !r->buf[k].y || (r->weighted && !r->buf[k].w)) ok = 0;
+    }
+    if (!ok) {
+        freeChunkReader(r);
+        *err = LOAD_ERR_NO_MEMORY;
+        return NULL;
+    }
+
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cond, NULL);
+    if (pthread_create(&r->thread, NULL, chunkReaderMain, r) != 0) {
+        pthread_mutex_destroy(&r->lock);
+        pthread_cond_destroy(&r->cond);
+        freeChunkReader(r);
+        *err = LOAD_ERR_NO_MEMORY;
+        return NULL;
+    }
+    *err = LOAD_OK;
+    return r;
+}
+
+// Khối kế tiếp (hợp lệ đến lần gọi sau); 1: có khối, 0: hết file, < 0: LOAD_ERR_*
+int nextChunk(ChunkReader *r, DatasetView *chunk) {
+    pthread_mutex_lock(&r->lock);
+    if (r->held >= 0) {
+        r->buf[r->held].full = 0;
+        r->held = -1;
+        pthread_cond_broadcast(&r->cond);
+    }
+    ChunkBuffer *b = &r->buf[r->next];
+    while (!b->full && !r->done) pthread_cond_wait(&r->cond, &r->lock);
+    int rc = r->err;
+    if (b->full) {
+        chunk->x = b->x;
+        chunk->y = b->y;
+        chunk->w = b->w;
+        chunk->size = b->size;
+        chunk->X = NULL;
+        chunk->features = chunk->ld = 0;
+        r->held = r->next;
+        r->next = 1 - r->next;
+        rc = 1;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return rc;
+}
+
+// Dừng luồng nền và giải phóng; rep (nếu khác NULL) nhận thống kê đọc file
+void closeChunkReader(ChunkReader *r, LoadReport *rep) {
+    pthread_mutex_lock(&r->lock);
+    r->stop = 1;
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+    pthread_join(r->thread, NULL);
+    if (rep) *rep = r->report;
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->cond);
+    freeChunkReader(r);
+}
+
+// Khớp các mô hình trên file đọc theo khối, không giữ dữ liệu: lượt 1 tích lũy
+// mô-men cho mọi mô hình (đa thức giải bằng phương trình chuẩn tắc), lượt 2 chỉ
+// khi có hàm mũ để tính R^2 theo y gốc. Trả về LOAD_OK hoặc LOAD_ERR_*; trạng
+// thái từng mô hình trong results[i].status, hệ số nằm trong ws. rep (có thể
+// NULL) nhận thống kê đọc file.
+int fitFileChunked(const char *path, int flags, size_t memBytes, const ModelSpec specs[],
+                   int count, FitWorkspace *ws, FitResult results[], LoadReport *rep) {
+    int maxDegree, momentFlags;
+    momentsNeeded(specs, count, &maxDegree, &momentFlags);
+    Moments m;
+    if (wsMoments(ws, &m, maxDegree, momentFlags) != 0) return LOAD_ERR_NO_MEMORY;
+
+    int err;
+    ChunkReader *r = openChunkReader(path, flags, memBytes, &err);
+    if (!r) return err;
+    DatasetView chunk;
+    while ((err = nextChunk(r, &chunk)) > 0) {
+        accumulateWeightedMoments(&m, chunk.x, chunk.y, chunk.w, chunk.size, ws);
+    }
+    LoadReport report;
+    closeChunkReader(r, &report);
+    if (rep) *rep = report;
+    if (err < 0) return err;
+    fitModelsFromMoments(NULL, &m, report.points, specs, count, ws, results);
+
+    double ssRes[MAX_MODELS];
+    int expCount = 0;
+    for (int i = 0; i < count; i++) {
+        ssRes[i] = 0;
+        if (specs[i].kind == MODEL_EXP && results[i].status == FIT_OK) expCount++;
+    }
+    if (expCount == 0) return LOAD_OK;
+
+    r = openChunkReader(path, flags, memBytes, &err);
+    if (!r) return err;
+    while ((err = nextChunk(r, &chunk)) > 0) {
+        for (int i = 0; i < count; i++) {
+            if (specs[i].kind == MODEL_EXP && results[i].status == FIT_OK) {
+                ssRes[i] += residualSumSquares(&chunk, expModel, results[i].coeff, ws);
+            }
+        }
+    }
+    closeChunkReader(r, NULL);
+    if (err < 0) return err;
+    for (int i = 0; i < count; i++) {
+        if (specs[i].kind == MODEL_EXP) setResidualSum(&results[i], ssRes[i]);
+    }
+    return LOAD_OK;
+}
+
+// ===== Ghi log bất đồng bộ =====
+
+// Hai bộ đệm: luồng gọi điền buf[active], luồng nền ghi buf[1 - active].
+// Chỉ một luồng được gọi logPrintf trên cùng một LogSink.
+struct LogSink {
+    FILE *file;
+    char *buf[2];
+    size_t used;            // số byte đã điền trong buf[active]
+    int active;
+    size_t pendingBytes;    // số byte của bộ đệm đang chờ ghi (0: luồng ghi rảnh)
+    int stop;
+    int failed;             // fwrite từng thất bại
+    int threaded;           // 0: không tạo được luồng, ghi đồng bộ
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;   // có bộ đệm cần ghi hoặc yêu cầu dừng
+    pthread_cond_t idle;    // luồng ghi đã ghi xong bộ đệm
+};
+
+static void *logWriter(void *arg) {
+    LogSink *sink = (LogSink*)arg;
+    pthread_mutex_lock(&sink->lock);
+    for (;;) {
+        while (sink->pendingBytes == 0 && !sink->stop) {
+            pthread_cond_wait(&sink->ready, &sink->lock);
+        }
+        if (sink->pendingBytes == 0) break;
+
+        const char *data = sink->buf[1 - sink->active];
+        size_t bytes = sink->pendingBytes;
+        pthread_mutex_unlock(&sink->lock);
+        int ok = fwrite(data, 1, bytes, sink->file) == bytes;
+        pthread_mutex_lock(&sink->lock);
+
+        if (!ok) sink->failed = 1;
+        sink->pendingBytes = 0;
+        pthread_cond_signal(&sink->idle);
+    }
+    pthread_mutex_unlock(&sink->lock);
+    return NULL;
+}
+
+LogSink *openLogSink(const char *path) {
+    LogSink *sink = (LogSink*)calloc(1, sizeof(LogSink));
+    if (!sink) return NULL;
+    sink->buf[0] = (char*)malloc(LOG_BUFFER_SIZE);
+    sink->buf[1] = (char*)malloc(LOG_BUFFER_SIZE);
+    sink->file = fopen(path, "w");
+    if (!sink->buf[0] || !sink->buf[1] || !sink->file) {
+        if (sink->file) fclose(sink->file);
+        free(sink->buf[0]);
+        free(sink->buf[1]);
+        free(sink);
+        return NULL;
+    }
+
+    pthread_mutex_init(&sink->lock, NULL);
+    pthread_cond_init(&sink->ready, NULL);
+    pthread_cond_init(&sink->idle, NULL);
+    sink->threaded = pthread_create(&sink->thread, NULL, logWriter, sink) == 0;
+    return sink;
+}
+
+// Chờ luồng ghi xử lý xong bộ đệm trước đó
+static void waitLogIdle(LogSink *sink) {
+    if (!sink->threaded) return;
+    pthread_mutex_lock(&sink->lock);
+    while (sink->pendingBytes != 0) {
+        pthread_cond_wait(&sink->idle, &sink->lock);
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
+
+// Giao bộ đệm đang điền cho luồng ghi rồi chuyển sang bộ đệm còn lại
+static void submitLogBuffer(LogSink *sink) {
+    if (sink->used == 0) return;
+    if (!sink->threaded) {
+        if (fwrite(sink->buf[sink->active], 1, sink->used, sink->file) != sink->used) {
+            sink->failed = 1;
+        }
+        sink->used = 0;
+        return;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    while (sink->pendingBytes != 0) {
+        pthread_cond_wait(&sink->idle, &sink->lock);
+    }
+    sink->pendingBytes = sink->used;
+    sink->active = 1 - sink->active;
+    sink->used = 0;
+    pthread_cond_signal(&sink->ready);
+    pthread_mutex_unlock(&sink->lock);
+}
+
+void logPrintf(LogSink *sink, const char *fmt, ...) {
+    if (!sink) return;
+
+    va_list ap;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t room = LOG_BUFFER_SIZE - sink->used;
+        va_start(ap, fmt);
+        int len = vsnprintf(sink->buf[sink->active] + sink->used, room, fmt, ap);
+        va_end(ap);
+        if (len < 0) return;
+        if ((size_t)len < room) {
+            sink->used += (size_t)len;
+            return;
+        }
+        submitLogBuffer(sink);
+    }
+
+    // Dòng dài hơn cả bộ đệm: ghi thẳng sau khi luồng ghi xong để giữ thứ tự
+    waitLogIdle(sink);
+    va_start(ap, fmt);
+    if (vfprintf(sink->file, fmt, ap) < 0) sink->failed = 1;
+    va_end(ap);
+}
+
+// Ghi hết nội dung đang đệm xuống file (chặn tới khi xong)
+void flushLogSink(LogSink *sink) {
+    if (!sink) return;
+    submitLogBuffer(sink);
+    waitLogIdle(sink);
+    if (fflush(sink->file) != 0) sink->failed = 1;
+}
+
+// Trả về 0 nếu mọi dòng log đều được ghi thành công
+int closeLogSink(LogSink *sink) {
+    if (!sink) return 0;
+    flushLogSink(sink);
+    if (sink->threaded) {
+        pthread_mutex_lock(&sink->lock);
+        sink->stop = 1;
+        pthread_cond_signal(&sink->ready);
+        pthread_mutex_unlock(&sink->lock);
+        pthread_join(sink->thread, NULL);
+    }
+    pthread_mutex_destroy(&sink->lock);
+    pthread_cond_destroy(&sink->ready);
+    pthread_cond_destroy(&sink->idle);
+
+    int failed = sink->failed;
+    if (fclose(sink->file) != 0) failed = 1;
+    free(sink->buf[0]);
+    free(sink->buf[1]);
+    free(sink);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,154 @@
+// Bộ đếm và khoảng thời gian của lsq_trace.h; phần ghi số liệu chỉ được biên
+// dịch khi có LSQ_TRACE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "lsq_trace.h"
+
+static const char *const stageNames[TRACE_STAGE_COUNT] = {
+    "load", "parse", "grow", "moments", "solve", "qr", "gram", "r2", "fit", "batch", "predict", "output"
+};
+
+static const char *const counterNames[TRACE_COUNTER_COUNT] = {
+    "bytes_read", "points_read", "reallocs", "pivots", "row_swaps"
+};
+
+const char *traceStageName(int stage) {
+    return stage >= 0 && stage < TRACE_STAGE_COUNT ? stageNames[stage] : "?";
+}
+
+const char *traceCounterName(int counter) {
+    return counter >= 0 && counter < TRACE_COUNTER_COUNT ? counterNames[counter] : "?";
+}
+
+#ifdef LSQ_TRACE
+
+// Thời gian giữ theo nano giây nguyên để cộng nguyên tử; cập nhật không khóa
+// bằng __atomic (relaxed: chỉ cần đúng tổng, không cần thứ tự)
+typedef struct {
+    uint64_t calls, items, nanos, maxNanos;
+} StageCounters;
+
+typedef struct {
+    double start, seconds;
+    long long items;
+    int stage, thread;
+} TraceEvent;
+
+static struct {
+    StageCounters stages[TRACE_STAGE_COUNT];
+    uint64_t counters[TRACE_COUNTER_COUNT];
+    double origin;              // thời điểm traceStart (0: chưa gọi)
+    TraceEvent *events;
+    uint64_t eventCount;        // số khoảng đã xin chỗ, có thể vượt eventCapacity
+    uint64_t eventCapacity;
+    int nextThread;
+} trace;
+
+static _Thread_local int traceThread = -1;
+
+static uint64_t atomicAdd(uint64_t *v, uint64_t n) {
+    return __atomic_fetch_add(v, n, __ATOMIC_RELAXED);
+}
+
+static uint64_t atomicLoad(const uint64_t *v) {
+    return __atomic_load_n(v, __ATOMIC_RELAXED);
+}
+
+void traceSpan(int stage, double start, long long items) {
+    double now = nowSeconds();
+    uint64_t nanos = now > start ? (uint64_t)((now - start) * 1e9) : 0;
+    StageCounters *s = &trace.stages[stage];
+    atomicAdd(&s->calls, 1);
+    atomicAdd(&s->items, items > 0 ? (uint64_t)items : 0);
+    atomicAdd(&s->nanos, nanos);
+    uint64_t seen = atomicLoad(&s->maxNanos);
+    while (nanos > seen &&
+           !__atomic_compare_exchange_n(&s->maxNanos, &seen, nanos, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    if (!trace.events) return;
+    uint64_t slot = atomicAdd(&trace.eventCount, 1);
+    if (slot >= trace.eventCapacity) return;
+    if (traceThread < 0) traceThread = __atomic_fetch_add(&trace.nextThread, 1, __ATOMIC_RELAXED);
+    TraceEvent *e = &trace.events[slot];
+    e->start = start;
+    e->seconds = (double)nanos * 1e-9;
+    e->items = items;
+    e->stage = stage;
+    e->thread = traceThread;
+}
+
+void traceCount(int counter, long long n) {
+    atomicAdd(&trace.counters[counter], (uint64_t)n);
+}
+
+// Không được gọi khi luồng khác còn đang đo
+int traceStart(int events) {
+    free(trace.events);
+    memset(&trace, 0, sizeof(trace));
+    trace.origin = nowSeconds();
+    if (events <= 0) return 0;
+    trace.events = (TraceEvent*)malloc((size_t)events * sizeof(TraceEvent));
+    if (!trace.events) return -1;
+    trace.eventCapacity = (uint64_t)events;
+    return 0;
+}
+
+void traceSnapshot(TraceStage stages[TRACE_STAGE_COUNT], unsigned long long counters[TRACE_COUNTER_COUNT]) {
+    for (int i = 0; i < TRACE_STAGE_COUNT; i++) {
+        const StageCounters *s = &trace.stages[i];
+        stages[i].calls = atomicLoad(&s->calls);
+        stages[i].items = atomicLoad(&s->items);
+        stages[i].seconds = (double)atomicLoad(&s->nanos) * 1e-9;
+        stages[i].maxSeconds = (double)atomicLoad(&s->maxNanos) * 1e-9;
+    }
+    for (int i = 0; i < TRACE_COUNTER_COUNT; i++) counters[i] = atomicLoad(&trace.counters[i]);
+}
+
+// Các giai đoạn lồng nhau (parse nằm trong load, solve trong fit) nên tổng thời
+// gian các giai đoạn có thể lớn hơn wall_seconds
+int writeTraceSummary(FILE *out) {
+    TraceStage stages[TRACE_STAGE_COUNT];
+    unsigned long long counters[TRACE_COUNTER_COUNT];
+    traceSnapshot(stages, counters);
+    uint64_t recorded = atomicLoad(&trace.eventCount);
+    uint64_t dropped = recorded > trace.eventCapacity ? recorded - trace.eventCapacity : 0;
+
+    fprintf(out, "{\n  \"wall_seconds\": %.9f,\n  \"threads\": %d,\n  \"stages\": [",
+            trace.origin > 0 ? nowSeconds() - trace.origin : 0.0, getThreadCount());
+    for (int i = 0; i < TRACE_STAGE_COUNT; i++) {
+        const TraceStage *s = &stages[i];
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"calls\": %llu, \"items\": %llu, \"seconds\": %.9f, "
+                "\"max_seconds\": %.9f, \"items_per_sec\": ", i ? "," : "", stageNames[i], s->calls,
+                s->items, s->seconds, s->maxSeconds);
+        if (s->items > 0 && s->seconds > 0) fprintf(out, "%.6g}", (double)s->items / s->seconds);
+        else fprintf(out, "null}");
+    }
+    fprintf(out, "\n  ],\n  \"counters\": {");
+    for (int i = 0; i < TRACE_COUNTER_COUNT; i++) {
+        fprintf(out, "%s\n    \"%s\": %llu", i ? "," : "", counterNames[i], counters[i]);
+    }
+    fprintf(out, "\n  },\n  \"events_dropped\": %llu\n}\n", (unsigned long long)dropped);
+    return ferror(out) ? -1 : 0;
+}
+
+// Định dạng "Trace Event" với sự kiện hoàn chỉnh ("ph": "X"), thời gian tính
+// bằng micro giây kể từ traceStart
+int writeChromeTrace(FILE *out) {
+    uint64_t count = atomicLoad(&trace.eventCount);
+    if (count > trace.eventCapacity) count = trace.eventCapacity;
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (uint64_t i = 0; i < count; i++) {
+        const TraceEvent *e = &trace.events[i];
+        fprintf(out, "%s\n{\"name\": \"%s\", \"cat\": \"lsq\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"items\": %lld}}", i ? "," : "",
+                stageNames[e->stage], e->thread, (e->start - trace.origin) * 1e6, e->seconds * 1e6,
+                e->items);
+    }
+    fprintf(out, "\n]}\n");
+    return ferror(out) ? -1 : 0;
+}
+
+#endif
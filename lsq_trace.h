@@ -0,0 +1,78 @@
+// Đo thời gian từng giai đoạn và bộ đếm trên đường nóng. Chỉ có hiệu lực khi
+// biên dịch với -DLSQ_TRACE; nếu không, mọi macro TRACE_* là lệnh rỗng và
+// không sinh ra mã nào.
+//
+//     TRACE_BEGIN(t);
+//     ... giai đoạn ...
+//     TRACE_END(t, TRACE_PARSE, points);      // items: số điểm (hoặc byte) đã xử lý
+//     TRACE_COUNT(TRACE_PIVOTS, 1);
+//
+// Thời gian lấy từ đồng hồ đơn điệu (nowSeconds). Mỗi giai đoạn cộng dồn số lần
+// gọi, số phần tử, tổng và lớn nhất thời gian; an toàn khi gọi từ nhiều luồng.
+// traceStart(events > 0) giữ thêm tối đa events khoảng thời gian riêng lẻ để
+// ghi file Chrome trace (chrome://tracing, Perfetto).
+#ifndef LSQ_TRACE_H
+#define LSQ_TRACE_H
+
+#include <stdio.h>
+#include "lsq.h"
+
+enum {
+    TRACE_LOAD = 0,         // loadDatasetFile, cả mở file và kiểm tra
+    TRACE_PARSE,            // vòng đọc dòng của file văn bản
+    TRACE_GROW,             // cấp phát lại các cột Dataset
+    TRACE_MOMENTS,          // tích lũy tổng lũy thừa
+    TRACE_SOLVE,            // giải một mô hình từ mô-men (khử Gauss, số điều kiện)
+    TRACE_QR,               // bộ giải QR / QR trực giao
+    TRACE_GRAM,             // ma trận Gram của hồi quy nhiều biến
+    TRACE_R2,               // calculateR2, residualSumSquares
+    TRACE_FIT,              // fitModels, toàn bộ
+    TRACE_BATCH,            // fitSeriesBatch
+    TRACE_PREDICT,
+    TRACE_OUTPUT,           // ghi kết quả ra file / màn hình
+    TRACE_STAGE_COUNT
+};
+
+enum {
+    TRACE_BYTES_READ = 0,   // byte file đã đọc
+    TRACE_POINTS_READ,      // điểm hợp lệ đã đọc
+    TRACE_REALLOCS,         // số lần cấp phát lại cột
+    TRACE_PIVOTS,           // bước khử có chọn phần tử trội
+    TRACE_ROW_SWAPS,        // số lần phải đổi hàng khi chọn phần tử trội
+    TRACE_COUNTER_COUNT
+};
+
+const char *traceStageName(int stage);
+const char *traceCounterName(int counter);
+
+#ifdef LSQ_TRACE
+
+typedef struct {
+    unsigned long long calls, items;
+    double seconds, maxSeconds;
+} TraceStage;
+
+void traceSpan(int stage, double start, long long items);
+void traceCount(int counter, long long n);
+
+// Xóa số liệu và bắt đầu đo lại; events > 0: giữ tối đa chừng ấy khoảng thời gian
+// cho writeChromeTrace. Trả về -1 nếu không đủ bộ nhớ (số liệu tổng vẫn được đo).
+int traceStart(int events);
+void traceSnapshot(TraceStage stages[TRACE_STAGE_COUNT], unsigned long long counters[TRACE_COUNTER_COUNT]);
+// Ghi bản tóm tắt JSON / file Chrome trace; trả về 0 hoặc -1 khi lỗi ghi
+int writeTraceSummary(FILE *out);
+int writeChromeTrace(FILE *out);
+
+#define TRACE_BEGIN(span) double span = nowSeconds()
+#define TRACE_END(span, stage, items) traceSpan((stage), (span), (long long)(items))
+#define TRACE_COUNT(counter, n) traceCount((counter), (long long)(n))
+
+#else
+
+#define TRACE_BEGIN(span) ((void)0)
+#define TRACE_END(span, stage, items) ((void)0)
+#define TRACE_COUNT(counter, n) ((void)0)
+
+#endif
+
+#endif
@@ -2,59 +2,11 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
-#include <float.h>
-#include <stdarg.h>
-#include <ctype.h>
-
-// Cấu trúc dữ liệu động
-typedef struct {
-    double *x;
-    double *y;
-    int capacity;
-    int size;
-} Dataset;
-
-// Khởi tạo dataset
-void initDataset(Dataset *ds) {
-    ds->x = ds->y = NULL;
-    ds->capacity = ds->size = 0;
-}
-
-// Giải phóng bộ nhớ
-void freeDataset(Dataset *ds) {
-    if (ds->x) free(ds->x);
-    if (ds->y) free(ds->y);
-    ds->x = ds->y = NULL;
-    ds->capacity = ds->size = 0;
-}
-
-// Mở rộng dung lượng khi cần
-void expandDataset(Dataset *ds) {
-    int new_capacity = ds->capacity == 0 ? 100 : ds->capacity * 2;
-    double *new_x = (double*)realloc(ds->x, new_capacity * sizeof(double));
-    double *new_y = (double*)realloc(ds->y, new_capacity * sizeof(double));
-    
-    if (!new_x || !new_y) {
-        printf("Loi: Khong du bo nho!\n");
-        free(new_x);
-        free(new_y);
-        exit(1);
-    }
-    
-    ds->x = new_x;
-    ds->y = new_y;
-    ds->capacity = new_capacity;
-}
-
-// Thêm điểm dữ liệu
-void addDataPoint(Dataset *ds, double x, double y) {
-    if (ds->size >= ds->capacity) {
-        expandDataset(ds);
-    }
-    ds->x[ds->size] = x;
-    ds->y[ds->size] = y;
-    ds->size++;
-}
+#include <errno.h>
+#include "lsq.h"
+#include "bench.h"
+#include "server.h"
+#include "lsq_trace.h"
 
 // Hàm phụ trợ
 void clearInputBuffer() {
@@ -62,99 +14,84 @@ void clearInputBuffer() {
     while ((c = getchar()) != '\n' && c != EOF) {}
 }
 
-double safeDiv(double a, double b) {
-    return (fabs(b) < DBL_EPSILON) ? 0.0 : (a / b);
-}
+// Mức hiển thị kết quả trong chế độ tương tác
+enum {
+    OUTPUT_SILENT = 0,      // không in kết quả (log vẫn ghi phương trình và R^2)
+    OUTPUT_SUMMARY,         // chỉ phương trình và R^2
+    OUTPUT_TABLE            // thêm bảng từng điểm, tối đa maxRows dòng
+};
 
-// Hàm tính R²
-double calculateR2(Dataset *ds, double (*model)(double, double[]), double coeff[], int degree) {
-    double ss_tot = 0, ss_res = 0;
-    double y_mean = 0;
-    
-    for (int i = 0; i < ds->size; i++) {
-        y_mean += ds->y[i];
-    }
-    y_mean /= ds->size;
-    
-    for (int i = 0; i < ds->size; i++) {
-        double y_pred = model(ds->x[i], coeff);
-        ss_res += (ds->y[i] - y_pred) * (ds->y[i] - y_pred);
-        ss_tot += (ds->y[i] - y_mean) * (ds->y[i] - y_mean);
-    }
-    
-    return 1.0 - safeDiv(ss_res, ss_tot);
-}
+#define TABLE_ROWS_DEFAULT 20
 
-// Các hàm mô hình
-double linearModel(double x, double coeff[]) {
-    return coeff[0] + coeff[1] * x;
-}
-
-double logModel(double x, double coeff[]) {
-    return coeff[0] + coeff[1] * log(x);
-}
+typedef struct {
+    int level;
+    int maxRows;            // 0: không giới hạn
+} OutputOptions;
 
-double expModel(double x, double coeff[]) {
-    return coeff[0] * exp(coeff[1] * x);
+// Số dòng đầu của bảng được in; phần còn lại rút gọn thành "..." và dòng cuối
+static int tableHeadRows(const OutputOptions *out, int n) {
+    return (out->maxRows > 0 && n > out->maxRows + 1) ? out->maxRows : n;
 }
 
-double quadraticModel(double x, double coeff[]) {
-    return coeff[0] + coeff[1] * x + coeff[2] * x * x;
+static int nextTableRow(int i, int head, int n) {
+    return (i + 1 == head && head < n) ? n - 1 : i + 1;
 }
 
-double polyModel(double x, double coeff[]) {
-    double result = 0;
-    int degree = (int)coeff[0];
-    for (int i = 0; i <= degree; i++) {
-        result += coeff[i+1] * pow(x, i);
-    }
-    return result;
+// Dòng thay cho các điểm bị bỏ qua, căn theo độ rộng đường viền
+static void printSkippedRows(const char *border, int skipped) {
+    char text[64];
+    snprintf(text, sizeof(text), "... (%d dong) ...", skipped);
+    printf("| %-*s |\n", (int)strlen(border) - 4, text);
 }
 
-// Các hàm hồi quy
-void linearRegression(Dataset *ds, FILE *logFile) {
+// Các hàm hồi quy (chế độ tương tác: in bảng và ghi log)
+void linearRegression(Dataset *ds, FitWorkspace *ws, const OutputOptions *out, LogSink *logSink) {
     if (ds->size < 2) {
         printf("Can it nhat 2 diem de hoi quy tuyen tinh!\n");
         return;
     }
 
-    double sum_x = 0, sum_y = 0, sum_x2 = 0, sum_xy = 0;
-    
-    printf("\n=== HOI QUY TUYEN TINH ===\n");
-    printf("+-------+--------+--------+---------+----------+\n");
-    printf("| %-5s | %-6s | %-6s | %-7s | %-8s |\n", "STT", "x", "y", "x^2", "x*y");
-    printf("+-------+--------+--------+---------+----------+\n");
-    
-    for (int i = 0; i < ds->size; i++) {
-        double xi = ds->x[i], yi = ds->y[i];
-        double xi2 = xi * xi, xiyi = xi * yi;
-        sum_x += xi;
-        sum_y += yi;
-        sum_x2 += xi2;
-        sum_xy += xiyi;
-        
-        printf("| %-5d | %-6.2lf | %-6.2lf | %-7.2lf | %-8.2lf |\n", 
-              i+1, xi, yi, xi2, xiyi);
-        fprintf(logFile, "x[%d]=%.2lf y=%.2lf x^2=%.2lf x*y=%.2lf\n", 
-               i, xi, yi, xi2, xiyi);
-    }
-    printf("+-------+--------+--------+---------+----------+\n");
+    if (out->level >= OUTPUT_SUMMARY) printf("\n=== HOI QUY TUYEN TINH ===\n");
+    if (out->level == OUTPUT_TABLE) {
+        const char *border = "+-------+--------+--------+---------+----------+";
+        printf("%s\n", border);
+        printf("| %-5s | %-6s | %-6s | %-7s | %-8s |\n", "STT", "x", "y", "x^2", "x*y");
+        printf("%s\n", border);
+
+        int head = tableHeadRows(out, ds->size);
+        for (int i = 0; i < ds->size; i = nextTableRow(i, head, ds->size)) {
+            if (i >= head) printSkippedRows(border, i - head);
+            double xi = ds->x[i], yi = ds->y[i];
+            double xi2 = xi * xi, xiyi = xi * yi;
+
+            printf("| %-5d | %-6.2lf | %-6.2lf | %-7.2lf | %-8.2lf |\n", 
+                  i+1, xi, yi, xi2, xiyi);
+            logPrintf(logSink, "x[%d]=%.2lf y=%.2lf x^2=%.2lf x*y=%.2lf\n", 
+                      i, xi, yi, xi2, xiyi);
+        }
+        printf("%s\n", border);
+    }
     
-    double denom = ds->size * sum_x2 - sum_x * sum_x;
-    double a = safeDiv(sum_y * sum_x2 - sum_x * sum_xy, denom);
-    double b = safeDiv(ds->size * sum_xy - sum_x * sum_y, denom);
+    DatasetView view = datasetView(ds);
+    double coeff[2], r2;
+    int status = fitLinear(&view, ws, coeff, &r2);
+    if (status != FIT_OK) {
+        printf("Loi: %s\n", status == FIT_ERR_NO_MEMORY ? "Khong du bo nho!" : fitStatusName(status));
+        wsReset(ws);
+        return;
+    }
+    double a = coeff[0], b = coeff[1];
     
-    printf("\nPhuong trinh hoi quy:\n");
-    printf("y = %.6lf + %.6lf * x\n", a, b);
-    fprintf(logFile, "\n[Tuyen tinh] y = %.6lf + %.6lf * x\n", a, b);
-
-    double coeff[2] = {a, b};
-    double r2 = calculateR2(ds, linearModel, coeff, 1);
-    printf("He so xac dinh R^2: %.6lf\n", r2);
-    fprintf(logFile, "[Tuyen tinh] R^2 = %.6lf\n\n", r2);
+    if (out->level >= OUTPUT_SUMMARY) {
+        printf("\nPhuong trinh hoi quy:\n");
+        printf("y = %.6lf + %.6lf * x\n", a, b);
+        printf("He so xac dinh R^2: %.6lf\n", r2);
+    }
+    logPrintf(logSink, "\n[Tuyen tinh] y = %.6lf + %.6lf * x\n", a, b);
+    logPrintf(logSink, "[Tuyen tinh] R^2 = %.6lf\n\n", r2);
 }
 
-void logRegression(Dataset *ds, FILE *logFile) {
+void logRegression(Dataset *ds, FitWorkspace *ws, const OutputOptions *out, LogSink *logSink) {
     if (ds->size < 2) {
         printf("Can it nhat 2 diem de hoi quy logarit!\n");
         return;
@@ -168,43 +105,47 @@ void logRegression(Dataset *ds, FILE *logFile) {
         }
     }
 
-    double sum_lnx = 0, sum_y = 0, sum_lnx2 = 0, sum_lnx_y = 0;
-    
-    printf("\n=== HOI QUY LOGARIT ===\n");
-    printf("+-------+--------+--------+---------+-----------+-------------+\n");
-    printf("| %-5s | %-6s | %-6s | %-7s | %-9s | %-11s |\n", 
-           "STT", "x", "y", "ln(x)", "ln(x)^2", "ln(x)*y");
-    printf("+-------+--------+--------+---------+-----------+-------------+\n");
-    
-    for (int i = 0; i < ds->size; i++) {
-        double lnx = log(ds->x[i]);
-        sum_lnx += lnx;
-        sum_y += ds->y[i];
-        sum_lnx2 += lnx * lnx;
-        sum_lnx_y += lnx * ds->y[i];
-        
-        printf("| %-5d | %-6.2lf | %-6.2lf | %-7.3lf | %-9.3lf | %-11.3lf |\n",
-              i+1, ds->x[i], ds->y[i], lnx, lnx * lnx, lnx * ds->y[i]);
-        fprintf(logFile, "x[%d]=%.2lf ln(x)=%.3lf y=%.2lf ln(x)^2=%.3lf ln(x)*y=%.3lf\n",
-               i, ds->x[i], lnx, ds->y[i], lnx * lnx, lnx * ds->y[i]);
-    }
-    printf("+-------+--------+--------+---------+-----------+-------------+\n");
+    if (out->level >= OUTPUT_SUMMARY) printf("\n=== HOI QUY LOGARIT ===\n");
+    if (out->level == OUTPUT_TABLE) {
+        const char *border = "+-------+--------+--------+---------+-----------+-------------+";
+        printf("%s\n", border);
+        printf("| %-5s | %-6s | %-6s | %-7s | %-9s | %-11s |\n", 
+               "STT", "x", "y", "ln(x)", "ln(x)^2", "ln(x)*y");
+        printf("%s\n", border);
+
+        int head = tableHeadRows(out, ds->size);
+        for (int i = 0; i < ds->size; i = nextTableRow(i, head, ds->size)) {
+            if (i >= head) printSkippedRows(border, i - head);
+            double lnx = log(ds->x[i]);
+
+            printf("| %-5d | %-6.2lf | %-6.2lf | %-7.3lf | %-9.3lf | %-11.3lf |\n",
+                  i+1, ds->x[i], ds->y[i], lnx, lnx * lnx, lnx * ds->y[i]);
+            logPrintf(logSink, "x[%d]=%.2lf ln(x)=%.3lf y=%.2lf ln(x)^2=%.3lf ln(x)*y=%.3lf\n",
+                      i, ds->x[i], lnx, ds->y[i], lnx * lnx, lnx * ds->y[i]);
+        }
+        printf("%s\n", border);
+    }
     
-    double denom = ds->size * sum_lnx2 - sum_lnx * sum_lnx;
-    double a = safeDiv(sum_y * sum_lnx2 - sum_lnx * sum_lnx_y, denom);
-    double b = safeDiv(ds->size * sum_lnx_y - sum_lnx * sum_y, denom);
+    DatasetView view = datasetView(ds);
+    double coeff[2], r2;
+    int status = fitLog(&view, ws, coeff, &r2);
+    if (status != FIT_OK) {
+        printf("Loi: %s\n", status == FIT_ERR_NO_MEMORY ? "Khong du bo nho!" : fitStatusName(status));
+        wsReset(ws);
+        return;
+    }
+    double a = coeff[0], b = coeff[1];
     
-    printf("\nPhuong trinh hoi quy:\n");
-    printf("y = %.6lf + %.6lf * ln(x)\n", a, b);
-    fprintf(logFile, "\n[Logarit] y = %.6lf + %.6lf * ln(x)\n", a, b);
-
-    double coeff[2] = {a, b};
-    double r2 = calculateR2(ds, logModel, coeff, 1);
-    printf("He so xac dinh R^2: %.6lf\n", r2);
-    fprintf(logFile, "[Logarit] R^2 = %.6lf\n\n", r2);
+    if (out->level >= OUTPUT_SUMMARY) {
+        printf("\nPhuong trinh hoi quy:\n");
+        printf("y = %.6lf + %.6lf * ln(x)\n", a, b);
+        printf("He so xac dinh R^2: %.6lf\n", r2);
+    }
+    logPrintf(logSink, "\n[Logarit] y = %.6lf + %.6lf * ln(x)\n", a, b);
+    logPrintf(logSink, "[Logarit] R^2 = %.6lf\n\n", r2);
 }
 
-void exponentialRegression(Dataset *ds, FILE *logFile) {
+void exponentialRegression(Dataset *ds, FitWorkspace *ws, const OutputOptions *out, LogSink *logSink) {
     if (ds->size < 2) {
         printf("Can it nhat 2 diem de hoi quy ham mu!\n");
         return;
@@ -218,197 +159,262 @@ void exponentialRegression(Dataset *ds, FILE *logFile) {
         }
     }
 
-    double sum_x = 0, sum_lny = 0, sum_x2 = 0, sum_x_lny = 0;
-    
-    printf("\n=== HOI QUY HAM MU ===\n");
-    printf("+-------+--------+--------+---------+-----------+\n");
-    printf("| %-5s | %-6s | %-6s | %-7s | %-9s |\n", 
-           "STT", "x", "y", "ln(y)", "x*ln(y)");
-    printf("+-------+--------+--------+---------+-----------+\n");
-    
-    for (int i = 0; i < ds->size; i++) {
-        double lny = log(ds->y[i]);
-        sum_x += ds->x[i];
-        sum_lny += lny;
-        sum_x2 += ds->x[i] * ds->x[i];
-        sum_x_lny += ds->x[i] * lny;
-        
-        printf("| %-5d | %-6.2lf | %-6.2lf | %-7.3lf | %-9.3lf |\n", 
-              i+1, ds->x[i], ds->y[i], lny, ds->x[i]*lny);
-        fprintf(logFile, "x[%d]=%.2lf y=%.2lf ln(y)=%.3lf x*ln(y)=%.3lf\n", 
-               i, ds->x[i], ds->y[i], lny, ds->x[i]*lny);
-    }
-    printf("+-------+--------+--------+---------+-----------+\n");
+    if (out->level >= OUTPUT_SUMMARY) printf("\n=== HOI QUY HAM MU ===\n");
+    if (out->level == OUTPUT_TABLE) {
+        const char *border = "+-------+--------+--------+---------+-----------+";
+        printf("%s\n", border);
+        printf("| %-5s | %-6s | %-6s | %-7s | %-9s |\n", 
+               "STT", "x", "y", "ln(y)", "x*ln(y)");
+        printf("%s\n", border);
+
+        int head = tableHeadRows(out, ds->size);
+        for (int i = 0; i < ds->size; i = nextTableRow(i, head, ds->size)) {
+            if (i >= head) printSkippedRows(border, i - head);
+            double lny = log(ds->y[i]);
+
+            printf("| %-5d | %-6.2lf | %-6.2lf | %-7.3lf | %-9.3lf |\n", 
+                  i+1, ds->x[i], ds->y[i], lny, ds->x[i]*lny);
+            logPrintf(logSink, "x[%d]=%.2lf y=%.2lf ln(y)=%.3lf x*ln(y)=%.3lf\n", 
+                      i, ds->x[i], ds->y[i], lny, ds->x[i]*lny);
+        }
+        printf("%s\n", border);
+    }
     
-    double denom = ds->size * sum_x2 - sum_x * sum_x;
-    double A = safeDiv(sum_lny * sum_x2 - sum_x * sum_x_lny, denom);
-    double B = safeDiv(ds->size * sum_x_lny - sum_x * sum_lny, denom);
-    double a = exp(A), b = B;
+    DatasetView view = datasetView(ds);
+    double coeff[2], r2;
+    int status = fitExponential(&view, ws, coeff, &r2);
+    if (status != FIT_OK) {
+        printf("Loi: %s\n", status == FIT_ERR_NO_MEMORY ? "Khong du bo nho!" : fitStatusName(status));
+        wsReset(ws);
+        return;
+    }
+    double a = coeff[0], b = coeff[1];
     
-    printf("\nPhuong trinh hoi quy:\n");
-    printf("y = %.6lf * e^(%.6lf * x)\n", a, b);
-    fprintf(logFile, "\n[Ham mu] y = %.6lf * e^(%.6lf * x)\n", a, b);
-
-    double coeff[2] = {a, b};
-    double r2 = calculateR2(ds, expModel, coeff, 1);
-    printf("He so xac dinh R^2: %.6lf\n", r2);
-    fprintf(logFile, "[Ham mu] R^2 = %.6lf\n\n", r2);
+    if (out->level >= OUTPUT_SUMMARY) {
+        printf("\nPhuong trinh hoi quy:\n");
+        printf("y = %.6lf * e^(%.6lf * x)\n", a, b);
+        printf("He so xac dinh R^2: %.6lf\n", r2);
+    }
+    logPrintf(logSink, "\n[Ham mu] y = %.6lf * e^(%.6lf * x)\n", a, b);
+    logPrintf(logSink, "[Ham mu] R^2 = %.6lf\n\n", r2);
 }
 
-void quadraticRegression(Dataset *ds, FILE *logFile) {
+void quadraticRegression(Dataset *ds, FitWorkspace *ws, const OutputOptions *out, LogSink *logSink) {
     if (ds->size < 3) {
         printf("Can it nhat 3 diem de hoi quy bac hai!\n");
         return;
     }
 
-    double sx = 0, sx2 = 0, sx3 = 0, sx4 = 0, sy = 0, sxy = 0, sx2y = 0;
-    
-    printf("\n=== HOI QUY BAC HAI ===\n");
-    printf("+-------+--------+--------+--------+--------+--------+--------+---------+\n");
-    printf("| %-5s | %-6s | %-6s | %-6s | %-6s | %-6s | %-6s | %-7s |\n", 
-           "STT", "x", "y", "x^2", "x^3", "x^4", "x*y", "x^2*y");
-    printf("+-------+--------+--------+--------+--------+--------+--------+---------+\n");
-    
-    for (int i = 0; i < ds->size; i++) {
-        double xi = ds->x[i], yi = ds->y[i];
-        double xi2 = xi * xi, xi3 = xi2 * xi, xi4 = xi2 * xi2;
-        sx += xi; sx2 += xi2; sx3 += xi3; sx4 += xi4;
-        sy += yi; sxy += xi * yi; sx2y += xi2 * yi;
-        
-        printf("| %-5d | %-6.2lf | %-6.2lf | %-6.2lf | %-6.2lf | %-6.2lf | %-6.2lf | %-7.2lf |\n",
-              i+1, xi, yi, xi2, xi3, xi4, xi * yi, xi2 * yi);
-        fprintf(logFile, "x=%.2lf y=%.2lf x^2=%.2lf x^3=%.2lf x^4=%.2lf x*y=%.2lf x^2*y=%.2lf\n",
-               xi, yi, xi2, xi3, xi4, xi * yi, xi2 * yi);
-    }
-    printf("+-------+--------+--------+--------+--------+--------+--------+---------+\n");
-    
-    // Giải hệ phương trình
-    double A[3][4] = {
-        {(double)ds->size, sx, sx2, sy},
-        {sx, sx2, sx3, sxy},
-        {sx2, sx3, sx4, sx2y}
-    };
-    
-    // Phương pháp khử Gauss
-    for (int k = 0; k < 2; k++) {
-        for (int i = k+1; i < 3; i++) {
-            double factor = A[i][k] / A[k][k];
-            for (int j = k; j < 4; j++) {
-                A[i][j] -= factor * A[k][j];
-            }
+    if (out->level >= OUTPUT_SUMMARY) printf("\n=== HOI QUY BAC HAI ===\n");
+    if (out->level == OUTPUT_TABLE) {
+        const char *border = "+-------+--------+--------+--------+--------+--------+--------+---------+";
+        printf("%s\n", border);
+        printf("| %-5s | %-6s | %-6s | %-6s | %-6s | %-6s | %-6s | %-7s |\n", 
+               "STT", "x", "y", "x^2", "x^3", "x^4", "x*y", "x^2*y");
+        printf("%s\n", border);
+
+        int head = tableHeadRows(out, ds->size);
+        for (int i = 0; i < ds->size; i = nextTableRow(i, head, ds->size)) {
+            if (i >= head) printSkippedRows(border, i - head);
+            double xi = ds->x[i], yi = ds->y[i];
+            double xi2 = xi * xi, xi3 = xi2 * xi, xi4 = xi2 * xi2;
+
+            printf("| %-5d | %-6.2lf | %-6.2lf | %-6.2lf | %-6.2lf | %-6.2lf | %-6.2lf | %-7.2lf |\n",
+                  i+1, xi, yi, xi2, xi3, xi4, xi * yi, xi2 * yi);
+            logPrintf(logSink, "x=%.2lf y=%.2lf x^2=%.2lf x^3=%.2lf x^4=%.2lf x*y=%.2lf x^2*y=%.2lf\n",
+                      xi, yi, xi2, xi3, xi4, xi * yi, xi2 * yi);
         }
+        printf("%s\n", border);
     }
     
-    // Thế ngược
-    double c = A[2][3] / A[2][2];
-    double b = (A[1][3] - A[1][2]*c) / A[1][1];
-    double a = (A[0][3] - A[0][2]*c - A[0][1]*b) / A[0][0];
+    DatasetView view = datasetView(ds);
+    double coeff[3], r2 = NAN;
+    int status = fitQuadratic(&view, ws, coeff, &r2);
+    if (status != FIT_OK) {
+        printf("Loi: %s\n", status == FIT_ERR_NO_MEMORY ? "Khong du bo nho!" : fitStatusName(status));
+        wsReset(ws);
+        return;
+    }
+    double a = coeff[0], b = coeff[1], c = coeff[2];
     
-    printf("\nPhuong trinh hoi quy:\n");
-    printf("y = %.6lf + %.6lf * x + %.6lf * x^2\n", a, b, c);
-    fprintf(logFile, "\n[Bac hai] y = %.6lf + %.6lf * x + %.6lf * x^2\n", a, b, c);
-
-    double coeff[3] = {a, b, c};
-    double r2 = calculateR2(ds, quadraticModel, coeff, 2);
-    printf("He so xac dinh R^2: %.6lf\n", r2);
-    fprintf(logFile, "[Bac hai] R^2 = %.6lf\n\n", r2);
+    if (out->level >= OUTPUT_SUMMARY) {
+        printf("\nPhuong trinh hoi quy:\n");
+        printf("y = %.6lf + %.6lf * x + %.6lf * x^2\n", a, b, c);
+        printf("He so xac dinh R^2: %.6lf\n", r2);
+    }
+    logPrintf(logSink, "\n[Bac hai] y = %.6lf + %.6lf * x + %.6lf * x^2\n", a, b, c);
+    logPrintf(logSink, "[Bac hai] R^2 = %.6lf\n\n", r2);
 }
 
-void polyRegression(Dataset *ds, int degree, FILE *logFile) {
+// Bộ nhớ tạm (kể cả hệ số) lấy từ ws nên bậc chỉ bị giới hạn bởi bộ nhớ
+void polyRegression(Dataset *ds, int degree, FitWorkspace *ws,
+                    const OutputOptions *out, LogSink *logSink) {
     if (ds->size <= degree) {
         printf("So diem du lieu phai lon hon bac da thuc!\n");
         return;
     }
 
-    int n = degree + 1;
-    double X[2*degree+1], Y[degree+1];
-    double A[degree+1][degree+2];
-    
-    // Khởi tạo ma trận
-    memset(X, 0, sizeof(X));
-    memset(Y, 0, sizeof(Y));
-    
-    // Tính các tổng lũy thừa
-    for (int i = 0; i <= 2*degree; i++) {
-        for (int j = 0; j < ds->size; j++) {
-            X[i] += pow(ds->x[j], i);
+    DatasetView view = datasetView(ds);
+    double *coeff = (double*)wsAlloc(ws, (size_t)(degree + 2) * sizeof(double));
+    double r2 = NAN, cond = NAN;
+    int status = coeff ? fitPolySolver(&view, degree, SOLVER_NORMAL, ws, coeff, &r2, &cond)
+                       : FIT_ERR_NO_MEMORY;
+    if (status == FIT_ERR_NO_MEMORY) {
+        printf("Loi: Khong du bo nho!\n");
+        wsReset(ws);
+        return;
+    }
+
+    // Phương trình chuẩn tắc mất khoảng log10(cond^2) chữ số: giải lại bằng QR
+    if (status != FIT_OK || !(cond < POLY_COND_LIMIT)) {
+        if (out->level >= OUTPUT_SUMMARY) {
+            printf("Canh bao: phuong trinh chuan tac kem on dinh (so dieu kien ~ %.1e),"
+                   " giai lai bang QR\n", cond);
         }
+        fitPolySolver(&view, degree, SOLVER_QR_ORTHO, ws, coeff, &r2, &cond);
     }
     
-    for (int i = 0; i <= degree; i++) {
-        for (int j = 0; j < ds->size; j++) {
-            Y[i] += pow(ds->x[j], i) * ds->y[j];
+    if (out->level >= OUTPUT_SUMMARY) {
+        printf("\nPhuong trinh hoi quy da thuc bac %d:\n", degree);
+        printf("y = ");
+        for (int i = 0; i <= degree; i++) {
+            if (i == 0) {
+                printf("%.6lf", coeff[1]);
+            } else {
+                printf(" %+.6lfx^%d", coeff[i+1], i);
+            }
         }
+        printf("\n");
+        printf("He so xac dinh R^2: %.6lf\n", r2);
+        printf("So dieu kien (uoc luong): %.3e\n", cond);
     }
     
-    // Xây dựng ma trận hệ số
+    logPrintf(logSink, "\n[Da thuc bac %d] y = ", degree);
     for (int i = 0; i <= degree; i++) {
-        for (int j = 0; j <= degree; j++) {
-            A[i][j] = X[i+j];
-        }
-        A[i][degree+1] = Y[i];
+        logPrintf(logSink, "%+.6lfx^%d ", coeff[i+1], i);
     }
-    
-    // Giải hệ phương trình bằng phép khử Gauss
-    for (int k = 0; k <= degree; k++) {
-        // Tìm hàng có phần tử lớn nhất
-        int max_row = k;
-        for (int i = k+1; i <= degree; i++) {
-            if (fabs(A[i][k]) > fabs(A[max_row][k])) {
-                max_row = i;
-            }
-        }
-        
-        // Đổi hàng
-        if (max_row != k) {
-            for (int j = k; j <= degree+1; j++) {
-                double temp = A[k][j];
-                A[k][j] = A[max_row][j];
-                A[max_row][j] = temp;
-            }
-        }
-        
-        // Khử
-        for (int i = k+1; i <= degree; i++) {
-            double factor = A[i][k] / A[k][k];
-            for (int j = k; j <= degree+1; j++) {
-                A[i][j] -= factor * A[k][j];
+    logPrintf(logSink, "\n");
+    logPrintf(logSink, "[Da thuc bac %d] R^2 = %.6lf\n\n", degree, r2);
+    wsReset(ws);
+}
+
+// Phương trình của một kết quả khớp, dạng một dòng
+static void formatEquation(const FitResult *res, char *buf, size_t len) {
+    const double *c = res->coeff;
+    switch (res->model.kind) {
+        case MODEL_LINEAR: snprintf(buf, len, "y = %.6lf + %.6lf * x", c[0], c[1]); break;
+        case MODEL_LOG: snprintf(buf, len, "y = %.6lf + %.6lf * ln(x)", c[0], c[1]); break;
+        case MODEL_EXP: snprintf(buf, len, "y = %.6lf * e^(%.6lf * x)", c[0], c[1]); break;
+        default: {
+            const double *p = res->model.kind == MODEL_POLY ? c + 1 : c;
+            size_t used = (size_t)snprintf(buf, len, "y = %.6lf", p[0]);
+            for (int i = 1; i <= res->model.degree && used < len; i++) {
+                used += (size_t)snprintf(buf + used, len - used, " %+.6lfx^%d", p[i], i);
             }
         }
     }
-    
-    // Thế ngược
-    double coeff[degree+2];
-    coeff[0] = degree; // Lưu bậc đa thức
-    
-    for (int i = degree; i >= 0; i--) {
-        coeff[i+1] = A[i][degree+1];
-        for (int j = i+1; j <= degree; j++) {
-            coeff[i+1] -= A[i][j] * coeff[j+1];
-        }
-        coeff[i+1] /= A[i][i];
+}
+
+// Khớp mọi họ mô hình một lần và chọn mô hình tốt nhất theo criterion
+void autoRegression(Dataset *ds, int maxDegree, int criterion, FitWorkspace *ws,
+                    const OutputOptions *out, LogSink *logSink) {
+    DatasetView view = datasetView(ds);
+    int count = autoCandidateCount(maxDegree);
+    FitResult *results = (FitResult*)wsAlloc(ws, (size_t)count * sizeof(FitResult));
+    int best;
+    if (!results || fitAuto(&view, maxDegree, criterion, ws, results, &best) != FIT_OK) {
+        printf("Loi: Khong du bo nho!\n");
+        wsReset(ws);
+        return;
     }
-    
-    printf("\nPhuong trinh hoi quy da thuc bac %d:\n", degree);
-    printf("y = ");
-    for (int i = 0; i <= degree; i++) {
-        if (i == 0) {
-            printf("%.6lf", coeff[1]);
-        } else {
-            printf(" %+.6lfx^%d", coeff[i+1], i);
+    if (best < 0) {
+        printf("Khong co mo hinh nao khop duoc du lieu!\n");
+        wsReset(ws);
+        return;
+    }
+
+    if (out->level >= OUTPUT_SUMMARY) printf("\n=== TU DONG CHON MO HINH (%s) ===\n", criterionName(criterion));
+    if (out->level == OUTPUT_TABLE) {
+        const char *border = "+---+------------+----------------+------------+------------+--------------+--------------+";
+        printf("%s\n", border);
+        printf("|   | %-10s | %-14s | %-10s | %-10s | %-12s | %-12s |\n",
+               "Mo hinh", "Trang thai", "R^2", "R^2 hc", "AIC", "BIC");
+        printf("%s\n", border);
+        for (int i = 0; i < count; i++) {
+            const FitResult *res = &results[i];
+            char name[32];
+            formatModelSpec(&res->model, name, sizeof(name));
+            printf("| %c | %-10s | %-14s | %-10.6lf | %-10.6lf | %-12.4lf | %-12.4lf |\n",
+                   i == best ? '*' : ' ', name, fitStatusName(res->status),
+                   res->r2, res->adjR2, res->aic, res->bic);
         }
+        printf("%s\n", border);
     }
-    printf("\n");
-    
-    fprintf(logFile, "\n[Da thuc bac %d] y = ", degree);
-    for (int i = 0; i <= degree; i++) {
-        fprintf(logFile, "%+.6lfx^%d ", coeff[i+1], i);
+
+    const FitResult *res = &results[best];
+    char name[32], equation[1024];
+    formatModelSpec(&res->model, name, sizeof(name));
+    formatEquation(res, equation, sizeof(equation));
+    if (out->level >= OUTPUT_SUMMARY) {
+        printf("\nMo hinh tot nhat: %s\n", name);
+        printf("%s\n", equation);
+        printf("He so xac dinh R^2: %.6lf\n", res->r2);
+    }
+    logPrintf(logSink, "\n[Tu dong %s: %s] %s\n", criterionName(criterion), name, equation);
+    logPrintf(logSink, "[Tu dong %s: %s] R^2 = %.6lf\n\n", criterionName(criterion), name, res->r2);
+    wsReset(ws);
+}
+
+// Khớp bền vững (IRLS) một mô hình tuyến tính / bậc hai / đa thức
+void robustRegression(Dataset *ds, const ModelSpec *spec, int loss, FitWorkspace *ws,
+                      const OutputOptions *out, LogSink *logSink) {
+    DatasetView view = datasetView(ds);
+    FitResult res;
+    RobustInfo info;
+    int status = fitRobust(&view, spec, loss, ws, &res, &info);
+    if (status != FIT_OK) {
+        printf("Loi: %s\n", status == FIT_ERR_NO_MEMORY ? "Khong du bo nho!" : fitStatusName(status));
+        wsReset(ws);
+        return;
     }
-    fprintf(logFile, "\n");
 
-    double r2 = calculateR2(ds, polyModel, coeff, degree);
-    printf("He so xac dinh R^2: %.6lf\n", r2);
-    fprintf(logFile, "[Da thuc bac %d] R^2 = %.6lf\n\n", degree, r2);
+    char name[32], equation[1024];
+    formatModelSpec(spec, name, sizeof(name));
+    formatEquation(&res, equation, sizeof(equation));
+    if (out->level >= OUTPUT_SUMMARY) {
+        printf("\n=== HOI QUY BEN VUNG (%s, %s) ===\n", name, robustName(loss));
+        printf("%s\n", equation);
+        printf("He so xac dinh R^2 (co trong so): %.6lf\n", res.r2);
+        printf("So vong lap: %d, thang do phan du: %.6lf, so diem bi giam trong so: %d\n",
+               info.iterations, info.scale, info.downweighted);
+    }
+    logPrintf(logSink, "\n[Ben vung %s: %s] %s\n", robustName(loss), name, equation);
+    logPrintf(logSink, "[Ben vung %s: %s] R^2 = %.6lf, %d vong lap\n\n", robustName(loss), name,
+              res.r2, info.iterations);
+    wsReset(ws);
+}
+
+// Chọn mức hiển thị và số dòng tối đa của bảng
+void chooseOutputLevel(OutputOptions *out) {
+    printf("Muc hien thi (0: im lang, 1: tom tat, 2: bang tung diem): ");
+    int level;
+    if (scanf("%d", &level) != 1 || level < OUTPUT_SILENT || level > OUTPUT_TABLE) {
+        printf("Lua chon khong hop le!\n");
+        clearInputBuffer();
+        return;
+    }
+    if (level == OUTPUT_TABLE) {
+        printf("So dong toi da cua bang (0: khong gioi han): ");
+        int rows;
+        if (scanf("%d", &rows) != 1 || rows < 0) {
+            printf("So dong khong hop le!\n");
+            clearInputBuffer();
+            return;
+        }
+        out->maxRows = rows;
+    }
+    clearInputBuffer();
+    out->level = level;
 }
 
 // Hiển thị menu
@@ -422,6 +428,9 @@ void displayMainMenu() {
     printf("| 4. Hoi quy bac hai                 |\n");
     printf("| 5. Hoi quy da thuc bac n           |\n");
     printf("| 6. Xem lai du lieu nhap            |\n");
+    printf("| 7. Che do hien thi                 |\n");
+    printf("| 8. Tu dong chon mo hinh            |\n");
+    printf("| 9. Hoi quy ben vung (Huber/Tukey)  |\n");
     printf("| 0. Thoat                           |\n");
     printf("+-------------------------------------+\n");
     printf("Lua chon cua ban: ");
@@ -463,12 +472,12 @@ void displayInputData(Dataset *ds) {
     printf("| %-5s | %-10s | %-10s |\n", "STT", "x", "y");
     printf("+-------+------------+------------+\n");
     
-    int displayLimit = ds->size > 20 ? 20 : ds->size;
+    int displayLimit = ds->size > TABLE_ROWS_DEFAULT ? TABLE_ROWS_DEFAULT : ds->size;
     for (int i = 0; i < displayLimit; i++) {
         printf("| %-5d | %-10.2lf | %-10.2lf |\n", i+1, ds->x[i], ds->y[i]);
     }
     
-    if (ds->size > 20) {
+    if (ds->size > TABLE_ROWS_DEFAULT) {
         printf("| %-5s | %-10s | %-10s |\n", "...", "...", "...");
         printf("| %-5d | %-10.2lf | %-10.2lf |\n", ds->size, ds->x[ds->size-1], ds->y[ds->size-1]);
     }
@@ -476,10 +485,893 @@ void displayInputData(Dataset *ds) {
     printf("Tong cong: %d diem du lieu\n", ds->size);
 }
 
-int main() {
+// ===== Chế độ dòng lệnh (không menu) =====
+
+// Chuyển file văn bản sang định dạng nhị phân
+// (loadFlags có LOAD_WEIGHTS: cột thứ ba là trọng số, được ghi vào file nhị phân)
+int convertTextToBinary(const char *textPath, const char *binaryPath, int loadFlags) {
+    Dataset ds;
+    initDataset(&ds);
+    LoadReport report;
+    int err = (loadFlags & LOAD_FEATURES) ? loadFeatureFile(textPath, &ds, &report, loadFlags)
+                                          : loadTextFile(textPath, &ds, &report, loadFlags);
+    if (err != LOAD_OK) {
+        fprintf(stderr, "Loi doc file %s: %s\n", textPath,
+                err == LOAD_ERR_OPEN ? strerror(errno) : loadErrorName(err));
+        freeDataset(&ds);
+        return 1;
+    }
+    printLoadReport(stderr, textPath, &report);
+    int rc = 0;
+    if (saveBinaryFile(binaryPath, &ds) != 0) {
+        fprintf(stderr, "Loi ghi file %s: %s\n", binaryPath, strerror(errno));
+        rc = 1;
+    } else {
+        fprintf(stderr, "Da ghi %d diem vao %s\n", ds.size, binaryPath);
+    }
+    freeDataset(&ds);
+    return rc;
+}
+
+// Ghi một dòng kết quả (phân cách bằng tab); series khác NULL thì cột file là "file:series"
+// cond: ước lượng số điều kiện (chỉ có với đa thức và multi, còn lại NAN)
+void writeFitResult(FILE *out, const char *filename, const char *series, const ModelSpec *m,
+                    int status, long long n, const double coeff[], double r2, double cond) {
+    TRACE_BEGIN(t);
+    char name[32];
+    formatModelSpec(m, name, sizeof(name));
+    fprintf(out, "%s%s%s\t%s\t%s\t%lld", filename, series ? ":" : "", series ? series : "",
+            name, fitStatusName(status), n);
+    if (status != FIT_OK) {
+        fprintf(out, "\n");
+        TRACE_END(t, TRACE_OUTPUT, 1);
+        return;
+    }
+    fprintf(out, "\t%.17g\t%.3e", r2, cond);
+    for (int i = m->kind == MODEL_POLY ? 1 : 0; i < coeffCount(m); i++) {
+        fprintf(out, "\t%.17g", coeff[i]);
+    }
+    fprintf(out, "\n");
+    TRACE_END(t, TRACE_OUTPUT, 1);
+}
+
+// Tùy chọn của chế độ dòng lệnh dùng chung cho mọi file
+typedef struct {
+    ModelSpec models[MAX_MODELS];
+    int modelCount;
+    int solver;
+    int autoDegree;         // > 0: tự chọn mô hình, đa thức tới bậc này
+    int criterion;
+    int robust;             // ROBUST_*: chỉ áp dụng cho tuyến tính, bậc hai, đa thức
+    int loadFlags;          // LOAD_VERIFY | LOAD_WEIGHTS | LOAD_FEATURES
+    int server;             // >= 0: kết nối tới máy chủ (--connect), file được khớp ở đó
+    FitCache *cache;        // NULL: không dùng bộ nhớ đệm (auto và IRLS luôn khớp lại)
+    size_t chunkBytes;      // > 0: đọc file theo khối với chừng này bộ nhớ đệm
+    int cvFolds;            // > 0: chọn bậc đa thức bằng kiểm định chéo chừng này fold
+    int cvDegree;           // bậc cao nhất thử khi kiểm định chéo
+    int bootstrap;          // > 0: số mẫu bootstrap cho khoảng tin cậy
+    double level;           // mức tin cậy của bootstrap
+} BatchOptions;
+
+// Hai dòng khoảng tin cậy bootstrap cùng bố cục với dòng kết quả: cột trạng thái
+// là phân vị (q0.025, q0.975 với mức 0.95), cột n là số mẫu khớp được
+static void writeBootstrapRows(FILE *out, const char *filename, const BootstrapInterval *ci) {
+    char name[32];
+    formatModelSpec(&ci->model, name, sizeof(name));
+    double alpha = (1.0 - ci->level) / 2;
+    for (int side = 0; side < 2; side++) {
+        const double *bound = side == 0 ? ci->lo : ci->hi;
+        fprintf(out, "%s\t%s\tq%g\t%d\t%.17g\tnan", filename, name, side == 0 ? alpha : 1.0 - alpha,
+                ci->resamples, side == 0 ? ci->r2Lo : ci->r2Hi);
+        for (int i = ci->model.kind == MODEL_POLY ? 1 : 0; i < coeffCount(&ci->model); i++) {
+            fprintf(out, "\t%.17g", bound[i]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+static int robustApplies(const ModelSpec *m) {
+    return m->kind != MODEL_LOG && m->kind != MODEL_EXP;
+}
+
+// Tự chọn mô hình: chỉ ghi dòng của mô hình tốt nhất theo criterion
+// (không có mô hình nào khớp được thì ghi trạng thái của hồi quy tuyến tính).
+// fitAuto xếp hạng đa thức bằng phương trình chuẩn tắc; với solver QR, đa thức
+// thắng được khớp lại bằng QR để lấy hệ số chính xác.
+static int writeAutoResult(const char *filename, const DatasetView *view, int autoDegree,
+                           int criterion, int solver, FitWorkspace *ws, FILE *out) {
+    int count = autoCandidateCount(autoDegree);
+    FitResult *results = (FitResult*)wsAlloc(ws, (size_t)count * sizeof(FitResult));
+    int best;
+    if (!results || fitAuto(view, autoDegree, criterion, ws, results, &best) != FIT_OK) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return -1;
+    }
+    FitResult *res = &results[best >= 0 ? best : 0];
+    int isPoly = res->model.kind == MODEL_QUADRATIC || res->model.kind == MODEL_POLY;
+    if (best >= 0 && isPoly && solver != SOLVER_NORMAL) {
+        ModelSpec spec = res->model;
+        fitModel(view, &spec, solver, ws, res);
+    }
+    writeFitResult(out, filename, NULL, &res->model, res->status, res->n, res->coeff, res->r2, res->cond);
+    return 0;
+}
+
+// Chọn bậc đa thức bằng kiểm định chéo: bảng MSE theo bậc ra stderr, chỉ ghi
+// dòng kết quả của bậc tốt nhất (khớp lại trên toàn bộ dữ liệu bằng solver)
+static int writeCvResult(const char *filename, const DatasetView *view, int folds, int maxDegree,
+                         int solver, FitWorkspace *ws, FILE *out) {
+    CvScore *scores = (CvScore*)wsAlloc(ws, (size_t)maxDegree * sizeof(CvScore));
+    int best = 0;
+    int status = scores ? crossValidatePoly(view, folds, maxDegree, ws, scores, &best) : FIT_ERR_NO_MEMORY;
+    if (status == FIT_ERR_NO_MEMORY) {
+        fprintf(stderr, "Loi: Khong du bo nho!\n");
+        return -1;
+    }
+    if (status == FIT_OK) {
+        fprintf(stderr, "%s: kiem dinh cheo %d fold\n", filename, folds);
+        for (int d = 1; d <= maxDegree; d++) {
+            const CvScore *sc = &scores[d - 1];
+            fprintf(stderr, "  bac %2d  mse = %.6e  (+/- %.2e)  %s%s\n", d, sc->mse, sc->mseStdErr,
+                    fitStatusName(sc->status), d == best ? "  <- tot nhat" : "");
+        }
+    }
+    ModelSpec spec = {MODEL_POLY, best > 0 ? best : 1};
+    FitResult res;
+    if (best > 0) {
+        fitModel(view, &spec, solver, ws, &res);
+    } else {
+        res.status = status;
+        res.n = view->size;
+    }
+    writeFitResult(out, filename, NULL, &spec, res.status, res.n, res.coeff, res.r2, res.cond);
+    return 0;
+}
+
+// Khớp file trên máy chủ (--connect): máy chủ tự đọc file theo đường dẫn tuyệt
+// đối và giữ dataset lại cho các lần gọi sau
+static int processRemoteFile(const char *filename, const BatchOptions *opt, FitWorkspace *ws,
+                             FILE *out) {
+    char path[SERVER_MAX_PATH + 1];
+#ifdef _WIN32
+    if (!_fullpath(path, filename, sizeof(path))) snprintf(path, sizeof(path), "%s", filename);
+#else
+    if (!realpath(filename, path)) snprintf(path, sizeof(path), "%s", filename);
+#endif
+    FitResult results[MAX_MODELS];
+    int loadError;
+    int status = serverFitFile(opt->server, path, opt->loadFlags, opt->solver, opt->models,
+                               opt->modelCount, ws, results, &loadError);
+    if (status != SERVER_OK) {
+        fprintf(out, "%s\t-\tload_error\t0\n", filename);
+        fprintf(stderr, "Loi khop file %s tren may chu: %s\n", filename,
+                status == SERVER_ERR_LOAD ? loadErrorName(loadError) : serverStatusName(status));
+        wsReset(ws);
+        return -1;
+    }
+    for (int i = 0; i < opt->modelCount; i++) {
+        const FitResult *res = &results[i];
+        writeFitResult(out, filename, NULL, &res->model, res->status, res->n, res->coeff, res->r2, res->cond);
+    }
+    wsReset(ws);
+    return 0;
+}
+
+// Khớp file theo khối, không nạp toàn bộ dữ liệu (--chunk-mb)
+static int processChunkedFile(const char *filename, const BatchOptions *opt, FitWorkspace *ws,
+                              FILE *out) {
+    FitResult results[MAX_MODELS];
+    LoadReport report;
+    int err = fitFileChunked(filename, opt->loadFlags, opt->chunkBytes, opt->models, opt->modelCount,
+                             ws, results, &report);
+    if (err != LOAD_OK) {
+        fprintf(out, "%s\t-\tload_error\t0\n", filename);
+        fprintf(stderr, "Loi doc file %s: %s\n", filename,
+                err == LOAD_ERR_OPEN ? strerror(errno) : loadErrorName(err));
+        wsReset(ws);
+        return -1;
+    }
+    printLoadReport(stderr, filename, &report);
+    for (int i = 0; i < opt->modelCount; i++) {
+        const FitResult *res = &results[i];
+        writeFitResult(out, filename, NULL, &res->model, res->status, res->n, res->coeff, res->r2, res->cond);
+    }
+    wsReset(ws);
+    return 0;
+}
+
+// Đọc một file dữ liệu và khớp tất cả mô hình; trả về 0 nếu đọc được file.
+// opt->autoDegree > 0: bỏ qua opt->models và tự chọn mô hình.
+// Với opt->cache, file chưa đổi mà mọi mô hình đã có kết quả thì không đọc lại file.
+// Bộ nhớ tạm lấy từ ws và được trả lại sau mỗi file, nên khớp nhiều file liên
+// tiếp chỉ cấp phát heap ở vài file đầu.
+int processBatchFile(const char *filename, Dataset *ds, const BatchOptions *opt,
+                     FitWorkspace *ws, FILE *out) {
+    if (opt->server >= 0) return processRemoteFile(filename, opt, ws, out);
+    if (opt->chunkBytes > 0) return processChunkedFile(filename, opt, ws, out);
+
+    // Mô hình bền vững khớp riêng bằng IRLS, các mô hình còn lại chung một lượt
+    FitResult results[MAX_MODELS], plainResults[MAX_MODELS];
+    ModelSpec plain[MAX_MODELS];
+    int plainIndex[MAX_MODELS], plainCount = 0;
+    for (int i = 0; i < opt->modelCount; i++) {
+        if (opt->robust == ROBUST_NONE || !robustApplies(&opt->models[i])) {
+            plain[plainCount] = opt->models[i];
+            plainIndex[plainCount++] = i;
+        }
+    }
+    FitCache *cache = opt->autoDegree > 0 ? NULL : opt->cache;
+    uint64_t fp;
+    int n;
+    int cached = cache && plainCount == opt->modelCount &&
+                 cacheFileFingerprint(cache, filename, opt->loadFlags, &fp, &n) &&
+                 lookupFitCache(cache, fp, n, plain, plainCount, opt->solver, ws, results);
+    if (!cached) {
+        LoadReport report;
+        int err = loadDatasetFile(filename, ds, &report, opt->loadFlags | (cache ? LOAD_FINGERPRINT : 0));
+        if (err != LOAD_OK) {
+            fprintf(out, "%s\t-\tload_error\t0\n", filename);
+            fprintf(stderr, "Loi doc file %s: %s\n", filename,
+                    err == LOAD_ERR_OPEN ? strerror(errno) : loadErrorName(err));
+            return -1;
+        }
+        printLoadReport(stderr, filename, &report);
+
+        DatasetView view = datasetView(ds);
+        if (opt->autoDegree > 0) {
+            int rc = writeAutoResult(filename, &view, opt->autoDegree, opt->criterion, opt->solver, ws, out);
+            wsReset(ws);
+            return rc;
+        }
+        if (opt->cvFolds > 0) {
+            int rc = writeCvResult(filename, &view, opt->cvFolds, opt->cvDegree, opt->solver, ws, out);
+            wsReset(ws);
+            return rc;
+        }
+
+        for (int i = 0; i < opt->modelCount; i++) {
+            if (opt->robust != ROBUST_NONE && robustApplies(&opt->models[i])) {
+                fitRobust(&view, &opt->models[i], opt->robust, ws, &results[i], NULL);
+            }
+        }
+        if (cache) cacheRememberFile(cache, filename, opt->loadFlags, report.fingerprint, ds->size);
+        err = FIT_OK;
+        if (plainCount > 0 && cache) {
+            err = cachedFitModels(cache, report.fingerprint, &view, plain, plainCount, opt->solver,
+                                  ws, plainResults);
+        } else if (plainCount > 0) {
+            err = fitModels(&view, plain, plainCount, opt->solver, ws, plainResults);
+        }
+        if (err != FIT_OK) {
+            fprintf(stderr, "Loi: Khong du bo nho!\n");
+            wsReset(ws);
+            return -1;
+        }
+        for (int k = 0; k < plainCount; k++) results[plainIndex[k]] = plainResults[k];
+    }
+
+    BootstrapInterval intervals[MAX_MODELS];
+    int haveIntervals = 0;
+    if (opt->bootstrap > 0) {
+        DatasetView view = datasetView(ds);
+        double t0 = nowSeconds();
+        int status = bootstrapFit(&view, opt->models, opt->modelCount, opt->bootstrap, opt->level, 1,
+                                  ws, intervals);
+        if (status == FIT_ERR_NO_MEMORY) {
+            fprintf(stderr, "Loi: Khong du bo nho cho bootstrap!\n");
+        } else if (status == FIT_OK) {
+            haveIntervals = 1;
+            fprintf(stderr, "%s: bootstrap %d mau trong %.3lf s\n", filename, opt->bootstrap,
+                    nowSeconds() - t0);
+        }
+    }
+    for (int i = 0; i < opt->modelCount; i++) {
+        const FitResult *res = &results[i];
+        writeFitResult(out, filename, NULL, &res->model, res->status, res->n, res->coeff, res->r2, res->cond);
+        if (haveIntervals && res->status == FIT_OK) writeBootstrapRows(out, filename, &intervals[i]);
+    }
+    wsReset(ws);
+    return 0;
+}
+
+// Đọc file nhiều chuỗi "id x y" và khớp từng mô hình cho mọi chuỗi bằng fitSeriesBatch.
+// Các mảng kết quả lấy từ ws và được trả lại sau mỗi file.
+int processSeriesFile(const char *filename, SeriesSet *set, const ModelSpec models[],
+                      int modelCount, FitWorkspace *ws, FILE *out) {
+    LoadReport report;
+    int err = loadSeriesFile(filename, set, &report);
+    if (err != LOAD_OK) {
+        fprintf(out, "%s\t-\tload_error\t0\n", filename);
+        fprintf(stderr, "Loi doc file %s: %s\n", filename,
+                err == LOAD_ERR_OPEN ? strerror(errno) : loadErrorName(err));
+        return -1;
+    }
+    printLoadReport(stderr, filename, &report);
+
+    SeriesBatch batch = seriesBatch(set);
+    size_t count = (size_t)set->count;
+    double *coeff[MAX_MODELS], *r2[MAX_MODELS];
+    int *status[MAX_MODELS];
+    for (int i = 0; i < modelCount; i++) {
+        coeff[i] = (double*)wsAlloc(ws, count * (size_t)coeffCount(&models[i]) * sizeof(double));
+        r2[i] = (double*)wsAlloc(ws, count * sizeof(double));
+        status[i] = (int*)wsAlloc(ws, count * sizeof(int));
+        if (!coeff[i] || !r2[i] || !status[i]) {
+            fprintf(stderr, "Loi: Khong du bo nho!\n");
+            wsReset(ws);
+            return -1;
+        }
+        fitSeriesBatch(&batch, &models[i], coeff[i], r2[i], status[i]);
+    }
+
+    for (int s = 0; s < set->count; s++) {
+        int n = set->offsets[s + 1] - set->offsets[s];
+        for (int i = 0; i < modelCount; i++) {
+            int width = coeffCount(&models[i]);
+            writeFitResult(out, filename, seriesName(set, s), &models[i], status[i][s], n,
+                           coeff[i] + (size_t)s * width, r2[i][s], NAN);
+        }
+    }
+    wsReset(ws);
+    return 0;
+}
+
+// Đọc điểm liên tục từ stdin và cập nhật các mô hình trực tuyến;
+// in kết quả mỗi every điểm (0: chỉ in khi hết dữ liệu)
+// window > 0 hoặc decay > 0: chỉ khớp trên cửa sổ trượt / với hệ số quên
+int runStream(const ModelSpec models[], int modelCount, long every, int window, double decay,
+              double coeff[], FILE *out) {
+    WindowFit wf;
+    OnlineFit *of = &wf.fit;
+    int windowed = window > 0 || decay > 0;
+    int rc = windowed ? initWindowFit(&wf, models, modelCount, window, decay)
+                      : initOnlineFit(of, models, modelCount);
+    if (rc != 0) {
+        fprintf(stderr, windowed ? "Loi: Tham so cua so khong hop le hoac khong du bo nho!\n"
+                                 : "Loi: Khong du bo nho!\n");
+        return 1;
+    }
+
+    char line[4096];
+    long seen = 0, bad = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        double x, y;
+        int kind = parsePointLine(line, line + strcspn(line, "\n"), &x, &y);
+        if (kind < 0) {
+            bad++;
+            continue;
+        }
+        if (kind == 0) continue;
+
+        if (windowed) {
+            windowAddPoint(&wf, x, y);
+        } else {
+            onlineAddPoint(of, x, y);
+        }
+        if (every > 0 && ++seen % every == 0) {
+            for (int i = 0; i < modelCount; i++) {
+                double r2 = NAN;
+                int status = onlineQuery(of, i, coeff, &r2);
+                writeFitResult(out, "stdin", NULL, &models[i], status, of->m.count, coeff, r2, NAN);
+            }
+            fflush(out);
+        }
+    }
+
+    for (int i = 0; i < modelCount; i++) {
+        double r2 = NAN;
+        int status = onlineQuery(of, i, coeff, &r2);
+        writeFitResult(out, "stdin", NULL, &models[i], status, of->m.count, coeff, r2, NAN);
+    }
+    if (bad > 0) {
+        fprintf(stderr, "Canh bao: stdin: bo qua %ld dong khong hop le\n", bad);
+    }
+    if (windowed) {
+        freeWindowFit(&wf);
+    } else {
+        freeOnlineFit(of);
+    }
+    return 0;
+}
+
+void printUsage(const char *prog) {
+    printf("Cach dung:\n");
+    printf("  %s                        che do menu tuong tac\n", prog);
+    printf("  %s [tuy chon] file...     khop tat ca file, khong hoi dap\n\n", prog);
+    printf("Tuy chon:\n");
+    printf("  -m, --models DS     danh sach mo hinh phan cach boi dau phay:\n");
+    printf("                      linear,log,exp,quadratic,poly:N,multi (mac dinh: linear)\n");
+    printf("                      hoac auto[:K]: khop moi ho (da thuc bac 1..K, mac dinh K = %d)\n",
+           AUTO_DEFAULT_DEGREE);
+    printf("                      va chi ghi mo hinh tot nhat theo --criterion\n");
+    printf("      --criterion C   tieu chi cho auto: aic (mac dinh), bic, adjr2, r2\n");
+    printf("  -o, --output FILE   ghi ket qua ra FILE (mac dinh: stdout)\n");
+    printf("  -l, --list FILE     doc danh sach file du lieu tu FILE, moi dong mot file\n");
+    printf("                      ('-' de doc tu stdin)\n");
+    printf("  -s, --stream        doc diem lien tuc tu stdin, cap nhat mo hinh truc tuyen\n");
+    printf("                      (khong giu du lieu goc; R^2 ham mu tinh tren ln y)\n");
+    printf("      --every K       voi --stream: in ket qua sau moi K diem\n");
+    printf("      --window W      voi --stream: chi khop W diem gan nhat (cua so truot)\n");
+    printf("      --decay L       voi --stream: he so quen L trong (0, 1) cho moi diem moi\n");
+    printf("      --bench-window [N]     do so lan truot cua so moi giay\n");
+    printf("      --series        moi file gom nhieu chuoi \"id x y\" (cac dong lien nhau cung id);\n");
+    printf("                      khop tung chuoi, cot file ghi file:id\n");
+    printf("      --bench-series [N]     do toc do khop N chuoi ngan theo lo so voi tung chuoi\n");
+    printf("      --bench-predict [N]    do toc do du bao N diem: tung diem so voi predict()\n");
+    printf("      --verify        kiem tra checksum khi doc file nhi phan\n");
+    printf("      --weights       file van ban co cot thu ba la trong so w >= 0 (\"x y w\");\n");
+    printf("                      dat truoc -c de ghi trong so vao file nhi phan\n");
+    printf("      --features      file van ban nhieu dac trung \"x1 ... xp y\" (them w neu co\n");
+    printf("                      --weights); mo hinh multi khop y = c0 + c1*x1 + ... + cp*xp,\n");
+    printf("                      cac mo hinh mot bien dung cot x1\n");
+    printf("      --robust L      khop ben vung IRLS cho linear/quadratic/poly: huber, tukey\n");
+    printf("      --chunk-mb M    doc file theo khoi voi M MB bo nho dem (mac dinh %d), khong\n",
+           CHUNK_DEFAULT_MB);
+    printf("                      nap toan bo du lieu: cho file lon hon RAM (bo giai normal)\n");
+    printf("      --cv K          chon bac da thuc 1..D bang kiem dinh cheo K fold (bang MSE ra\n");
+    printf("                      stderr), chi ghi dong cua bac tot nhat\n");
+    printf("      --cv-degree D   bac cao nhat cho --cv (mac dinh %d)\n", AUTO_DEFAULT_DEGREE);
+    printf("      --bootstrap B   them khoang tin cay bootstrap (B mau Poisson, chay song song)\n");
+    printf("                      cho he so va R^2: hai dong q0.025 / q0.975 sau moi mo hinh\n");
+    printf("      --ci-level L    muc tin cay cho --bootstrap (mac dinh %.2f)\n", BOOTSTRAP_DEFAULT_LEVEL);
+    printf("      --cache FILE    luu ket qua va tong luy thua vao FILE; lan chay sau tra loi ngay\n");
+    printf("                      neu file du lieu chua doi (khong ap dung cho auto, --robust)\n");
+    printf("      --bench-cache [N]      do thoi gian khop N diem: lan dau, trung bo nho dem,\n");
+    printf("                      bac thap hon tu tong luy thua da luu\n");
+    printf("      --bench-suite [DS]     bo do tong hop tren du lieu sinh ngau nhien voi cac co\n");
+    printf("                      trong DS (mac dinh 1e3,1e4,1e5,1e6): doc file, tung mo hinh,\n");
+    printf("                      R^2, du bao; sai so so voi khop tham chieu long double\n");
+    printf("      --bench-json FILE      dat truoc --bench-suite: ghi them ket qua JSON vao FILE\n");
+    printf("      --generate N FILE      sinh N diem tong hop vao FILE (.bin: nhi phan) roi thoat;\n");
+    printf("                      chon truoc bang --family poly|log|exp (mac dinh poly),\n");
+    printf("                      --noise none|gauss|heavy|outliers (mac dinh gauss),\n");
+    printf("                      --xrange unit|offset|wide (mac dinh unit)\n");
+    printf("      --solver S      bo giai cho da thuc va multi: normal (mac dinh, nhanh nhat),\n");
+    printf("                      qr (Householder), qr-ortho (QR tren da thuc Chebyshev\n");
+    printf("                      cua x chuan hoa; on dinh nhat cho bac cao)\n");
+    printf("      --serve SOCKET  chay may chu khop tren Unix socket SOCKET (den Ctrl+C): nhan\n");
+    printf("                      diem noi tuyen hoac duong dan file, gop yeu cau nho thanh lo\n");
+    printf("      --resident-mb M bo nho cho dataset may chu giu lai (mac dinh %d)\n",
+           SERVER_RESIDENT_DEFAULT_MB);
+    printf("      --connect SOCKET       khop cac file tren may chu dang chay thay vi tai cho\n");
+    printf("      --bench-server [N]     do thong luong va do tre p50/p99 cua may chu voi N yeu cau\n");
+    printf("      --trace-json FILE      khi thoat ghi thoi gian tung giai doan (doc, phan tich,\n");
+    printf("                      cap phat, mo-men, giai, R^2, ghi ket qua) va bo dem ra FILE\n");
+    printf("      --trace FILE    khi thoat ghi tung khoang thoi gian dang Chrome trace ra FILE\n");
+    printf("                      (hai tuy chon tren can bien dich voi -DLSQ_TRACE)\n");
+    printf("  -c, --convert TXT BIN  chuyen file van ban TXT sang file nhi phan BIN roi thoat\n");
+    printf("  -t, --threads N     so luong tinh toan (mac dinh: so CPU, hoac bien PBL_THREADS)\n");
+    printf("      --bench-powersums [N]  do toc do tinh tong luy thua (bac 1..20, N diem)\n");
+    printf("      --bench-threads [N]    do toc do theo so luong tu 1 den so CPU\n");
+    printf("  -h, --help          hien thi huong dan nay\n\n");
+    printf("File du lieu co the la van ban (x y moi dong) hoac nhi phan (tao bang --convert);\n");
+    printf("file nhi phan duoc anh xa truc tiep vao bo nho, khong phai phan tich lai.\n\n");
+    printf("Moi dong ket qua: file, mo hinh, trang thai, so diem, R^2, so dieu kien\n");
+    printf("(chi voi da thuc va multi, con lai nan), cac he so\n");
+    printf("(da thuc: c0..cN theo bac tang dan; multi: c0, c1..cp;\n");
+    printf("ham mu: a, b voi y = a*e^(b*x)).\n");
+}
+
+#ifdef LSQ_TRACE
+#define TRACE_EVENTS (1 << 20)
+
+static const char *traceSummaryPath = NULL;
+static const char *traceEventsPath = NULL;
+
+static void writeTraceFile(const char *path, int (*write)(FILE*)) {
+    FILE *f = fopen(path, "w");
+    if (!f || write(f) != 0) fprintf(stderr, "Loi ghi file %s: %s\n", path, strerror(errno));
+    if (f) fclose(f);
+}
+
+// Đăng ký bằng atexit để ghi cả khi runBatch trả về từ các chế độ đo (--bench-*)
+static void writeTraceFiles(void) {
+    if (traceSummaryPath) writeTraceFile(traceSummaryPath, writeTraceSummary);
+    if (traceEventsPath) writeTraceFile(traceEventsPath, writeChromeTrace);
+}
+#endif
+
+// --trace-json / --trace: bắt đầu đo từ lúc gặp tùy chọn
+static int enableTrace(const char *arg, const char *path) {
+#ifdef LSQ_TRACE
+    int first = !traceSummaryPath && !traceEventsPath;
+    if (strcmp(arg, "--trace") == 0) traceEventsPath = path;
+    else traceSummaryPath = path;
+    if (traceStart(traceEventsPath ? TRACE_EVENTS : 0) != 0) {
+        fprintf(stderr, "Canh bao: khong du bo nho cho %s, chi ghi so lieu tong\n", arg);
+    }
+    if (first) atexit(writeTraceFiles);
+    return 0;
+#else
+    (void)path;
+    fprintf(stderr, "%s can bien dich voi -DLSQ_TRACE\n", arg);
+    return 1;
+#endif
+}
+
+int runBatch(int argc, char *argv[]) {
+    BatchOptions opt;
+    opt.modelCount = 1;
+    opt.models[0].kind = MODEL_LINEAR;
+    opt.models[0].degree = 1;
+    opt.solver = SOLVER_NORMAL;
+    opt.autoDegree = 0;
+    opt.criterion = CRITERION_AIC;
+    opt.robust = ROBUST_NONE;
+    opt.loadFlags = 0;
+    opt.server = -1;
+    opt.cache = NULL;
+    opt.chunkBytes = 0;
+    opt.cvFolds = 0;
+    opt.cvDegree = AUTO_DEFAULT_DEGREE;
+    opt.bootstrap = 0;
+    opt.level = BOOTSTRAP_DEFAULT_LEVEL;
+    ModelSpec *models = opt.models;
+    const char *outPath = NULL;
+    const char *cachePath = NULL;
+    const char *listPath = NULL;
+    const char *benchJson = NULL;
+    const char *servePath = NULL;
+    const char *connectPath = NULL;
+    ServerOptions serverOpt = {(size_t)SERVER_RESIDENT_DEFAULT_MB << 20, SERVER_DEFAULT_CLIENTS};
+    int genFamily = FAMILY_POLY, genNoise = NOISE_GAUSS, genRange = XRANGE_UNIT;
+    int series = 0;
+    int stream = 0;
+    long every = 0;
+    int window = 0;
+    double decay = 0;
+    int firstFile = argc;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else if ((strcmp(arg, "-m") == 0 || strcmp(arg, "--models") == 0) && i + 1 < argc) {
+            const char *spec = argv[++i];
+            if (strcmp(spec, "auto") == 0) {
+                opt.autoDegree = AUTO_DEFAULT_DEGREE;
+            } else if (strncmp(spec, "auto:", 5) == 0) {
+                opt.autoDegree = atoi(spec + 5);
+                if (opt.autoDegree < 1 || opt.autoDegree > MAX_POLY_DEGREE) {
+                    fprintf(stderr, "Danh sach mo hinh khong hop le: %s\n", spec);
+                    return 1;
+                }
+            } else {
+                opt.autoDegree = 0;
+                opt.modelCount = parseModelList(spec, models, MAX_MODELS);
+                if (opt.modelCount <= 0) {
+                    fprintf(stderr, "Danh sach mo hinh khong hop le: %s\n", spec);
+                    return 1;
+                }
+            }
+        } else if ((strcmp(arg, "-o") == 0 || strcmp(arg, "--output") == 0) && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if ((strcmp(arg, "-l") == 0 || strcmp(arg, "--list") == 0) && i + 1 < argc) {
+            listPath = argv[++i];
+        } else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(arg, "--every") == 0 && i + 1 < argc) {
+            every = atol(argv[++i]);
+        } else if (strcmp(arg, "--window") == 0 && i + 1 < argc) {
+            window = atoi(argv[++i]);
+            stream = 1;
+        } else if (strcmp(arg, "--decay") == 0 && i + 1 < argc) {
+            decay = atof(argv[++i]);
+            stream = 1;
+        } else if (strcmp(arg, "--bench-window") == 0) {
+            int n = i + 1 < argc ? atoi(argv[i+1]) : 0;
+            return benchWindow(n > 0 ? n : 10000000);
+        } else if (strcmp(arg, "--verify") == 0) {
+            opt.loadFlags |= LOAD_VERIFY;
+        } else if (strcmp(arg, "--weights") == 0) {
+            opt.loadFlags |= LOAD_WEIGHTS;
+        } else if (strcmp(arg, "--features") == 0) {
+            opt.loadFlags |= LOAD_FEATURES;
+        } else if (strcmp(arg, "--robust") == 0 && i + 1 < argc) {
+            opt.robust = parseRobust(argv[++i]);
+            if (opt.robust < 0) {
+                fprintf(stderr, "Ham mat mat khong hop le: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--series") == 0) {
+            series = 1;
+        } else if (strcmp(arg, "--bench-series") == 0) {
+            int n = i + 1 < argc ? atoi(argv[i+1]) : 0;
+            return benchSeries(n > 0 ? n : 500000);
+        } else if (strcmp(arg, "--criterion") == 0 && i + 1 < argc) {
+            opt.criterion = parseCriterion(argv[++i]);
+            if (opt.criterion < 0) {
+                fprintf(stderr, "Tieu chi khong hop le: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--bench-predict") == 0) {
+            int n = i + 1 < argc ? atoi(argv[i+1]) : 0;
+            return benchPredict(n > 0 ? n : 10000000);
+        } else if (strcmp(arg, "--chunk-mb") == 0 && i + 1 < argc) {
+            long mb = atol(argv[++i]);
+            if (mb < 1) {
+                fprintf(stderr, "Kich thuoc bo nho dem khong hop le: %s\n", argv[i]);
+                return 1;
+            }
+            opt.chunkBytes = (size_t)mb << 20;
+        } else if (strcmp(arg, "--cv") == 0 && i + 1 < argc) {
+            opt.cvFolds = atoi(argv[++i]);
+            if (opt.cvFolds < 2) {
+                fprintf(stderr, "So fold khong hop le: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--cv-degree") == 0 && i + 1 < argc) {
+            opt.cvDegree = atoi(argv[++i]);
+            if (opt.cvDegree < 1 || opt.cvDegree > MAX_POLY_DEGREE) {
+                fprintf(stderr, "Bac khong hop le: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--bootstrap") == 0 && i + 1 < argc) {
+            opt.bootstrap = atoi(argv[++i]);
+            if (opt.bootstrap < 1) {
+                fprintf(stderr, "So mau bootstrap khong hop le: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--ci-level") == 0 && i + 1 < argc) {
+            opt.level = atof(argv[++i]);
+            if (!(opt.level > 0 && opt.level < 1)) {
+                fprintf(stderr, "Muc tin cay khong hop le: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(arg, "--serve") == 0 && i + 1 < argc) {
+            servePath = argv[++i];
+        } else if (strcmp(arg, "--resident-mb") == 0 && i + 1 < argc) {
+            long mb = atol(argv[++i]);
+            if (mb < 0) {
+                fprintf(stderr, "Kich thuoc bo nho khong hop le: %s\n", argv[i]);
+                return 1;
+            }
+            serverOpt.residentBytes = (size_t)mb << 20;
+        } else if (strcmp(arg, "--connect") == 0 && i + 1 < argc) {
+            connectPath = argv[++i];
+        } else if (strcmp(arg, "--bench-server") == 0) {
+            int n = i + 1 < argc ? atoi(argv[i+1]) : 0;
+            return benchServer(n > 0 ? n : 200000);
+        } else if ((strcmp(arg, "--trace-json") == 0 || strcmp(arg, "--trace") == 0) && i + 1 < argc) {
+            if (enableTrace(arg, argv[++i]) != 0) return 1;
+        } else if (strcmp(arg, "--cache") == 0 && i + 1 < argc) {
+            cachePath = argv[++i];
+        } else if (strcmp(arg, "--bench-cache") == 0) {
+            int n = i + 1 < argc ? atoi(argv[i+1]) : 0;
+            return benchCache(n > 0 ? n : 10000000);
+        } else if (strcmp(arg, "--bench-json") == 0 && i + 1 < argc) {
+            benchJson = argv[++i];
+        } else if (strcmp(arg, "--bench-suite") == 0) {
+            const char *sizes = i + 1 < argc && argv[i+1][0] != '-' ? argv[i+1] : "1e3,1e4,1e5,1e6";
+            return benchSuite(sizes, benchJson);
+        } else if ((strcmp(arg, "--noise") == 0 || strcmp(arg, "--xrange") == 0 ||
+                    strcmp(arg, "--family") == 0) && i + 1 < argc) {
+            const char *name = argv[++i];
+            int value = arg[2] == 'n' ? parseNoise(name) : arg[2] == 'x' ? parseXRange(name)
+                                                                          : parseFamily(name);
+            if (value < 0) {
+                fprintf(stderr, "Gia tri khong hop le cho %s: %s\n", arg, name);
+                return 1;
+            }
+            if (arg[2] == 'n') genNoise = value;
+            else if (arg[2] == 'x') genRange = value;
+            else genFamily = value;
+        } else if (strcmp(arg, "--generate") == 0 && i + 2 < argc) {
+            int n = atoi(argv[i+1]);
+            if (n < 1) {
+                fprintf(stderr, "So diem khong hop le: %s\n", argv[i+1]);
+                return 1;
+            }
+            return generateFile(argv[i+2], n, genFamily, genNoise, genRange, 42);
+        } else if (strcmp(arg, "--solver") == 0 && i + 1 < argc) {
+            opt.solver = parseSolver(argv[++i]);
+            if (opt.solver < 0) {
+                fprintf(stderr, "Bo giai khong hop le: %s\n", argv[i]);
+                return 1;
+            }
+        } else if ((strcmp(arg, "-c") == 0 || strcmp(arg, "--convert") == 0) && i + 2 < argc) {
+            return convertTextToBinary(argv[i+1], argv[i+2], opt.loadFlags);
+        } else if ((strcmp(arg, "-t") == 0 || strcmp(arg, "--threads") == 0) && i + 1 < argc) {
+            setThreadCount(atoi(argv[++i]));
+        } else if (strcmp(arg, "--bench-threads") == 0) {
+            int n = i + 1 < argc ? atoi(argv[i+1]) : 0;
+            return benchThreads(n > 0 ? n : 10000000);
+        } else if (strcmp(arg, "--bench-powersums") == 0) {
+            int n = i + 1 < argc ? atoi(argv[i+1]) : 0;
+            return benchPowerSums(n > 0 ? n : 200000);
+        } else if (strcmp(arg, "--") == 0) {
+            firstFile = i + 1;
+            break;
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            fprintf(stderr, "Tuy chon khong hop le: %s\n", arg);
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            firstFile = i;
+            break;
+        }
+    }
+
+    if (opt.autoDegree > 0 && (stream || series)) {
+        fprintf(stderr, "Che do auto khong dung duoc voi --stream hoac --series.\n");
+        return 1;
+    }
+    if ((opt.robust != ROBUST_NONE || (opt.loadFlags & LOAD_WEIGHTS)) &&
+        (stream || series || opt.autoDegree > 0)) {
+        fprintf(stderr, "--robust va --weights khong dung duoc voi --stream, --series hoac auto.\n");
+        return 1;
+    }
+    if (opt.robust != ROBUST_NONE) {
+        for (int i = 0; i < opt.modelCount; i++) {
+            if (!robustApplies(&models[i])) {
+                fprintf(stderr, "Canh bao: --robust chi ap dung cho linear, quadratic, poly;"
+                                " log/exp khop binh phuong toi thieu\n");
+                break;
+            }
+        }
+    }
+    if (opt.chunkBytes > 0 && (stream || series || opt.autoDegree > 0 || cachePath ||
+                               opt.robust != ROBUST_NONE || (opt.loadFlags & LOAD_VERIFY) ||
+                               opt.solver != SOLVER_NORMAL)) {
+        fprintf(stderr, "--chunk-mb chi dung voi bo giai normal, khong dung duoc voi --stream,"
+                        " --series, auto, --cache, --robust hoac --verify.\n");
+        return 1;
+    }
+    if (opt.cvFolds > 0 && (stream || series || opt.autoDegree > 0 || cachePath || opt.chunkBytes > 0 ||
+                            opt.robust != ROBUST_NONE || opt.bootstrap > 0)) {
+        fprintf(stderr, "--cv khong dung duoc voi --stream, --series, auto, --cache, --chunk-mb,"
+                        " --robust hoac --bootstrap.\n");
+        return 1;
+    }
+    if (opt.bootstrap > 0 && (stream || series || opt.autoDegree > 0 || cachePath || opt.chunkBytes > 0 ||
+                              opt.robust != ROBUST_NONE || opt.solver != SOLVER_NORMAL)) {
+        fprintf(stderr, "--bootstrap chi dung voi bo giai normal, khong dung duoc voi --stream,"
+                        " --series, auto, --cache, --chunk-mb hoac --robust.\n");
+        return 1;
+    }
+    int hasMulti = 0;
+    for (int i = 0; i < opt.modelCount; i++) {
+        if (models[i].kind == MODEL_MULTI) hasMulti = 1;
+    }
+    if ((hasMulti || (opt.loadFlags & LOAD_FEATURES)) &&
+        (stream || series || opt.autoDegree > 0 || cachePath || opt.chunkBytes > 0 ||
+         opt.robust != ROBUST_NONE || opt.cvFolds > 0 || opt.bootstrap > 0)) {
+        fprintf(stderr, "multi va --features khong dung duoc voi --stream, --series, auto, --cache,"
+                        " --chunk-mb, --robust, --cv hoac --bootstrap.\n");
+        return 1;
+    }
+    if (cachePath && (stream || series)) {
+        fprintf(stderr, "--cache khong dung duoc voi --stream hoac --series.\n");
+        return 1;
+    }
+    if (connectPath && (stream || series || opt.autoDegree > 0 || cachePath || opt.chunkBytes > 0 ||
+                        opt.robust != ROBUST_NONE || opt.cvFolds > 0 || opt.bootstrap > 0)) {
+        fprintf(stderr, "--connect khong dung duoc voi --stream, --series, auto, --cache, --chunk-mb,"
+                        " --robust, --cv hoac --bootstrap.\n");
+        return 1;
+    }
+    if (servePath) return runServer(servePath, &serverOpt);
+    if (firstFile >= argc && !listPath && !stream) {
+        fprintf(stderr, "Chua chi dinh file du lieu nao.\n");
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (outPath) {
+        out = fopen(outPath, "w");
+        if (!out) {
+            fprintf(stderr, "Loi mo file ket qua %s: %s\n", outPath, strerror(errno));
+            return 1;
+        }
+    }
+    setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+    fprintf(out, "# file\tmodel\tstatus\tn\tr2\tcond\tcoefficients\n");
+    if (stream) {
+        int maxDegree = 2;
+        for (int i = 0; i < opt.modelCount; i++) {
+            if (models[i].degree > maxDegree) maxDegree = models[i].degree;
+        }
+        double *coeff = (double*)malloc((maxDegree + 2) * sizeof(double));
+        int rc = 1;
+        if (coeff) {
+            rc = runStream(models, opt.modelCount, every, window, decay, coeff, out);
+        } else {
+            fprintf(stderr, "Loi: Khong du bo nho!\n");
+        }
+        free(coeff);
+        if (out != stdout) fclose(out); else fflush(out);
+        return rc;
+    }
+
+    if (connectPath) {
+        opt.server = serverConnect(connectPath);
+        if (opt.server < 0) {
+            fprintf(stderr, "Loi ket noi may chu %s: %s\n", connectPath, strerror(errno));
+            if (out != stdout) fclose(out);
+            return 1;
+        }
+    }
+    if (cachePath) {
+        opt.cache = openFitCache(cachePath);
+        if (!opt.cache) {
+            fprintf(stderr, "Loi: Khong du bo nho!\n");
+            if (out != stdout) fclose(out);
+            return 1;
+        }
+    }
+
+    Dataset data;
+    initDataset(&data);
+    SeriesSet set;
+    initSeriesSet(&set);
+    FitWorkspace ws;
+    initWorkspace(&ws);
+    int failures = 0;
+
+    for (int i = firstFile; i < argc; i++) {
+        int rc = series ? processSeriesFile(argv[i], &set, models, opt.modelCount, &ws, out)
+                        : processBatchFile(argv[i], &data, &opt, &ws, out);
+        if (rc != 0) failures++;
+    }
+
+    if (listPath) {
+        FILE *list = strcmp(listPath, "-") == 0 ? stdin : fopen(listPath, "r");
+        if (!list) {
+            fprintf(stderr, "Loi mo danh sach %s: %s\n", listPath, strerror(errno));
+            failures++;
+        } else {
+            char line[4096];
+            while (fgets(line, sizeof(line), list)) {
+                size_t len = strcspn(line, "\r\n");
+                line[len] = '\0';
+                if (len == 0 || line[0] == '#') continue;
+                int rc = series ? processSeriesFile(line, &set, models, opt.modelCount, &ws, out)
+                                : processBatchFile(line, &data, &opt, &ws, out);
+                if (rc != 0) failures++;
+            }
+            if (list != stdin) fclose(list);
+        }
+    }
+
+    if (opt.cache) {
+        FitCacheStats stats;
+        fitCacheStats(opt.cache, &stats);
+        fprintf(stderr, "Bo nho dem: %lld ket qua co san, %lld giai tu tong luy thua, %lld khop lai\n",
+                stats.hits, stats.derived, stats.computed);
+        if (saveFitCache(opt.cache) != 0) {
+            fprintf(stderr, "Loi ghi bo nho dem %s: %s\n", cachePath, strerror(errno));
+            failures++;
+        }
+        closeFitCache(opt.cache);
+    }
+    serverClose(opt.server);
+    freeDataset(&data);
+    freeSeriesSet(&set);
+    freeWorkspace(&ws);
+    if (out != stdout) {
+        fclose(out);
+    } else {
+        fflush(out);
+    }
+    return failures ? 2 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        return runBatch(argc, argv);
+    }
+
     Dataset data;
     initDataset(&data);
-    FILE *logFile = fopen("regression_log.txt", "w");
+    FitWorkspace ws;
+    initWorkspace(&ws);
+    OutputOptions output = {OUTPUT_TABLE, TABLE_ROWS_DEFAULT};
+    LogSink *logSink = openLogSink("regression_log.txt");
+    if (!logSink) {
+        printf("Canh bao: khong mo duoc regression_log.txt, bo qua ghi log\n");
+    }
     
     displayInfoPanel();
 
@@ -511,7 +1403,10 @@ int main() {
                             i--; // Nhập lại điểm này
                             continue;
                         }
-                        addDataPoint(&data, x, y);
+                        if (addDataPoint(&data, x, y) != 0) {
+                            printf("Loi: Khong du bo nho!\n");
+                            break;
+                        }
                     }
                     break;
                 }
@@ -525,20 +1420,16 @@ int main() {
                     }
                     clearInputBuffer();
                     
-                    FILE *f = fopen(filename, "r");
-                    if (!f) {
+                    LoadReport report;
+                    int err = loadDatasetFile(filename, &data, &report, LOAD_VERIFY);
+                    if (err == LOAD_ERR_OPEN) {
                         perror("Loi mo file");
                         continue;
+                    } else if (err != LOAD_OK) {
+                        printf("Loi: %s: %s\n", filename, loadErrorName(err));
+                        continue;
                     }
-                    
-                    double x, y;
-                    while (fscanf(f, "%lf %lf", &x, &y) == 2) {
-                        addDataPoint(&data, x, y);
-                        if (data.size % 1000 == 0) {
-                            printf("Da doc %d diem...\n", data.size);
-                        }
-                    }
-                    fclose(f);
+                    printLoadReport(stdout, filename, &report);
                     printf("Da doc duoc %d diem tu file.\n", data.size);
                     break;
                 }
@@ -556,7 +1447,8 @@ int main() {
     if (data.size == 0) {
         printf("Khong co du lieu de xu ly.\n");
         freeDataset(&data);
-        fclose(logFile);
+        freeWorkspace(&ws);
+        closeLogSink(logSink);
         return 0;
     }
 
@@ -569,31 +1461,81 @@ int main() {
             
             switch (choice) {
                 case 1:
-                    linearRegression(&data, logFile);
+                    linearRegression(&data, &ws, &output, logSink);
                     break;
                 case 2:
-                    logRegression(&data, logFile);
+                    logRegression(&data, &ws, &output, logSink);
                     break;
                 case 3:
-                    exponentialRegression(&data, logFile);
+                    exponentialRegression(&data, &ws, &output, logSink);
                     break;
                 case 4:
-                    quadraticRegression(&data, logFile);
+                    quadraticRegression(&data, &ws, &output, logSink);
                     break;
                 case 5: {
-                    printf("Nhap bac da thuc (toi da %d): ", data.size-1);
+                    int maxDegree = data.size - 1 < MAX_POLY_DEGREE ? data.size - 1 : MAX_POLY_DEGREE;
+                    printf("Nhap bac da thuc (toi da %d): ", maxDegree);
                     int degree;
-                    if (scanf("%d", &degree) != 1 || degree < 1 || degree > data.size-1) {
+                    if (scanf("%d", &degree) != 1 || degree < 1 || degree > maxDegree) {
                         printf("Bac da thuc khong hop le!\n");
                         clearInputBuffer();
                         break;
                     }
-                    polyRegression(&data, degree, logFile);
+                    polyRegression(&data, degree, &ws, &output, logSink);
                     break;
                 }
                 case 6:
                     displayInputData(&data);
                     break;
+                case 7:
+                    chooseOutputLevel(&output);
+                    break;
+                case 8: {
+                    if (data.size < 2) {
+                        printf("Can it nhat 2 diem de chon mo hinh!\n");
+                        break;
+                    }
+                    int maxDegree = data.size - 1 < MAX_POLY_DEGREE ? data.size - 1 : MAX_POLY_DEGREE;
+                    printf("Nhap bac da thuc lon nhat can thu (toi da %d): ", maxDegree);
+                    int degree;
+                    if (scanf("%d", &degree) != 1 || degree < 1 || degree > maxDegree) {
+                        printf("Bac da thuc khong hop le!\n");
+                        clearInputBuffer();
+                        break;
+                    }
+                    printf("Tieu chi (aic, bic, adjr2, r2): ");
+                    char name[16];
+                    int criterion = scanf("%15s", name) == 1 ? parseCriterion(name) : -1;
+                    clearInputBuffer();
+                    if (criterion < 0) {
+                        printf("Tieu chi khong hop le!\n");
+                        break;
+                    }
+                    autoRegression(&data, degree, criterion, &ws, &output, logSink);
+                    break;
+                }
+                case 9: {
+                    int maxDegree = data.size - 1 < MAX_POLY_DEGREE ? data.size - 1 : MAX_POLY_DEGREE;
+                    printf("Bac da thuc (1: tuyen tinh, 2: bac hai, toi da %d): ", maxDegree);
+                    int degree;
+                    if (scanf("%d", &degree) != 1 || degree < 1 || degree > maxDegree) {
+                        printf("Bac da thuc khong hop le!\n");
+                        clearInputBuffer();
+                        break;
+                    }
+                    printf("Ham mat mat (huber, tukey): ");
+                    char name[16];
+                    int loss = scanf("%15s", name) == 1 ? parseRobust(name) : -1;
+                    clearInputBuffer();
+                    if (loss <= ROBUST_NONE) {
+                        printf("Ham mat mat khong hop le!\n");
+                        break;
+                    }
+                    ModelSpec spec = {degree == 1 ? MODEL_LINEAR : degree == 2 ? MODEL_QUADRATIC : MODEL_POLY,
+                                      degree};
+                    robustRegression(&data, &spec, loss, &ws, &output, logSink);
+                    break;
+                }
                 case 0:
                     printf("Tam biet!\n");
                     break;
@@ -601,12 +1543,13 @@ int main() {
                     printf("Lua chon khong hop le!\n");
             }
         } else {
-            printf("Vui long nhap so tu 0 den 6!\n");
+            printf("Vui long nhap so tu 0 den 9!\n");
             clearInputBuffer();
         }
     } while (choice != 0);
 
     freeDataset(&data);
-    fclose(logFile);
+    freeWorkspace(&ws);
+    closeLogSink(logSink);
     return 0;
 }
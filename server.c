@@ -0,0 +1,889 @@
+// Máy chủ khớp qua Unix domain socket (--serve) và các hàm client tương ứng.
+// Mỗi kết nối có một luồng đọc/ghi; một luồng điều phối duy nhất lấy hết các
+// yêu cầu đang chờ, gộp yêu cầu nhỏ thành lô fitSeriesBatch và khớp tất cả trên
+// nhóm luồng của parallelFor (nên parallelFor không bao giờ bị gọi đồng thời).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "lsq.h"
+#include "server.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+const char *serverStatusName(int status) {
+    switch (status) {
+        case SERVER_OK: return "ok";
+        case SERVER_ERR_PROTOCOL: return "yeu cau khong dung giao thuc";
+        case SERVER_ERR_MODEL: return "mo hinh hoac bo giai khong hop le";
+        case SERVER_ERR_TOO_LARGE: return "yeu cau qua lon";
+        case SERVER_ERR_LOAD: return "khong doc duoc file";
+        case SERVER_ERR_DATA: return "trong so khong hop le";
+        case SERVER_ERR_NO_MEMORY: return "khong du bo nho";
+        case SERVER_ERR_STOPPING: return "may chu dang dung";
+        case SERVER_ERR_IO: return "loi ket noi";
+    }
+    return "loi khong xac dinh";
+}
+
+#ifdef _WIN32
+
+int runServer(const char *socketPath, const ServerOptions *opt) {
+    (void)socketPath;
+    (void)opt;
+    fprintf(stderr, "Che do may chu can Unix domain socket, chua ho tro tren Windows.\n");
+    return 1;
+}
+
+int serverConnect(const char *socketPath) {
+    (void)socketPath;
+    errno = ENOSYS;
+    return -1;
+}
+
+void serverClose(int fd) {
+    (void)fd;
+}
+
+int serverCall(int fd, const ServerRequest *req, const void *payload, size_t payloadBytes,
+               ServerResponse *resp, void **body) {
+    (void)fd; (void)req; (void)payload; (void)payloadBytes; (void)resp;
+    *body = NULL;
+    errno = ENOSYS;
+    return SERVER_ERR_IO;
+}
+
+#else
+
+// Số yêu cầu tối đa một lượt điều phối lấy ra khỏi hàng đợi
+#define SERVER_QUEUE_MAX 4096
+
+// Số mẫu độ trễ gần nhất giữ lại để tính phân vị
+#define SERVER_LATENCY_SAMPLES 65536
+
+// ===== Đọc/ghi trọn vẹn =====
+
+// Trả về 0, hoặc -1 nếu lỗi hay kết nối đóng trước khi đủ len byte
+static int readFull(int fd, void *buf, size_t len) {
+    char *p = (char*)buf;
+    while (len > 0) {
+        ssize_t r = read(fd, p, len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        len -= (size_t)r;
+    }
+    return 0;
+}
+
+static int writeFull(int fd, const void *buf, size_t len) {
+    const char *p = (const char*)buf;
+    while (len > 0) {
+        ssize_t r = write(fd, p, len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        p += r;
+        len -= (size_t)r;
+    }
+    return 0;
+}
+
+// ===== Trạng thái máy chủ =====
+
+typedef struct ServerJob {
+    ServerRequest req;
+    ModelSpec models[MAX_MODELS];
+    int modelCount;
+    double *data;               // nội tuyến: x, y (, w) liền nhau
+    char path[SERVER_MAX_PATH + 1];
+    // Do luồng điều phối ghi
+    FitResult results[MAX_MODELS];
+    ServerResponse resp;
+    unsigned char *body;
+    int done;
+    struct ServerJob *next;
+} ServerJob;
+
+// Dataset giữ lại giữa các yêu cầu; chỉ luồng điều phối đọc/ghi
+typedef struct {
+    char *path;
+    int loadFlags;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    Dataset ds;
+    size_t bytes;
+    unsigned long long lastUse;
+} Resident;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;       // có yêu cầu mới hoặc bắt đầu dừng
+    pthread_cond_t done;        // một lượt điều phối vừa xong
+    ServerJob *head, *tail;
+    int stopping;
+    int clients;
+    const char *socketPath;
+    ServerOptions opt;
+    // Thống kê (giữ khóa)
+    long long requests, batches, batched;
+    int residentCount;
+    double latency[SERVER_LATENCY_SAMPLES];
+    long long latencyCount;
+} srv = {.lock = PTHREAD_MUTEX_INITIALIZER, .ready = PTHREAD_COND_INITIALIZER,
+         .done = PTHREAD_COND_INITIALIZER};
+
+static volatile sig_atomic_t stopSignal = 0;
+
+static void onStopSignal(int sig) {
+    (void)sig;
+    stopSignal = 1;
+}
+
+// Tạo luồng với SIGINT/SIGTERM bị chặn, để tín hiệu luôn tới luồng accept
+static int startThread(pthread_t *tid, void *(*fn)(void*), void *arg) {
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    int rc = pthread_create(tid, NULL, fn, arg);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return rc;
+}
+
+static void recordLatency(double seconds) {
+    pthread_mutex_lock(&srv.lock);
+    srv.latency[srv.latencyCount % SERVER_LATENCY_SAMPLES] = seconds;
+    srv.latencyCount++;
+    srv.requests++;
+    pthread_mutex_unlock(&srv.lock);
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Ghi thống kê hiện tại vào stats[SERVER_STAT_*]; trả về -1 nếu không đủ bộ nhớ
+static int collectStats(double stats[SERVER_STAT_COUNT]) {
+    double *sorted = (double*)malloc(SERVER_LATENCY_SAMPLES * sizeof(double));
+    if (!sorted) return -1;
+    pthread_mutex_lock(&srv.lock);
+    int n = srv.latencyCount < SERVER_LATENCY_SAMPLES ? (int)srv.latencyCount : SERVER_LATENCY_SAMPLES;
+    memcpy(sorted, srv.latency, (size_t)n * sizeof(double));
+    stats[SERVER_STAT_REQUESTS] = (double)srv.requests;
+    stats[SERVER_STAT_BATCHES] = (double)srv.batches;
+    stats[SERVER_STAT_BATCHED] = (double)srv.batched;
+    stats[SERVER_STAT_RESIDENT] = srv.residentCount;
+    pthread_mutex_unlock(&srv.lock);
+
+    qsort(sorted, (size_t)n, sizeof(double), compareDouble);
+    stats[SERVER_STAT_P50] = n > 0 ? sorted[(n - 1) / 2] : NAN;
+    stats[SERVER_STAT_P99] = n > 0 ? sorted[(int)((n - 1) * 0.99)] : NAN;
+    stats[SERVER_STAT_MAX] = n > 0 ? sorted[n - 1] : NAN;
+    free(sorted);
+    return 0;
+}
+
+// ===== Dataset giữ lại =====
+
+static Resident *residents;
+static int residentCount, residentCapacity;
+static size_t residentBytes;
+static unsigned long long residentClock;
+
+static void dropResident(int i) {
+    freeDataset(&residents[i].ds);
+    free(residents[i].path);
+    residentBytes -= residents[i].bytes;
+    residents[i] = residents[--residentCount];
+}
+
+// Đẩy các dataset ít dùng nhất ra cho tới khi tổng bộ nhớ không vượt giới hạn
+static void trimResidents(size_t limit) {
+    while (residentCount > 0 && residentBytes > limit) {
+        int oldest = 0;
+        for (int i = 1; i < residentCount; i++) {
+            if (residents[i].lastUse < residents[oldest].lastUse) oldest = i;
+        }
+        dropResident(oldest);
+    }
+    pthread_mutex_lock(&srv.lock);
+    srv.residentCount = residentCount;
+    pthread_mutex_unlock(&srv.lock);
+}
+
+// Dataset của file path (đọc lại nếu file đã đổi); trả về LOAD_OK hoặc LOAD_ERR_*
+static int residentDataset(const char *path, int loadFlags, Dataset **out) {
+    struct stat st;
+    if (stat(path, &st) != 0) return LOAD_ERR_OPEN;
+    for (int i = 0; i < residentCount; i++) {
+        Resident *r = &residents[i];
+        if (r->loadFlags != loadFlags || strcmp(r->path, path) != 0) continue;
+        if (r->dev == st.st_dev && r->ino == st.st_ino && r->size == st.st_size &&
+            r->mtime == st.st_mtime) {
+            r->lastUse = ++residentClock;
+            *out = &r->ds;
+            return LOAD_OK;
+        }
+        dropResident(i);
+        break;
+    }
+
+    if (residentCount == residentCapacity) {
+        int capacity = residentCapacity ? 2 * residentCapacity : 16;
+        Resident *grown = (Resident*)realloc(residents, (size_t)capacity * sizeof(Resident));
+        if (!grown) return LOAD_ERR_NO_MEMORY;
+        residents = grown;
+        residentCapacity = capacity;
+    }
+    Resident *r = &residents[residentCount];
+    memset(r, 0, sizeof(*r));
+    r->path = strdup(path);
+    if (!r->path) return LOAD_ERR_NO_MEMORY;
+    initDataset(&r->ds);
+    LoadReport report;
+    int err = loadDatasetFile(path, &r->ds, &report, loadFlags);
+    if (err != LOAD_OK) {
+        freeDataset(&r->ds);
+        free(r->path);
+        return err;
+    }
+    int columns = (r->ds.features > 0 ? r->ds.features : 1) + 1 + (r->ds.w ? 1 : 0);
+    r->loadFlags = loadFlags;
+    r->dev = st.st_dev;
+    r->ino = st.st_ino;
+    r->size = st.st_size;
+    r->mtime = st.st_mtime;
+    r->bytes = (size_t)r->ds.capacity * columns * sizeof(double);
+    r->lastUse = ++residentClock;
+    residentBytes += r->bytes;
+    residentCount++;
+    *out = &r->ds;
+    return LOAD_OK;
+}
+
+// ===== Điều phối =====
+
+// Yêu cầu nội tuyến đủ nhỏ để gộp vào lô fitSeriesBatch
+static int batchable(const ServerJob *job) {
+    if (job->req.count == 0 || job->req.count > SERVER_BATCH_POINTS) return 0;
+    if ((job->req.loadFlags & LOAD_WEIGHTS) || job->req.solver != SOLVER_NORMAL) return 0;
+    for (int k = 0; k < job->modelCount; k++) {
+        if (job->models[k].kind == MODEL_MULTI) return 0;
+    }
+    return 1;
+}
+
+static int sameSpec(const ModelSpec *a, const ModelSpec *b) {
+    return a->kind == b->kind && a->degree == b->degree;
+}
+
+// Gộp mọi cặp (yêu cầu, mô hình) có cùng mô hình thành một lô; kết quả trỏ vào ws.
+// Trả về số lô, hoặc -1 nếu không đủ bộ nhớ (các yêu cầu chưa khớp giữ status lỗi).
+static int fitBatches(ServerJob **jobs, int count, FitWorkspace *ws) {
+    int batches = 0;
+    for (int j = 0; j < count; j++) {
+        for (int k = 0; k < jobs[j]->modelCount; k++) {
+            if (jobs[j]->results[k].coeff) continue;
+            const ModelSpec *spec = &jobs[j]->models[k];
+
+            int members = 0;
+            long long points = 0;
+            for (int a = j; a < count; a++) {
+                for (int b = 0; b < jobs[a]->modelCount; b++) {
+                    if (!jobs[a]->results[b].coeff && sameSpec(&jobs[a]->models[b], spec)) {
+                        members++;
+                        points += jobs[a]->req.count;
+                    }
+                }
+            }
+            int width = coeffCount(spec);
+            double *x = (double*)wsAlloc(ws, (size_t)points * sizeof(double));
+            double *y = (double*)wsAlloc(ws, (size_t)points * sizeof(double));
+            double *coeff = (double*)wsAlloc(ws, (size_t)members * width * sizeof(double));
+            double *r2 = (double*)wsAlloc(ws, (size_t)members * sizeof(double));
+            int *offsets = (int*)wsAlloc(ws, (size_t)(members + 1) * sizeof(int));
+            int *status = (int*)wsAlloc(ws, (size_t)members * sizeof(int));
+            if (!x || !y || !coeff || !r2 || !offsets || !status) return -1;
+
+            int s = 0;
+            offsets[0] = 0;
+            for (int a = j; a < count; a++) {
+                for (int b = 0; b < jobs[a]->modelCount; b++) {
+                    if (jobs[a]->results[b].coeff || !sameSpec(&jobs[a]->models[b], spec)) continue;
+                    int n = (int)jobs[a]->req.count;
+                    memcpy(x + offsets[s], jobs[a]->data, (size_t)n * sizeof(double));
+                    memcpy(y + offsets[s], jobs[a]->data + n, (size_t)n * sizeof(double));
+                    offsets[s + 1] = offsets[s] + n;
+                    s++;
+                }
+            }
+            SeriesBatch batch = {x, y, offsets, members};
+            fitSeriesBatch(&batch, spec, coeff, r2, status);
+
+            s = 0;
+            for (int a = j; a < count; a++) {
+                for (int b = 0; b < jobs[a]->modelCount; b++) {
+                    FitResult *res = &jobs[a]->results[b];
+                    if (res->coeff || !sameSpec(&jobs[a]->models[b], spec)) continue;
+                    res->status = status[s];
+                    res->r2 = r2[s];
+                    res->coeff = coeff + (size_t)s * width;
+                    s++;
+                }
+            }
+            batches++;
+        }
+    }
+    return batches;
+}
+
+// Khớp một yêu cầu không gộp được (điểm nhiều, có trọng số, QR, multi, hoặc file)
+static void fitSingle(ServerJob *job, FitWorkspace *ws) {
+    if (job->req.count > 0) {
+        int n = (int)job->req.count;
+        const double *w = (job->req.loadFlags & LOAD_WEIGHTS) ? job->data + 2 * (size_t)n : NULL;
+        DatasetView view = {job->data, job->data + n, n, w, NULL, 0, 0};
+        if (fitModels(&view, job->models, job->modelCount, job->req.solver, ws, job->results) != FIT_OK) {
+            job->resp.status = SERVER_ERR_NO_MEMORY;
+        }
+        return;
+    }
+    Dataset *ds;
+    int err = residentDataset(job->path, (int)job->req.loadFlags, &ds);
+    if (err != LOAD_OK) {
+        job->resp.status = SERVER_ERR_LOAD;
+        job->resp.loadError = err;
+        return;
+    }
+    DatasetView view = datasetView(ds);
+    if (fitModels(&view, job->models, job->modelCount, job->req.solver, ws, job->results) != FIT_OK) {
+        job->resp.status = SERVER_ERR_NO_MEMORY;
+    }
+}
+
+// Đóng gói kết quả thành thân trả lời: mỗi mô hình một ServerFitRecord và coeffCount
+// hệ số (NaN khi khớp lỗi)
+static void encodeResults(ServerJob *job) {
+    if (job->resp.status != SERVER_OK) return;
+    size_t bytes = 0;
+    for (int k = 0; k < job->modelCount; k++) {
+        bytes += sizeof(ServerFitRecord) + (size_t)job->results[k].coeffCount * sizeof(double);
+    }
+    job->body = (unsigned char*)malloc(bytes);
+    if (!job->body) {
+        job->resp.status = SERVER_ERR_NO_MEMORY;
+        return;
+    }
+    unsigned char *p = job->body;
+    for (int k = 0; k < job->modelCount; k++) {
+        const FitResult *res = &job->results[k];
+        ServerFitRecord rec;
+        rec.kind = res->model.kind;
+        rec.degree = res->model.degree;
+        rec.status = res->status;
+        rec.coeffCount = res->coeffCount;
+        rec.n = res->n;
+        rec.r2 = res->r2;
+        rec.cond = res->cond;
+        memcpy(p, &rec, sizeof(rec));
+        p += sizeof(rec);
+        for (int i = 0; i < res->coeffCount; i++) {
+            double c = res->status == FIT_OK ? res->coeff[i] : NAN;
+            memcpy(p, &c, sizeof(c));
+            p += sizeof(c);
+        }
+    }
+    job->resp.count = (uint32_t)job->modelCount;
+    job->resp.bodyBytes = bytes;
+}
+
+// Khớp một lượt yêu cầu: các yêu cầu nhỏ theo lô trước, rồi từng yêu cầu còn lại
+static void runJobs(ServerJob **jobs, int count, FitWorkspace *ws) {
+    ServerJob **small = (ServerJob**)wsAlloc(ws, (size_t)count * sizeof(ServerJob*));
+    int smallCount = 0;
+    for (int j = 0; j < count; j++) {
+        ServerJob *job = jobs[j];
+        for (int k = 0; k < job->modelCount; k++) {
+            FitResult *res = &job->results[k];
+            memset(res, 0, sizeof(*res));
+            res->model = job->models[k];
+            res->n = job->req.count;
+            res->coeffCount = coeffCount(&job->models[k]);
+            res->status = FIT_ERR_NO_MEMORY;
+            res->r2 = res->cond = NAN;
+        }
+        if (small && batchable(job)) small[smallCount++] = job;
+    }
+
+    int batches = smallCount > 0 ? fitBatches(small, smallCount, ws) : 0;
+    for (int j = 0; j < count; j++) {
+        ServerJob *job = jobs[j];
+        if (small && batchable(job)) {
+            if (batches < 0) job->resp.status = SERVER_ERR_NO_MEMORY;
+        } else {
+            fitSingle(job, ws);
+        }
+        encodeResults(job);
+    }
+    trimResidents(srv.opt.residentBytes);
+
+    pthread_mutex_lock(&srv.lock);
+    if (batches > 0) {
+        srv.batches += batches;
+        srv.batched += smallCount;
+    }
+    pthread_mutex_unlock(&srv.lock);
+}
+
+static void *dispatchThread(void *arg) {
+    (void)arg;
+    FitWorkspace ws;
+    initWorkspace(&ws);
+    ServerJob *jobs[SERVER_QUEUE_MAX];
+    pthread_mutex_lock(&srv.lock);
+    for (;;) {
+        while (!srv.head && !srv.stopping) pthread_cond_wait(&srv.ready, &srv.lock);
+        if (!srv.head) break;
+        int count = 0;
+        while (srv.head && count < SERVER_QUEUE_MAX) {
+            jobs[count++] = srv.head;
+            srv.head = srv.head->next;
+        }
+        if (!srv.head) srv.tail = NULL;
+        pthread_mutex_unlock(&srv.lock);
+
+        runJobs(jobs, count, &ws);
+        wsReset(&ws);
+
+        pthread_mutex_lock(&srv.lock);
+        for (int j = 0; j < count; j++) jobs[j]->done = 1;
+        pthread_cond_broadcast(&srv.done);
+    }
+    pthread_mutex_unlock(&srv.lock);
+    freeWorkspace(&ws);
+    return NULL;
+}
+
+// Đưa yêu cầu vào hàng đợi và chờ luồng điều phối khớp xong
+static void submitJob(ServerJob *job) {
+    pthread_mutex_lock(&srv.lock);
+    if (srv.stopping) {
+        pthread_mutex_unlock(&srv.lock);
+        job->resp.status = SERVER_ERR_STOPPING;
+        return;
+    }
+    job->next = NULL;
+    job->done = 0;
+    if (srv.tail) srv.tail->next = job;
+    else srv.head = job;
+    srv.tail = job;
+    pthread_cond_signal(&srv.ready);
+    while (!job->done) pthread_cond_wait(&srv.done, &srv.lock);
+    pthread_mutex_unlock(&srv.lock);
+}
+
+// Bắt đầu dừng: không nhận yêu cầu mới, đánh thức luồng điều phối và accept
+static void requestStop(void) {
+    pthread_mutex_lock(&srv.lock);
+    int first = !srv.stopping;
+    srv.stopping = 1;
+    pthread_cond_broadcast(&srv.ready);
+    pthread_mutex_unlock(&srv.lock);
+    if (first) {
+        int fd = serverConnect(srv.socketPath);
+        if (fd >= 0) close(fd);
+    }
+}
+
+// ===== Kết nối =====
+
+// Đọc phần còn lại của yêu cầu sau header; trả về SERVER_OK hoặc mã lỗi.
+// SERVER_ERR_PROTOCOL / SERVER_ERR_TOO_LARGE: luồng byte không còn đồng bộ.
+static int readRequestBody(int fd, ServerJob *job) {
+    const ServerRequest *req = &job->req;
+    if (memcmp(req->magic, SERVER_REQUEST_MAGIC, 4) != 0 || req->type > SERVER_REQ_SHUTDOWN) {
+        return SERVER_ERR_PROTOCOL;
+    }
+    if (req->type != SERVER_REQ_FIT) return SERVER_OK;
+    if (req->count > SERVER_MAX_INLINE || req->pathLength > SERVER_MAX_PATH) return SERVER_ERR_TOO_LARGE;
+    if (req->count == 0) {
+        if (req->pathLength == 0 || readFull(fd, job->path, req->pathLength) != 0) return SERVER_ERR_PROTOCOL;
+        job->path[req->pathLength] = '\0';
+    } else {
+        size_t values = (size_t)req->count * ((req->loadFlags & LOAD_WEIGHTS) ? 3 : 2);
+        job->data = (double*)malloc(values * sizeof(double));
+        if (!job->data) return SERVER_ERR_TOO_LARGE;
+        if (readFull(fd, job->data, values * sizeof(double)) != 0) return SERVER_ERR_PROTOCOL;
+    }
+
+    if (!memchr(req->models, '\0', SERVER_MODELS_LEN) || req->solver < SOLVER_NORMAL ||
+        req->solver > SOLVER_QR_ORTHO) {
+        return SERVER_ERR_MODEL;
+    }
+    job->modelCount = parseModelList(req->models, job->models, MAX_MODELS);
+    if (job->modelCount <= 0) return SERVER_ERR_MODEL;
+    if (req->count > 0 && (req->loadFlags & LOAD_WEIGHTS)) {
+        const double *w = job->data + 2 * (size_t)req->count;
+        for (uint32_t i = 0; i < req->count; i++) {
+            if (!(w[i] >= 0 && isfinite(w[i]))) return SERVER_ERR_DATA;
+        }
+    }
+    return SERVER_OK;
+}
+
+static int sendResponse(int fd, const ServerResponse *resp, const void *body) {
+    if (writeFull(fd, resp, sizeof(*resp)) != 0) return -1;
+    if (resp->bodyBytes > 0 && writeFull(fd, body, (size_t)resp->bodyBytes) != 0) return -1;
+    return 0;
+}
+
+static void *clientThread(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    ServerJob *job = (ServerJob*)malloc(sizeof(ServerJob));
+    int alive = job != NULL;
+    while (alive) {
+        memset(job, 0, sizeof(*job));
+        if (readFull(fd, &job->req, sizeof(job->req)) != 0) break;
+        double t0 = nowSeconds();
+        memcpy(job->resp.magic, SERVER_RESPONSE_MAGIC, 4);
+        int status = readRequestBody(fd, job);
+        job->resp.status = status;
+        double stats[SERVER_STAT_COUNT];
+        if (status != SERVER_OK) {
+            alive = status != SERVER_ERR_PROTOCOL && status != SERVER_ERR_TOO_LARGE;
+        } else if (job->req.type == SERVER_REQ_SHUTDOWN) {
+            alive = 0;
+        } else if (job->req.type == SERVER_REQ_STATS) {
+            if (collectStats(stats) == 0) {
+                job->resp.count = SERVER_STAT_COUNT;
+                job->resp.bodyBytes = sizeof(stats);
+            } else {
+                job->resp.status = SERVER_ERR_NO_MEMORY;
+            }
+        } else {
+            submitJob(job);
+        }
+
+        const void *body = job->req.type == SERVER_REQ_STATS ? (const void*)stats : job->body;
+        if (sendResponse(fd, &job->resp, body) != 0) alive = 0;
+        if (job->req.type == SERVER_REQ_FIT && status == SERVER_OK) recordLatency(nowSeconds() - t0);
+        if (job->req.type == SERVER_REQ_SHUTDOWN && status == SERVER_OK) requestStop();
+        free(job->data);
+        free(job->body);
+    }
+    free(job);
+    close(fd);
+    pthread_mutex_lock(&srv.lock);
+    srv.clients--;
+    pthread_mutex_unlock(&srv.lock);
+    return NULL;
+}
+
+// Mở socket nghe tại path; socket cũ chỉ bị xóa khi không còn máy chủ nào nghe
+static int listenSocket(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        int other = S_ISSOCK(st.st_mode) ? serverConnect(path) : -1;
+        if (!S_ISSOCK(st.st_mode) || other >= 0) {
+            if (other >= 0) close(other);
+            errno = EADDRINUSE;
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    // Chỉ người dùng hiện tại được kết nối
+    mode_t oldMask = umask(077);
+    int rc = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    umask(oldMask);
+    if (rc != 0 || listen(fd, 128) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+// Chạy máy chủ cho tới SIGINT/SIGTERM hoặc yêu cầu SERVER_REQ_SHUTDOWN;
+// trả về 0, hoặc 1 nếu không mở được socket
+int runServer(const char *socketPath, const ServerOptions *opt) {
+    int listenFd = listenSocket(socketPath);
+    if (listenFd < 0) {
+        fprintf(stderr, "Loi mo socket %s: %s\n", socketPath, strerror(errno));
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onStopSignal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);     // không SA_RESTART: accept bị ngắt và trả về EINTR
+    sigaction(SIGTERM, &sa, NULL);
+
+    srv.head = srv.tail = NULL;
+    srv.stopping = 0;
+    srv.clients = 0;
+    srv.socketPath = socketPath;
+    srv.opt = *opt;
+    srv.requests = srv.batches = srv.batched = srv.latencyCount = 0;
+    srv.residentCount = 0;
+    stopSignal = 0;
+
+    pthread_t dispatcher;
+    if (startThread(&dispatcher, dispatchThread, NULL) != 0) {
+        fprintf(stderr, "Loi: khong tao duoc luong dieu phoi\n");
+        close(listenFd);
+        unlink(socketPath);
+        return 1;
+    }
+    fprintf(stderr, "May chu dang nghe tai %s (%d luong tinh toan)\n", socketPath, getThreadCount());
+
+    for (;;) {
+        int fd = accept(listenFd, NULL, NULL);
+        pthread_mutex_lock(&srv.lock);
+        int stopping = srv.stopping;
+        int full = srv.clients >= srv.opt.maxClients;
+        if (fd >= 0 && !stopping && !full) srv.clients++;
+        pthread_mutex_unlock(&srv.lock);
+        if (stopSignal && !stopping) {
+            requestStop();
+            stopping = 1;
+        }
+        if (fd < 0) {
+            if (stopping) break;
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "Loi accept: %s\n", strerror(errno));
+            requestStop();
+            break;
+        }
+        if (stopping || full) {
+            close(fd);
+            if (stopping) break;
+            continue;
+        }
+        pthread_t tid;
+        if (startThread(&tid, clientThread, (void*)(intptr_t)fd) != 0) {
+            close(fd);
+            pthread_mutex_lock(&srv.lock);
+            srv.clients--;
+            pthread_mutex_unlock(&srv.lock);
+            continue;
+        }
+        pthread_detach(tid);
+    }
+
+    pthread_join(dispatcher, NULL);
+    close(listenFd);
+    unlink(socketPath);
+
+    double stats[SERVER_STAT_COUNT];
+    if (collectStats(stats) == 0) {
+        fprintf(stderr, "Da tra loi %.0f yeu cau (%.0f theo %.0f lo), p50 = %.1f us, p99 = %.1f us\n",
+                stats[SERVER_STAT_REQUESTS], stats[SERVER_STAT_BATCHED], stats[SERVER_STAT_BATCHES],
+                stats[SERVER_STAT_P50] * 1e6, stats[SERVER_STAT_P99] * 1e6);
+    }
+    while (residentCount > 0) dropResident(residentCount - 1);
+    free(residents);
+    residents = NULL;
+    residentCapacity = 0;
+    return 0;
+}
+
+// ===== Client =====
+
+// Trả về fd đã kết nối, hoặc -1 (errno)
+int serverConnect(const char *socketPath) {
+    struct sockaddr_un addr;
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+void serverClose(int fd) {
+    if (fd >= 0) close(fd);
+}
+
+// Gửi một yêu cầu và nhận trả lời; *body (malloc, bên gọi giải phóng, NULL nếu
+// rỗng) chứa resp->bodyBytes byte. Trả về SERVER_ERR_IO nếu đứt kết nối, còn
+// lại resp->status.
+int serverCall(int fd, const ServerRequest *req, const void *payload, size_t payloadBytes,
+               ServerResponse *resp, void **body) {
+    *body = NULL;
+    if (writeFull(fd, req, sizeof(*req)) != 0) return SERVER_ERR_IO;
+    if (payloadBytes > 0 && writeFull(fd, payload, payloadBytes) != 0) return SERVER_ERR_IO;
+    if (readFull(fd, resp, sizeof(*resp)) != 0 || memcmp(resp->magic, SERVER_RESPONSE_MAGIC, 4) != 0) {
+        return SERVER_ERR_IO;
+    }
+    if (resp->bodyBytes > 0) {
+        *body = malloc((size_t)resp->bodyBytes);
+        if (!*body || readFull(fd, *body, (size_t)resp->bodyBytes) != 0) {
+            free(*body);
+            *body = NULL;
+            return SERVER_ERR_IO;
+        }
+    }
+    return resp->status;
+}
+#endif
+
+// Header yêu cầu khớp với danh sách mô hình dạng văn bản
+static int fitRequest(ServerRequest *req, int solver, const ModelSpec specs[], int count) {
+    memset(req, 0, sizeof(*req));
+    memcpy(req->magic, SERVER_REQUEST_MAGIC, 4);
+    req->type = SERVER_REQ_FIT;
+    req->solver = solver;
+    size_t used = 0;
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        formatModelSpec(&specs[i], name, sizeof(name));
+        size_t len = strlen(name);
+        if (used + len + 2 > SERVER_MODELS_LEN) return SERVER_ERR_MODEL;
+        if (i > 0) req->models[used++] = ',';
+        memcpy(req->models + used, name, len);
+        used += len;
+    }
+    return SERVER_OK;
+}
+
+// Giải mã trả lời khớp vào results[] (hệ số trong ws) như fitModels
+static int decodeResults(const ServerResponse *resp, const unsigned char *body, int count,
+                         FitWorkspace *ws, FitResult results[]) {
+    const unsigned char *p = body, *end = body + resp->bodyBytes;
+    if ((int)resp->count != count) return SERVER_ERR_PROTOCOL;
+    for (int i = 0; i < count; i++) {
+        ServerFitRecord rec;
+        if ((size_t)(end - p) < sizeof(rec)) return SERVER_ERR_PROTOCOL;
+        memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+        if (rec.coeffCount < 0 || (size_t)(end - p) / sizeof(double) < (size_t)rec.coeffCount) {
+            return SERVER_ERR_PROTOCOL;
+        }
+        FitResult *res = &results[i];
+        memset(res, 0, sizeof(*res));
+        res->model.kind = rec.kind;
+        res->model.degree = rec.degree;
+        res->status = rec.status;
+        res->n = rec.n;
+        res->r2 = rec.r2;
+        res->cond = rec.cond;
+        res->coeffCount = rec.coeffCount;
+        res->coeff = (double*)wsAlloc(ws, ((size_t)rec.coeffCount + 1) * sizeof(double));
+        if (!res->coeff) return SERVER_ERR_NO_MEMORY;
+        memcpy(res->coeff, p, (size_t)rec.coeffCount * sizeof(double));
+        p += (size_t)rec.coeffCount * sizeof(double);
+    }
+    return SERVER_OK;
+}
+
+static int callFit(int fd, const ServerRequest *req, const void *payload, size_t payloadBytes,
+                   int count, FitWorkspace *ws, FitResult results[], int *loadError) {
+    ServerResponse resp;
+    void *body;
+    int status = serverCall(fd, req, payload, payloadBytes, &resp, &body);
+    if (loadError) *loadError = status == SERVER_ERR_LOAD ? resp.loadError : LOAD_OK;
+    if (status == SERVER_OK) status = decodeResults(&resp, (const unsigned char*)body, count, ws, results);
+    free(body);
+    return status;
+}
+
+// Khớp các điểm của ds trên máy chủ (ds->X bị bỏ qua: chỉ gửi x, y, w).
+// Kết quả như fitModels, trừ các thống kê ngoài R^2 và số điều kiện (NAN).
+// Trả về SERVER_OK hoặc SERVER_ERR_*.
+int serverFitPoints(int fd, const DatasetView *ds, int solver, const ModelSpec specs[], int count,
+                    FitWorkspace *ws, FitResult results[]) {
+    ServerRequest req;
+    if (ds->size <= 0 || ds->size > SERVER_MAX_INLINE) return SERVER_ERR_TOO_LARGE;
+    if (fitRequest(&req, solver, specs, count) != SERVER_OK) return SERVER_ERR_MODEL;
+    req.count = (uint32_t)ds->size;
+    req.loadFlags = ds->w ? LOAD_WEIGHTS : 0;
+
+    size_t n = (size_t)ds->size, columns = ds->w ? 3 : 2;
+    size_t mark = wsMark(ws);
+    double *payload = (double*)wsAlloc(ws, n * columns * sizeof(double));
+    if (!payload) return SERVER_ERR_NO_MEMORY;
+    memcpy(payload, ds->x, n * sizeof(double));
+    memcpy(payload + n, ds->y, n * sizeof(double));
+    if (ds->w) memcpy(payload + 2 * n, ds->w, n * sizeof(double));
+    int status = callFit(fd, &req, payload, n * columns * sizeof(double), count, ws, results, NULL);
+    // Hệ số nằm sau vùng dữ liệu gửi đi nên chưa trả lại được vùng đó
+    if (status != SERVER_OK) wsRelease(ws, mark);
+    return status;
+}
+
+// Khớp file trên máy chủ (đường dẫn được máy chủ mở, nên nên là đường dẫn tuyệt
+// đối); *loadError nhận mã LOAD_ERR_* khi trả về SERVER_ERR_LOAD
+int serverFitFile(int fd, const char *path, int loadFlags, int solver, const ModelSpec specs[],
+                  int count, FitWorkspace *ws, FitResult results[], int *loadError) {
+    ServerRequest req;
+    size_t len = strlen(path);
+    if (len == 0 || len > SERVER_MAX_PATH) return SERVER_ERR_TOO_LARGE;
+    if (fitRequest(&req, solver, specs, count) != SERVER_OK) return SERVER_ERR_MODEL;
+    req.pathLength = (uint32_t)len;
+    req.loadFlags = (uint32_t)loadFlags;
+    return callFit(fd, &req, path, len, count, ws, results, loadError);
+}
+
+int serverStats(int fd, double stats[SERVER_STAT_COUNT]) {
+    ServerRequest req;
+    memset(&req, 0, sizeof(req));
+    memcpy(req.magic, SERVER_REQUEST_MAGIC, 4);
+    req.type = SERVER_REQ_STATS;
+    ServerResponse resp;
+    void *body;
+    int status = serverCall(fd, &req, NULL, 0, &resp, &body);
+    if (status == SERVER_OK) {
+        if (resp.bodyBytes == SERVER_STAT_COUNT * sizeof(double)) memcpy(stats, body, (size_t)resp.bodyBytes);
+        else status = SERVER_ERR_PROTOCOL;
+    }
+    free(body);
+    return status;
+}
+
+// Yêu cầu máy chủ dừng sau khi trả lời hết các yêu cầu đang chờ
+int serverShutdown(int fd) {
+    ServerRequest req;
+    memset(&req, 0, sizeof(req));
+    memcpy(req.magic, SERVER_REQUEST_MAGIC, 4);
+    req.type = SERVER_REQ_SHUTDOWN;
+    ServerResponse resp;
+    void *body;
+    int status = serverCall(fd, &req, NULL, 0, &resp, &body);
+    free(body);
+    return status;
+}
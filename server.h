@@ -0,0 +1,114 @@
+// Chế độ máy chủ (--serve): nhận yêu cầu khớp nhị phân qua Unix domain socket
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+#include "lsq.h"
+
+// ===== Giao thức =====
+//
+// Mọi số theo thứ tự byte của máy (client và server cùng một máy). Mỗi yêu cầu
+// là một ServerRequest rồi tới phần dữ liệu; một kết nối gửi được nhiều yêu cầu
+// nối tiếp, mỗi yêu cầu nhận đúng một ServerResponse.
+//   - Khớp điểm nội tuyến (count > 0): x[count], y[count], rồi w[count] nếu
+//     loadFlags có LOAD_WEIGHTS.
+//   - Khớp file (count = 0): pathLength byte đường dẫn (không có '\0'), đọc bằng
+//     loadDatasetFile với loadFlags; dataset được giữ lại trong bộ nhớ cho các
+//     lần gọi sau cho tới khi file đổi hoặc bị đẩy ra theo --resident-mb.
+// Trả lời của SERVER_REQ_FIT: count bản ghi ServerFitRecord, mỗi bản ghi theo
+// sau bởi coeffCount hệ số (bố cục như FitResult.coeff). SERVER_REQ_STATS:
+// count giá trị double theo thứ tự SERVER_STAT_*.
+
+#define SERVER_REQUEST_MAGIC "PBLQ"
+#define SERVER_RESPONSE_MAGIC "PBLR"
+#define SERVER_MODELS_LEN 88
+
+// Giới hạn một yêu cầu (lớn hơn thì trả SERVER_ERR_TOO_LARGE)
+#define SERVER_MAX_INLINE (1 << 24)
+#define SERVER_MAX_PATH 4096
+
+// Yêu cầu nội tuyến tới chừng này điểm (một mô hình, không trọng số, bộ giải
+// normal) được gộp với các yêu cầu đang chờ khác thành lô cho fitSeriesBatch
+#define SERVER_BATCH_POINTS 4096
+
+#define SERVER_RESIDENT_DEFAULT_MB 1024
+#define SERVER_DEFAULT_CLIENTS 256
+
+enum {
+    SERVER_REQ_FIT = 0,
+    SERVER_REQ_STATS,
+    SERVER_REQ_SHUTDOWN
+};
+
+enum {
+    SERVER_OK = 0,
+    SERVER_ERR_PROTOCOL,      // header sai hoặc kết nối đứt giữa chừng
+    SERVER_ERR_MODEL,         // danh sách mô hình hoặc bộ giải không hợp lệ
+    SERVER_ERR_TOO_LARGE,     // vượt SERVER_MAX_INLINE / SERVER_MAX_PATH
+    SERVER_ERR_LOAD,          // không đọc được file; loadError là mã LOAD_ERR_*
+    SERVER_ERR_DATA,          // trọng số nội tuyến âm hoặc không hữu hạn
+    SERVER_ERR_NO_MEMORY,
+    SERVER_ERR_STOPPING,      // máy chủ đang dừng
+    SERVER_ERR_IO             // (phía client) không gửi/nhận được, xem errno
+};
+
+enum {
+    SERVER_STAT_REQUESTS = 0,   // số yêu cầu khớp đã trả lời
+    SERVER_STAT_BATCHES,        // số lần gọi fitSeriesBatch
+    SERVER_STAT_BATCHED,        // số yêu cầu được khớp theo lô
+    SERVER_STAT_RESIDENT,       // số dataset đang giữ trong bộ nhớ
+    SERVER_STAT_P50,            // độ trễ (giây) trên SERVER_LATENCY_SAMPLES yêu cầu gần nhất
+    SERVER_STAT_P99,
+    SERVER_STAT_MAX,
+    SERVER_STAT_COUNT
+};
+
+typedef struct {
+    char magic[4];
+    uint32_t type;                  // SERVER_REQ_*
+    uint32_t count;                 // số điểm nội tuyến, 0: khớp file
+    uint32_t pathLength;
+    uint32_t loadFlags;             // LOAD_*; nội tuyến chỉ dùng LOAD_WEIGHTS
+    int32_t solver;                 // SOLVER_*
+    char models[SERVER_MODELS_LEN]; // "linear,poly:3" (parseModelList), kết thúc bằng '\0'
+} ServerRequest;
+
+typedef struct {
+    char magic[4];
+    int32_t status;                 // SERVER_OK hoặc SERVER_ERR_*
+    uint32_t count;
+    int32_t loadError;
+    uint64_t bodyBytes;             // số byte theo sau header
+} ServerResponse;
+
+typedef struct {
+    int32_t kind, degree, status, coeffCount;
+    int64_t n;
+    double r2;
+    double cond;                    // nan với mô hình không phải đa thức hoặc khi khớp theo lô
+} ServerFitRecord;
+
+// ===== Máy chủ =====
+
+typedef struct {
+    size_t residentBytes;           // giới hạn bộ nhớ cho dataset giữ lại
+    int maxClients;                 // số kết nối đồng thời tối đa
+} ServerOptions;
+
+int runServer(const char *socketPath, const ServerOptions *opt);
+
+// ===== Client =====
+
+const char *serverStatusName(int status);
+int serverConnect(const char *socketPath);
+void serverClose(int fd);
+int serverCall(int fd, const ServerRequest *req, const void *payload, size_t payloadBytes,
+               ServerResponse *resp, void **body);
+int serverFitPoints(int fd, const DatasetView *ds, int solver, const ModelSpec specs[], int count,
+                    FitWorkspace *ws, FitResult results[]);
+int serverFitFile(int fd, const char *path, int loadFlags, int solver, const ModelSpec specs[],
+                  int count, FitWorkspace *ws, FitResult results[], int *loadError);
+int serverStats(int fd, double stats[SERVER_STAT_COUNT]);
+int serverShutdown(int fd);
+
+#endif